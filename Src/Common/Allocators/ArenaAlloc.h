@@ -0,0 +1,85 @@
+// ArenaAlloc.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __ArenaAlloc_h__
+#define __ArenaAlloc_h__
+
+// CArenaAlloc hands out memory by just advancing a pointer through a block.
+// Nothing is freed individually: Reset makes all the memory available again at
+// once, without running any destructors - so only use it for objects which
+// don't need them. When a block runs out, another twice the size is made; on
+// Reset, all but the newest (biggest) are freed. Hence an arena used for about
+// the same amount each time (e.g. each frame) soon stops allocating at all.
+
+#include "../NoClones.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+class CArenaAlloc : private NoClones {
+public:
+  // Construct with given initial block size (in bytes)
+  CArenaAlloc(std::size_t iBlockSize=4096)
+  : m_pBlock(new char[iBlockSize]), m_iSize(iBlockSize), m_iUsed(0) {
+  }
+
+  ~CArenaAlloc() {
+    Reset();
+    delete[] m_pBlock;
+  }
+
+  // Return uninitialized memory for iBytes, aligned for any type
+  void *Alloc(std::size_t iBytes) {
+    iBytes = (iBytes + ALIGN - 1) & ~(ALIGN - 1);
+    if (m_iUsed + iBytes > m_iSize) {
+      m_vOldBlocks.push_back(m_pBlock);
+      m_iSize = std::max(m_iSize * 2, iBytes);
+      m_pBlock = new char[m_iSize];
+      m_iUsed = 0;
+    }
+    void *p = m_pBlock + m_iUsed;
+    m_iUsed += iBytes;
+    return p;
+  }
+
+  // Return uninitialized memory for a T (to construct with placement new)
+  template<typename T> T *Alloc() {
+    return static_cast<T *>(Alloc(sizeof(T)));
+  }
+
+  // Make all memory returned by Alloc available again
+  void Reset() {
+    for (std::size_t i = 0; i < m_vOldBlocks.size(); i++)
+      delete[] m_vOldBlocks[i];
+    m_vOldBlocks.clear();
+    m_iUsed = 0;
+  }
+
+private:
+  static const std::size_t ALIGN = 16;
+  // Block currently being allocated from...
+  char *m_pBlock;
+  std::size_t m_iSize, m_iUsed;
+  // ...and those filled before it, since the last Reset
+  std::vector<char *> m_vOldBlocks;
+};
+
+#endif // __ArenaAlloc_h__
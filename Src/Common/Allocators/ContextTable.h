@@ -0,0 +1,147 @@
+// ContextTable.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __ContextTable_h__
+#define __ContextTable_h__
+
+#include "../myassert.h"
+
+#include <vector>
+#include <cstddef>
+
+// CContextTable holds objects T (e.g. language model contexts) in fixed-size blocks,
+// like CPooledAlloc, but identifies them by integer handle rather than pointer.
+// Alloc and Free are O(1) and, once the table has grown to its peak size, never
+// allocate memory. Each handle also records the generation of its slot, so in
+// debug builds Get can check the handle has not been freed (or the slot reused).
+// Objects are not reinitialised between uses, and never move.
+
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T> class CContextTable {
+
+public:
+
+  // Construct with given block size (rounded up to a power of two)
+  CContextTable(std::size_t iBlockSize);
+  ~CContextTable();
+
+  // Take a slot, returning its handle (never 0); the object in it is as last left
+  std::size_t Alloc();
+
+  // Return a slot to the table; its handle (and any copies) become invalid
+  void Free(std::size_t h);
+
+  // Whether a handle refers to a slot which is allocated, and not since reused
+  bool IsValid(std::size_t h) const;
+
+  T &Get(std::size_t h) {
+    DASHER_ASSERT(IsValid(h));
+    return slot(index(h)).obj;
+  }
+  const T &Get(std::size_t h) const {
+    DASHER_ASSERT(IsValid(h));
+    return slot(index(h)).obj;
+  }
+
+  // Number of slots ever used, i.e. the range of indices for Live
+  std::size_t Size() const {return m_iSize;}
+
+  // Memory taken by the slots currently allocated
+  std::size_t LiveBytes() const {return (m_iSize - m_viFree.size()) * sizeof(SSlot);}
+
+  // The object in slot i (< Size()) if allocated, else NULL
+  T *Live(std::size_t i) {
+    SSlot &s(slot(i));
+    return (s.iGen & 1) ? &s.obj : NULL;
+  }
+
+private:
+
+  struct SSlot {
+    T obj;
+    // Incremented on each Alloc and Free, so odd iff allocated
+    unsigned int iGen;
+  };
+
+  // Low bits of a handle are slot index + 1, the rest the generation
+  static const unsigned int INDEX_BITS = sizeof(std::size_t) > 4 ? 32 : 24;
+
+  static std::size_t index(std::size_t h) {
+    return (h & ((std::size_t(1) << INDEX_BITS) - 1)) - 1;
+  }
+  SSlot &slot(std::size_t i) const {
+    return m_vpBlocks[i >> m_iBlockShift][i & m_iBlockMask];
+  }
+
+  unsigned int m_iBlockShift;
+  std::size_t m_iBlockMask;
+  std::vector<SSlot *> m_vpBlocks;
+  std::size_t m_iSize;
+
+  // The free list (indices)
+  std::vector<std::size_t> m_viFree;
+
+};
+
+template<typename T> CContextTable<T>::CContextTable(std::size_t iBlockSize) : m_iBlockShift(0), m_iSize(0) {
+  while ((std::size_t(1) << m_iBlockShift) < iBlockSize) ++m_iBlockShift;
+  m_iBlockMask = (std::size_t(1) << m_iBlockShift) - 1;
+}
+
+template<typename T> CContextTable<T>::~CContextTable() {
+  for (typename std::vector<SSlot *>::iterator it = m_vpBlocks.begin(); it != m_vpBlocks.end(); it++)
+    delete[] *it;
+}
+
+template<typename T> std::size_t CContextTable<T>::Alloc() {
+  std::size_t i;
+  if (m_viFree.size() > 0) {
+    i = m_viFree.back();
+    m_viFree.pop_back();
+  } else {
+    if (m_iSize == (m_vpBlocks.size() << m_iBlockShift)) {
+      m_vpBlocks.push_back(new SSlot[m_iBlockMask + 1]);
+      for (std::size_t j = 0; j <= m_iBlockMask; j++) m_vpBlocks.back()[j].iGen = 0;
+    }
+    i = m_iSize++;
+    DASHER_ASSERT(i + 1 < (std::size_t(1) << INDEX_BITS));
+  }
+  SSlot &s(slot(i));
+  ++s.iGen;
+  return (std::size_t(s.iGen) << INDEX_BITS) | (i + 1);
+}
+
+template<typename T> void CContextTable<T>::Free(std::size_t h) {
+  DASHER_ASSERT(IsValid(h));
+  const std::size_t i = index(h);
+  ++slot(i).iGen;
+  m_viFree.push_back(i);
+}
+
+template<typename T> bool CContextTable<T>::IsValid(std::size_t h) const {
+  const std::size_t i = index(h);
+  if (i >= m_iSize) return false; //inc. h==0, which wraps round
+  const unsigned int iGen = slot(i).iGen;
+  //compare only as many bits of the generation as the handle holds
+  return (iGen & 1) && (h >> INDEX_BITS) == (iGen & (~std::size_t(0) >> INDEX_BITS));
+}
+
+#endif // __ContextTable_h__
@@ -59,8 +59,8 @@ string CAlphInfo::escape(const string &ch) const {
 }
 
 CAlphInfo::~CAlphInfo() {
-  pChild->RecursiveDelete();
-  pNext->RecursiveDelete();
+  RecursiveDelete(pChild);
+  RecursiveDelete(pNext);
 }
 
 void CAlphInfo::copyCharacterFrom(const CAlphInfo *other, int idx) {
@@ -20,10 +20,11 @@ struct SGroupInfo {
   // where it is used in training text to disambiguate which pinyin/pronunciation
   // (i.e. group) was used to produce a given target(chinese)-alphabet symbol
   std::string strName;
-  void RecursiveDelete() {
-    for(SGroupInfo *t=this; t; ) {
+  ///Delete a list of groups (may be NULL), following pNext, and all their descendants
+  static void RecursiveDelete(SGroupInfo *pFirst) {
+    for(SGroupInfo *t=pFirst; t; ) {
       SGroupInfo *next = t->pNext;
-      t->pChild->RecursiveDelete();
+      RecursiveDelete(t->pChild);
       delete t;
       t = next;
     }
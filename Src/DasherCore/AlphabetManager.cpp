@@ -33,8 +33,11 @@
 #include "LanguageModelling/MixtureLanguageModel.h"
 #include "LanguageModelling/PPMPYLanguageModel.h"
 #include "LanguageModelling/CTWLanguageModel.h"
+#include "LanguageModelling/LayeredPPMLanguageModel.h"
 #include "FileWordGenerator.h"
 
+#include <algorithm>
+#include <thread>
 #include <vector>
 #include <sstream>
 #include <iostream>
@@ -53,7 +56,8 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 CAlphabetManager::CAlphabetManager(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager, const CAlphInfo *pAlphabet)
-  : CSettingsUser(pCreateFrom), m_pBaseGroup(NULL), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pAlphabet(pAlphabet), m_pLastOutput(NULL) {
+  : CSettingsUser(pCreateFrom), m_pBaseGroup(NULL), m_iLabelBytes(0), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pAlphabet(pAlphabet), m_pSpeculator(NULL), m_pLastOutput(NULL) {
+  std::fill(m_aTableParams, m_aTableParams+4, -1);
 }
 
 const string &CAlphabetManager::GetLabelText(symbol i) const {
@@ -74,6 +78,12 @@ void CAlphabetManager::Setup() {
   // (and we'll find a delimiter for each context)
 
   CreateLanguageModel();
+
+  const long iThreads(GetLongParameter(LP_SPECULATION_THREADS));
+  const unsigned int iCores(std::thread::hardware_concurrency());
+  if (iThreads > 0 && iCores > 1)
+    m_pSpeculator = new CProbSpeculator(min(static_cast<unsigned int>(iThreads), iCores - 1),
+      [this](size_t key, CProbSpeculator::Table &table) {return ComputeProbTable(key, table);});
 }
 
 void CAlphabetManager::InitMap() {
@@ -116,15 +126,30 @@ void CAlphabetManager::CreateLanguageModel() {
     case 4:
       m_pLanguageModel = new CCTWLanguageModel(m_pAlphabet->iEnd-1);
       break;
+    case 5:
+      m_pLanguageModel = new CLayeredPPMLanguageModel(this, m_pAlphabet->iEnd-1);
+      break;
   }
 }
 
-CTrainer *CAlphabetManager::GetTrainer() {
-  return new CTrainer(m_pInterface, m_pLanguageModel, m_pAlphabet, &m_map);
+CTrainer *CAlphabetManager::GetTrainer(CMessageDisplay *pMsgs) {
+  switch (GetLongParameter(LP_LANGUAGE_MODEL_ID)) {
+    case 2:
+    case 3:
+    case 4:
+      return new CTrainer(pMsgs, m_pLanguageModel, m_pAlphabet, &m_map);
+    case 5:
+      return new CLayeredTrainer(pMsgs, static_cast<CLayeredPPMLanguageModel *>(m_pLanguageModel), m_pAlphabet, &m_map);
+    default:
+      // As CreateLanguageModel, anything else is a standard PPM model
+      return new CPPMTrainer(this, pMsgs, static_cast<CPPMLanguageModel *>(m_pLanguageModel), m_pAlphabet, &m_map);
+  }
 }
 
 void CAlphabetManager::MakeLabels(CDasherScreen *pScreen) {
-  m_pBaseGroup->RecursiveDelete();
+  //speculation reads the groups (via m_pBaseGroup), which we are about to delete
+  StopSpeculating();
+  SGroupInfo::RecursiveDelete(m_pBaseGroup);
   for (vector<CDasherScreen::Label *>::iterator it=m_vLabels.begin(); it!=m_vLabels.end(); it++)
     delete (*it);
   m_vLabels.clear();
@@ -132,6 +157,18 @@ void CAlphabetManager::MakeLabels(CDasherScreen *pScreen) {
     delete it->second;
   m_mGroupLabels.clear();
   m_pBaseGroup = copyGroups(m_pAlphabet,pScreen);
+  m_iLabelBytes = 0;
+  for (vector<CDasherScreen::Label *>::iterator it=m_vLabels.begin(); it!=m_vLabels.end(); it++)
+    if (*it) m_iLabelBytes += (*it)->Bytes();
+  for (map<const SGroupInfo *,CDasherScreen::Label *>::iterator it=m_mGroupLabels.begin(); it!=m_mGroupLabels.end(); it++)
+    if (it->second) m_iLabelBytes += it->second->Bytes();
+}
+
+void CAlphabetManager::GetMemoryUsage(SMemoryUsage &usage) const {
+  CNodeManager::GetMemoryUsage(usage);
+  usage.iProbs += m_ProbTables.Bytes();
+  usage.iContexts += m_pLanguageModel->ContextBytes();
+  usage.iLabels += m_iLabelBytes;
 }
 
 SGroupInfo *CAlphabetManager::copyGroups(const SGroupInfo *pBase, CDasherScreen *pScreen) {
@@ -230,12 +267,28 @@ const CAlphInfo *CAlphabetManager::GetAlphabet() const {
 }
 
 CAlphabetManager::~CAlphabetManager() {
+  //stop using the LM on other threads first
+  delete m_pSpeculator;
   //the alphabet belongs to the AlphIO, and may be reused later
   delete m_pLanguageModel;
 }
 
 void CAlphabetManager::WriteTrainFileFull(CDasherInterfaceBase *pInterface) {
-  if (strTrainfileBuffer == "") return;
+  string strText(TakeTrainText());
+  if (strText == "") return;
+  if (pInterface->isTraining()) {
+    //Hold it back: the file is being read to train our replacement, which
+    // will take it over (along with anything written subsequently)
+    m_strHeldTrainText.swap(strText);
+    return;
+  }
+  pInterface->WriteTrainFile(m_pAlphabet->GetTrainingFile(), strText);
+}
+
+string CAlphabetManager::TakeTrainText() {
+  string strText;
+  strText.swap(m_strHeldTrainText);
+  if (strTrainfileBuffer == "") return strText;
   if (strTrainfileContext != "") {
     //If context begins with the default, skip that - it'll be entered by Trainer 1st anyway
     string defCtx(m_pAlphabet->GetDefaultContext());
@@ -251,8 +304,9 @@ void CAlphabetManager::WriteTrainFileFull(CDasherInterfaceBase *pInterface) {
     strTrainfileBuffer = m_pAlphabet->GetContextEscapeChar() + sDelim + strTrainfileContext + sDelim + strTrainfileBuffer;
     strTrainfileContext="";
   }
-  pInterface->WriteTrainFile(m_pAlphabet->GetTrainingFile(), strTrainfileBuffer);
+  strText += strTrainfileBuffer;
   strTrainfileBuffer="";
+  return strText;
 }
 
 int CAlphabetManager::GetColour(symbol sym, int iOffset) const {
@@ -290,7 +344,34 @@ void CAlphabetManager::CAlphBase::Undo() {
   if (m_pMgr->m_pLastOutput==this) m_pMgr->m_pLastOutput = Parent();
 }
 CAlphabetManager::CAlphNode::CAlphNode(int iOffset, int iColour, CDasherScreen::Label *pLabel, CAlphabetManager *pMgr)
-: CAlphBase(iOffset, iColour, pLabel, pMgr), m_pProbInfo(NULL) {
+: CAlphBase(iOffset, iColour, pLabel, pMgr), m_pProbInfo(NULL), m_iContext(0), m_iDeferredSym(-1) {
+}
+
+CLanguageModel::Context CAlphabetManager::CAlphNode::GetLMContext() {
+  if (m_iDeferredSym != -1) {
+    DASHER_ASSERT(Parent() && Parent()->mgr() == mgr());
+    CLanguageModel *pLM(m_pMgr->m_pLanguageModel);
+    m_iContext = pLM->CloneContext(static_cast<CAlphBase *>(Parent())->GetLMContext());
+    if (m_iDeferredSym) pLM->EnterSymbol(m_iContext, m_iDeferredSym);
+    m_iDeferredSym = -1;
+  }
+  return m_iContext;
+}
+
+void CAlphabetManager::CAlphNode::SetLMContext(CLanguageModel::Context ctx) {
+  if (m_iDeferredSym == -1 && m_iContext) m_pMgr->m_pLanguageModel->ReleaseContext(m_iContext);
+  m_iContext = ctx;
+  m_iDeferredSym = -1;
+}
+
+void CAlphabetManager::CAlphNode::DeferLMContext(symbol sym) {
+  DASHER_ASSERT(sym >= 0);
+  SetLMContext(0);
+  m_iDeferredSym = sym;
+}
+
+void CAlphabetManager::CAlphNode::LosingParent() {
+  GetLMContext();
 }
 
 CAlphabetManager::CSymbolNode::CSymbolNode(int iOffset, CDasherScreen::Label *pLabel, CAlphabetManager *pMgr, symbol _iSymbol)
@@ -315,24 +396,73 @@ CAlphabetManager::CAlphNode *CAlphabetManager::GetRoot(CDasherNode *pParent, boo
 
   pair<symbol, CLanguageModel::Context> p = GetContextSymbols(pParent, iNewOffset, &m_map);
 
+  //if couldn't extract last symbol (so probably using default context), or shouldn't,
+  // make a group node for the whole alphabet
+  if (!bEnteredLast) p.first = 0;
+  DASHER_ASSERT(p.first==0 || !pParent);
+  return MakeRoot(iNewOffset, p.first, p.second);
+}
+
+CAlphabetManager::CAlphNode *CAlphabetManager::MakeRoot(int iOffset, symbol sym, CLanguageModel::Context ctx) {
   CAlphNode *pNewNode;
-  if(p.first==0 || !bEnteredLast) {
-    //couldn't extract last symbol (so probably using default context), or shouldn't
-    pNewNode = new CGroupNode(iNewOffset, NULL, 0, this, m_pBaseGroup); //default background colour
+  if (sym==0) {
+    pNewNode = m_NodeAlloc.Make<CGroupNode>(iOffset, (CDasherScreen::Label *)NULL, 0, this, m_pBaseGroup); //default background colour
   } else {
     //new node represents a symbol that's already happened - i.e. user has already steered through it;
     // so either we're rebuilding, or else creating a new root from existing text (in edit box)
-    DASHER_ASSERT(!pParent);
-    pNewNode = CreateSymbolRoot(iNewOffset, p.second, p.first);
+    pNewNode = CreateSymbolRoot(iOffset, ctx, sym);
     pNewNode->SetFlag(NF_SEEN, true);
     pNewNode->CDasherNode::SetFlag(NF_COMMITTED, true); //do NOT commit!
   }
-  pNewNode->iContext = p.second;
+  pNewNode->SetLMContext(ctx);
   return pNewNode;
 }
 
+CAlphabetManager::CRootRecipe::CRootRecipe(CAlphabetManager *pMgr, int iOffset, symbol sym, CLanguageModel::Context ctx)
+: m_pMgr(pMgr), m_iOffset(iOffset), m_iSymbol(sym), m_iContext(ctx) {
+}
+
+CAlphabetManager::CRootRecipe::~CRootRecipe() {
+  m_pMgr->m_pLanguageModel->ReleaseContext(m_iContext);
+}
+
+CDasherNode *CAlphabetManager::CRootRecipe::Rebuild(CDasherNode *pChild) {
+  if (pChild->mgr() != m_pMgr) return NULL;
+  return static_cast<CAlphBase *>(pChild)->RebuildParentFrom(this);
+}
+
+function<bool(CDasherNode *)> CAlphabetManager::ContextMatcher(int iOffset) {
+  const int iNewOffset(iOffset-1);
+  //symbols in the buffer, over the range GetContextSymbols would read
+  vector<symbol> vContextSymbols; int iStart(0);
+  if (iNewOffset!=-1) {
+    iStart = max(0, iNewOffset - m_pLanguageModel->GetContextLength());
+    m_map.GetSymbols(vContextSymbols, m_pInterface->GetContext(iStart, iNewOffset+1 - iStart));
+  }
+  //symbol 0 is text not in the alphabet, which no node can have entered
+  if (find(vContextSymbols.begin(), vContextSymbols.end(), 0) != vContextSymbols.end())
+    return [](CDasherNode *) {return false;};
+  //if the range starts at the beginning of the buffer, no symbols may precede it
+  const bool bBufferStart(iStart==0);
+  return [this, iNewOffset, vContextSymbols, bBufferStart](CDasherNode *pNode) {
+    if (pNode->mgr()!=this || pNode->offset()!=iNewOffset) return false;
+    vector<symbol>::const_reverse_iterator it = vContextSymbols.rbegin();
+    for (CDasherNode *p = pNode; ; p = p->Parent()) {
+      //Reached the top of the tree: the symbols before that were read from the buffer
+      // when it was made, and may have changed since, so must not be needed
+      if (!p) return it == vContextSymbols.rend();
+      //Likewise any other manager's nodes; we can't tell what text they entered
+      if (p->mgr()!=this) return it == vContextSymbols.rend() && !bBufferStart;
+      if (symbol sym = p->GetAlphSymbol()) {
+        if (it == vContextSymbols.rend()) return !bBufferStart;
+        if (sym != *it++) return false;
+      }
+    }
+  };
+}
+
 CAlphabetManager::CAlphNode *CAlphabetManager::CreateSymbolRoot(int iOffset, CLanguageModel::Context ctx, symbol sym) {
-  return new CSymbolNode(iOffset, m_vLabels[sym], this, sym);
+  return m_NodeAlloc.Make<CSymbolNode>(iOffset, m_vLabels[sym], this, sym);
 }
 
 pair<symbol, CLanguageModel::Context> CAlphabetManager::GetContextSymbols(CDasherNode *pParent, int iRootOffset, const CAlphabetMap *pAlphMap) {
@@ -378,6 +508,8 @@ bool CAlphabetManager::CSymbolNode::GameSearchNode(symbol sym) {
 }
 bool CAlphabetManager::CGroupNode::GameSearchNode(symbol sym) {
   if (sym >= m_pGroup->iStart && sym < m_pGroup->iEnd) {
+    //game child may not have been made yet
+    if (GetFlag(NF_LAZY)) MaterializeChildren(0, CDasherModel::NORMALIZATION, 0);
     if (GetFlag(NF_ALLCHILDREN)) {
       if (!GameSearchChildren(sym)) //recurse, to mark game child also
         DASHER_ASSERT(false); //sym within this group, should definitely be found!
@@ -405,6 +537,9 @@ symbol CAlphabetManager::CSymbolNode::GetAlphSymbol() {
 void CAlphabetManager::CSymbolNode::PopulateChildren() {
   m_pMgr->IterateChildGroups(this, m_pMgr->m_pBaseGroup, NULL);
 }
+const SGroupInfo *CAlphabetManager::CSymbolNode::childGroup() const {
+  return m_pMgr->m_pBaseGroup;
+}
 int CAlphabetManager::CAlphNode::ExpectedNumChildren() {
   int i=m_pMgr->m_pBaseGroup->iNumChildNodes;
   return (m_pMgr->GetBoolParameter(BP_CONTROL_MODE)) ? i+1 : i;
@@ -417,9 +552,7 @@ void CAlphabetManager::GetProbs(vector<unsigned int> *pProbInfo, CLanguageModel:
   // TODO: New method (see commented code) has been removed as it wasn' working.
 
   const unsigned long iNorm(m_pNCManager->GetAlphNodeNormalization());
-  //the case for control mode on, generalizes to handle control mode off also,
-  // as then iNorm - control_space == iNorm...
-  const unsigned int iUniformAdd = max(1ul, ((iNorm * GetLongParameter(LP_UNIFORM)) / 1000) / iSymbols);
+  const unsigned int iUniformAdd = UniformAdd(iNorm, GetLongParameter(LP_UNIFORM));
   const unsigned long iNonUniformNorm = iNorm - iSymbols * iUniformAdd;
   //  m_pLanguageModel->GetProbs(context, Probs, iNorm, ((iNorm * uniform) / 1000));
 
@@ -443,19 +576,77 @@ void CAlphabetManager::GetProbs(vector<unsigned int> *pProbInfo, CLanguageModel:
 #endif
 }
 
-std::vector<unsigned int> *CAlphabetManager::CAlphNode::GetProbInfo() {
-  if (!m_pProbInfo) {
-    m_pProbInfo = new std::vector<unsigned int>();
-    m_pMgr->GetProbs(m_pProbInfo, iContext);
+unsigned int CAlphabetManager::UniformAdd(unsigned long iNorm, long iUniform) const {
+  //the case for control mode on, generalizes to handle control mode off also,
+  // as then iNorm - control_space == iNorm...
+  return max(1ul, ((iNorm * iUniform) / 1000) / (m_pBaseGroup->iEnd-1));
+}
+
+void CAlphabetManager::CheckTableParams() {
+  //Tables made with different parameters are no use
+  const long aParams[] = {static_cast<long>(m_pNCManager->GetAlphNodeNormalization()), GetLongParameter(LP_UNIFORM),
+    GetLongParameter(LP_LM_ALPHA), GetLongParameter(LP_LM_BETA)};
+  if (!std::equal(aParams, aParams+4, m_aTableParams)) {
+    //(before changing m_aTableParams, which ComputeProbTable reads)
+    StopSpeculating();
+    m_ProbTables.Clear();
+    std::copy(aParams, aParams+4, m_aTableParams);
+  }
+}
+
+std::vector<unsigned int> *CAlphabetManager::GetProbTable(CLanguageModel::Context context) {
+  CheckTableParams();
+  const size_t key(m_pLanguageModel->ContextKey(context));
+  if (std::vector<unsigned int> *pTable = m_ProbTables.Find(key)) return pTable;
+
+  std::vector<unsigned int> *pTable = m_ProbTables.Alloc();
+  if (!key || !m_pSpeculator || !m_pSpeculator->Take(key, *pTable)) {
+    GetProbs(pTable, context);
 
     // work out cumulative probs in place
-    for(unsigned int i = 1; i < m_pProbInfo->size(); i++) {
-      (*m_pProbInfo)[i] += (*m_pProbInfo)[i - 1];
+    for(unsigned int i = 1; i < pTable->size(); i++) {
+      (*pTable)[i] += (*pTable)[i - 1];
     }
   }
+  m_ProbTables.Insert(key, pTable);
+  return pTable;
+}
+
+void CAlphabetManager::Speculate(CLanguageModel::Context context) {
+  if (!m_pSpeculator) return;
+  CheckTableParams();
+  const size_t key(m_pLanguageModel->ContextKey(context));
+  if (key && !m_ProbTables.Contains(key)) m_pSpeculator->Request(key);
+}
+
+bool CAlphabetManager::ComputeProbTable(size_t key, std::vector<unsigned int> &table) const {
+  //as GetProbs, but with the normalization, LP_UNIFORM, LP_LM_ALPHA & LP_LM_BETA
+  // last seen by CheckTableParams (settings can't be read on other threads)
+  const unsigned long iNorm(m_aTableParams[0]);
+  const unsigned int iUniformAdd = UniformAdd(iNorm, m_aTableParams[1]);
+  const unsigned long iNonUniformNorm = iNorm - (m_pBaseGroup->iEnd-1) * iUniformAdd;
+  if (!m_pLanguageModel->GetProbsForKey(key, table, iNonUniformNorm, 0, m_aTableParams[2], m_aTableParams[3])) return false;
+  //add uniformity and cumulate, in one pass
+  for (unsigned int k = 1; k < table.size(); k++)
+    table[k] += iUniformAdd + table[k - 1];
+  return true;
+}
+
+std::vector<unsigned int> *CAlphabetManager::CAlphNode::GetProbInfo() {
+  if (!m_pProbInfo)
+    m_pProbInfo = m_pMgr->GetProbTable(GetLMContext());
   return m_pProbInfo;
 }
 
+void CAlphabetManager::CAlphNode::PrepareChildren() {
+  if (!m_pProbInfo) m_pMgr->Speculate(GetLMContext());
+}
+
+void CAlphabetManager::CGroupNode::PrepareChildren() {
+  if (Parent() && Parent()->mgr() == mgr() && Parent()->offset()==offset()) return;
+  CAlphNode::PrepareChildren();
+}
+
 std::vector<unsigned int> *CAlphabetManager::CGroupNode::GetProbInfo() {
   if (Parent() && Parent()->mgr() == mgr() && Parent()->offset()==offset()) {
     return (static_cast<CAlphNode *>(Parent()))->GetProbInfo();
@@ -477,10 +668,10 @@ CAlphabetManager::CGroupNode *CAlphabetManager::CreateGroupNode(CAlphNode *pPare
   // When creating a group node...
   // ...the offset is the same as the parent...
 
-  CGroupNode *pNewNode = new CGroupNode(pParent->offset(), m_mGroupLabels[pInfo], iBkgCol, this, pInfo);
+  CGroupNode *pNewNode = m_NodeAlloc.Make<CGroupNode>(pParent->offset(), m_mGroupLabels[pInfo], iBkgCol, this, pInfo);
 
-  //...as is the context!
-  pNewNode->iContext = m_pLanguageModel->CloneContext(pParent->iContext);
+  //...as is the context! (Made only if needed - most groups get their probabilities from the parent)
+  pNewNode->DeferLMContext(0);
 
   return pNewNode;
 }
@@ -519,15 +710,15 @@ CDasherNode *CAlphabetManager::CreateSymbolNode(CAlphNode *pParent, symbol iSymb
     // (and we can't call numChars() on the symbol before we've constructed it!)
     int iNewOffset = pParent->offset()+1;
     if (m_pAlphabet->GetText(iSymbol)=="\r\n") iNewOffset++;
-    CSymbolNode *pAlphNode = new CSymbolNode(iNewOffset, m_vLabels[iSymbol], this, iSymbol);
+    CSymbolNode *pAlphNode = m_NodeAlloc.Make<CSymbolNode>(iNewOffset, m_vLabels[iSymbol], this, iSymbol);
     //     std::stringstream ssLabel;
 
     //     ssLabel << GetLabelText(iSymbol) << ": " << pNewNode;
 
     //    pDisplayInfo->strDisplayText = ssLabel.str();
 
-    pAlphNode->iContext = m_pLanguageModel->CloneContext(pParent->iContext);
-    m_pLanguageModel->EnterSymbol(pAlphNode->iContext, iSymbol); // TODO: Don't use symbols?
+    //context will be the parent's plus this symbol - if the node is ever expanded
+    pAlphNode->DeferLMContext(iSymbol); // TODO: Don't use symbols?
 
   return pAlphNode;
 }
@@ -544,13 +735,26 @@ CDasherNode *CAlphabetManager::CSymbolNode::RebuildSymbol(CAlphNode *pParent, sy
   return CAlphBase::RebuildSymbol(pParent, iSymbol);
 }
 
-void CAlphabetManager::IterateChildGroups(CAlphNode *pParent, const SGroupInfo *pParentGroup, CAlphBase *buildAround) {
+void CAlphabetManager::IterateChildGroups(CAlphNode *pParent, const SGroupInfo *pParentGroup, CAlphBase *buildAround, unsigned int iMinLbnd, unsigned int iMaxHbnd, unsigned int iMinSize) {
   std::vector<unsigned int> *pCProb(pParent->GetProbInfo());
   DASHER_ASSERT((*pCProb)[0] == 0);
   const int iMin(pParentGroup->iStart);
   const int iMax(pParentGroup->iEnd);
   unsigned int iRange(pParentGroup == m_pBaseGroup ? CDasherModel::NORMALIZATION : ((*pCProb)[iMax-1] - (*pCProb)[iMin-1]));
 
+  const bool bLazy(pParent->GetFlag(NF_LAZY));
+  if (!bLazy) {
+    const long iLazy(GetLongParameter(LP_LAZY_CHILDREN));
+    if (!buildAround && iLazy && pParentGroup->iNumChildNodes >= iLazy && !pParent->GetFlag(NF_GAME)) {
+      //Make children only when they are onscreen (the view will ask); the parent
+      // keeps its probabilities (i.e. pCProb) until then. Extras are few, so make now.
+      pParent->SetFlag(NF_LAZY, true);
+      if (pParentGroup == m_pBaseGroup) m_pNCManager->AddExtras(pParent);
+      return;
+    }
+    pParent->ReserveChildren(pParent->ExpectedNumChildren());
+  }
+
   // TODO: Think through alphabet file formats etc. to make this class easier.
   // TODO: Throw a warning if parent node already has children
 
@@ -558,6 +762,7 @@ void CAlphabetManager::IterateChildGroups(CAlphNode *pParent, const SGroupInfo *
 
   int i(iMin); //lowest index of child which we haven't yet added
   const SGroupInfo *pCurrentNode(pParentGroup->pChild);
+  unsigned int iExisting(0); //if lazy, index of first existing child not above the next to make
   // The SGroupInfo structure has something like linked list behaviour
   // Each SGroupInfo contains a pNext, a pointer to a sibling group info
   while (i < iMax) {
@@ -572,27 +777,67 @@ void CAlphabetManager::IterateChildGroups(CAlphNode *pParent, const SGroupInfo *
     unsigned int iHbnd = (((*pCProb)[iEnd-1] - (*pCProb)[iMin-1]) *
                           static_cast<uint64>(CDasherModel::NORMALIZATION)) /
                          iRange;
+    const SGroupInfo *pGroup(bSymbol ? NULL : pCurrentNode);
     if (bSymbol) {
-      pNewChild = (buildAround) ? buildAround->RebuildSymbol(pParent, i) : CreateSymbolNode(pParent, i);
       i++; //make one symbol at a time - move onto next symbol in next iteration of (outer) loop
     } else {
       DASHER_ASSERT(pCurrentNode->iNumChildNodes > 1);
-      pNewChild= (buildAround) ? buildAround->RebuildGroup(pParent, pParent->getColour(), pCurrentNode) : CreateGroupNode(pParent, pParent->getColour(), pCurrentNode);
       i = pCurrentNode->iEnd; //make one group at a time - so move past entire group...
       pCurrentNode = pCurrentNode->pNext; //next sibling of _original_ pCurrentNode (above)
-      // (maybe not of pCurrentNode now, which might be a subgroup filling the original)
     }
+    if (bLazy) {
+      if (iLbnd >= iMaxHbnd) break; //all the rest are below the range
+      const CDasherNode::ChildMap &children(pParent->GetChildren());
+      while (iExisting < children.size() && children[iExisting]->Lbnd() < iLbnd) iExisting++;
+      if (iHbnd <= iMinLbnd || iHbnd - iLbnd < iMinSize //above the range, or too small
+          || (iExisting < children.size() && children[iExisting]->Lbnd() == iLbnd)) //already made
+        continue;
+    }
+    if (pGroup)
+      pNewChild= (buildAround) ? buildAround->RebuildGroup(pParent, pParent->getColour(), pGroup) : CreateGroupNode(pParent, pParent->getColour(), pGroup);
+    else
+      pNewChild = (buildAround) ? buildAround->RebuildSymbol(pParent, iStart) : CreateSymbolNode(pParent, iStart);
     //created a new node - symbol or (group which will have >1 child).
     pNewChild->Reparent(pParent, iLbnd, iHbnd);
   }
 
-  if (pParentGroup == m_pBaseGroup) m_pNCManager->AddExtras(pParent);
+  if (bLazy) {
+    if (pParent->ChildCount() < static_cast<unsigned int>(pParent->ExpectedNumChildren())) return;
+    //made the last one
+    pParent->SetFlag(NF_LAZY, false);
+  } else if (pParentGroup == m_pBaseGroup) m_pNCManager->AddExtras(pParent);
   pParent->SetFlag(NF_ALLCHILDREN, true);
 }
 
+void CAlphabetManager::CAlphNode::MaterializeChildren(unsigned int iLbnd, unsigned int iHbnd, unsigned int iMinSize) {
+  DASHER_ASSERT(GetFlag(NF_LAZY));
+  m_pMgr->IterateChildGroups(this, childGroup(), NULL, iLbnd, iHbnd, iMinSize);
+}
+
+int CAlphabetManager::CAlphNode::MostProbableChild() {
+  int iMax = CDasherNode::MostProbableChild();
+  if (GetFlag(NF_LAZY)) {
+    //compute sizes of the rest as IterateChildGroups would
+    const std::vector<unsigned int> &vCProb(*GetProbInfo());
+    const SGroupInfo *pParentGroup(childGroup()), *pCurrentNode(pParentGroup->pChild);
+    const int iMin(pParentGroup->iStart);
+    const unsigned int iRange(pParentGroup == m_pMgr->m_pBaseGroup ? CDasherModel::NORMALIZATION : (vCProb[pParentGroup->iEnd-1] - vCProb[iMin-1]));
+    for (int i = iMin; i < pParentGroup->iEnd;) {
+      const int iStart = i;
+      if (!pCurrentNode || i < pCurrentNode->iStart) i++;
+      else {
+        i = pCurrentNode->iEnd;
+        pCurrentNode = pCurrentNode->pNext;
+      }
+      iMax = max(iMax, static_cast<int>(((vCProb[i-1] - vCProb[iStart-1]) * static_cast<uint64>(CDasherModel::NORMALIZATION)) / iRange));
+    }
+  }
+  return iMax;
+}
+
 CAlphabetManager::CAlphNode::~CAlphNode() {
-  delete m_pProbInfo;
-  m_pMgr->m_pLanguageModel->ReleaseContext(iContext);
+  if (m_pProbInfo) m_pMgr->m_ProbTables.Release(m_pProbInfo);
+  SetLMContext(0);
 }
 
 const std::string &CAlphabetManager::CSymbolNode::outputText() const {
@@ -688,17 +933,42 @@ CDasherNode *CAlphabetManager::CAlphBase::RebuildParent() {
     //Parent's offset usually one less than this, but can be two for the paragraph symbol.
     int iNewOffset = offset()-numChars();
 
-    CAlphNode *pNewNode = m_pMgr->GetRoot(NULL, iNewOffset!=-1, iNewOffset+1);
-
-    RebuildForwardsFromAncestor(pNewNode);
+    GraftUnder(m_pMgr->GetRoot(NULL, iNewOffset!=-1, iNewOffset+1));
+  }
+  return Parent();
+}
 
-    if (int flags=(GetFlag(NF_SEEN) ? NF_SEEN : 0) | (GetFlag(NF_COMMITTED) ? NF_COMMITTED : 0)) {
-      for (CDasherNode *pNode=this; (pNode=pNode->Parent()); pNode->SetFlag(flags, true));
-    }
+CDasherNode *CAlphabetManager::CAlphBase::RebuildParentFrom(const CRootRecipe *pRecipe) {
+  if (!Parent()) {
+    if (pRecipe->m_iOffset != offset()-numChars()) return NULL;
+    CLanguageModel *pLM(m_pMgr->m_pLanguageModel);
+    GraftUnder(m_pMgr->MakeRoot(pRecipe->m_iOffset, pRecipe->m_iSymbol, pLM->CloneContext(pRecipe->m_iContext)));
   }
   return Parent();
 }
 
+CDasherNode *CAlphabetManager::CGroupNode::RebuildParentFrom(const CRootRecipe *pRecipe) {
+  if (Parent()) return Parent();
+  if (m_pGroup == m_pMgr->m_pBaseGroup) return NULL;
+  return CAlphBase::RebuildParentFrom(pRecipe);
+}
+
+void CAlphabetManager::CAlphBase::GraftUnder(CAlphNode *pNewNode) {
+  RebuildForwardsFromAncestor(pNewNode);
+
+  if (int flags=(GetFlag(NF_SEEN) ? NF_SEEN : 0) | (GetFlag(NF_COMMITTED) ? NF_COMMITTED : 0)) {
+    for (CDasherNode *pNode=this; (pNode=pNode->Parent()); pNode->SetFlag(flags, true));
+  }
+}
+
+CDasherNode::CRecipe *CAlphabetManager::CAlphNode::MakeRecipe() {
+  return new CRootRecipe(m_pMgr, offset(), GetAlphSymbol(), m_pMgr->m_pLanguageModel->CloneContext(GetLMContext()));
+}
+
+CDasherNode::CRecipe *CAlphabetManager::CGroupNode::MakeRecipe() {
+  return (m_pGroup == m_pMgr->m_pBaseGroup) ? CAlphNode::MakeRecipe() : NULL;
+}
+
 void CAlphabetManager::CAlphBase::RebuildForwardsFromAncestor(CAlphNode *pNewNode) {
   //now fill in the new node - recursively - until it reaches us
   m_pMgr->IterateChildGroups(pNewNode, m_pMgr->m_pBaseGroup, this);
@@ -714,15 +984,20 @@ void CAlphabetManager::CSymbolNode::SetFlag(int iFlag, bool bValue) {
       if (Parent()->mgr() != mgr()) return; //do not set flag
       CLanguageModel *pLM(m_pMgr->m_pLanguageModel);
       // (Note: for first symbol after startup: parent is (root) group node, which'll have the alphabet default context)
-      CLanguageModel::Context ctx = pLM->CloneContext(static_cast<CAlphabetManager::CAlphNode *>(Parent())->iContext);
+      CLanguageModel::Context ctx = pLM->CloneContext(static_cast<CAlphBase *>(Parent())->GetLMContext());
+      m_pMgr->StopSpeculating();
+      //Forget the tables whose probabilities learning may change (keeping the rest)
+      std::vector<size_t> vKeys;
+      m_pMgr->m_ProbTables.GetKeys(vKeys);
+      pLM->GetKeysChangedByLearning(ctx, iSymbol, vKeys);
       pLM->LearnSymbol(ctx, iSymbol);
+      m_pMgr->m_ProbTables.Forget(vKeys);
       //could: pLM->ReleaseContext(ctx);
       //however, seems better to replace this node's context (i.e. which it uses to create its own children)
       // with the new (learned) context: the former was obtained by EnterSymbol rather than LearnSymbol, so
       // will be different iff this node was the first time its symbol was entered into its parent context.
       // (Yes, this node's context is unlikely to be used again, but not impossible...)
-      pLM->ReleaseContext(iContext);
-      iContext = ctx;
+      SetLMContext(ctx);
     }
   }
   CDasherNode::SetFlag(iFlag, bValue);
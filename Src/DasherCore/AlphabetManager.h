@@ -29,6 +29,10 @@
 #include "SettingsStore.h"
 #include "Observable.h"
 #include "WordGeneratorBase.h"
+#include "ProbSpeculator.h"
+#include "ProbTableStore.h"
+
+#include <functional>
 
 class CNodeCreationManager;
 struct SGroupInfo;
@@ -64,17 +68,39 @@ namespace Dasher {
     void Setup();
 
     virtual void MakeLabels(CDasherScreen *pScreen);
+    ///Override: adds the probability tables (see m_ProbTables), contexts of the
+    /// LM, and labels for symbols and groups
+    virtual void GetMemoryUsage(SMemoryUsage &usage) const;
+    ///How often nodes' probability tables have been found already computed,
+    /// rather than computed afresh (see CProbTableStore)
+    const CProbTableStore::SStats &GetProbTableStats() const {return m_ProbTables.GetStats();}
+    ///Wait for, and cancel, any computing of probabilities on other threads (see
+    /// CProbSpeculator): must be called before anything else changes the LM.
+    void StopSpeculating() {if (m_pSpeculator) m_pSpeculator->Stop();}
     ///Gets a new trainer to train this LM. Caller is responsible for deallocating the
     /// trainer later.
-    virtual CTrainer *GetTrainer();
+    /// \param pMsgs to which the trainer should report errors (not necessarily the
+    /// interface, e.g. if training will happen on another thread)
+    virtual CTrainer *GetTrainer(CMessageDisplay *pMsgs);
     
     /// Gets a (Game) Word Generator to make target sentences for the current alphabet
     CWordGeneratorBase *GetGameWords();
 
     virtual ~CAlphabetManager();
-    /// Flush to the user's training file everything written in this AlphMgr
+    /// The LM has learnt other than by nodes being committed (e.g. from a file),
+    /// so any probabilities computed from it may be out of date. (Call
+    /// StopSpeculating before it learns.)
+    void ModelChanged() {m_ProbTables.Clear();}
+    /// Flush to the user's training file everything written in this AlphMgr.
+    /// While the interface isTraining(), another thread may be reading that file,
+    /// so the text is instead held back (for TakeTrainText) until training ends.
     /// \param pInterface to use for I/O by calling WriteTrainFile(fname,txt)
     void WriteTrainFileFull(CDasherInterfaceBase *pInterface);
+    /// Remove and return everything written in this AlphMgr and not yet flushed
+    /// (including anything held back by WriteTrainFileFull), as WriteTrainFileFull
+    /// would write it out (i.e. in training file format, each part preceded by
+    /// the context in which it was written).
+    std::string TakeTrainText();
   protected:
     ///Initializes the alphabet map (m_map) from the characters in the alphabet.
     /// Called from Setup(), i.e. before the manager is or need be usable.
@@ -107,10 +133,13 @@ namespace Dasher {
     std::map<const SGroupInfo *,CDasherScreen::Label *> m_mGroupLabels;
     ///A label for each symbol, indexed by symbol id (element 0 = null)
     std::vector<CDasherScreen::Label *> m_vLabels;
+    ///Memory taken by the labels in m_vLabels and m_mGroupLabels (see MakeLabels)
+    std::size_t m_iLabelBytes;
     
     virtual const std::string &GetLabelText(symbol i) const;
     
     class CAlphNode;
+    class CRootRecipe;
     /// Abstract superclass for alphabet manager nodes, provides common implementation
     /// code for rebuilding parent nodes = reversing.
     class CAlphBase : public CDasherNode {
@@ -119,6 +148,10 @@ namespace Dasher {
       ///Rebuilds this node's parent by recreating the previous 'root' node,
       /// then calling RebuildForwardsFromAncestor
       CDasherNode *RebuildParent();
+      ///As RebuildParent, but remaking the previous 'root' node from a recipe
+      /// rather than from the text in the buffer.
+      /// \return NULL, doing nothing, if the recipe is for a different offset
+      virtual CDasherNode *RebuildParentFrom(const CRootRecipe *pRecipe);
       ///Called to build a symbol (leaf) node which is a descendant of the symbol or root node preceding this.
       /// Default implementation just calls the manager's CreateSymbolNode method to create a new node,
       /// but subclasses can override to graft themselves into the appropriate point beneath the previous node.
@@ -136,6 +169,10 @@ namespace Dasher {
       void Undo();
       ///Just keep track of the last node output (for training file purposes)
       void Output();
+      ///The LM context after this node, i.e. in which its children are predicted
+      virtual CLanguageModel::Context GetLMContext()=0;
+      ///Override: 0, i.e. enters no symbol (only CSymbolNode does)
+      virtual symbol GetAlphSymbol() {return 0;}
     protected:
       ///Called in process of rebuilding parent: fill in the hierarchy _beneath_ the
       /// the previous root node, by calling IterateChildGroups passing this node as
@@ -143,6 +180,9 @@ namespace Dasher {
       /// at which point RebuildSymbol/Group should graft it in.
       /// \param pNewNode newly-created root node beneath which this node should fit
       virtual void RebuildForwardsFromAncestor(CAlphNode *pNewNode);
+      ///Make pNewNode (a new root) our ancestor, by RebuildForwardsFromAncestor;
+      /// then mark the nodes created as seen/committed if we are.
+      void GraftUnder(CAlphNode *pNewNode);
       CAlphBase(int iOffset, int iColour, CDasherScreen::Label *pLabel, CAlphabetManager *pMgr);
       CAlphabetManager *m_pMgr;
       ///Number of unicode characters entered by this node; i.e., the number
@@ -157,7 +197,20 @@ namespace Dasher {
     class CAlphNode : public CAlphBase {
     public:
       CAlphNode(int iOffset, int iColour, CDasherScreen::Label *pLabel, CAlphabetManager *pMgr);
-      CLanguageModel::Context iContext;
+      ///The LM context after this node; made on first call, if deferred (see DeferLMContext).
+      CLanguageModel::Context GetLMContext();
+      ///Set the LM context, which the node then owns (releasing it when deleted)
+      void SetLMContext(CLanguageModel::Context ctx);
+      ///Don't make an LM context yet: most nodes are collapsed again without ever
+      /// needing one. Instead, GetLMContext will make it (if called) by entering
+      /// sym (or nothing, if 0) into the context of the parent, which must be a
+      /// node of the same manager.
+      void DeferLMContext(symbol sym);
+      ///Override: make any deferred context now, while we have a parent to get it from
+      void LosingParent();
+      ///Override: recipe from which GetRoot's result for this node can be remade,
+      /// i.e. our offset, symbol (if any), and a copy of our LM context
+      virtual CRecipe *MakeRecipe();
       ///
       /// Delete any storage alocated for this node
       ///
@@ -165,8 +218,22 @@ namespace Dasher {
       ///Have to call this from CAlphabetManager, and from CGroupNode on a _different_ CAlphNode, hence public...
       virtual std::vector<unsigned int> *GetProbInfo();
       virtual int ExpectedNumChildren();
+      ///Override: if probabilities not yet computed, asks for them to be
+      /// computed on another thread (see CAlphabetManager::Speculate)
+      virtual void PrepareChildren();
+      ///Override: make children by IterateChildGroups, over just that range
+      virtual void MaterializeChildren(unsigned int iLbnd, unsigned int iHbnd, unsigned int iMinSize);
+      ///Override: if NF_LAZY, finds the most probable child from GetProbInfo
+      virtual int MostProbableChild();
+    protected:
+      ///The group whose contents are the children of this node
+      virtual const SGroupInfo *childGroup() const=0;
     private:
+      ///Cumulative probabilities, if computed; a reference to m_pMgr->m_ProbTables
       std::vector<unsigned int> *m_pProbInfo;
+      CLanguageModel::Context m_iContext;
+      ///If DeferLMContext called and GetLMContext not yet, the symbol to enter; else -1
+      symbol m_iDeferredSym;
     };
     class CSymbolNode : public CAlphNode {
     public:
@@ -180,6 +247,8 @@ namespace Dasher {
       virtual void Undo();
       ///Override to provide symbol number, probability, _edit_ text from alphabet
       virtual SymbolProb GetSymbolProb() const;
+      ///Override: the whole alphabet, i.e. m_pBaseGroup
+      const SGroupInfo *childGroup() const;
 
       virtual void SetFlag(int iFlag, bool bValue);
 
@@ -211,6 +280,11 @@ namespace Dasher {
 
       ///Override: if m_pGroup==NULL, i.e. whole/root-of alphabet, cannot rebuild.
       virtual CDasherNode *RebuildParent();
+      ///Override: likewise, cannot rebuild the parent of a whole-alphabet root
+      virtual CDasherNode *RebuildParentFrom(const CRootRecipe *pRecipe);
+      ///Override: NULL unless this is a whole-alphabet root; other groups are
+      /// remade within the node (with the same offset) before them.
+      virtual CRecipe *MakeRecipe();
 
       ///Create children of this group node, by traversing the section of the alphabet
       /// indicated by m_pGroup.
@@ -218,15 +292,37 @@ namespace Dasher {
       virtual int ExpectedNumChildren();
       virtual bool GameSearchNode(symbol sym);
       std::vector<unsigned int> *GetProbInfo();
+      ///Override: nothing to do if GetProbInfo would use the parent's
+      void PrepareChildren();
       ///Override: if the group to create is the same as this node's group, return this node instead of creating a new one
       virtual CDasherNode *RebuildGroup(CAlphNode *pParent, int iBkgCol, const SGroupInfo *pInfo);
     protected:
       ///Override: true if pGroup encloses this one (by start/end symbol#)
       bool isInGroup(const SGroupInfo *pGroup);
+      ///Override: returns m_pGroup
+      const SGroupInfo *childGroup() const {return m_pGroup;}
     private:
       const SGroupInfo *m_pGroup;
     };
 
+    ///Recipe (see CDasherNode::CRecipe) for a root GetRoot made or would make:
+    /// can remake it, without reading the buffer or entering symbols into the LM.
+    class CRootRecipe : public CDasherNode::CRecipe {
+    public:
+      ///Takes ownership of ctx
+      CRootRecipe(CAlphabetManager *pMgr, int iOffset, symbol sym, CLanguageModel::Context ctx);
+      ~CRootRecipe();
+      std::size_t Bytes() const {return sizeof(*this);}
+      CDasherNode *Rebuild(CDasherNode *pChild);
+      CAlphabetManager * const m_pMgr;
+      ///offset() of the root, i.e. of the symbol it enters
+      const int m_iOffset;
+      ///Symbol entered, or 0 for a whole-alphabet group node
+      const symbol m_iSymbol;
+      ///LM context after the root
+      const CLanguageModel::Context m_iContext;
+    };
+
   public:
     ///
     /// Get a new root node owned by this manager
@@ -238,6 +334,13 @@ namespace Dasher {
     /// Note, the new node will _not_ be NF_SEEN
     CAlphNode *GetRoot(CDasherNode *pContext, bool bEnteredLast, int iOffset);
 
+    ///Make a test of whether a node already in the tree could be kept, in place of
+    /// the root GetRoot(NULL, true, iOffset) would make from the text now in the buffer.
+    /// A node passes if it is one of ours, at offset iOffset-1, and the symbols entered by
+    /// it and its ancestors are those in the buffer, as far back as the LM looks (so its
+    /// LM context is the same). The buffer is read once, here; see CDasherModel::ReuseNode.
+    std::function<bool(CDasherNode *)> ContextMatcher(int iOffset);
+
     const CAlphInfo *GetAlphabet() const;
 
   protected:
@@ -280,6 +383,39 @@ namespace Dasher {
     /// (also leaves space for NCManager::AddExtras to add control node)
     /// Returns array of non-cumulative probs. Should this be protected and/or virtual???
     void GetProbs(std::vector<unsigned int> *pProbs, CLanguageModel::Context iContext);
+
+    ///Get the cumulative probabilities (as GetProbs, then summed) for a context,
+    /// from m_ProbTables if already computed for an equivalent context (see
+    /// CLanguageModel::ContextKey), else computing them into a new table there.
+    /// \return table with a reference for the caller to m_ProbTables.Release.
+    std::vector<unsigned int> *GetProbTable(CLanguageModel::Context iContext);
+
+    ///Uniform probability to add to every symbol (from LP_UNIFORM), in GetProbs
+    /// or ComputeProbTable, out of iNorm
+    unsigned int UniformAdd(unsigned long iNorm, long iUniform) const;
+    ///If the parameters affecting the tables have changed since they were made,
+    /// forget them and stop any speculation (see m_aTableParams)
+    void CheckTableParams();
+    ///Ask m_pSpeculator (if any) to compute the table for a context, unless
+    /// m_ProbTables has it already.
+    void Speculate(CLanguageModel::Context iContext);
+    ///As GetProbTable, but for a context key, using m_aTableParams: run on
+    /// m_pSpeculator's threads, so must not touch anything they might change.
+    bool ComputeProbTable(std::size_t key, std::vector<unsigned int> &table) const;
+
+    ///Make a root node, as GetRoot, from what GetContextSymbols would return
+    /// \param sym symbol entered by the root, or 0 for a whole-alphabet group node
+    /// \param ctx LM context after it, of which the node takes ownership
+    CAlphNode *MakeRoot(int iOffset, symbol sym, CLanguageModel::Context ctx);
+
+    ///Tables of cumulative probabilities, shared between alphabet nodes
+    CProbTableStore m_ProbTables;
+    ///Parameters (normalization, LP_UNIFORM, LP_LM_ALPHA, LP_LM_BETA) with which
+    /// the tables in m_ProbTables were computed
+    long m_aTableParams[4];
+    ///Computes tables for m_ProbTables ahead of time, if LP_SPECULATION_THREADS
+    /// (used only for contexts with keys; see CLanguageModel::GetProbsForKey); else NULL
+    CProbSpeculator *m_pSpeculator;
     
     ///Constructs child nodes under the specified parent according to provided group.
     /// Nodes are created by calling CreateSymbolNode and CreateGroupNode, unless buildAround is non-null.
@@ -290,7 +426,13 @@ namespace Dasher {
     /// instead of the AlphabetManager's CreateSymbolNode/CreateGroupNode methods. This is used when
     /// rebuilding parents: passing in the pre-existing node here, allows it to intercept those calls
     /// and graft itself in in place of a new node, when appropriate.
-    void IterateChildGroups(CAlphNode *pParent, const SGroupInfo *pParentGroup, CAlphBase *buildAround);
+    /// Lazy expansion: if buildAround is null and the group has at least LP_LAZY_CHILDREN child
+    /// nodes, just sets NF_LAZY on the parent (except in game mode) without making any children.
+    /// Calling again on a parent with NF_LAZY, makes only those children not already existing
+    /// whose ranges intersect [iMinLbnd,iMaxHbnd) and are at least iMinSize; once all
+    /// exist, clears NF_LAZY (and sets NF_ALLCHILDREN).
+    void IterateChildGroups(CAlphNode *pParent, const SGroupInfo *pParentGroup, CAlphBase *buildAround,
+                            unsigned int iMinLbnd=0, unsigned int iMaxHbnd=~0u, unsigned int iMinSize=0);
 
     ///Last node (owned by this manager) that was output; if a node
     /// is Undo()ne, this is set to its parent. This is used to detect
@@ -303,6 +445,9 @@ namespace Dasher {
     /// Set when first character put in strTrainfileBuffer (following a context switch),
     /// as we may not be able to get the preceding characters if we wait too long.
     std::string strTrainfileContext;
+    ///Text taken from the above by WriteTrainFileFull, but not yet written out
+    /// as training was in progress in the background.
+    std::string m_strHeldTrainText;
 
     ///A character, 33<=c<=255, not in the alphabet; used to delimit contexts.
     ///"" if no such could be found (=> will be found on a per-context basis)
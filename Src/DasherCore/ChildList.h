@@ -0,0 +1,119 @@
+// ChildList.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __ChildList_h__
+#define __ChildList_h__
+
+#include "../Common/Common.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace Dasher {
+
+/// \ingroup Model
+/// @{
+
+/// Ordered list of (pointers to) the children of a node, e.g. a CDasherNode:
+/// the subset of std::vector that nodes need, but only 24 bytes (on 64-bit)
+/// and allocating nothing if there is at most one child. More are kept in a
+/// single array, which can be made exactly the right size before the children
+/// are added (see reserve) - unlike std::deque, which allocates a large chunk
+/// (and an index) even when empty. clear() frees the array.
+template<typename T> class CChildList {
+public:
+  typedef T **iterator;
+  typedef T *const *const_iterator;
+
+  CChildList() : m_ppData(m_pInline), m_iSize(0), m_iCapacity(INLINE) {}
+  ~CChildList() {release();}
+
+  iterator begin() {return m_ppData;}
+  iterator end() {return m_ppData + m_iSize;}
+  const_iterator begin() const {return m_ppData;}
+  const_iterator end() const {return m_ppData + m_iSize;}
+
+  std::size_t size() const {return m_iSize;}
+  bool empty() const {return m_iSize == 0;}
+  T *operator[](std::size_t i) const {
+    DASHER_ASSERT(i < m_iSize);
+    return m_ppData[i];
+  }
+  T *back() const {
+    DASHER_ASSERT(m_iSize > 0);
+    return m_ppData[m_iSize - 1];
+  }
+
+  /// Make room for at least iNum children in total, without reallocating
+  void reserve(std::size_t iNum) {
+    if (iNum > m_iCapacity) grow(iNum);
+  }
+  void push_back(T *pChild) {
+    if (m_iSize == m_iCapacity) grow(m_iCapacity * 2);
+    m_ppData[m_iSize++] = pChild;
+  }
+  /// Insert a child before the one at pos (or at the end), moving later ones down.
+  /// \return iterator pointing to the new child
+  iterator insert(iterator pos, T *pChild) {
+    const std::size_t i = pos - m_ppData;
+    DASHER_ASSERT(i <= m_iSize);
+    if (m_iSize == m_iCapacity) grow(m_iCapacity * 2);
+    std::memmove(m_ppData + i + 1, m_ppData + i, (m_iSize - i) * sizeof(T *));
+    m_ppData[i] = pChild;
+    m_iSize++;
+    return m_ppData + i;
+  }
+  /// Remove all children (without deleting them), freeing any array
+  void clear() {
+    release();
+    m_ppData = m_pInline;
+    m_iSize = 0;
+    m_iCapacity = INLINE;
+  }
+
+private:
+  ///Number of children held without allocating
+  static const unsigned int INLINE = 1;
+
+  void grow(std::size_t iCapacity) {
+    T **ppNew = new T *[iCapacity];
+    if (m_iSize) std::memcpy(ppNew, m_ppData, m_iSize * sizeof(T *));
+    release();
+    m_ppData = ppNew;
+    m_iCapacity = static_cast<unsigned int>(iCapacity);
+  }
+  void release() {
+    if (m_ppData != m_pInline) delete[] m_ppData;
+  }
+
+  T **m_ppData;
+  unsigned int m_iSize, m_iCapacity;
+  T *m_pInline[INLINE];
+
+  //Not copyable (nodes aren't)
+  CChildList(const CChildList &);
+  CChildList &operator=(const CChildList &);
+};
+
+/// @}
+
+}
+
+#endif // __ChildList_h__
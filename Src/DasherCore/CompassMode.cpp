@@ -78,25 +78,19 @@ bool CCompassMode::DecorateView(CDasherView *pView, CDasherInput *pInput) {
   bool bFirst(true);
 
   while(iPos >= 0) {
-    CDasherScreen::point p[2];
+    //the line at iPos is p[0]-p[1], that at 4096-iPos is p[2]-p[3]
+    const myint x[4] = {-100, -1000, -100, -1000}, y[4] = {iPos, iPos, 4096-iPos, 4096-iPos};
+    CDasherScreen::point p[4];
 
-    pView->Dasher2Screen(-100, iPos, p[0].x, p[0].y);
+    pView->Dasher2Screen(x, y, p, 4);
 
-    pView->Dasher2Screen(-1000, iPos, p[1].x, p[1].y);
-
-    if(bFirst)
-      pScreen->Polyline(p, 2, 1, 1);
-    else
-      pScreen->Polyline(p, 2, 1, 2);
-
-    pView->Dasher2Screen(-100, 4096-iPos, p[0].x, p[0].y);
-
-    pView->Dasher2Screen(-1000, 4096-iPos, p[1].x, p[1].y);
-
-    if(bFirst)
+    if(bFirst) {
       pScreen->Polyline(p, 2, 1, 1);
-    else
+      pScreen->Polyline(p+2, 2, 1, 1);
+    } else {
       pScreen->Polyline(p, 2, 1, 2);
+      pScreen->Polyline(p+2, 2, 1, 2);
+    }
 
     iPos -= iTargetWidth;
     bFirst = false;
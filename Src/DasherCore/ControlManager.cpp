@@ -37,7 +37,7 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 CControlBase::CControlBase(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager)
-  : CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pScreen(NULL), m_pRoot(NULL) {
+  : CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pScreen(NULL), m_iLabelBytes(0), m_pRoot(NULL) {
 }
 
 CControlBase::NodeTemplate *CControlBase::GetRootTemplate() {
@@ -58,7 +58,7 @@ int CControlBase::getColour(NodeTemplate *pTemplate, CDasherNode *pParent) {
 CDasherNode *CControlBase::GetRoot(CDasherNode *pContext, int iOffset) {
   if (!m_pRoot) return m_pNCManager->GetAlphabetManager()->GetRoot(pContext, false, iOffset);
 
-  CContNode *pNewNode = new CContNode(iOffset, getColour(m_pRoot, pContext), m_pRoot, this);
+  CContNode *pNewNode = m_NodeAlloc.Make<CContNode>(iOffset, getColour(m_pRoot, pContext), m_pRoot, this);
 
   // FIXME - handle context properly
 
@@ -72,11 +72,13 @@ void CControlBase::ChangeScreen(CDasherScreen *pScreen) {
   m_pScreen=pScreen;
   deque<NodeTemplate *> templateQueue(1,m_pRoot);
   set<NodeTemplate *> allTemplates(templateQueue.begin(),templateQueue.end());
+  m_iLabelBytes = 0;
   while (!templateQueue.empty()) {
     NodeTemplate *head = templateQueue.front();
     templateQueue.pop_front();
     delete head->m_pLabel;
     head->m_pLabel = pScreen->MakeLabel(head->m_strLabel);
+    m_iLabelBytes += head->m_pLabel->Bytes();
     for (auto child : head->successors) {
       if (!child) continue; //an escape back to the alphabet, no label/successors here
       if (allTemplates.find(child)==allTemplates.end()) {
@@ -87,6 +89,11 @@ void CControlBase::ChangeScreen(CDasherScreen *pScreen) {
   }
 }
 
+void CControlBase::GetMemoryUsage(SMemoryUsage &usage) const {
+  CNodeManager::GetMemoryUsage(usage);
+  usage.iLabels += m_iLabelBytes;
+}
+
 CControlBase::NodeTemplate::NodeTemplate(const string &strLabel,int iColour)
 : m_strLabel(strLabel), m_iColour(iColour), m_pLabel(NULL) {
 }
@@ -120,7 +127,7 @@ void CControlBase::CContNode::PopulateChildren() {
       pNewNode = m_pMgr->m_pNCManager->GetAlphabetManager()->GetRoot(this, false, newOffset + 1);
     }
     else {
-      pNewNode = new CContNode(newOffset, m_pMgr->getColour(child, this), child, m_pMgr);
+      pNewNode = m_pMgr->m_NodeAlloc.Make<CContNode>(newOffset, m_pMgr->getColour(child, this), child, m_pMgr);
     }
     pNewNode->Reparent(this, iLbnd, iHbnd);
     iLbnd=iHbnd;
@@ -102,6 +102,9 @@ namespace Dasher {
 
     ///Make this manager ready to make nodes renderable on the screen by preallocating labels
     virtual void ChangeScreen(CDasherScreen *pScreen);
+
+    ///Override to add the labels of all the templates
+    void GetMemoryUsage(SMemoryUsage &usage) const;
     
     ///
     /// Get a new root node owned by this manager
@@ -122,6 +125,8 @@ namespace Dasher {
     CDasherScreen *m_pScreen;
     
   private:
+    ///Memory taken by the labels made by ChangeScreen
+    std::size_t m_iLabelBytes;
     NodeTemplate *m_pRoot;
   };
 
@@ -42,7 +42,7 @@ using namespace Dasher;
 using namespace std;
 
 CConversionManager::CConversionManager(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager, const CAlphInfo *pAlphabet, CLanguageModel *pLanguageModel)
-: CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pAlphabet(pAlphabet), m_pLanguageModel(pLanguageModel) {
+: CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pNCManager(pNCManager), m_pAlphabet(pAlphabet), m_iLabelBytes(0), m_pLanguageModel(pLanguageModel) {
 
   //Testing for alphabet details, delete if needed:
   /*
@@ -63,7 +63,7 @@ CConversionManager::CConversionManager(CSettingsUser *pCreateFrom, CDasherInterf
 }
 
 CConversionManager::CConvNode *CConversionManager::makeNode(int iOffset, int iColour, CDasherScreen::Label *pLabel) {
-  return new CConvNode(iOffset, iColour, pLabel, this);
+  return m_NodeAlloc.Make<CConvNode>(iOffset, iColour, pLabel, this);
 }
 
 void CConversionManager::ChangeScreen(CDasherScreen *pScreen) {
@@ -71,14 +71,23 @@ void CConversionManager::ChangeScreen(CDasherScreen *pScreen) {
   for (map<string, CDasherScreen::Label *>::iterator it=m_vLabels.begin(); it!=m_vLabels.end(); it++)
     delete it->second;
   m_vLabels.clear();
+  m_iLabelBytes = 0;
   m_pScreen=pScreen;
 }
 
+void CConversionManager::GetMemoryUsage(SMemoryUsage &usage) const {
+  CNodeManager::GetMemoryUsage(usage);
+  usage.iContexts += m_pLanguageModel->ContextBytes();
+  usage.iLabels += m_iLabelBytes;
+}
+
 CDasherScreen::Label *CConversionManager::GetLabel(const char *pszConversion) {
   string strConv(pszConversion);
   if (m_vLabels[strConv])
     return m_vLabels[strConv];
-  return m_vLabels[strConv] = m_pScreen->MakeLabel(strConv);
+  CDasherScreen::Label *pLabel = m_vLabels[strConv] = m_pScreen->MakeLabel(strConv);
+  m_iLabelBytes += pLabel->Bytes();
+  return pLabel;
 }
 
 CConversionManager::CConvNode *CConversionManager::GetRoot(int iOffset, CLanguageModel::Context newCtx) {
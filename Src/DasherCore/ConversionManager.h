@@ -75,6 +75,9 @@ namespace Dasher {
     ///Tells us to use the specified screen to create node labels.
     /// (note we cache the screen and create labels lazily)
     void ChangeScreen(CDasherScreen *pScreen);
+
+    ///Override to add the contexts of our LM, and labels
+    void GetMemoryUsage(SMemoryUsage &usage) const;
     
   protected:
     
@@ -201,6 +204,8 @@ namespace Dasher {
   private:
 
     std::map<std::string, CDasherScreen::Label *> m_vLabels;
+    ///Memory taken by the labels in m_vLabels
+    std::size_t m_iLabelBytes;
     CDasherScreen *m_pScreen;
 
     ///
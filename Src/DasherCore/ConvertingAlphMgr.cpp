@@ -21,6 +21,11 @@ void CConvertingAlphMgr::MakeLabels(CDasherScreen *pScreen) {
   m_pConvMgr->ChangeScreen(pScreen);
 }
 
+void CConvertingAlphMgr::GetMemoryUsage(SMemoryUsage &usage) const {
+  CAlphabetManager::GetMemoryUsage(usage);
+  m_pConvMgr->GetMemoryUsage(usage);
+}
+
 CConvertingAlphMgr::~CConvertingAlphMgr() {
 }
 
@@ -34,8 +39,8 @@ CDasherNode *CConvertingAlphMgr::CreateSymbolNode(CAlphNode *pParent, symbol iSy
     // ConversionManager's LM to clone a context from an Alphabet Node,
     // I don't know - not sure how LanguageModelling WRT conversion
     // is supposed to work...
-    CLanguageModel::Context iContext = (pParent->iContext)
-      ? m_pConvMgr->m_pLanguageModel->CloneContext(pParent->iContext)
+    CLanguageModel::Context iContext = (pParent->GetLMContext())
+      ? m_pConvMgr->m_pLanguageModel->CloneContext(pParent->GetLMContext())
       : m_pConvMgr->m_pLanguageModel->CreateEmptyContext(); 
 
     //ACL setting m_iOffset+1 for consistency with "proper" symbol nodes...
@@ -25,6 +25,8 @@ namespace Dasher {
     CConvertingAlphMgr(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager, CConversionManager *pConvMgr, const CAlphInfo *pAlphabet);
     ///Override to also tell the ConversionManager that the screen has changed.
     void MakeLabels(CDasherScreen *pScreen);
+    ///Override to also include the ConversionManager's usage
+    void GetMemoryUsage(SMemoryUsage &usage) const;
     virtual ~CConvertingAlphMgr();
   protected:
     ///Override to return a conversion root for iSymbol==(one beyond last alphabet symbol)
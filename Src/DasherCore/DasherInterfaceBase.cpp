@@ -88,7 +88,9 @@ CDasherInterfaceBase::CDasherInterfaceBase(CSettingsStore *pSettingsStore, CFile
   m_pSettingsStore(pSettingsStore), 
   m_pLockLabel(NULL),
   m_preSetObserver(*pSettingsStore),
-  m_bLastMoved(false) {
+  m_pTrainingLabel(NULL),
+  m_bLastMoved(false),
+  m_pFrameTimings(NULL) {
   
   pSettingsStore->Register(this);
   pSettingsStore->PreSetObservable().Register(&m_preSetObserver);
@@ -105,6 +107,7 @@ CDasherInterfaceBase::CDasherInterfaceBase(CSettingsStore *pSettingsStore, CFile
   m_ControlBoxIO = NULL;
   m_pUserLog = NULL;
   m_pNCManager = NULL;
+  m_pTrainingNCManager = NULL;
   m_defaultPolicy = NULL;
   m_pWordSpeaker = NULL;
   m_pGameModule = NULL;
@@ -167,6 +170,7 @@ void CDasherInterfaceBase::Realize(unsigned long ulTime) {
     pCon->HandleEvent(SP_INPUT_FILTER);
 
   HandleEvent(LP_NODE_BUDGET);
+  HandleEvent(LP_ROOT_HISTORY_BUDGET);
   HandleEvent(BP_SPEAK_WORDS);
 
   // FIXME - need to rationalise this sort of thing.
@@ -181,6 +185,7 @@ void CDasherInterfaceBase::Realize(unsigned long ulTime) {
 
 CDasherInterfaceBase::~CDasherInterfaceBase() {
   //WriteTrainFileFull();???
+  StopTraining();               // Before anything it uses goes; writes held-back text
   delete m_pDasherModel;        // The order of some of these deletions matters
   delete m_pDasherView;
   delete m_ControlBoxIO;
@@ -263,6 +268,7 @@ void CDasherInterfaceBase::HandleEvent(int iParameter) {
  SetStringParameter(SP_COLOUR_ID, m_pNCManager->GetAlphabet()->GetPalette());
     break;
   case LP_LANGUAGE_MODEL_ID:
+  case LP_SPECULATION_THREADS:
     CreateNCManager();
     break;
   case LP_LINE_WIDTH:
@@ -286,8 +292,16 @@ void CDasherInterfaceBase::HandleEvent(int iParameter) {
       ScheduleRedraw();
       break;
   case LP_NODE_BUDGET:
+  case LP_NODE_MEMORY_BUDGET:
     delete m_defaultPolicy;
-    m_defaultPolicy = new AmortizedPolicy(m_pDasherModel,GetLongParameter(LP_NODE_BUDGET));
+    if (long iKB = GetLongParameter(LP_NODE_MEMORY_BUDGET))
+      m_defaultPolicy = new AmortizedPolicy(m_pDasherModel, GetLongParameter(LP_NODE_BUDGET), iKB * 1024,
+                                            [this]() {return m_pNCManager->GetMemoryUsage().Total();});
+    else
+      m_defaultPolicy = new AmortizedPolicy(m_pDasherModel,GetLongParameter(LP_NODE_BUDGET));
+    break;
+  case LP_ROOT_HISTORY_BUDGET:
+    m_pDasherModel->SetHistoryBudget(GetLongParameter(LP_ROOT_HISTORY_BUDGET) * 1024);
     break;
   case BP_SPEAK_WORDS:
     delete m_pWordSpeaker;
@@ -367,6 +381,22 @@ void CDasherInterfaceBase::SetLockStatus(const string &strText, int iPercent) {
   }
 }
 
+void CDasherInterfaceBase::SetTrainingStatus(const string &strText, int iPercent) {
+  string newMessage; //empty if iPercent==-1 (finished)
+  if (iPercent!=-1) {
+    ostringstream os;
+    os << (strText.empty() ? "Training Dasher" : strText);
+    if (iPercent) os << " " << iPercent << "%";
+    newMessage = os.str();
+  }
+  if (newMessage != m_strTrainingMessage) {
+    ScheduleRedraw();
+    delete m_pTrainingLabel;
+    m_pTrainingLabel = NULL;
+    m_strTrainingMessage = newMessage;
+  }
+}
+
 void CDasherInterfaceBase::editOutput(const std::string &strText, CDasherNode *pCause) {
   CEditEvent evt(CEditEvent::EDIT_OUTPUT, strText, pCause);
   DispatchEvent(&evt);
@@ -396,26 +426,60 @@ void CDasherInterfaceBase::CreateNCManager() {
   if(!m_AlphIO || GetLongParameter(LP_LANGUAGE_MODEL_ID)==-1)
     return;
 
-  //can't delete the old manager yet until we've deleted all its nodes...
-  CNodeCreationManager *pOldMgr = m_pNCManager;
+  //Any manager still training, was for the old alphabet/settings
+  StopTraining();
 
-  //now create the new manager...
-  m_pNCManager = new CNodeCreationManager(this, this, m_AlphIO, m_ControlBoxIO);
+  CNodeCreationManager *pNewMgr = new CNodeCreationManager(this, this, m_AlphIO, m_ControlBoxIO);
+  if (pNewMgr->StartTraining()) {
+    //Training in the background. Until it finishes, use a manager with an
+    // untrained LM (PollTraining will swap in the trained one).
+    m_pTrainingNCManager = pNewMgr;
+    pNewMgr = new CNodeCreationManager(this, this, m_AlphIO, m_ControlBoxIO);
+  }
   if (GetBoolParameter(BP_PALETTE_CHANGE))
-    SetStringParameter(SP_COLOUR_ID, m_pNCManager->GetAlphabet()->GetPalette());
+    SetStringParameter(SP_COLOUR_ID, pNewMgr->GetAlphabet()->GetPalette());
+  SetNCManager(pNewMgr);
+}
+
+void CDasherInterfaceBase::SetNCManager(CNodeCreationManager *pNewMgr) {
+  //can't delete the old manager yet until we've deleted all its nodes...
+  CNodeCreationManager *pOldMgr = m_pNCManager;
+  m_pNCManager = pNewMgr;
 
   if (m_DasherScreen) {
     m_pNCManager->ChangeScreen(m_DasherScreen);
     //and start a new tree of nodes from it (retaining old offset -
     // this will be a sensible default of 0 if no nodes previously existed).
     // This deletes the old tree of nodes...
-    SetOffset(m_pDasherModel->GetOffset(), true);
+    MakeTree(m_pDasherModel->GetOffset());
   } //else, if there is no screen, the model should not contain any nodes from the old NCManager. (Assert, somehow?)
 
   //...so now we can delete the old manager
   delete pOldMgr;
 }
 
+void CDasherInterfaceBase::StopTraining() {
+  if (!m_pTrainingNCManager) return;
+  delete m_pTrainingNCManager;
+  m_pTrainingNCManager = NULL;
+  SetTrainingStatus("", -1);
+  //Nothing is reading the training file now, so write out any text held back
+  // while it was (which the trained manager would have taken over)
+  m_pNCManager->GetAlphabetManager()->WriteTrainFileFull(this);
+}
+
+void CDasherInterfaceBase::PollTraining(bool bWait) {
+  if (!m_pTrainingNCManager || !m_pTrainingNCManager->PollTraining(bWait)) return;
+  CNodeCreationManager *pTrained = m_pTrainingNCManager;
+  m_pTrainingNCManager = NULL;
+  //BP_CONTROL_MODE may have been set, or an input filter or game module created,
+  // since the manager was constructed...
+  pTrained->CreateControlBox(m_ControlBoxIO);
+  //and the user may have written something, which the untrained LM learnt.
+  pTrained->TakeOverTrainText(m_pNCManager);
+  SetNCManager(pTrained);
+}
+
 CDasherInterfaceBase::TextAction::TextAction(CDasherInterfaceBase *pIntf) : m_pIntf(pIntf) {
   m_iStartOffset= pIntf->GetAllContextLenght();
   pIntf->m_vTextActions.insert(this);
@@ -493,13 +557,21 @@ void CDasherInterfaceBase::NewFrame(unsigned long iTime, bool bForceRedraw) {
   if(m_DasherScreen) {
     //ok, can draw _something_. Try and see what we can :).
 
+    if (m_pFrameTimings) {
+      *m_pFrameTimings = SFrameTimings();
+      m_tStageEnd = std::chrono::steady_clock::now();
+    }
+
     bool bBlit = false; //set to true if we actually render anything different i.e. that needs blitting to display
 
+    //Swap in the trained LM if it's ready.
+    PollTraining(false);
+
     if (isLocked() || !m_pDasherView) {
-      //Hmmm. If we're locked, NewFrame is never actually called - the thread
-      // that would be rendering frames, is the same one doing the training.
-      // So the following is never actually executed atm, but may be a simple
-      // template if/when we ever implement multithreading widely/properly...
+      //Hmmm. We are only locked while importing training text (ImportTrainingText),
+      // which trains on the thread that would be rendering frames, so NewFrame
+      // is never actually called then (training at startup or on alphabet change
+      // is in the background, and reported by SetTrainingStatus instead).
       m_DasherScreen->SendMarker(0); //this replaces the nodes...
       const screenint iSW = m_DasherScreen->GetWidth(), iSH = m_DasherScreen->GetHeight();
       m_DasherScreen->DrawRectangle(0,0,iSW,iSH,0,0,0); //fill in colour 0 = white
@@ -516,6 +588,7 @@ void CDasherInterfaceBase::NewFrame(unsigned long iTime, bool bForceRedraw) {
       if(m_pInputFilter) {
         m_pInputFilter->Timer(iTime, m_pDasherView, m_pInput, m_pDasherModel, &pol);
       }
+      EndStage(&SFrameTimings::dTimer);
       //2. Render...
 
       //If we've been told to render another frame via ScheduleRedraw,
@@ -536,9 +609,20 @@ void CDasherInterfaceBase::NewFrame(unsigned long iTime, bool bForceRedraw) {
         if (m_bLastMoved) bForceRedraw=true;//move into onPause() method if reqd
         m_bLastMoved=false;
       }
+      EndStage(&SFrameTimings::dStep);
       //2. Render nodes decorations, messages
       bBlit = Redraw(iTime, bForceRedraw, *pol);
 
+      if (!m_strTrainingMessage.empty()) {
+        //Still training: show progress in the corner, over the decorations
+        unsigned int iSize(GetLongParameter(LP_MESSAGE_FONTSIZE));
+        if (!m_pTrainingLabel) m_pTrainingLabel = m_DasherScreen->MakeLabel(m_strTrainingMessage, iSize);
+        pair<screenint,screenint> dims = m_DasherScreen->TextSize(m_pTrainingLabel, iSize);
+        m_DasherScreen->DrawRectangle(0, 0, dims.first, dims.second, 5, -1, -1); //black
+        m_DasherScreen->DrawString(m_pTrainingLabel, 0, 0, iSize, 0); //white
+        bBlit = true;
+      }
+
       if (m_pUserLog != NULL) {
         //(any) UserLogBase will have been watching output events to gather information
         // about symbols added/deleted; this tells it to apply that information at end-of-frame
@@ -546,13 +630,23 @@ void CDasherInterfaceBase::NewFrame(unsigned long iTime, bool bForceRedraw) {
         m_pUserLog->FrameEnded();
       }
     }
+    EndStage(NULL);
     if (FinishRender(iTime)) bBlit = true;
     if (bBlit) m_DasherScreen->Display();
+    EndStage(&SFrameTimings::dFinish);
   }
 
   bReentered=false;
 }
 
+void CDasherInterfaceBase::EndStage(double SFrameTimings::*pStage) {
+  if (!m_pFrameTimings) return;
+  const std::chrono::steady_clock::time_point tNow(std::chrono::steady_clock::now());
+  if (pStage)
+    m_pFrameTimings->*pStage += std::chrono::duration<double, std::micro>(tNow - m_tStageEnd).count();
+  m_tStageEnd = tNow;
+}
+
 void CDasherInterfaceBase::onUnpause(unsigned long lTime) {
   //TODO When Game+UserLog modules are combined => reduce to just one call here
   if (m_pGameModule)
@@ -569,10 +663,12 @@ bool CDasherInterfaceBase::Redraw(unsigned long ulTime, bool bRedrawNodes, CExpa
     m_pDasherView->Screen()->SendMarker(0);
     if (m_pDasherModel) {
       m_pDasherModel->RenderToView(m_pDasherView,policy);
+      EndStage(&SFrameTimings::dRender);
       // if anything was expanded or collapsed render at least one more
       // frame after this
       if (policy.apply())
         ScheduleRedraw();
+      EndStage(&SFrameTimings::dApply);
     }
     if(m_pGameModule) {
       m_pGameModule->DecorateView(ulTime, m_pDasherView, m_pDasherModel);
@@ -634,6 +730,9 @@ void CDasherInterfaceBase::ChangeColours() {
 void CDasherInterfaceBase::ChangeScreen(CDasherScreen *NewScreen) {
   
   m_DasherScreen = NewScreen;
+  //labels are specific to the screen that made them
+  delete m_pTrainingLabel;
+  m_pTrainingLabel = NULL;
   ChangeColours();
   
   if(m_pDasherView != 0) {
@@ -647,7 +746,7 @@ void CDasherInterfaceBase::ChangeScreen(CDasherScreen *NewScreen) {
   if (m_pNCManager) {
     m_pNCManager->ChangeScreen(m_DasherScreen);
     if (m_pDasherModel)
-      SetOffset(m_pDasherModel->GetOffset(), true);
+      MakeTree(m_pDasherModel->GetOffset());
   }
 }
 
@@ -706,6 +805,10 @@ void CDasherInterfaceBase::ResetNats() {
     m_pDasherModel->ResetNats();
 }
 
+const CProbTableStore::SStats &CDasherInterfaceBase::GetProbTableStats() const {
+  return m_pNCManager->GetAlphabetManager()->GetProbTableStats();
+}
+
 void CDasherInterfaceBase::ClearAllContext() {
   ctrlDelete(true, CControlManager::EDIT_FILE);
   ctrlDelete(false, CControlManager::EDIT_FILE);
@@ -833,9 +936,9 @@ bool CDasherInterfaceBase::GetModuleSettings(const std::string &strName, SModule
 void CDasherInterfaceBase::SetOffset(int iOffset, bool bForce) {
   if (iOffset == m_pDasherModel->GetOffset() && !bForce) return;
 
-  CDasherNode *pNode = m_pNCManager->GetAlphabetManager()->GetRoot(NULL, iOffset!=0, iOffset);
-  if (GetGameModule()) pNode->SetFlag(NF_GAME, true);
-  m_pDasherModel->SetNode(pNode);
+  //(game mode flags the nodes on the target path, so always starts afresh)
+  if (GetGameModule() || !m_pDasherModel->ReuseNode(iOffset, m_pNCManager->GetAlphabetManager()->ContextMatcher(iOffset)))
+    MakeTree(iOffset);
   
   //ACL TODO note that CTL_MOVE, etc., do not come here (that would probably
   // rebuild the model / violently repaint the screen every time!). But we
@@ -849,6 +952,13 @@ void CDasherInterfaceBase::SetOffset(int iOffset, bool bForce) {
   ScheduleRedraw();
 }
 
+void CDasherInterfaceBase::MakeTree(int iOffset) {
+  CDasherNode *pNode = m_pNCManager->GetAlphabetManager()->GetRoot(NULL, iOffset!=0, iOffset);
+  if (GetGameModule()) pNode->SetFlag(NF_GAME, true);
+  m_pDasherModel->SetNode(pNode);
+  ScheduleRedraw();
+}
+
 // Returns 0 on success, an error string on failure.
 const char* CDasherInterfaceBase::ClSet(const std::string &strKey, const std::string &strValue) {
   return m_pSettingsStore->ClSet(strKey, strValue);
@@ -857,6 +967,8 @@ const char* CDasherInterfaceBase::ClSet(const std::string &strKey, const std::st
 
 void
 CDasherInterfaceBase::ImportTrainingText(const std::string &strPath) {
+  //Import into the trained LM, not one about to be replaced
+  PollTraining(true);
   if(m_pNCManager)
     m_pNCManager->ImportTrainingText(strPath);
 }
@@ -41,8 +41,10 @@
 #include "ModuleManager.h"
 #include "ControlManager.h"
 #include "FrameRate.h"
+#include "ProbTableStore.h"
 #include <set>
 #include <algorithm>
+#include <chrono>
 
 namespace Dasher {
   class CDasherScreen;
@@ -84,6 +86,10 @@ public:
 	virtual void ScanFiles(AbstractParser *parser, const std::string &strPattern) = 0;
 
 	// Writes file to user data directory. 
+	/// Unless appending, the file must be replaced as a whole (e.g. by writing
+	/// a new file and renaming it over the old one) rather than truncated and
+	/// rewritten in place: where mmap is available, the old contents may still
+	/// be mapped by a language model (see CPPMSnapshot and CTrainingCache::Store).
 	virtual bool WriteUserDataFile(const std::string &filename, const std::string &strNewText, bool append) = 0;
 
 };
@@ -166,6 +172,18 @@ public:
   /// needs to be threadsafe, which neither this nor BP_TRAINING is (I don't think!)...
   inline bool isLocked() {return !m_strLockMessage.empty();}
 
+  ///Whether an LM is still being trained in the background (see SetTrainingStatus)
+  bool isTraining() const {return m_pTrainingNCManager != NULL;}
+
+  ///Reports progress of training the language model in the background (see
+  /// CreateNCManager); unlike SetLockStatus, the user may carry on writing
+  /// meanwhile. The default stores the message in m_strTrainingMessage, for
+  /// NewFrame to render in the corner of the canvas; subclasses may override to
+  /// e.g. use a status bar instead.
+  /// \param strText text of message to display, excluding %age
+  /// \param iPercent -1 means training has finished; else %progress.
+  virtual void SetTrainingStatus(const std::string &strText, int iPercent);
+
   ///Does this subclass support speech (i.e. the speak(string) method?)
   /// Default is just to return false.
   virtual bool SupportsSpeech() {return false;}
@@ -292,15 +310,13 @@ public:
   ///Equivalent to SetOffset(iOffset, true)
   void SetBuffer(int iOffset) {SetOffset(iOffset, true);}
 
-  /// Rebuilds the model at the specified location, potentially reusing nodes if !bForce
+  /// Moves the model to the specified location. Nodes already in the tree are
+  /// kept if one, at that location, enters the text now in the buffer before it
+  /// (see CDasherModel::ReuseNode); otherwise the tree is rebuilt (MakeTree).
   /// @param iOffset Cursor position in attached buffer from which to obtain context
-  /// @param bForce if true, model should be completely rebuilt (even for
-  /// same offset) - characters at old offsets may have changed, or we have
-  /// a new AlphabetManager. If false, assume buffer and alphabet unchanged,
-  /// so no need to rebuild the model if an existing node covers this point.
-
-  /// @param bForce true meaning the entire context may have changed,
-  /// false if we've just moved around within it.
+  /// @param bForce if true, characters at old offsets may have changed, so the
+  /// tree must be checked against the buffer even for the same offset. If false,
+  /// assume the buffer is unchanged, so nothing need be done for the same offset.
   void SetOffset(int iOffset, bool bForce=false);
 
   /// @name Status reporting
@@ -331,6 +347,30 @@ public:
 
   void ResetNats();
 
+  /// Time (in microseconds) spent in each stage of a call to NewFrame; stages
+  /// not reached (e.g. if locked) are 0.
+  struct SFrameTimings {
+    SFrameTimings() : dTimer(0), dStep(0), dRender(0), dApply(0), dFinish(0) {}
+    /// The input filter's Timer, i.e. deciding where to move
+    double dTimer;
+    /// CDasherModel::NextScheduledStep, i.e. moving
+    double dStep;
+    /// CDasherModel::RenderToView
+    double dRender;
+    /// CExpansionPolicy::apply, i.e. expanding and collapsing nodes
+    double dApply;
+    /// FinishRender, and blitting (CDasherScreen::Display)
+    double dFinish;
+  };
+
+  /// Record how long each stage of NewFrame takes into *pTimings, overwriting
+  /// it every frame, until called again with NULL (the default).
+  void SetFrameTimings(SFrameTimings *pTimings) {m_pFrameTimings = pTimings;}
+
+  /// How often the current alphabet's nodes have found their probability tables
+  /// already made (see CAlphabetManager::GetProbTableStats)
+  const CProbTableStore::SStats &GetProbTableStats() const;
+
   /// @}
 
   /// @name User input
@@ -400,7 +440,8 @@ public:
   void ImportTrainingText(const std::string &strPath);
 
   /// Flush the/all currently-written text to the user's training file(s).
-  /// Just calls through to WriteTrainFileFull(this) on the AlphabetManager;
+  /// Just calls through to WriteTrainFileFull(this) on the AlphabetManager
+  /// (so, while isTraining(), holds the text until training finishes);
   /// public so e.g. iPhone can flush the buffer when app is backgrounded.
   void WriteTrainFileFull();
 
@@ -426,6 +467,12 @@ public:
   void ScanFiles(AbstractParser *parser, const std::string &strPattern)  {
 	  m_fileUtils->ScanFiles(parser, strPattern);
   }
+
+  ///Write a file to the user data directory, replacing any existing one
+  /// unless append is true.
+  bool WriteUserDataFile(const std::string &filename, const std::string &strNewText, bool append) {
+	  return m_fileUtils->WriteUserDataFile(filename, strNewText, append);
+  }
   
   // @}
   
@@ -537,7 +584,8 @@ protected:
   CPreSetObserver m_preSetObserver;
   CFileUtils* m_fileUtils;
 
-  //The default expansion policy to use - an amortized policy depending on the LP_NODE_BUDGET parameter.
+  //The default expansion policy to use - an amortized policy depending on the LP_NODE_BUDGET
+  // and LP_NODE_MEMORY_BUDGET parameters.
   CExpansionPolicy *m_defaultPolicy;
 
   /// Provide a new CDasherInput input device object.
@@ -547,7 +595,24 @@ protected:
   void CreateInputFilter();
 
   void CreateModel(int iOffset);
+  ///Creates a new NCManager for the current alphabet & LM settings. The LM is
+  /// trained on a separate thread (in m_pTrainingNCManager), and meanwhile
+  /// the user writes using an untrained one.
   void CreateNCManager();
+  ///Start using a new NCManager, rebuilding the tree of nodes from it, and
+  /// deleting the old manager.
+  void SetNCManager(CNodeCreationManager *pNewMgr);
+  ///Discard all nodes and build a new tree from the text in the buffer. Unlike
+  /// SetOffset, never reuses any nodes, so must be used when those are unusable,
+  /// e.g. labelled for a previous screen, or made by a previous NCManager.
+  /// \param iOffset Cursor position in attached buffer
+  void MakeTree(int iOffset);
+  ///Abandon any training in m_pTrainingNCManager, then write out any text the
+  /// current manager held back meanwhile (see CAlphabetManager::WriteTrainFileFull)
+  void StopTraining();
+  ///Check on m_pTrainingNCManager, and swap it in if it has finished training.
+  /// \param bWait if true, wait for training to finish.
+  void PollTraining(bool bWait);
 
   void ChangeAlphabet();
   void ChangeColours();
@@ -578,6 +643,9 @@ protected:
   CColourIO *m_ColourIO;
   CControlBoxIO *m_ControlBoxIO;
   CNodeCreationManager *m_pNCManager;
+  ///Manager whose LM is being trained in the background, to replace
+  /// m_pNCManager when done; NULL if none.
+  CNodeCreationManager *m_pTrainingNCManager;
   CUserLogBase *m_pUserLog;
 
   // the game mode module - only
@@ -591,6 +659,12 @@ protected:
   /// (so may still be NULL even if locked)
   CDasherScreen::Label *m_pLockLabel;
 
+  ///If non-empty, the LM is being trained in the background, and this is the
+  /// progress message to display (without stopping the user writing).
+  std::string m_strTrainingMessage;
+  /// (Cache) renderable version of previous, as m_pLockLabel
+  CDasherScreen::Label *m_pTrainingLabel;
+
   ///Whether a full redraw (inc of nodes) has been requested externally,
   /// via ScheduleRedraw, for the next frame
   bool m_bRedrawScheduled;
@@ -598,6 +672,13 @@ protected:
   ///Whether we moved anywhere in the last call to NewFrame.
   bool m_bLastMoved;
 
+  ///Where to record the stages of NewFrame (see SetFrameTimings), or NULL
+  SFrameTimings *m_pFrameTimings;
+  ///When the last stage recorded ended
+  std::chrono::steady_clock::time_point m_tStageEnd;
+  ///If recording, add the time since the last stage ended to pStage (if non-NULL).
+  void EndStage(double SFrameTimings::*pStage);
+
   /// @}
 
   std::set<TextAction *> m_vTextActions;
@@ -58,6 +58,10 @@ CDasherModel::CDasherModel() {
   m_Rootmax = 0;
   m_iDisplayOffset = 0;
   m_dTotalNats = 0.0;
+  m_iHistoryBudget = 256 * 1024;
+  m_iRecipeBytes = 0;
+  m_iRootNodes = 0;
+  m_iRootBytes = 0;
 
   // TODO: Need to rationalise the require conversion methods
 #ifdef JAPANESE
@@ -74,6 +78,7 @@ CDasherModel::CDasherModel() {
 }
 
 CDasherModel::~CDasherModel() {
+  ClearRecipes();
   if(oldroots.size() > 0) {
     delete oldroots[0];
     oldroots.clear();
@@ -96,16 +101,11 @@ void CDasherModel::Make_root(CDasherNode *pNewRoot) {
 
   // TODO: Is the stack necessary at all? We may as well just keep the
   // existing data structure?
-  oldroots.push_back(m_Root);
+  PushOldRoot(m_Root, pNewRoot, false);
 
-  // TODO: tidy up conditional
-  while((oldroots.size() > 10) && (!m_bRequireConversion || (oldroots[0]->GetFlag(NF_CONVERTED)))) {
-    oldroots[0]->OrphanChild(oldroots[1]);
-    delete oldroots[0];
-    oldroots.pop_front();
-  }
   DASHER_ASSERT(pNewRoot->GetFlag(NF_SEEN));
   m_Root = pNewRoot;
+  TrimHistory();
 
   // Update the root coordinates, as well as any currently scheduled locations
   const myint range = m_Rootmax - m_Rootmin;
@@ -130,7 +130,19 @@ bool CDasherModel::Reparent_root() {
   CDasherNode *pNewRoot;
 
   if(oldroots.size() == 0) {
-    pNewRoot = m_Root->RebuildParent();
+    pNewRoot = NULL;
+    //Remake the parent from the most recent recipe, if we have one...
+    if (!m_deRecipes.empty()) {
+      CDasherNode::CRecipe *pRecipe = m_deRecipes.back();
+      m_deRecipes.pop_back();
+      m_iRecipeBytes -= pRecipe->Bytes();
+      pNewRoot = pRecipe->Rebuild(m_Root);
+      delete pRecipe;
+      //if that recipe wasn't for the parent, the older ones won't be for its ancestors
+      if (!pNewRoot) ClearRecipes();
+    }
+    //...otherwise, from scratch
+    if (!pNewRoot) pNewRoot = m_Root->RebuildParent();
     // Fail if there's no existing parent and no way of recreating one
     if(pNewRoot == NULL) return false;
     //better propagate gameness backwards, the original nodes must have been NF_GAME too
@@ -140,13 +152,10 @@ bool CDasherModel::Reparent_root() {
     //RebuildParent() can create multiple generations of parents at once;
     // make sure our cache has all such that were created, so we delete them
     // if we ever delete all our other nodes.
-    for (CDasherNode *pTemp = pNewRoot; (pTemp = pTemp->Parent()); )
-      oldroots.push_front(pTemp);
-  }
-  else {
-    pNewRoot = oldroots.back();
-    oldroots.pop_back();
+    for (CDasherNode *pTemp = pNewRoot; pTemp->Parent(); pTemp = pTemp->Parent())
+      PushOldRoot(pTemp->Parent(), pTemp, true);
   }
+  else pNewRoot = PopOldRoot(false);
 
   DASHER_ASSERT(m_Root->Parent() == pNewRoot);
 
@@ -160,7 +169,7 @@ bool CDasherModel::Reparent_root() {
       ((myint(lower) / static_cast<double>(iRange)) >
            (m_Rootmin - m_Rootmin_min) / static_cast<double>(iRootWidth))) {
     //but cache the (currently-unusable) root node - else we'll keep recreating (and deleting) it on every frame...
-    oldroots.push_back(pNewRoot);
+    PushOldRoot(pNewRoot, m_Root, false);
     return false;
   }
 
@@ -182,7 +191,82 @@ bool CDasherModel::Reparent_root() {
   return true;
 }
 
+void CDasherModel::SetHistoryBudget(size_t iBytes) {
+  m_iHistoryBudget = iBytes;
+  if (m_Root) TrimHistory();
+}
+
+///Memory taken by a node and all its descendants; adds their number to iNodes
+static size_t SubtreeBytes(const CDasherNode *pNode, int &iNodes) {
+  iNodes++;
+  size_t iBytes(pNode->mgr()->AverageNodeBytes());
+  for (CDasherNode::ChildMap::const_iterator it = pNode->GetChildren().begin(); it != pNode->GetChildren().end(); it++)
+    iBytes += SubtreeBytes(*it, iNodes);
+  return iBytes;
+}
+
+void CDasherModel::PushOldRoot(CDasherNode *pOld, const CDasherNode *pNext, bool bFront) {
+  //Make_root deletes pNext's nephews first, but an old root rebuilt by
+  // Reparent_root may still have some.
+  int iNodes(1);
+  size_t iBytes(pOld->mgr()->AverageNodeBytes());
+  for (CDasherNode::ChildMap::const_iterator it = pOld->GetChildren().begin(); it != pOld->GetChildren().end(); it++)
+    if (*it != pNext) iBytes += SubtreeBytes(*it, iNodes);
+  m_iRootNodes += iNodes;
+  m_iRootBytes += iBytes;
+  if (bFront) {
+    oldroots.push_front(pOld);
+    m_deRootCosts.push_front(make_pair(iNodes, iBytes));
+  } else {
+    oldroots.push_back(pOld);
+    m_deRootCosts.push_back(make_pair(iNodes, iBytes));
+  }
+}
+
+CDasherNode *CDasherModel::PopOldRoot(bool bFront) {
+  CDasherNode *pOld(bFront ? oldroots.front() : oldroots.back());
+  const pair<int, size_t> cost(bFront ? m_deRootCosts.front() : m_deRootCosts.back());
+  if (bFront) {
+    oldroots.pop_front();
+    m_deRootCosts.pop_front();
+  } else {
+    oldroots.pop_back();
+    m_deRootCosts.pop_back();
+  }
+  m_iRootNodes -= cost.first;
+  m_iRootBytes -= cost.second;
+  return pOld;
+}
+
+void CDasherModel::TrimHistory() {
+  // TODO: tidy up conditional
+  while (!oldroots.empty() && m_iRootBytes > m_iHistoryBudget / 2 && (!m_bRequireConversion || (oldroots[0]->GetFlag(NF_CONVERTED)))) {
+    CDasherNode *pOld(PopOldRoot(true));
+    CDasherNode *pNext(oldroots.empty() ? m_Root : oldroots[0]);
+    if (CDasherNode::CRecipe *pRecipe = pOld->MakeRecipe()) {
+      m_deRecipes.push_back(pRecipe);
+      m_iRecipeBytes += pRecipe->Bytes();
+    }
+    pOld->OrphanChild(pNext);
+    delete pOld;
+  }
+
+  while (m_iRecipeBytes > m_iHistoryBudget - m_iHistoryBudget / 2) {
+    m_iRecipeBytes -= m_deRecipes.front()->Bytes();
+    delete m_deRecipes.front();
+    m_deRecipes.pop_front();
+  }
+}
+
+void CDasherModel::ClearRecipes() {
+  for (deque<CDasherNode::CRecipe *>::iterator it = m_deRecipes.begin(); it != m_deRecipes.end(); it++)
+    delete *it;
+  m_deRecipes.clear();
+  m_iRecipeBytes = 0;
+}
+
 void CDasherModel::ClearRootQueue() {
+  ClearRecipes();
   while(oldroots.size() > 0) {
     if(oldroots.size() > 1) {
       oldroots[0]->OrphanChild(oldroots[1]);
@@ -190,8 +274,7 @@ void CDasherModel::ClearRootQueue() {
     else {
       oldroots[0]->OrphanChild(m_Root);
     }
-    delete oldroots[0];
-    oldroots.pop_front();
+    delete PopOldRoot(true);
   }
 }
 
@@ -206,11 +289,78 @@ void CDasherModel::SetNode(CDasherNode *pNewRoot) {
   // Create children of the root...
   ExpandNode(m_Root);
 
-  // Set the root coordinates so that the root node is an appropriate
-  // size and we're not in any of the children
-  m_Root->SetFlag(NF_SEEN, true); //(but we are in the node itself)
+  m_Root->SetFlag(NF_SEEN, true); //we are in the node itself
   m_pLastOutput = m_Root;
 
+  InitRootCoords();
+}
+
+bool CDasherModel::ReuseNode(int iOffset, const std::function<bool(CDasherNode *)> &fnMatches) {
+  if (!m_Root) return false;
+  const int iNewOffset(iOffset-1);
+  CDasherNode *pNewRoot(NULL);
+  const bool bBackwards(m_pLastOutput->offset() >= iNewOffset);
+  if (bBackwards) {
+    //Nodes output lead back (through any old roots) to the top of the tree,
+    // with offsets decreasing; find the outermost at the new offset
+    for (CDasherNode *p = m_pLastOutput; p && p->offset() >= iNewOffset; p = p->Parent())
+      if (p->offset() == iNewOffset) pNewRoot = p;
+    if (pNewRoot && !fnMatches(pNewRoot)) return false;
+  } else {
+    //Search the nodes already made beneath the last output; no need to look
+    // inside any node beyond the new offset
+    vector<CDasherNode *> vToSearch(1, m_pLastOutput);
+    while (!pNewRoot && !vToSearch.empty()) {
+      CDasherNode *pNode(vToSearch.back());
+      vToSearch.pop_back();
+      for (CDasherNode::ChildMap::const_iterator it = pNode->GetChildren().begin(); it != pNode->GetChildren().end(); it++) {
+        if ((*it)->offset() < iNewOffset) vToSearch.push_back(*it);
+        else if ((*it)->offset() == iNewOffset && fnMatches(*it)) {
+          pNewRoot = *it;
+          break;
+        }
+      }
+    }
+  }
+  if (!pNewRoot) return false;
+  //Already there, with nothing to change (e.g. the buffer was edited only after the cursor)
+  if (pNewRoot == m_pLastOutput) return true;
+
+  AbortOffset();
+  //The text the nodes between the last output and the new root would enter, is already
+  // (or not) in the buffer; so just mark them (un)seen, without any Output() or Undo().
+  if (bBackwards) {
+    for (CDasherNode *p = m_pLastOutput; p != pNewRoot; p = p->Parent()) {
+      p->SetFlag(NF_COMMITTED, false);
+      p->SetFlag(NF_SEEN, false);
+    }
+  } else {
+    for (CDasherNode *p = pNewRoot; p != m_pLastOutput; p = p->Parent())
+      p->SetFlag(NF_SEEN, true);
+  }
+  //As the root GetRoot would have made: the text is already in the buffer, so do NOT commit/learn it.
+  pNewRoot->CDasherNode::SetFlag(NF_COMMITTED, true);
+
+  //Delete everything else, i.e. its ancestors and their other descendants
+  if (CDasherNode *pParent = pNewRoot->Parent()) {
+    CDasherNode *pTop(pParent);
+    while (pTop->Parent()) pTop = pTop->Parent();
+    pParent->OrphanChild(pNewRoot);
+    delete pTop;
+  }
+  oldroots.clear();
+  m_deRootCosts.clear();
+  m_iRootNodes = 0;
+  m_iRootBytes = 0;
+  ClearRecipes(); //contexts before the new root may have changed
+
+  m_Root = m_pLastOutput = pNewRoot;
+  ExpandNode(m_Root); //if not already
+  InitRootCoords();
+  return true;
+}
+
+void CDasherModel::InitRootCoords() {
   double dFraction( 1 - (1 - m_Root->MostProbableChild() / static_cast<double>(NORMALIZATION)) / 2.0 );
 
   //TODO somewhere round here, old code checked whether the InputFilter implemented
@@ -249,6 +399,11 @@ bool CDasherModel::NextScheduledStep()
 
     //pick _child_ covering crosshair...
     const myint iWidth(m_Rootmax-m_Rootmin);
+    if (m_Root->GetFlag(NF_LAZY)) {
+      //...which may not have been made yet
+      const unsigned int iCross = ((ORIGIN_Y - m_Rootmin) * NORMALIZATION) / iWidth;
+      m_Root->MaterializeChildren(iCross, iCross+1, 0);
+    }
     for (CDasherNode::ChildMap::const_iterator it = m_Root->GetChildren().begin(); ;) {
       CDasherNode *pChild(*it);
       DASHER_ASSERT(m_Rootmin + ((pChild->Lbnd() * iWidth) / NORMALIZATION) <= ORIGIN_Y);
@@ -475,8 +630,8 @@ void CDasherModel::ExpandNode(CDasherNode *pNode) {
 
   // TODO: Is NF_ALLCHILDREN any more useful/efficient than reading the map size?
 
-  if(pNode->GetFlag(NF_ALLCHILDREN)) {
-    DASHER_ASSERT(pNode->GetChildren().size() > 0);
+  if(pNode->GetFlag(NF_ALLCHILDREN | NF_LAZY)) {
+    DASHER_ASSERT(pNode->GetFlag(NF_LAZY) || pNode->GetChildren().size() > 0);
     return;
   }
 
@@ -488,12 +643,13 @@ void CDasherModel::ExpandNode(CDasherNode *pNode) {
 #endif
   pNode->PopulateChildren();
 #ifdef DEBUG
-  if (iExpect != pNode->GetChildren().size()) {
+  if (iExpect != pNode->GetChildren().size() && !pNode->GetFlag(NF_LAZY)) {
     std::cout << "(Note: expected " << iExpect << " children, actually created " << pNode->GetChildren().size() << ")" << std::endl;
   }
 #endif
 
-  pNode->SetFlag(NF_ALLCHILDREN, true);
+  //lazy nodes (only) will make the rest of their children later
+  if (!pNode->GetFlag(NF_LAZY)) pNode->SetFlag(NF_ALLCHILDREN, true);
 
   DispatchEvent(pNode);
 }
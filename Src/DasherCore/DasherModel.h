@@ -28,6 +28,7 @@
 #include <climits>
 #include <deque>
 #include <cmath>
+#include <functional>
 #include <vector>
 
 #include "../Common/NoClones.h"
@@ -180,6 +181,21 @@ class Dasher::CDasherModel: public Observable<CDasherNode*>, private NoClones
 
   void SetNode(CDasherNode *pNewRoot);
 
+  ///
+  /// Move to a new offset (e.g. the cursor has moved, or text been typed in
+  /// the buffer) by making a node already in the tree the root, keeping its
+  /// subtree, rather than rebuilding everything as SetNode. Looks back along
+  /// the nodes output (and old roots), or forwards among the descendants
+  /// already made, for the outermost node at the offset.
+  /// \param iOffset as GetOffset(), i.e. one more than the new root's offset()
+  /// \param fnMatches whether a candidate node enters the text now in the buffer
+  /// (see CAlphabetManager::ContextMatcher)
+  /// \return true if done; false, leaving the tree unchanged, if no node
+  /// found (caller should then SetNode)
+  ///
+
+  bool ReuseNode(int iOffset, const std::function<bool(CDasherNode *)> &fnMatches);
+
   ///
   /// The current offset of the cursor/insertion point in the text buffer
   /// - measured in (unicode) characters, _not_ octets.
@@ -190,6 +206,23 @@ class Dasher::CDasherModel: public Observable<CDasherNode*>, private NoClones
   /// Create the children of a Dasher node
   void ExpandNode(CDasherNode * pNode);
 
+  ///
+  /// Set the memory (in bytes) to use for root history, i.e. ancestors of the
+  /// root, so reversing need not rebuild them. Up to half is for the most
+  /// recent old roots, kept whole (with their other children); the rest for
+  /// recipes (see CDasherNode::CRecipe) to remake older ones.
+  ///
+
+  void SetHistoryBudget(std::size_t iBytes);
+
+  ///
+  /// Nodes, and their (estimated) memory, in the whole old roots kept (with
+  /// their other descendants). These are budgeted by SetHistoryBudget, so
+  /// expansion policies leave them out of their own budgets.
+  ///
+  int HistoryNodes() const {return m_iRootNodes;}
+  std::size_t HistoryBytes() const {return m_iRootBytes;}
+
  private:
 
   // The root of the Dasher tree
@@ -199,6 +232,23 @@ class Dasher::CDasherModel: public Observable<CDasherNode*>, private NoClones
   // TODO: This should probably be rethought at some point - it doesn't really make a lot of sense
   std::deque < CDasherNode * >oldroots;
 
+  // Recipes for remaking ancestors of oldroots[0] (or m_Root, if none), most
+  // recent (i.e. the parent) last; see SetHistoryBudget.
+  std::deque<CDasherNode::CRecipe *> m_deRecipes;
+
+  // Memory to use for oldroots and m_deRecipes; see SetHistoryBudget
+  std::size_t m_iHistoryBudget;
+
+  // Total Bytes() of m_deRecipes
+  std::size_t m_iRecipeBytes;
+
+  // Nodes and memory of each of oldroots when it was added; see PushOldRoot
+  std::deque<std::pair<int, std::size_t> > m_deRootCosts;
+
+  // Totals of m_deRootCosts; see HistoryNodes
+  int m_iRootNodes;
+  std::size_t m_iRootBytes;
+
   // Rootmin and Rootmax specify the position of the root node in Dasher coords
   myint m_Rootmin;
   myint m_Rootmax;
@@ -261,6 +311,41 @@ class Dasher::CDasherModel: public Observable<CDasherNode*>, private NoClones
 
   void ClearRootQueue();
 
+  ///
+  /// Delete all recipes in m_deRecipes
+  ///
+
+  void ClearRecipes();
+
+  ///
+  /// Move old roots, oldest first, into recipes, and discard the oldest
+  /// recipes, to keep within the history budget
+  ///
+
+  void TrimHistory();
+
+  ///
+  /// Add pOld to the front (oldest end) or back of oldroots, counting towards
+  /// the history its nodes and memory: itself and its descendants, except for
+  /// pNext (the next root) and below. (Nothing under an old root changes while
+  /// it is one, so this can be taken off again as is by PopOldRoot.)
+  ///
+
+  void PushOldRoot(CDasherNode *pOld, const CDasherNode *pNext, bool bFront);
+
+  ///
+  /// Remove the oldest (bFront) or newest old root, and its count; returns it
+  ///
+
+  CDasherNode *PopOldRoot(bool bFront);
+
+  ///
+  /// Set the root coordinates for a new root, so that it is an appropriate
+  /// size and the crosshair is not in any of its children
+  ///
+
+  void InitRootCoords();
+
 };
 /// @}
 
@@ -24,6 +24,8 @@
 
 #include "DasherInterfaceBase.h"
 
+#include <algorithm>
+
 using namespace Dasher;
 using namespace Opts;
 using namespace std;
@@ -38,13 +40,19 @@ static char THIS_FILE[] = __FILE__;
 #endif
 #endif
 static int iNumNodes = 0;
+static unsigned long iNodesMade = 0;
 
 int Dasher::currentNumNodeObjects() {return iNumNodes;}
 
+unsigned long Dasher::totalNodeObjectsMade() {return iNodesMade;}
+
+size_t Dasher::currentNodeObjectBytes() {return CNodeAllocator::TotalLiveBytes();}
+
 //TODO this used to be inline - should we make it so again?
 CDasherNode::CDasherNode(int iOffset, int iColour, CDasherScreen::Label *pLabel)
 : onlyChildRendered(NULL),  m_iLbnd(0), m_iHbnd(CDasherModel::NORMALIZATION), m_pParent(NULL), m_iFlags(DEFAULT_FLAGS), m_iOffset(iOffset), m_iColour(iColour), m_pLabel(pLabel) {
   iNumNodes++;
+  iNodesMade++;
 }
 
 // TODO: put this back to being inlined
@@ -101,10 +109,11 @@ void CDasherNode::OrphanChild(CDasherNode *pChild) {
     }
   }
 
+  pChild->LosingParent();
   pChild->m_pParent=NULL;
 
   Children().clear();
-  SetFlag(NF_ALLCHILDREN, false);
+  SetFlag(NF_ALLCHILDREN | NF_LAZY, false);
 }
 
 // Delete nephews of the child which has the specified symbol
@@ -132,7 +141,7 @@ void CDasherNode::Delete_children() {
   }
   Children().clear();
   //  std::cout << "NM: " << MgrID() << std::endl;
-  SetFlag(NF_ALLCHILDREN, false);
+  SetFlag(NF_ALLCHILDREN | NF_LAZY, false);
   onlyChildRendered = NULL;
 }
 
@@ -148,11 +157,21 @@ void CDasherNode::Reparent(CDasherNode *pNewParent, unsigned int iLbnd, unsigned
   DASHER_ASSERT(!m_pParent);
   DASHER_ASSERT(pNewParent);
   DASHER_ASSERT(!pNewParent->GetFlag(NF_ALLCHILDREN));
-  DASHER_ASSERT(iLbnd == (pNewParent->GetChildren().empty() ? 0 : pNewParent->GetChildren().back()->m_iHbnd));
   m_pParent = pNewParent;
-  pNewParent->Children().push_back(this);
   m_iLbnd = iLbnd;
   m_iHbnd = iHbnd;
+  ChildMap &children(pNewParent->Children());
+  if (pNewParent->GetFlag(NF_LAZY)) {
+    //children made on demand, in any order; find the first child below this one
+    ChildMap::iterator it = std::lower_bound(children.begin(), children.end(), iLbnd,
+        [](const CDasherNode *pChild, unsigned int i) {return pChild->m_iLbnd < i;});
+    DASHER_ASSERT(it == children.begin() || it[-1]->m_iHbnd <= iLbnd);
+    DASHER_ASSERT(it == children.end() || (*it)->m_iLbnd >= iHbnd);
+    children.insert(it, this);
+  } else {
+    DASHER_ASSERT(iLbnd == (children.empty() ? 0 : children.back()->m_iHbnd));
+    children.push_back(this);
+  }
 }
 
 int CDasherNode::MostProbableChild() {
@@ -26,6 +26,8 @@
 #include "LanguageModelling/LanguageModel.h"
 #include "DasherTypes.h"
 #include "NodeManager.h"
+#include "NodeAllocator.h"
+#include "ChildList.h"
 #include "Alphabet/AlphabetMap.h"
 #include "DasherScreen.h"
 
@@ -51,9 +53,8 @@ namespace Dasher {
 /// NF_GAME - Node is on the path in game mode
 #define NF_GAME 8
 
-/// NF_ALLCHILDREN - Node has all children. TODO Since nodes only
-/// ever have all their children, or none of them, can we not
-/// just check it has children, and get rid of this flag?
+/// NF_ALLCHILDREN - Node has all children. (Nodes without NF_LAZY
+/// only ever have all their children, or none of them.)
 #define NF_ALLCHILDREN 16
 
 /// NF_SUPER - Node covers entire visible area (and so is eligible
@@ -66,6 +67,12 @@ namespace Dasher {
 /// is drawn and outlined) by default in the constructor.
 #define NF_VISIBLE 64
 
+/// NF_LAZY - Node has been expanded, but only some of its children (maybe
+/// none) exist; the rest are made on demand by MaterializeChildren, as they
+/// come onscreen. Those that exist are in order, but need not be contiguous.
+/// Cleared (and NF_ALLCHILDREN set) once every child has been made.
+#define NF_LAZY 128
+
 ///Flags to assign to a newly created node:
 #define DEFAULT_FLAGS NF_VISIBLE
 
@@ -107,8 +114,9 @@ class Dasher::CDasherNode:private NoClones {
   CDasherNode *onlyChildRendered; //cache that only one child was rendered (as it filled the screen)
 
   /// Container type for storing children. Note that it's worth
-  /// optimising this as lookup happens a lot
-  typedef std::deque<CDasherNode*> ChildMap;
+  /// optimising this as lookup happens a lot, and there may be thousands
+  /// of nodes (most without children)
+  typedef CChildList<CDasherNode> ChildMap;
 
   /// @brief Constructor
   ///
@@ -126,6 +134,11 @@ class Dasher::CDasherNode:private NoClones {
   ///
   virtual ~CDasherNode();
 
+  /// Nodes can only be made from a CNodeAllocator (see CNodeAllocator::Make)...
+  static void *operator new(std::size_t iSize, CNodeAllocator *pAlloc) {return pAlloc->Alloc(iSize);}
+  /// ...to which delete returns them (iSize being that of the most-derived class)
+  static void operator delete(void *p, std::size_t iSize) {CNodeAllocator::Free(p, iSize);}
+
   void Trace() const;           // diagnostic
 
   /// @name Routines for manipulating node status
@@ -177,9 +190,10 @@ class Dasher::CDasherNode:private NoClones {
 
   /// @brief Get the size of the most probable child
   ///
-  /// @return The size
+  /// @return The size (subclasses making children lazily, should override
+  /// to include those not yet made)
   ///
-  int MostProbableChild();
+  virtual int MostProbableChild();
   /// @}
 
   /// @name Routines for manipulating relatives
@@ -191,9 +205,14 @@ class Dasher::CDasherNode:private NoClones {
   
   /// Makes the node be the child of a new parent, and set its range amongst
   /// that parent's children. This node will be positioned AFTER any/all
-  /// existing children of the new parent; so TODO - iLower redundant?
+  /// existing children of the new parent - unless that has NF_LAZY set, in
+  /// which case it is put in its place amongst those by range.
   /// Before the call is made, the (child) node must have no parent.
   void Reparent(CDasherNode *pNewParent, unsigned int iLower, unsigned int iUpper);
+
+  /// Make room for iNum children, so that adding them (by Reparent) allocates
+  /// a single array of exactly the right size.
+  void ReserveChildren(unsigned int iNum) {m_mChildren.reserve(iNum);}
   
   /// @brief Orphan a child of this node
   ///
@@ -239,6 +258,23 @@ class Dasher::CDasherNode:private NoClones {
   /// the node budgetting algorithm to behave sub-optimally)
   virtual int ExpectedNumChildren() = 0;
 
+  /// Called on (leaf) nodes likely to be expanded soon, e.g. by an expansion
+  /// policy with more candidates than it has time for this frame. May start
+  /// preparing, on another thread, what PopulateChildren will need; must not
+  /// make any children. Default does nothing.
+  virtual void PrepareChildren() {}
+
+  /// Called (only) on a node with NF_LAZY set, to make any children that do not
+  /// yet exist, whose ranges intersect [iLbnd,iHbnd) and are at least iMinSize
+  /// (all in this node's coordinates, i.e. out of NORMALIZATION). Default does
+  /// nothing, as a node never has NF_LAZY unless its subclass sets it.
+  virtual void MaterializeChildren(unsigned int iLbnd, unsigned int iHbnd, unsigned int iMinSize) {}
+
+  /// Called (by OrphanChild) just before this node's parent is deleted, leaving
+  /// this node without one. Anything the node computes lazily from its parent,
+  /// must be computed now. Default does nothing.
+  virtual void LosingParent() {}
+
   ///
   /// Called whenever a node belonging to this manager first
   /// moves under the crosshair
@@ -259,6 +295,26 @@ class Dasher::CDasherNode:private NoClones {
     return 0;
   };
 
+  /// Compact record from which a node, once deleted, can be remade as the
+  /// parent of another: kept by CDasherModel for root history too deep to keep
+  /// whole (see CDasherModel::SetHistoryBudget).
+  class CRecipe {
+  public:
+    virtual ~CRecipe() {}
+    /// Memory taken by the recipe, in bytes
+    virtual std::size_t Bytes() const=0;
+    /// Remake the node as (an ancestor of) pChild, which must have no parent,
+    /// as RebuildParent would, but from the recipe.
+    /// \return pChild's new parent, or NULL if the recipe is not for the node
+    /// RebuildParent would make (pChild then is unchanged)
+    virtual CDasherNode *Rebuild(CDasherNode *pChild)=0;
+  };
+
+  /// Make a recipe for this node, which is about to be deleted, leaving its
+  /// child as the oldest root. Default returns NULL, i.e. cannot: as it need
+  /// not, if its children's RebuildParent does not make this node itself.
+  virtual CRecipe *MakeRecipe() {return NULL;}
+
   ///
   /// Get as many symbols of context, up to the _end_ of the specified range,
   /// as possible from this node and its uncommitted ancestors
@@ -300,6 +356,12 @@ class Dasher::CDasherNode:private NoClones {
 namespace Dasher {
   /// Return the number of CDasherNode objects currently in existence.
   int currentNumNodeObjects();
+  /// Return the number of CDasherNode objects ever made (so, less
+  /// currentNumNodeObjects, the number deleted).
+  unsigned long totalNodeObjectsMade();
+  /// Return the total size in bytes of the CDasherNode objects currently in
+  /// existence (not inc. anything they allocate themselves, e.g. labels).
+  std::size_t currentNodeObjectBytes();
 }
 
 
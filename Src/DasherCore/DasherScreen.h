@@ -60,6 +60,11 @@ public:
     screenint x;
     screenint y;
   } point;
+  //! Structure defining a rectangle on the screen by two opposite corners
+  typedef struct tagrect {
+    screenint x1, y1;
+    screenint x2, y2;
+  } rect;
   
   /// (Default implementation returns false)
   ///\return true if this Screen can efficiently support fonts of many sizes (by continuous scaling);
@@ -85,6 +90,9 @@ public:
     ///Delete the label. This should free up any resources associated with
     /// drawing the string onto the screen, e.g. layouts or textures.
     virtual ~Label() {}
+    ///Memory taken by the label, in bytes. Platforms keeping large resources
+    /// per label (e.g. textures) may override to include them.
+    virtual std::size_t Bytes() const {return sizeof(Label) + m_strText.capacity();}
   };
 
   ///Make a label for use with this screen.
@@ -125,6 +133,17 @@ public:
   /// \param iThickness Line thickness for outline; <1 for no outline
   virtual void DrawRectangle(screenint x1, screenint y1, screenint x2, screenint y2, int Colour, int iOutlineColour, int iThickness) = 0;
 
+  /// Fill a number of rectangles, all in the same colour and without outlines.
+  /// The default just calls DrawRectangle for each; platforms for which each
+  /// drawing call is expensive should override, e.g. to fill them as one path.
+  /// \param pRects corners of each rectangle, as for DrawRectangle
+  /// \param iNum number of rectangles
+  /// \param iColour colour in which to fill them
+  virtual void FillRectangles(const rect *pRects, int iNum, int iColour) {
+    for (int i=0; i<iNum; i++)
+      DrawRectangle(pRects[i].x1, pRects[i].y1, pRects[i].x2, pRects[i].y2, iColour, -1, 0);
+  }
+
   ///Draw a circle, potentially filled and/or outlined
   /// \param iFillColour colour in which to fill; -1 for no fill
   /// \param iLineColour colour to draw outline; -1 = use default
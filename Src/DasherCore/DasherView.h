@@ -79,6 +79,16 @@ public:
 
   virtual void Dasher2Screen(myint iDasherX, myint iDasherY, screenint & iScreenX, screenint & iScreenY) = 0;
 
+  ///
+  /// Convert many points from Dasher to screen co-ordinates at once, i.e.
+  /// (pDasherX[i],pDasherY[i]) to pPoints[i] for 0<=i<iNum. Default just
+  /// calls Dasher2Screen for each; subclasses may do better.
+  ///
+
+  virtual void Dasher2Screen(const myint *pDasherX, const myint *pDasherY, CDasherScreen::point *pPoints, int iNum) {
+    for (int i=0; i<iNum; i++) Dasher2Screen(pDasherX[i], pDasherY[i], pPoints[i].x, pPoints[i].y);
+  }
+
   ///
   /// Convert Dasher co-ordinates to polar co-ordinates (r,theta), with 0<r<1, 0<theta<2*pi
   ///
@@ -195,6 +205,10 @@ protected:
   /// this belong here? (perhaps for subclass-agnostic clients to inspect...)
   int m_iRenderCount;
 
+  ///Space for building up the screen points of one shape or line at a time
+  /// (e.g. by DasherLine2Screen), reused to avoid reallocating on every call.
+  std::vector<CDasherScreen::point> m_vPointScratch;
+
 private:
   Opts::ScreenOrientations m_Orientation;
   CDasherScreen *m_pScreen;    // provides the graphics (text, lines, rectangles):
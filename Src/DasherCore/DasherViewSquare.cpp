@@ -33,6 +33,7 @@
 #include <algorithm>
 #include <iostream>
 #include <limits>
+#include <new>
 #include <stdlib.h>
 
 using namespace Dasher;
@@ -86,31 +87,32 @@ void CDasherViewSquare::HandleEvent(int iParameter) {
 CDasherNode *CDasherViewSquare::Render(CDasherNode *pRoot, myint iRootMin, myint iRootMax,
 				    CExpansionPolicy &policy) {
   DASHER_ASSERT(pRoot != 0);
-  myint iDasherMinX;
-  myint iDasherMinY;
-  myint iDasherMaxX;
-  myint iDasherMaxY;
-  VisibleRegion(iDasherMinX, iDasherMinY, iDasherMaxX, iDasherMaxY);
-  //
+  //Start a new frame
+  m_FrameArena.Reset();
+  VisibleRegion(m_frame.iMinX, m_frame.iMinY, m_frame.iMaxX, m_frame.iMaxY);
+  m_frame.iShapeType = GetLongParameter(LP_SHAPE_TYPE);
+  m_frame.iOutlineWidth = GetLongParameter(LP_OUTLINE_WIDTH);
+  m_frame.iMinNodeSize = GetLongParameter(LP_MIN_NODE_SIZE);
+  const myint iDasherMinX(m_frame.iMinX), iDasherMinY(m_frame.iMinY), iDasherMaxX(m_frame.iMaxX), iDasherMaxY(m_frame.iMaxY);
 
   m_iRenderCount = 0;
 
   CDasherNode *pOutput = pRoot->Parent();
 
   // Blank the region around the root node:
-  if (GetLongParameter(LP_SHAPE_TYPE)==0) { //disjoint rects, so go round root
+  if (m_frame.iShapeType==0) { //disjoint rects, so go round root
     if(iRootMin > iDasherMinY)
-      DasherDrawRectangle(iDasherMaxX, iDasherMinY, iDasherMinX, iRootMin, 0, -1, 0);
+      m_DisplayList.Rectangle(iDasherMaxX, iDasherMinY, iDasherMinX, iRootMin, 0, -1, 0, 0);
 
     if(iRootMax < iDasherMaxY)
-      DasherDrawRectangle(iDasherMaxX, iRootMax, iDasherMinX, iDasherMaxY, 0, -1, 0);
+      m_DisplayList.Rectangle(iDasherMaxX, iRootMax, iDasherMinX, iDasherMaxY, 0, -1, 0, 0);
 
     //to left (greater Dasher X)
     if (iRootMax - iRootMin < iDasherMaxX)
-      DasherDrawRectangle(iDasherMaxX, std::max(iRootMin,iDasherMinY), iRootMax-iRootMin, std::min(iRootMax,iDasherMaxY), 0, -1, 0);
+      m_DisplayList.Rectangle(iDasherMaxX, std::max(iRootMin,iDasherMinY), iRootMax-iRootMin, std::min(iRootMax,iDasherMaxY), 0, -1, 0, 0);
 
     //to right (margin)
-    DasherDrawRectangle(0, iDasherMinY, iDasherMinX, iDasherMaxY, 0, -1, 0);
+    m_DisplayList.Rectangle(0, iDasherMinY, iDasherMinX, iDasherMaxY, 0, -1, 0, 0);
 
     //and render root.
     DisjointRender(pRoot, iRootMin, iRootMax, NULL, policy, std::numeric_limits<double>::infinity(), pOutput);
@@ -120,13 +122,15 @@ CDasherNode *CDasherViewSquare::Render(CDasherNode *pRoot, myint iRootMin, myint
       //LEFT of Y axis, would be entirely covered by the root node parent (before we render root)
       // (getColour() gives the right colour, even if pOutput is invisible - in that case it gives
       // the colour of its parent)
-      DasherDrawRectangle(iDasherMaxX, iDasherMinY, 0, iDasherMaxY, pOutput->getColour(), -1, 0);
+      m_DisplayList.Rectangle(iDasherMaxX, iDasherMinY, 0, iDasherMaxY, pOutput->getColour(), -1, 0, 0);
       //RIGHT of Y axis, should be white.
-      DasherDrawRectangle(0, iDasherMinY, iDasherMinX, iDasherMaxY, 0, -1, 0);
+      m_DisplayList.Rectangle(0, iDasherMinY, iDasherMinX, iDasherMaxY, 0, -1, 0, 0);
     } else //easy case, whole screen is white (outside root node, e.g. when starting)
       Screen()->DrawRectangle(0, 0, Screen()->GetWidth(), Screen()->GetHeight(), 0, -1, 0);
-    NewRender(pRoot, iRootMin, iRootMax, NULL, policy, std::numeric_limits<double>::infinity(), pOutput);
+    NewRender(pRoot, iRootMin, iRootMax, NULL, policy, std::numeric_limits<double>::infinity(), pOutput, 1);
   }
+  // Now actually draw the nodes
+  m_DisplayList.Submit(this, Screen());
 
   // Labels are drawn in a second parse to get the overlapping right
   for (vector<CTextString *>::iterator it=m_DelayedTexts.begin(), E=m_DelayedTexts.end(); it!=E; it++)
@@ -167,9 +171,11 @@ CDasherViewSquare::CTextString *CDasherViewSquare::DasherDrawText(myint iDasherM
     }
   }
 
-  CTextString *pRet = new CTextString(pLabel, x, y, iSize, iColor);
-  vector<CTextString *> &dest(pParent ? pParent->m_children : m_DelayedTexts);
-  dest.push_back(pRet);
+  CTextString *pRet = new (m_FrameArena.Alloc<CTextString>()) CTextString(pLabel, x, y, iSize, iColor);
+  if (pParent)
+    pParent->AddChild(pRet);
+  else
+    m_DelayedTexts.push_back(pRet);
   return pRet;
 }
 
@@ -186,12 +192,10 @@ void CDasherViewSquare::DoDelayedText(CTextString *pText) {
       screenint iRight = x + textDims.first;
       if (iRight < Screen()->GetWidth()) {
         Screen()->DrawString(pText->m_pLabel, x, y-textDims.second/2, pText->m_iSize, pText->m_iColor);
-        for (vector<CTextString *>::iterator it = pText->m_children.begin(); it!=pText->m_children.end(); it++) {
-          CTextString *pChild=*it;
+        for (CTextString *pChild = pText->m_pFirstChild; pChild; pChild = pChild->m_pNext) {
           pChild->m_ix = max(pChild->m_ix, iRight);
           DoDelayedText(pChild);
         }
-        pText->m_children.clear();
       }
       break;
     }
@@ -199,12 +203,10 @@ void CDasherViewSquare::DoDelayedText(CTextString *pText) {
       screenint iLeft = x-textDims.first;
       if (iLeft>=0) {
         Screen()->DrawString(pText->m_pLabel, iLeft, y-textDims.second/2, pText->m_iSize, pText->m_iColor);
-        for (vector<CTextString *>::iterator it = pText->m_children.begin(); it!=pText->m_children.end(); it++) {
-          CTextString *pChild=*it;
+        for (CTextString *pChild = pText->m_pFirstChild; pChild; pChild = pChild->m_pNext) {
           pChild->m_ix = min(pChild->m_ix, iLeft);
-          DoDelayedText(*it);
+          DoDelayedText(pChild);
         }
-        pText->m_children.clear();
       }
       break;
     }
@@ -212,12 +214,10 @@ void CDasherViewSquare::DoDelayedText(CTextString *pText) {
       screenint iBottom = y + textDims.second;
       if (iBottom < Screen()->GetHeight()) {
         Screen()->DrawString(pText->m_pLabel, x-textDims.first/2, y, pText->m_iSize, pText->m_iColor);
-        for (vector<CTextString *>::iterator it = pText->m_children.begin(); it!=pText->m_children.end(); it++) {
-          CTextString *pChild=*it;
+        for (CTextString *pChild = pText->m_pFirstChild; pChild; pChild = pChild->m_pNext) {
           pChild->m_iy = max(pChild->m_iy, iBottom);
-          DoDelayedText(*it);
+          DoDelayedText(pChild);
         }
-        pText->m_children.clear();
       }
       break;
     }
@@ -225,30 +225,21 @@ void CDasherViewSquare::DoDelayedText(CTextString *pText) {
       screenint iTop = y - textDims.second;
       if (y>=0) {
         Screen()->DrawString(pText->m_pLabel, x-textDims.first/2, iTop, pText->m_iSize, pText->m_iColor);
-        for (vector<CTextString *>::iterator it = pText->m_children.begin(); it!=pText->m_children.end(); it++) {
-          CTextString *pChild=*it;
+        for (CTextString *pChild = pText->m_pFirstChild; pChild; pChild = pChild->m_pNext) {
           pChild->m_iy = min(pChild->m_iy, iTop);
-          DoDelayedText(*it);
+          DoDelayedText(pChild);
         }
-        pText->m_children.clear();
       }
       break;
     }
     default:
       break;
   }
-  delete pText;
 }
 
-CDasherViewSquare::CTextString::~CTextString() {
-  for (vector<CTextString *>::iterator it = m_children.begin(); it!=m_children.end(); it++)
-    delete *it;
-}
-
-void CDasherViewSquare::TruncateTri(myint x, myint y1, myint y2, myint midy1, myint midy2, int fillColor, int outlineColor, int lineWidth) {
+void CDasherViewSquare::TruncateTri(myint x, myint y1, myint y2, myint midy1, myint midy2, int fillColor, int outlineColor, int lineWidth, int iLayer) {
   DASHER_ASSERT (y1<=midy1 && midy1<=midy2 && midy2<=y2);
-  myint iVisibleMinX, iVisibleMaxX, iVisibleMinY, iVisibleMaxY;
-  VisibleRegion(iVisibleMinX, iVisibleMinY, iVisibleMaxX, iVisibleMaxY);
+  const myint iVisibleMinY(m_frame.iMinY), iVisibleMaxX(m_frame.iMaxX), iVisibleMaxY(m_frame.iMaxY);
 
   myint x1(x), x2(x); //(max)x-coords of the two lines
   myint tempx1(0),tempx2(0); //& min x-coords
@@ -287,7 +278,8 @@ void CDasherViewSquare::TruncateTri(myint x, myint y1, myint y2, myint midy1, my
     }
   }
   // midy1,x1 is now start point
-  vector<CDasherScreen::point> pts(1);
+  vector<CDasherScreen::point> &pts(m_vPointScratch);
+  pts.resize(1);
   Dasher2Screen(x1, midy1, pts[0].x, pts[0].y);
   DasherLine2Screen(x1, midy1, tempx1, y1, pts);
   if (tempx1) {
@@ -320,18 +312,15 @@ void CDasherViewSquare::TruncateTri(myint x, myint y1, myint y2, myint midy1, my
     Dasher2Screen(x1, midy1, pts.back().x, pts.back().y);
   } else DASHER_ASSERT(pts.back().x == pts[0].x && pts.back().y == pts[0].y);
 
-  CDasherScreen::point *p_array=new CDasherScreen::point[pts.size()];
-  for (unsigned int i = 0; i<pts.size(); i++) p_array[i] = pts[i];
-  Screen()->Polygon(p_array, pts.size(), fillColor, outlineColor, lineWidth);
-  delete[] p_array;
+  m_DisplayList.Polygon(&pts[0], pts.size(), fillColor, outlineColor, lineWidth, iLayer);
 }
 
 #define sq(X) ((X)*(X))
-void CDasherViewSquare::Circle(myint Range, myint y1, myint y2, int fCol, int oCol, int lWidth) {
-  std::vector<CDasherScreen::point> pts;
+void CDasherViewSquare::Circle(myint Range, myint y1, myint y2, int fCol, int oCol, int lWidth, int iLayer) {
+  std::vector<CDasherScreen::point> &pts(m_vPointScratch);
+  pts.clear();
   myint cy((y1+y2)/2),r(Range/2), x1, x2;
-  myint iDasherMinX, iDasherMinY, iDasherMaxX, iDasherMaxY;
-  VisibleRegion(iDasherMinX, iDasherMinY, iDasherMaxX, iDasherMaxY);
+  const myint iDasherMinY(m_frame.iMinY), iDasherMaxX(m_frame.iMaxX), iDasherMaxY(m_frame.iMaxY);
 
   CDasherScreen::point p;
   //run along bottom edge...
@@ -356,7 +345,7 @@ void CDasherViewSquare::Circle(myint Range, myint y1, myint y2, int fCol, int oC
     if (x2==iDasherMaxX && x1==iDasherMaxX) {
       //circle entirely covers screen
       DASHER_ASSERT(y1==iDasherMinY);
-      DasherDrawRectangle(iDasherMaxX, iDasherMinY, 0, iDasherMaxY, fCol, oCol, lWidth);
+      m_DisplayList.Rectangle(iDasherMaxX, iDasherMinY, 0, iDasherMaxY, fCol, oCol, lWidth, iLayer);
       return;
     }
     //will also need final point at top-right (0,y2 in dasher coords)....
@@ -368,10 +357,7 @@ void CDasherViewSquare::Circle(myint Range, myint y1, myint y2, int fCol, int oC
     Dasher2Screen(0, iDasherMaxX, p.x, p.y);
     pts.push_back(p);
   }
-  CDasherScreen::point *p_array = new CDasherScreen::point[pts.size()];
-  for (unsigned int i=0; i<pts.size(); i++) p_array[i] = pts[i];
-  Screen()->Polygon(p_array, pts.size(), fCol, oCol, lWidth);
-  delete[] p_array;
+  m_DisplayList.Polygon(&pts[0], pts.size(), fCol, oCol, lWidth, iLayer);
 }
 
 void CDasherViewSquare::CircleTo(myint cy, myint r, myint y1, myint x1, myint y3, myint x3, CDasherScreen::point dest, vector<CDasherScreen::point> &pts, double dXMul) {
@@ -394,8 +380,8 @@ void CDasherViewSquare::DasherSpaceArc(myint cy, myint r, myint x1, myint y1, my
   CDasherScreen::point p;
   //start point
   Dasher2Screen(x1, y1, p.x, p.y);
-  vector<CDasherScreen::point> pts;
-  pts.push_back(p);
+  vector<CDasherScreen::point> &pts(m_vPointScratch);
+  pts.assign(1, p);
   //if circle goes behind crosshair and we want the point of max-x, force division into two sections with that point as boundary
   if (r>CDasherModel::ORIGIN_X && ((y1 < cy) ^ (y2 < cy))) {
     Dasher2Screen(r, cy, p.x, p.y);
@@ -404,34 +390,35 @@ void CDasherViewSquare::DasherSpaceArc(myint cy, myint r, myint x1, myint y1, my
   }
   Dasher2Screen(x2, y2, p.x, p.y);
   CircleTo(cy, r, y1, x1, y2, x2, p, pts, 1.0);
-  CDasherScreen::point *p_array = new CDasherScreen::point[pts.size()];
-  for (unsigned int i=0; i<pts.size(); i++) p_array[i] = pts[i];
-  Screen()->Polyline(p_array, pts.size(), iLineWidth, iColour);
+  Screen()->Polyline(&pts[0], pts.size(), iLineWidth, iColour);
 }
 
-void CDasherViewSquare::Quadric(myint Range, myint lowY, myint highY, int fillColor, int outlineColour, int lineWidth) {
+void CDasherViewSquare::Quadric(myint Range, myint lowY, myint highY, int fillColor, int outlineColour, int lineWidth, int iLayer) {
   static const double RR2=1.0/sqrt(2.0);
   const int midY=(lowY+highY)/2;
 #define NUM_STEPS 40
+  myint x[2*NUM_STEPS+2], y[2*NUM_STEPS+2];
   CDasherScreen::point p_array[2*NUM_STEPS+2];
-  myint minX,maxX,minY,maxY;
-  VisibleRegion(minX, minY, maxX, maxY);
+  const myint minY(m_frame.iMinY), maxX(m_frame.iMaxX), maxY(m_frame.iMaxY);
   {
     myint x1(0), y1(highY), x2(Range*RR2),y2(highY*RR2 + midY*(1.0-RR2)), x3(Range), y3(midY);
     for (int i=0; i<=NUM_STEPS; i++) {
       double f=i/(double)NUM_STEPS, of = 1.0-f;
-      Dasher2Screen(min(maxX,myint(of*of*x1 + 2.0*of*f*x2 + f*f*x3)), max(minY,min(maxY,myint(of*of*y1 + 2.0*of*f*y2 + f*f*y3))), p_array[i].x, p_array[i].y);
+      x[i] = min(maxX,myint(of*of*x1 + 2.0*of*f*x2 + f*f*x3));
+      y[i] = max(minY,min(maxY,myint(of*of*y1 + 2.0*of*f*y2 + f*f*y3)));
     }
   }
   {
     myint x1(Range), y1(midY), x2(Range*RR2), y2(lowY*RR2 + midY*(1.0-RR2)), x3(0), y3(lowY);
     for (int i=0; i<=NUM_STEPS; i++) {
       double f=i/(double)NUM_STEPS, of = 1.0-f;
-      Dasher2Screen(min(maxX,myint(of*of*x1 + 2.0*of*f*x2 + f*f*x3)),max(minY,min(maxY,myint(of*of*y1 + 2.0*of*f*y2 + f*f*y3))), p_array[i+NUM_STEPS+1].x, p_array[i+NUM_STEPS+1].y);
+      x[i+NUM_STEPS+1] = min(maxX,myint(of*of*x1 + 2.0*of*f*x2 + f*f*x3));
+      y[i+NUM_STEPS+1] = max(minY,min(maxY,myint(of*of*y1 + 2.0*of*f*y2 + f*f*y3)));
     }
   }
+  Dasher2Screen(x, y, p_array, 2*NUM_STEPS+2);
 
-  Screen()->Polygon(p_array, 2*NUM_STEPS+2, fillColor, outlineColour, lineWidth);
+  m_DisplayList.Polygon(p_array, 2*NUM_STEPS+2, fillColor, outlineColour, lineWidth, iLayer);
 #undef NUM_STEPS
 }
 
@@ -490,18 +477,14 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
   // Set the NF_SUPER flag if this node entirely frames the visual
   // area.
 
-  myint iDasherMinX;
-  myint iDasherMinY;
-  myint iDasherMaxX;
-  myint iDasherMaxY;
-  VisibleRegion(iDasherMinX, iDasherMinY, iDasherMaxX, iDasherMaxY);
+  const myint iDasherMinY(m_frame.iMinY), iDasherMaxX(m_frame.iMaxX), iDasherMaxY(m_frame.iMaxY);
   pRender->SetFlag(NF_SUPER, (y2-y1 >= iDasherMaxX) && (y1 <= iDasherMinY) && (y2 >= iDasherMaxY));
 
   const int myColor = pRender->getColour();
 
   if( pRender->getLabel() )
   {
-    const int textColor = GetLongParameter(LP_OUTLINE_WIDTH)<0 ? myColor : 4;
+    const int textColor = m_frame.iOutlineWidth<0 ? myColor : 4;
     myint ny1 = std::min(iDasherMaxY, std::max(iDasherMinY, y1)),
           ny2 = std::min(iDasherMaxY, std::max(iDasherMinY, y2));
     CTextString *pText = DasherDrawText(y2-y1, (ny1+ny2)/2, pRender->getLabel(), pPrevText, textColor);
@@ -518,11 +501,11 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
       policy.ExpandNode(pRender);
     }
   }
-  if (pRender->ChildCount() == 0) {
+  if (pRender->ChildCount() == 0 && !pRender->GetFlag(NF_LAZY)) {
     //allow empty node to be expanded, it's big enough.
     policy.pushNode(pRender, y1, y2, true, dMaxCost);
     //and render whole node in one go
-    DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY),0, std::min(y2,iDasherMaxY), myColor, -1, 0);
+    m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY),0, std::min(y2,iDasherMaxY), myColor, -1, 0, 0);
     //fall through to draw outline
   } else {
     //Node has children. It can therefore be collapsed...however,
@@ -550,7 +533,7 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
         DASHER_ASSERT(dMaxCost == std::numeric_limits<double>::infinity());
 
         if (newy2-newy1 < iDasherMaxX) //fill in to it's left...
-          DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), newy2-newy1, std::min(y2,iDasherMaxY), myColor, -1, 0);
+          m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), newy2-newy1, std::min(y2,iDasherMaxY), myColor, -1, 0, 0);
         DisjointRender(pChild, newy1, newy2, pPrevText,
                         policy, dMaxCost, pOutput);
         //leave pRender->onlyChildRendered set, so remaining children are skipped
@@ -561,6 +544,7 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
 
     if (!pRender->onlyChildRendered) {
       //render all children...
+      if (pRender->GetFlag(NF_LAZY)) MaterializeOnscreen(pRender, y1, y2);
       myint lasty=y1;
       for(CDasherNode::ChildMap::const_iterator i = pRender->GetChildren().begin();
         i != pRender->GetChildren().end(); i++) {
@@ -580,7 +564,7 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
           DASHER_ASSERT(dMaxCost == std::numeric_limits<double>::infinity());
           pRender->onlyChildRendered = pChild;
           if (newy2-newy1 < iDasherMaxX)
-            DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), newy2-newy1, std::min(y2,iDasherMaxY), myColor, -1, 0);
+            m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), newy2-newy1, std::min(y2,iDasherMaxY), myColor, -1, 0, 0);
           DisjointRender(pChild, newy1, newy2, pPrevText, policy, dMaxCost, pOutput);
           //ensure we don't blank over this child in "finishing off" the parent (!)
           lasty=newy2;
@@ -588,15 +572,15 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
           while ((++i)!=pRender->GetChildren().end())
             if (!(*i)->GetFlag(NF_SEEN)) (*i)->Delete_children();
           break;
-        } else if (newy2-newy1 >= GetLongParameter(LP_MIN_NODE_SIZE) //simple test if big enough
+        } else if (newy2-newy1 >= m_frame.iMinNodeSize //simple test if big enough
             && newy1 <= iDasherMaxY && newy2 >= iDasherMinY) //at least partly on screen
         {
           //child should be rendered!
           //fill in to its left
-          DasherDrawRectangle(std::min(y2-y1,iDasherMaxX), std::max(newy1,iDasherMinY), std::min(newy2-newy1,iDasherMaxX), std::min(newy2,iDasherMaxY), myColor, -1, 0);
+          m_DisplayList.Rectangle(std::min(y2-y1,iDasherMaxX), std::max(newy1,iDasherMinY), std::min(newy2-newy1,iDasherMaxX), std::min(newy2,iDasherMaxY), myColor, -1, 0, 0);
 
           if (std::max(lasty,iDasherMinY)<newy1) //fill in interval above child up to the last drawn child
-            DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(lasty,iDasherMinY),0, std::min(newy1,iDasherMaxY), myColor, -1, 0);
+            m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(lasty,iDasherMinY),0, std::min(newy1,iDasherMaxY), myColor, -1, 0, 0);
           lasty = newy2;
           DisjointRender(pChild, newy1, newy2, pPrevText, policy, dMaxCost, pOutput);
         } else {
@@ -609,14 +593,14 @@ void CDasherViewSquare::DisjointRender(CDasherNode *pRender, myint y1, myint y2,
       //all children rendered.
       if (lasty<min(y2,iDasherMaxY)) {
         // Finish off the drawing process, filling in any part of the parent below the last-rendered child
-        DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(lasty, iDasherMinY), 0, std::min(y2, iDasherMaxY), myColor, -1, 0);
+        m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(lasty, iDasherMinY), 0, std::min(y2, iDasherMaxY), myColor, -1, 0, 0);
       }
     }
     //end rendering children, fall through to outline
   }
   // Lastly, draw the outline
-  if(GetLongParameter(LP_OUTLINE_WIDTH) && pRender->GetFlag(NF_VISIBLE)) {
-    DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY),0, std::min(y2,iDasherMaxY), -1, -1, abs(GetLongParameter(LP_OUTLINE_WIDTH)));
+  if(m_frame.iOutlineWidth && pRender->GetFlag(NF_VISIBLE)) {
+    m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY),0, std::min(y2,iDasherMaxY), -1, -1, abs(m_frame.iOutlineWidth), 0);
   }
 }
 
@@ -656,7 +640,7 @@ bool CDasherViewSquare::CoversCrosshair(myint Range, myint y1, myint y2) {
 
 void CDasherViewSquare::NewRender(CDasherNode *pRender, myint y1, myint y2,
                                   CTextString *pPrevText, CExpansionPolicy &policy, double dMaxCost,
-                                  CDasherNode *&pOutput)
+                                  CDasherNode *&pOutput, int iDepth)
 {
 	//when we have only one child node to render, which'll be the last thing we
 	// do before returning, we make a tail call by jumping here, rather than
@@ -669,18 +653,14 @@ beginning:
   // Set the NF_SUPER flag if this node entirely frames the visual
   // area.
 
-  myint iDasherMinX;
-  myint iDasherMinY;
-  myint iDasherMaxX;
-  myint iDasherMaxY;
-  VisibleRegion(iDasherMinX, iDasherMinY, iDasherMaxX, iDasherMaxY);
+  const myint iDasherMinY(m_frame.iMinY), iDasherMaxX(m_frame.iMaxX), iDasherMaxY(m_frame.iMaxY);
   pRender->SetFlag(NF_SUPER, !IsSpaceAroundNode(y1, y2));
 
   const int myColor = pRender->getColour();
 
   if( pRender->getLabel() )
   {
-    const int textColor = GetLongParameter(LP_OUTLINE_WIDTH)<0 ? myColor : 4;
+    const int textColor = m_frame.iOutlineWidth<0 ? myColor : 4;
     myint ny1 = std::min(iDasherMaxY, std::max(iDasherMinY, y1)),
     ny2 = std::min(iDasherMaxY, std::max(iDasherMinY, y2));
     CTextString *pText = DasherDrawText(y2-y1, (ny1+ny2)/2, pRender->getLabel(), pPrevText, textColor);
@@ -701,23 +681,23 @@ beginning:
   // colour schemes)
   if (pRender->GetFlag(NF_VISIBLE)) {
 	//outline width 0 = fill only; >0 = fill + outline; <0 = outline only
-	int fillColour = GetLongParameter(LP_OUTLINE_WIDTH)>=0 ? myColor : -1;
-	int lineWidth = abs(GetLongParameter(LP_OUTLINE_WIDTH));
-    switch (GetLongParameter(LP_SHAPE_TYPE)) {
+	int fillColour = m_frame.iOutlineWidth>=0 ? myColor : -1;
+	int lineWidth = abs(m_frame.iOutlineWidth);
+    switch (m_frame.iShapeType) {
       case 1: //overlapping rects
-        DasherDrawRectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), 0, std::min(y2,iDasherMaxY), fillColour, -1, lineWidth);
+        m_DisplayList.Rectangle(std::min(Range,iDasherMaxX), std::max(y1,iDasherMinY), 0, std::min(y2,iDasherMaxY), fillColour, -1, lineWidth, iDepth);
         break;
       case 2: //simple triangles
-        TruncateTri(Range, y1, y2, (y1+y2)/2, (y1+y2)/2, fillColour, -1, lineWidth);
+        TruncateTri(Range, y1, y2, (y1+y2)/2, (y1+y2)/2, fillColour, -1, lineWidth, iDepth);
         break;
       case 3: //truncated triangles
-        TruncateTri(Range, y1, y2, (y1+y1+y2)/3, (y1+y2+y2)/3, fillColour, -1, lineWidth);
+        TruncateTri(Range, y1, y2, (y1+y1+y2)/3, (y1+y2+y2)/3, fillColour, -1, lineWidth, iDepth);
         break;
       case 4:
-        Quadric(Range, y1, y2, fillColour, -1, lineWidth);
+        Quadric(Range, y1, y2, fillColour, -1, lineWidth, iDepth);
         break;
       case 5:
-        Circle(Range, y1, y2, fillColour, -1, lineWidth);
+        Circle(Range, y1, y2, fillColour, -1, lineWidth, iDepth);
         break;
     }
   }
@@ -726,7 +706,7 @@ beginning:
   if (pOutput == pRender->Parent() && CoversCrosshair(Range, y1, y2))
     pOutput = pRender;
 
-  if (pRender->ChildCount() == 0) {
+  if (pRender->ChildCount() == 0 && !pRender->GetFlag(NF_LAZY)) {
     if (pOutput==pRender) {
       //covers crosshair! forcibly populate, now!
       policy.ExpandNode(pRender);
@@ -758,27 +738,30 @@ beginning:
     if (
 	    (newy1 < iDasherMinY && newy2 > iDasherMaxY)) { //covers entire y-axis!
          //render just that child; nothing more to do for this node => tail call to beginning
-         pRender = pChild; y1=newy1; y2=newy2;
+         pRender = pChild; y1=newy1; y2=newy2; iDepth++;
          goto beginning;
     }
     pRender->onlyChildRendered = NULL;
   }
 
   //ok, need to render all children...
-  myint newy1=y1,newy2;
+  if (pRender->GetFlag(NF_LAZY)) MaterializeOnscreen(pRender, y1, y2);
+  myint newy1,newy2;
   CDasherNode::ChildMap::const_iterator I = pRender->GetChildren().begin(), E = pRender->GetChildren().end();
   while (I!=E) {
     CDasherNode *pChild(*I);
 
+    //(computing newy1 afresh, as there may be gaps between lazily-made children)
+    newy1 = y1 + (Range * pChild->Lbnd()) / CDasherModel::NORMALIZATION;
     newy2 = y1 + (Range * pChild->Hbnd()) / CDasherModel::NORMALIZATION;
     if (pChild->GetFlag(NF_GAME)) {
       CGameNodeDrawEvent evt(pChild, newy1, newy2);
       Observable<CGameNodeDrawEvent*>::DispatchEvent(&evt);
     }
     if (newy1<=iDasherMaxY && newy2 >= iDasherMinY) { //onscreen
-      if (newy2-newy1 > GetLongParameter(LP_MIN_NODE_SIZE)) {
+      if (newy2-newy1 > m_frame.iMinNodeSize) {
         //definitely big enough to render.
-        NewRender(pChild, newy1, newy2, pPrevText, policy, dMaxCost, pOutput);
+        NewRender(pChild, newy1, newy2, pPrevText, policy, dMaxCost, pOutput, iDepth+1);
       } else if (!pChild->GetFlag(NF_SEEN)) pChild->Delete_children();
       if (newy2>iDasherMaxY && !pRender->GetFlag(NF_GAME)) {
         //remaining children offscreen and no game-mode child we might skip
@@ -788,7 +771,6 @@ beginning:
       }
     }
     I++;
-    newy1=newy2;
   }
   if (I!=E) {
     //broke out of loop. Possibly more to delete...
@@ -797,6 +779,18 @@ beginning:
   //all children rendered.
 }
 
+void CDasherViewSquare::MaterializeOnscreen(CDasherNode *pRender, myint y1, myint y2) {
+  const myint iDasherMinY(m_frame.iMinY), iDasherMaxY(m_frame.iMaxY);
+  const myint Range(y2-y1);
+  //Visible part of the node, in its own coordinates; rounded outwards, and
+  // with size rounded down, so we never miss a child that would be rendered
+  const myint iLbnd = std::max(myint(0), ((iDasherMinY - y1) * CDasherModel::NORMALIZATION) / Range - 1),
+    iHbnd = std::min(myint(CDasherModel::NORMALIZATION), ((iDasherMaxY - y1) * CDasherModel::NORMALIZATION) / Range + 1),
+    iMinSize = (std::max(0l, m_frame.iMinNodeSize - 1) * CDasherModel::NORMALIZATION) / Range;
+  if (iLbnd < iHbnd)
+    pRender->MaterializeChildren(iLbnd, iHbnd, iMinSize);
+}
+
 /// Convert screen co-ordinates to dasher co-ordinates. This doesn't
 /// include the nonlinear mapping for eyetracking mode etc - it is
 /// just the inverse of the mapping used to calculate the screen
@@ -837,6 +831,9 @@ void CDasherViewSquare::Screen2Dasher(screenint iInputX, screenint iInputY, myin
 
 void CDasherViewSquare::SetScaleFactor( void )
 {
+  m_bNonlinearX = GetLongParameter(LP_NONLINEAR_X)>0;
+  m_bNonlinearY = GetBoolParameter(BP_NONLINEAR_Y);
+
   //Parameters for X non-linearity.
   // Set some defaults here, in case we change(d) them later...
   m_iXlogThres=CDasherModel::MAX_Y/2; //threshold: DasherX's less than this are linear; those greater are logarithmic
@@ -902,6 +899,23 @@ void CDasherViewSquare::SetScaleFactor( void )
   iScaleFactorX = myint(dScaleFactorX * SCALE_FACTOR);
   iScaleFactorY = myint(dScaleFactorY * SCALE_FACTOR);
 
+  //Where the axes go on the screen, according to orientation
+  switch (GetOrientation()) {
+    case Dasher::Opts::RightToLeft:
+      m_iXAxisOrigin = 0; m_iXAxisSign = 1; m_iYAxisOrigin = iScreenHeight / 2;
+      break;
+    case Dasher::Opts::TopToBottom:
+      m_iXAxisOrigin = iScreenHeight; m_iXAxisSign = -1; m_iYAxisOrigin = iScreenWidth / 2;
+      break;
+    case Dasher::Opts::BottomToTop:
+      m_iXAxisOrigin = 0; m_iXAxisSign = 1; m_iYAxisOrigin = iScreenWidth / 2;
+      break;
+    default: //LeftToRight
+      m_iXAxisOrigin = iScreenWidth; m_iXAxisSign = -1; m_iYAxisOrigin = iScreenHeight / 2;
+      break;
+  }
+  m_bVertical = !bHoriz;
+
 #ifdef DEBUG
   //test...
   for (screenint x=0; x<iScreenWidth; x++) {
@@ -928,36 +942,11 @@ void CDasherViewSquare::SetScaleFactor( void )
 
 
 inline myint CDasherViewSquare::CustomIDivScaleFactor(myint iNumerator) {
-  // Integer division rounding away from zero
-
-  long long int num, denom, quot, rem;
-  myint res;
-
-  num   = iNumerator;
-  denom = SCALE_FACTOR;
-
-  DASHER_ASSERT(denom != 0);
-
-#ifdef HAVE_LLDIV
-  lldiv_t ans = ::lldiv(num, denom);
-
-  quot = ans.quot;
-  rem  = ans.rem;
-#else
-  quot = num / denom;
-  rem  = num % denom;
-#endif
-
-  if (rem < 0)
-    res = quot - 1;
-  else if (rem > 0)
-    res = quot + 1;
-  else
-    res = quot;
-
-  return res;
-
-  // return (iNumerator + iDenominator - 1) / iDenominator;
+  // Integer division rounding away from zero. As SCALE_FACTOR is a power of two,
+  // (arithmetic) right shift gives the floor, which is right for negatives;
+  // for positives, add SCALE_FACTOR-1 first to get the ceiling. Branch-free,
+  // so loops of these can be vectorized.
+  return (iNumerator + ((SCALE_FACTOR-1) & -static_cast<myint>(iNumerator > 0))) >> SCALE_SHIFT;
 }
 
 void CDasherViewSquare::Dasher2Screen(myint iDasherX, myint iDasherY, screenint &iScreenX, screenint &iScreenY) {
@@ -967,40 +956,52 @@ void CDasherViewSquare::Dasher2Screen(myint iDasherX, myint iDasherY, screenint
   iDasherX = xmap(iDasherX);
   iDasherY = ymap(iDasherY);
 
-  // Things we're likely to need:
-
-  screenint iScreenWidth = Screen()->GetWidth();
-  screenint iScreenHeight = Screen()->GetHeight();
-
   // Note that integer division is rounded *away* from zero here to
   // ensure that this really is the inverse of the map the other way
   // around.
 
-  switch( GetOrientation() ) {
-  case Dasher::Opts::LeftToRight:
-    iScreenX = screenint(iScreenWidth -
-			 CustomIDivScaleFactor(iDasherX  * iScaleFactorX));
-    iScreenY = screenint(iScreenHeight / 2 +
-			 CustomIDivScaleFactor(( iDasherY - CDasherModel::MAX_Y / 2 ) * iScaleFactorY));
-    break;
-  case Dasher::Opts::RightToLeft:
-    iScreenX = screenint(CustomIDivScaleFactor(iDasherX * iScaleFactorX));
-    iScreenY = screenint(iScreenHeight / 2 +
-			 CustomIDivScaleFactor( (iDasherY - CDasherModel::MAX_Y/2) * iScaleFactorY));
-    break;
-  case Dasher::Opts::TopToBottom:
-    iScreenX = screenint(iScreenWidth / 2 +
-			 CustomIDivScaleFactor( (iDasherY - CDasherModel::MAX_Y/2) * iScaleFactorY));
-    iScreenY = screenint(iScreenHeight -
-			 CustomIDivScaleFactor( iDasherX * iScaleFactorX ));
-    break;
-  case Dasher::Opts::BottomToTop:
-    iScreenX = screenint(iScreenWidth / 2 +
-			 CustomIDivScaleFactor(( iDasherY - CDasherModel::MAX_Y/2 ) * iScaleFactorY));
-    iScreenY = screenint(CustomIDivScaleFactor( iDasherX  * iScaleFactorX ));
-    break;
-    default:
-      break;
+  const screenint iAlongX(m_iXAxisOrigin + m_iXAxisSign * CustomIDivScaleFactor(iDasherX * iScaleFactorX));
+  const screenint iAlongY(m_iYAxisOrigin + CustomIDivScaleFactor((iDasherY - CDasherModel::MAX_Y/2) * iScaleFactorY));
+  if (m_bVertical) {
+    iScreenX = iAlongY; iScreenY = iAlongX;
+  } else {
+    iScreenX = iAlongX; iScreenY = iAlongY;
+  }
+}
+
+void CDasherViewSquare::Dasher2Screen(const myint *pDasherX, const myint *pDasherY, CDasherScreen::point *pPoints, int iNum) {
+  if (!m_bNonlinearX && !m_bNonlinearY) {
+    //xmap just adds the margin, and ymap does nothing
+    LinearDasher2Screen(pDasherX, pDasherY, iMarginWidth, 0, pPoints, iNum);
+    return;
+  }
+  //Nonlinearities (these need logs/divisions, and branch, so do them separately)
+  if (m_vMappedX.size() < static_cast<size_t>(iNum)) {
+    m_vMappedX.resize(iNum);
+    m_vMappedY.resize(iNum);
+  }
+  for (int i=0; i<iNum; i++) {
+    m_vMappedX[i] = xmap(pDasherX[i]);
+    m_vMappedY[i] = ymap(pDasherY[i]);
+  }
+  LinearDasher2Screen(&m_vMappedX[0], &m_vMappedY[0], 0, 0, pPoints, iNum);
+}
+
+void CDasherViewSquare::LinearDasher2Screen(const myint *pMappedX, const myint *pMappedY, myint iOffsetX, myint iOffsetY, CDasherScreen::point *pPoints, int iNum) const {
+  //Fold the offsets, and the centering of y, into the constant added before dividing
+  const myint iAddX((iOffsetX * iScaleFactorX)), iAddY((iOffsetY - CDasherModel::MAX_Y/2) * iScaleFactorY);
+  const myint iScaleX(iScaleFactorX), iScaleY(iScaleFactorY), iOriginX(m_iXAxisOrigin), iSignX(m_iXAxisSign), iOriginY(m_iYAxisOrigin);
+  //Test orientation once, outside the loops
+  if (m_bVertical) {
+    for (int i=0; i<iNum; i++) {
+      pPoints[i].x = screenint(iOriginY + CustomIDivScaleFactor(pMappedY[i] * iScaleY + iAddY));
+      pPoints[i].y = screenint(iOriginX + iSignX * CustomIDivScaleFactor(pMappedX[i] * iScaleX + iAddX));
+    }
+  } else {
+    for (int i=0; i<iNum; i++) {
+      pPoints[i].x = screenint(iOriginX + iSignX * CustomIDivScaleFactor(pMappedX[i] * iScaleX + iAddX));
+      pPoints[i].y = screenint(iOriginY + CustomIDivScaleFactor(pMappedY[i] * iScaleY + iAddY));
+    }
   }
 }
 
@@ -1019,7 +1020,7 @@ void CDasherViewSquare::Dasher2Polar(myint iDasherX, myint iDasherY, double &r,
 
 void CDasherViewSquare::DasherLine2Screen(myint x1, myint y1, myint x2, myint y2, vector<CDasherScreen::point> &vPoints) {
   if (x1!=x2 && y1!=y2) { //only diagonal lines ever get changed...
-    if (GetBoolParameter(BP_NONLINEAR_Y)) {
+    if (m_bNonlinearY) {
       if ((y1 < m_Y3 && y2 > m_Y3) ||(y2 < m_Y3 && y1 > m_Y3)) {
         //crosses bottom non-linearity border
         myint x_mid = x1+(x2-x1) * (m_Y3-y1)/(y2-y1);
@@ -1033,7 +1034,7 @@ void CDasherViewSquare::DasherLine2Screen(myint x1, myint y1, myint x2, myint y2
         x1=x_mid; y1=m_Y2;
       }
     }
-    if (GetLongParameter(LP_NONLINEAR_X) && (x1 > m_iXlogThres || x2 > m_iXlogThres)) {
+    if (m_bNonlinearX && (x1 > m_iXlogThres || x2 > m_iXlogThres)) {
       //into logarithmic section
       CDasherScreen::point pStart, pScreenMid, pEnd;
       Dasher2Screen(x2, y2, pEnd.x, pEnd.y);
@@ -1049,7 +1050,7 @@ void CDasherViewSquare::DasherLine2Screen(myint x1, myint y1, myint x2, myint y2
 
         //since we know both endpoints are in the same section of the screen wrt. Y nonlinearity,
         //the midpoint along the DasherY axis of both lines should be the same.
-        if (GetOrientation()==Dasher::Opts::LeftToRight || GetOrientation()==Dasher::Opts::RightToLeft) {
+        if (!m_bVertical) {
           DASHER_ASSERT(abs(pDasherMid.y - pScreenMid.y)<=1);//allow for rounding error
           if (abs(pDasherMid.x - pScreenMid.x)<=1) break; //call a straight line accurate enough
         } else {
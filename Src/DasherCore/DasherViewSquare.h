@@ -6,6 +6,8 @@
 #define __DasherViewSquare_h__
 #include "DasherView.h"
 #include "DasherScreen.h"
+#include "DisplayList.h"
+#include "../Common/Allocators/ArenaAlloc.h"
 #include <deque>
 #include "Alphabet/GroupInfo.h"
 #include "SettingsStore.h"
@@ -70,6 +72,12 @@ public:
   ///
   void Dasher2Screen(myint iDasherX, myint iDasherY, screenint & iScreenX, screenint & iScreenY);
 
+  ///
+  /// Convert many points at once: applies the nonlinearities to all, and then the
+  /// (linear) scaling and orientation, in straight-line loops over the arrays.
+  ///
+  void Dasher2Screen(const myint *pDasherX, const myint *pDasherY, CDasherScreen::point *pPoints, int iNum);
+
   ///
   /// Convert Dasher co-ordinates to polar co-ordinates (r,theta), with 0<r<1, 0<theta<2*pi
   ///
@@ -101,7 +109,7 @@ private:
   /// @param x = max dasher-x extent
   /// @param y1, y2 = dasher-y extent along y-axis
   /// @param midy1,midy2 = extent along line of max x (midy1==midy2 => triangle, midy1<midy2 => truncated tri)
-  void TruncateTri(myint x, myint y1, myint y2, myint midy1, myint midy2, int fillColor, int outlineColor, int lineWidth);
+  void TruncateTri(myint x, myint y1, myint y2, myint midy1, myint midy2, int fillColor, int outlineColor, int lineWidth, int iLayer);
 
   /// compute screen coords for a circle, centered on y-axis, between two points
   /// cy, r - dasher coords of center (on y-axis), radius
@@ -111,30 +119,53 @@ private:
   /// pts - vector into which to store points; on entry, last element should already be screen-coords of (x1,y1)
   /// dXMul - multiply x coords (in dasher space) by this (i.e. aspect ratio), for ovals
   void CircleTo(myint cy, myint r, myint y1, myint x1, myint y3, myint x3, CDasherScreen::point dest, vector<CDasherScreen::point> &pts, double dXMul);
-  void Circle(myint Range, myint lowY, myint highY, int fCol, int oCol, int lWidth);
-  void Quadric(myint Range, myint lowY, myint highY, int fillColor, int outlineColour, int lineWidth);
+  void Circle(myint Range, myint lowY, myint highY, int fCol, int oCol, int lWidth, int iLayer);
+  void Quadric(myint Range, myint lowY, myint highY, int fillColor, int outlineColour, int lineWidth, int iLayer);
   ///draw isoceles triangle, with baseline from y1-y2 along y axis (x=0), and other point at (x,(y1+y2)/2)
   /// (all in Dasher coords).
   void Triangle(myint x, myint y1, myint y2, int fillColor, int outlineColor, int lineWidth);
 
+  ///Made in m_FrameArena, so never deleted (and must not need destructing)
   class CTextString {
   public: //to CDasherViewSquare...
     ///Creates a request that label will be drawn.
     /// x,y are screen coords of midpoint of leading edge;
     /// iSize is desired size (already computed from requested position)
     CTextString(CDasherScreen::Label *pLabel, screenint x, screenint y, int iSize, int iColor)
-    : m_pLabel(pLabel), m_ix(x), m_iy(y), m_iSize(iSize), m_iColor(iColor) {
+    : m_pLabel(pLabel), m_ix(x), m_iy(y), m_iSize(iSize), m_iColor(iColor), m_pFirstChild(NULL), m_pLastChild(NULL), m_pNext(NULL) {
+    }
+    void AddChild(CTextString *pChild) {
+      (m_pLastChild ? m_pLastChild->m_pNext : m_pFirstChild) = pChild;
+      m_pLastChild = pChild;
     }
-    ~CTextString();
     CDasherScreen::Label *m_pLabel;
     screenint m_ix,m_iy;
-    vector<CTextString *> m_children;
     int m_iSize;
     int m_iColor;
+    ///Strings to draw after this one (if this one is drawn), in order:
+    /// a list linked through their m_pNext
+    CTextString *m_pFirstChild, *m_pLastChild, *m_pNext;
   };
 
   std::vector<CTextString *> m_DelayedTexts;
 
+  ///Holds the CTextStrings made during a call to Render; reset at the start of each.
+  CArenaAlloc m_FrameArena;
+
+  /// Values fixed for the duration of a call to Render, fetched at its start
+  /// rather than by every node rendered. (The scale factors, and parameters
+  /// of the nonlinearities, are cached by SetScaleFactor.)
+  struct SFrameContext {
+    ///As returned by VisibleRegion
+    myint iMinX, iMinY, iMaxX, iMaxY;
+    long iShapeType, iOutlineWidth, iMinNodeSize;
+  };
+  SFrameContext m_frame;
+
+  /// Shapes for the nodes (and around them), recorded by DisjointRender/NewRender
+  /// and sent to the screen at the end of Render
+  CDisplayList m_DisplayList;
+
   void DoDelayedText(CTextString *pText);
   ///
   /// Draw text specified in Dasher co-ordinates
@@ -154,7 +185,13 @@ private:
   /// 4=quadrics, 5=semicircles)
   /// Each call responsible for rendering exactly the area contained within the node.
   /// @param pOutput The innermost node covering the crosshair (if any)
-  void NewRender(CDasherNode * Render, myint y1, myint y2, CTextString *prevText, CExpansionPolicy &policy, double dMaxCost, CDasherNode *&pOutput);
+  /// @param iDepth layer in m_DisplayList for the node's shape: nodes at the same
+  /// depth in the tree don't overlap, and each is drawn over its parent.
+  void NewRender(CDasherNode * Render, myint y1, myint y2, CTextString *prevText, CExpansionPolicy &policy, double dMaxCost, CDasherNode *&pOutput, int iDepth);
+
+  /// Make any children of a node with NF_LAZY, that would be rendered if they
+  /// existed (i.e. are at least partly onscreen and at least LP_MIN_NODE_SIZE)
+  void MaterializeOnscreen(CDasherNode *pRender, myint y1, myint y2);
 
   /// @name Nonlinearity
   /// Implements the non-linear part of the coordinate space mapping
@@ -175,7 +212,11 @@ private:
   bool CoversCrosshair(myint Range,myint y1,myint y2);
 
   //Divides by SCALE_FACTOR, rounding away from 0
-  inline myint CustomIDivScaleFactor(myint iNumerator);
+  static inline myint CustomIDivScaleFactor(myint iNumerator);
+
+  /// Body of the batch Dasher2Screen, once any nonlinearities have been applied:
+  /// pMappedX/Y are as returned by xmap/ymap, minus iOffsetX/Y.
+  void LinearDasher2Screen(const myint *pMappedX, const myint *pMappedY, myint iOffsetX, myint iOffsetY, CDasherScreen::point *pPoints, int iNum) const;
 
   void DasherLine2Screen(myint x1, myint y1, myint x2, myint y2, vector<CDasherScreen::point> &vPoints);
 
@@ -188,6 +229,10 @@ private:
   double m_dXlogCoeff;
   myint m_iXlogThres;
 
+  /// Whether LP_NONLINEAR_X / BP_NONLINEAR_Y are in effect (copied by SetScaleFactor,
+  /// to save looking them up for every point)
+  bool m_bNonlinearX, m_bNonlinearY;
+
   //width of margin, in abstract screen coords
   myint iMarginWidth;
 
@@ -195,7 +240,19 @@ private:
   /// (Note the naming convention: iScaleFactorX/Y refers to X/Y in Dasher-space, which will be
   /// the other way around to real screen coordinates if using a vertical (T-B/B-T) orientation)
   myint iScaleFactorX, iScaleFactorY;
-  static const myint SCALE_FACTOR = 1<<26; //was 100,000,000; change to power of 2 => easier to multiply/divide
+  static const int SCALE_SHIFT = 26;
+  static const myint SCALE_FACTOR = 1<<SCALE_SHIFT; //was 100,000,000; change to power of 2 => easier to multiply/divide
+
+  /// The rest of the mapping from (nonlinearly mapped) Dasher coords to pixels,
+  /// computed by SetScaleFactor: Dasher X gives the screen coordinate
+  /// m_iXAxisOrigin + m_iXAxisSign * CustomIDivScaleFactor(x * iScaleFactorX),
+  /// Dasher Y gives m_iYAxisOrigin + CustomIDivScaleFactor((y - MAX_Y/2) * iScaleFactorY),
+  /// and for vertical orientations the former is the screen y rather than x.
+  myint m_iXAxisOrigin, m_iXAxisSign, m_iYAxisOrigin;
+  bool m_bVertical;
+
+  /// Nonlinearly-mapped coordinates for the batch Dasher2Screen (kept to save reallocating)
+  std::vector<myint> m_vMappedX, m_vMappedY;
 
   /// Cached extents of visible region
   myint m_iDasherMinX;
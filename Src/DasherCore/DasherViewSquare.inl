@@ -46,7 +46,7 @@ namespace Dasher {
   inline myint CDasherViewSquare::ixmap(myint x) const
   {
     x -= iMarginWidth;
-    if (GetLongParameter(LP_NONLINEAR_X)>0 && x >= m_iXlogThres) {
+    if (m_bNonlinearX && x >= m_iXlogThres) {
       double dx = (x - m_iXlogThres) / static_cast<double>(CDasherModel::MAX_Y);
       dx =  (exp(dx * m_dXlogCoeff) - 1) / m_dXlogCoeff;
       x = myint( dx * CDasherModel::MAX_Y) + m_iXlogThres;
@@ -56,7 +56,7 @@ namespace Dasher {
 
   inline myint CDasherViewSquare::xmap(myint x) const
   {
-    if(GetLongParameter(LP_NONLINEAR_X) && x >= m_iXlogThres) {
+    if(m_bNonlinearX && x >= m_iXlogThres) {
       double dx = log(1+ (x-m_iXlogThres)*m_dXlogCoeff/CDasherModel::MAX_Y)/m_dXlogCoeff;
       dx = (dx*CDasherModel::MAX_Y) + m_iXlogThres;
       x= myint(dx>0 ? ceil(dx) : floor(dx));
@@ -65,7 +65,7 @@ namespace Dasher {
   }
 
   inline myint CDasherViewSquare::ymap(myint y) const {
-    if (GetBoolParameter(BP_NONLINEAR_Y)) {
+    if (m_bNonlinearY) {
       if(y > m_Y2)
         return m_Y2 + (y - m_Y2) / m_Y1;
       else if(y < m_Y3)
@@ -75,7 +75,7 @@ namespace Dasher {
   }
 
   inline myint CDasherViewSquare::iymap(myint ydash) const {
-    if (GetBoolParameter(BP_NONLINEAR_Y)) {
+    if (m_bNonlinearY) {
       if(ydash > m_Y2)
         return (ydash - m_Y2) * m_Y1 + m_Y2;
       else if(ydash < m_Y3)
@@ -0,0 +1,193 @@
+// DisplayList.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+
+#include "DisplayList.h"
+#include "DasherView.h"
+
+#include <algorithm>
+
+using namespace Dasher;
+using std::vector;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG_MEMLEAKS
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CDisplayList::CDisplayList() : m_iMaxLayer(0), m_iCulled(0), m_iMerged(0) {
+}
+
+void CDisplayList::Rectangle(myint iDasherMaxX, myint iDasherMinY, myint iDasherMinX, myint iDasherMaxY, int iColour, int iOutlineColour, int iThickness, int iLayer) {
+  //As CDasherView::DasherDrawRectangle
+  DASHER_ASSERT(iDasherMinX <= iDasherMaxX && iDasherMinY <= iDasherMaxY);
+  const SShape shape = {m_vDasherX.size()/2, 0, iColour, iOutlineColour, iThickness, iLayer};
+  m_vDasherX.push_back(iDasherMaxX); m_vDasherY.push_back(iDasherMinY);
+  m_vDasherX.push_back(iDasherMinX); m_vDasherY.push_back(iDasherMaxY);
+  Add(shape);
+}
+
+void CDisplayList::Polygon(const CDasherScreen::point *pPoints, int iNum, int iFillColour, int iOutlineColour, int iLineWidth, int iLayer) {
+  DASHER_ASSERT(iNum > 0);
+  const SShape shape = {m_vPoints.size(), iNum, iFillColour, iOutlineColour, iLineWidth, iLayer};
+  m_vPoints.insert(m_vPoints.end(), pPoints, pPoints + iNum);
+  Add(shape);
+}
+
+void CDisplayList::Add(const SShape &shape) {
+  DASHER_ASSERT(shape.iLayer >= 0);
+  m_iMaxLayer = std::max(m_iMaxLayer, shape.iLayer);
+  m_vShapes.push_back(shape);
+}
+
+void CDisplayList::Submit(CDasherView *pView, CDasherScreen *pScreen) {
+  m_iCulled = m_iMerged = 0;
+  const screenint iWidth(pScreen->GetWidth()), iHeight(pScreen->GetHeight());
+
+  //Convert all the rectangles to screen coordinates first, in one go
+  const size_t iNumRects(m_vDasherX.size()/2);
+  m_vCorners.resize(2*iNumRects);
+  m_vRects.resize(iNumRects);
+  if (iNumRects) pView->Dasher2Screen(&m_vDasherX[0], &m_vDasherY[0], &m_vCorners[0], 2*iNumRects);
+  for (size_t i = 0; i < iNumRects; i++) {
+    const CDasherScreen::point &p1(m_vCorners[2*i]), &p2(m_vCorners[2*i+1]);
+    CDasherScreen::rect &r(m_vRects[i]);
+    r.x1 = std::min(p1.x, p2.x); r.x2 = std::max(p1.x, p2.x);
+    r.y1 = std::min(p1.y, p2.y); r.y2 = std::max(p1.y, p2.y);
+  }
+
+  //Sort into layers (counting sort), and find the topmost layer with a filled
+  // rectangle covering the whole screen: nothing beneath that can be seen.
+  m_vLayerStarts.assign(m_iMaxLayer + 2, 0);
+  int iFirstLayer = 0;
+  for (vector<SShape>::const_iterator it = m_vShapes.begin(); it != m_vShapes.end(); it++) {
+    m_vLayerStarts[it->iLayer + 1]++;
+    if (it->iNumPoints == 0 && it->iFillColour != -1 && it->iLayer > iFirstLayer) {
+      const CDasherScreen::rect &r(m_vRects[it->iStart]);
+      if (r.x1 <= 0 && r.y1 <= 0 && r.x2 >= iWidth && r.y2 >= iHeight) iFirstLayer = it->iLayer;
+    }
+  }
+  for (int i = 1; i <= m_iMaxLayer + 1; i++) m_vLayerStarts[i] += m_vLayerStarts[i - 1];
+  m_vOrder.resize(m_vShapes.size());
+  for (size_t i = 0; i < m_vShapes.size(); i++)
+    m_vOrder[m_vLayerStarts[m_vShapes[i].iLayer]++] = i;
+  //that moved each start along to the end of its layer, i.e. the start of the next
+  for (int i = m_iMaxLayer + 1; i > 0; i--) m_vLayerStarts[i] = m_vLayerStarts[i - 1];
+  m_vLayerStarts[0] = 0;
+  m_iCulled += m_vLayerStarts[iFirstLayer];
+
+  for (int iLayer = iFirstLayer; iLayer <= m_iMaxLayer; iLayer++) {
+    const size_t iStart(m_vLayerStarts[iLayer]), iEnd(m_vLayerStarts[iLayer + 1]);
+    //Fill-only rectangles first, in batches...
+    for (size_t i = iStart; i < iEnd; i++) {
+      const SShape &shape(m_vShapes[m_vOrder[i]]);
+      if (shape.iNumPoints || !shape.FillOnly()) continue;
+      const CDasherScreen::rect &r(m_vRects[shape.iStart]);
+      if (Invisible(r, pScreen))
+        m_iCulled++;
+      else
+        AddToBatch(r, shape.iFillColour);
+    }
+    FlushBatches(pScreen);
+    //...then everything else, in the order recorded
+    for (size_t i = iStart; i < iEnd; i++) {
+      const SShape &shape(m_vShapes[m_vOrder[i]]);
+      if (shape.iNumPoints || !shape.FillOnly()) Draw(shape, pScreen);
+    }
+  }
+  Clear();
+}
+
+void CDisplayList::Clear() {
+  m_vShapes.clear();
+  m_vDasherX.clear();
+  m_vDasherY.clear();
+  m_vCorners.clear();
+  m_vRects.clear();
+  m_vPoints.clear();
+  m_iMaxLayer = 0;
+}
+
+bool CDisplayList::Invisible(const CDasherScreen::rect &bounds, CDasherScreen *pScreen) const {
+  //Not culling empty shapes: some screens (e.g. GTK without cairo) fill pixels
+  // x1..x2 inclusive, so draw those as lines
+  return bounds.x2 < 0 || bounds.y2 < 0
+    || bounds.x1 >= pScreen->GetWidth() || bounds.y1 >= pScreen->GetHeight();
+}
+
+void CDisplayList::AddToBatch(const CDasherScreen::rect &r, int iColour) {
+  DASHER_ASSERT(iColour >= 0);
+  if (iColour >= static_cast<int>(m_vBatches.size())) m_vBatches.resize(iColour + 1);
+  vector<CDasherScreen::rect> &batch(m_vBatches[iColour]);
+  if (batch.empty())
+    m_vBatchColours.push_back(iColour);
+  else {
+    CDasherScreen::rect &last(batch.back());
+    if (last.x1 == r.x1 && last.x2 == r.x2 && (last.y2 == r.y1 || last.y1 == r.y2)) {
+      last.y1 = std::min(last.y1, r.y1);
+      last.y2 = std::max(last.y2, r.y2);
+      m_iMerged++;
+      return;
+    }
+    if (last.y1 == r.y1 && last.y2 == r.y2 && (last.x2 == r.x1 || last.x1 == r.x2)) {
+      last.x1 = std::min(last.x1, r.x1);
+      last.x2 = std::max(last.x2, r.x2);
+      m_iMerged++;
+      return;
+    }
+  }
+  batch.push_back(r);
+}
+
+void CDisplayList::FlushBatches(CDasherScreen *pScreen) {
+  for (vector<int>::const_iterator it = m_vBatchColours.begin(); it != m_vBatchColours.end(); it++) {
+    vector<CDasherScreen::rect> &batch(m_vBatches[*it]);
+    pScreen->FillRectangles(&batch[0], batch.size(), *it);
+    batch.clear();
+  }
+  m_vBatchColours.clear();
+}
+
+void CDisplayList::Draw(const SShape &shape, CDasherScreen *pScreen) {
+  if (shape.iNumPoints == 0) {
+    const CDasherScreen::rect &r(m_vRects[shape.iStart]);
+    pScreen->DrawRectangle(r.x1, r.y1, r.x2, r.y2, shape.iFillColour, shape.iOutlineColour, shape.iLineWidth);
+    return;
+  }
+  CDasherScreen::point *pPoints = &m_vPoints[shape.iStart];
+  if (shape.FillOnly()) {
+    CDasherScreen::rect bounds = {pPoints[0].x, pPoints[0].y, pPoints[0].x, pPoints[0].y};
+    for (int i = 1; i < shape.iNumPoints; i++) {
+      bounds.x1 = std::min(bounds.x1, pPoints[i].x); bounds.x2 = std::max(bounds.x2, pPoints[i].x);
+      bounds.y1 = std::min(bounds.y1, pPoints[i].y); bounds.y2 = std::max(bounds.y2, pPoints[i].y);
+    }
+    if (Invisible(bounds, pScreen)) {
+      m_iCulled++;
+      return;
+    }
+  }
+  pScreen->Polygon(pPoints, shape.iNumPoints, shape.iFillColour, shape.iOutlineColour, shape.iLineWidth);
+}
@@ -0,0 +1,124 @@
+// DisplayList.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __DisplayList_h__
+#define __DisplayList_h__
+
+#include "DasherScreen.h"
+#include "DasherTypes.h"
+#include "../Common/NoClones.h"
+
+#include <vector>
+
+namespace Dasher {
+  class CDisplayList;
+  class CDasherView;
+}
+
+/// \ingroup View
+/// @{
+
+/// The shapes making up one frame's rendering of the nodes, collected so they
+/// can be sent to the CDasherScreen together. Rectangles are recorded in Dasher
+/// coordinates, and only converted to screen coordinates (all at once) by Submit;
+/// polygons, whose outlines depend on the screen mapping, are recorded in
+/// screen coordinates.
+///
+/// Each shape is in a numbered layer, drawn in increasing order; shapes in the
+/// same layer must not overlap (e.g. nodes at the same depth in the tree), so
+/// may be drawn in any order. Hence Submit can fill all rectangles of the same
+/// colour in a layer at once (see CDasherScreen::FillRectangles), merging any
+/// which abut exactly, before drawing the layer's other shapes (e.g. outlines).
+/// It also drops fill-only shapes smaller than a pixel or entirely offscreen,
+/// and everything beneath the topmost filled rectangle covering the whole screen.
+/// Storage is kept between frames, so once warmed up, recording allocates nothing.
+class Dasher::CDisplayList : private NoClones {
+public:
+  CDisplayList();
+
+  /// Record a rectangle, as for CDasherView::DasherDrawRectangle
+  void Rectangle(myint iDasherMaxX, myint iDasherMinY, myint iDasherMinX, myint iDasherMaxY, int iColour, int iOutlineColour, int iThickness, int iLayer);
+
+  /// Record a polygon, as for CDasherScreen::Polygon; the points are copied.
+  void Polygon(const CDasherScreen::point *pPoints, int iNum, int iFillColour, int iOutlineColour, int iLineWidth, int iLayer);
+
+  /// Draw everything recorded since the last call onto the screen, and clear the list.
+  /// \param pView view used to convert rectangles into screen coordinates
+  void Submit(CDasherView *pView, CDasherScreen *pScreen);
+
+  /// Discard everything recorded
+  void Clear();
+
+  /// Number of shapes Submit dropped, and of rectangles it merged into others,
+  /// over the last call
+  int GetCulled() const {return m_iCulled;}
+  int GetMerged() const {return m_iMerged;}
+
+private:
+  struct SShape {
+    ///Index into m_vRects (if iNumPoints==0), else of the first point in m_vPoints
+    size_t iStart;
+    int iNumPoints;
+    int iFillColour, iOutlineColour, iLineWidth;
+    int iLayer;
+    bool FillOnly() const {return iFillColour!=-1 && iLineWidth<1;}
+  };
+
+  void Add(const SShape &shape);
+
+  /// Whether a fill-only shape with the given (normalized) bounds lies entirely
+  /// offscreen, so can't be seen
+  bool Invisible(const CDasherScreen::rect &bounds, CDasherScreen *pScreen) const;
+
+  /// Add a (normalized, screen) rectangle to the batch for its colour, merging
+  /// it into the last rectangle there if they abut along a whole side.
+  void AddToBatch(const CDasherScreen::rect &r, int iColour);
+
+  /// Fill all rectangles batched so far, and empty the batches
+  void FlushBatches(CDasherScreen *pScreen);
+
+  void Draw(const SShape &shape, CDasherScreen *pScreen);
+
+  std::vector<SShape> m_vShapes;
+  /// Corners of rectangles in Dasher coordinates, as recorded: (max x, min y)
+  /// then (min x, max y) for each, as separate arrays of x and y...
+  std::vector<myint> m_vDasherX, m_vDasherY;
+  /// ...and converted to screen coordinates (all at once, by Submit)...
+  std::vector<CDasherScreen::point> m_vCorners;
+  /// ...and then normalized into rectangles
+  std::vector<CDasherScreen::rect> m_vRects;
+  std::vector<CDasherScreen::point> m_vPoints;
+  /// Highest layer used so far
+  int m_iMaxLayer;
+
+  /// Indices into m_vShapes sorted by layer (stably), and the start of each
+  /// layer therein; computed by Submit
+  std::vector<size_t> m_vOrder, m_vLayerStarts;
+
+  /// Rectangles waiting to be filled, indexed by colour
+  std::vector<std::vector<CDasherScreen::rect> > m_vBatches;
+  /// Colours with non-empty batches, in the order first added
+  std::vector<int> m_vBatchColours;
+
+  int m_iCulled, m_iMerged;
+};
+/// @}
+
+#endif
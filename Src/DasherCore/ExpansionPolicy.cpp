@@ -21,7 +21,12 @@ void CExpansionPolicy::ExpandNode(CDasherNode *pNode) {
 bool Less(pair<double,CDasherNode *> x, pair<double, CDasherNode *> y) {return x.first < y.first;}
 bool More(pair<double,CDasherNode *> x, pair<double, CDasherNode *> y) {return x.first > y.first;}
   
-BudgettingPolicy::BudgettingPolicy(CDasherModel *pModel, unsigned int iNodeBudget) : CExpansionPolicy(pModel), m_iNodeBudget(iNodeBudget) {}
+BudgettingPolicy::BudgettingPolicy(CDasherModel *pModel, unsigned int iNodeBudget) : CExpansionPolicy(pModel), m_iMaxPrepare(0), m_iNodeBudget(iNodeBudget), m_iByteBudget(0) {}
+
+BudgettingPolicy::BudgettingPolicy(CDasherModel *pModel, unsigned int iNodeBudget, size_t iByteBudget, const function<size_t()> &fBytesUsed)
+: CExpansionPolicy(pModel), m_iMaxPrepare(0), m_iNodeBudget(iNodeBudget), m_iByteBudget(iByteBudget), m_fBytesUsed(fBytesUsed) {
+  DASHER_ASSERT(!iByteBudget || fBytesUsed);
+}
 
 double BudgettingPolicy::pushNode(CDasherNode *pNode, int iMin, int iMax, bool bExpand, double dParentCost) {
   double dRes = getCost(pNode, iMin, iMax);
@@ -66,8 +71,7 @@ bool BudgettingPolicy::apply() {
   double collapseCost = -std::numeric_limits<double>::infinity();
   
   //first, make sure we are within our budget (probably only in case the budget's changed)
-  while (!sCollapse.empty()
-         && currentNumNodeObjects() > m_iNodeBudget)
+  while (!sCollapse.empty() && overBudget())
   {
     pair<double,CDasherNode *> node = sCollapse.back();
     DASHER_ASSERT(node.first >= collapseCost);
@@ -81,7 +85,7 @@ bool BudgettingPolicy::apply() {
   // to make room to expand other more important (high-benefit) nodes.  
   while (!sExpand.empty() && sExpand.back().first > collapseCost)
   {
-    if (currentNumNodeObjects()+sExpand.back().second->ExpectedNumChildren() < m_iNodeBudget)
+    if (roomFor(sExpand.back().second))
     {
       ExpandNode(sExpand.back().second);
       sExpand.pop_back();
@@ -101,11 +105,43 @@ bool BudgettingPolicy::apply() {
     }
     else break; //not enough room, nothing to collapse.
   }
+  //Whatever we didn't expand is likeliest to be expanded over the next frames,
+  // so let the best prepare - at least, those more beneficial than anything we
+  // collapsed (others may have been deleted with it). All of sSpeculate are
+  // less beneficial than anything in sExpand, so this keeps them in < order:
+  sSpeculate.insert(sSpeculate.end(), sExpand.begin(), sExpand.end());
+  for (unsigned int i = 0; i < m_iMaxPrepare && !sSpeculate.empty() && sSpeculate.back().first > collapseCost; i++) {
+    sSpeculate.back().second->PrepareChildren();
+    sSpeculate.pop_back();
+  }
+  sSpeculate.clear();
   sExpand.clear();
   sCollapse.clear();
   return bReturnValue;
 }
 
+int BudgettingPolicy::nodesUsed() const {
+  return currentNumNodeObjects() - model()->HistoryNodes();
+}
+
+size_t BudgettingPolicy::bytesUsed() const {
+  const size_t iBytes(m_fBytesUsed());
+  return iBytes - min(iBytes, model()->HistoryBytes());
+}
+
+bool BudgettingPolicy::overBudget() const {
+  return nodesUsed() > m_iNodeBudget
+    || (m_iByteBudget && bytesUsed() > m_iByteBudget);
+}
+
+bool BudgettingPolicy::roomFor(CDasherNode *pNode) const {
+  const int iNodes(nodesUsed()), iNew(pNode->ExpectedNumChildren());
+  if (iNodes + iNew >= m_iNodeBudget) return false;
+  if (!m_iByteBudget) return true;
+  const size_t iBytes(bytesUsed());
+  return iBytes + (iBytes / max(iNodes, 1)) * iNew < m_iByteBudget;
+}
+
 int BudgettingPolicy::getRange(int y1, int y2, int iMin, int iMax) {
   if (y1>iMax || y2 < iMin) return 0;
   return min(y2, iMax) - max(y1, iMin);
@@ -115,26 +151,41 @@ double BudgettingPolicy::getCost(CDasherNode *pNode, int iDasherMinY, int iDashe
   return getRange(iDasherMinY, iDasherMaxY, 0, 4096);
 }
 
-AmortizedPolicy::AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget) : BudgettingPolicy(pModel,iNodeBudget), m_iMaxExpands(std::max(1u,(500+iNodeBudget)/1000)) {}
+AmortizedPolicy::AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget) : BudgettingPolicy(pModel,iNodeBudget), m_iMaxExpands(std::max(1u,(500+iNodeBudget)/1000)) {
+  m_iMaxPrepare = m_iMaxExpands;
+}
+
+AmortizedPolicy::AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget, unsigned int iMaxExpands) : BudgettingPolicy(pModel, iNodeBudget), m_iMaxExpands(iMaxExpands) {
+  m_iMaxPrepare = m_iMaxExpands;
+}
 
-AmortizedPolicy::AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget, unsigned int iMaxExpands) : BudgettingPolicy(pModel, iNodeBudget), m_iMaxExpands(iMaxExpands) {}
+AmortizedPolicy::AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget, size_t iByteBudget, const function<size_t()> &fBytesUsed)
+: BudgettingPolicy(pModel, iNodeBudget, iByteBudget, fBytesUsed), m_iMaxExpands(std::max(1u,(500+iNodeBudget)/1000)) {
+  m_iMaxPrepare = m_iMaxExpands;
+}
 
 double AmortizedPolicy::pushNode(CDasherNode *node, int iMin, int iMax, bool bExpand, double dParentCost) {
   double dRes = BudgettingPolicy::pushNode(node,iMin,iMax,bExpand,dParentCost);
-  if (bExpand && sExpand.size() > 2*m_iMaxExpands) trim();
+  //keep twice as many as we'll expand, so the rest can be prepared
+  if (bExpand && sExpand.size() > 4*m_iMaxExpands) trim(2*m_iMaxExpands);
   return dRes;
 }
 
 bool AmortizedPolicy::apply() {
-  trim();
+  trim(2*m_iMaxExpands);
+  //expand only the best m_iMaxExpands; the rest are just to be prepared
+  sort(sExpand.begin(), sExpand.end(), Less);
+  const size_t iSpare(sExpand.size() - min<size_t>(sExpand.size(), m_iMaxExpands));
+  sSpeculate.assign(sExpand.begin(), sExpand.begin() + iSpare);
+  sExpand.erase(sExpand.begin(), sExpand.begin() + iSpare);
   return BudgettingPolicy::apply();
 }
 
-void AmortizedPolicy::trim() {
-  if (sExpand.size() <= m_iMaxExpands) return;
+void AmortizedPolicy::trim(unsigned int iKeep) {
+  if (sExpand.size() <= iKeep) return;
   //ok - repeatedly find a pivot element, and place it dividing all elements into
   //those more than it (in lower indices) and those less than it (in higher indices),
-  // until we have separated off the <m_iMaxExpands> elements with greatest benefit
+  // until we have separated off the <iKeep> elements with greatest benefit
 #ifdef DEBUG_TRIM
   vector<pair<double,CDasherNode *> > backup = sExpand; //yep, copy the lot
 #endif
@@ -166,22 +217,22 @@ void AmortizedPolicy::trim() {
       sExpand[start]=sExpand[low];
       sExpand[low] = temp;
     }
-    //if (low == m_iMaxExpands), elements [0 - low-1] are all <= pivot
-    //if (low == m_iMaxExpands-1), elements [0 - low] are all <= pivot (as pivot<=pivot!)
+    //if (low == iKeep), elements [0 - low-1] are all <= pivot
+    //if (low == iKeep-1), elements [0 - low] are all <= pivot (as pivot<=pivot!)
     //finish in both cases.
-    if (low < m_iMaxExpands-1)
+    if (low < iKeep-1)
       start=low+1;
-    else if (low>m_iMaxExpands)
+    else if (low>iKeep)
       stop=low-1;
     else break;
   }
   //truncate array
-  sExpand.resize(m_iMaxExpands);
+  sExpand.resize(iKeep);
 #ifdef DEBUG_TRIM
   //now compare with the brute-force method...
   sort(sExpand.begin(), sExpand.end(), Less);
   sort(backup.begin(), backup.end(), Less);
-  backup.erase(backup.begin(), backup.end()-m_iMaxExpands);
+  backup.erase(backup.begin(), backup.end()-iKeep);
   //now compare. note we _don't_ require the node pointers to be the same;
   // where the cut-off point falls within a group of nodes with the same cost,
   // the two vectors could have different nodes from that group.
@@ -14,6 +14,7 @@
 #include <queue>
 #include <limits>
 #include <algorithm>
+#include <functional>
 #include "DasherNode.h"
 
 class CNodeCreationManager;
@@ -35,6 +36,7 @@ public:
   void ExpandNode(CDasherNode *pNode);
 protected:
   CExpansionPolicy(CDasherModel *pModel) : m_pModel(pModel) {}
+  const CDasherModel *model() const {return m_pModel;}
 private:
   CDasherModel *m_pModel;
 };
@@ -48,12 +50,18 @@ public:
   bool apply() override {return false;}
 };
 
-///A policy that expands/collapses nodes to maintain a given node budget.
+///A policy that expands/collapses nodes to maintain a given node budget,
+///and optionally a budget of memory, as measured by a function supplied
+///(e.g. CNodeCreationManager::GetMemoryUsage).
 ///Also ascribes uniform costs, according to size within the range 0-4096.
+///After expanding what it can, apply() calls PrepareChildren on the best (up to
+///m_iMaxPrepare) of those left, as the likeliest to be expanded next.
 class BudgettingPolicy : public CExpansionPolicy
 {
 public:
   BudgettingPolicy(CDasherModel *pModel, unsigned int iNodeBudget);
+  ///\param iByteBudget if nonzero, also keep fBytesUsed() below this
+  BudgettingPolicy(CDasherModel *pModel, unsigned int iNodeBudget, std::size_t iByteBudget, const std::function<std::size_t()> &fBytesUsed);
   ~BudgettingPolicy() override = default;
   ///sets cost according to getCost(pNode,iMin,iMax);
   ///then assures node is cheaper (less important) than its parent;
@@ -64,23 +72,46 @@ protected:
   virtual double getCost(CDasherNode *pNode, int iDasherMinY, int iDasherMaxY);
   ///return the intersection of the ranges (y1-y2) and (iMin-iMax)
   int getRange(int y1, int y2, int iMin, int iMax);
+  ///Nodes, and bytes (if a byte budget), counting against the budget: all but
+  /// those in the model's root history, which has its own budget (see
+  /// CDasherModel::SetHistoryBudget)
+  int nodesUsed() const;
+  std::size_t bytesUsed() const;
+  ///Whether we are over budget (of nodes, or of bytes if any)
+  bool overBudget() const;
+  ///Whether there is room in the budget to make the children of pNode; for the
+  /// byte budget, each is assumed to take as much as existing nodes do on average
+  /// (inc. their probability tables, etc.)
+  bool roomFor(CDasherNode *pNode) const;
   std::vector<std::pair<double,CDasherNode *> > sExpand, sCollapse;
+  ///Candidates for expansion which apply() should not expand this time, only
+  /// prepare (with those in sExpand it doesn't); all less beneficial than any in sExpand.
+  std::vector<std::pair<double,CDasherNode *> > sSpeculate;
+  ///Most nodes on which apply() calls PrepareChildren; 0 (the default) = none
+  unsigned int m_iMaxPrepare;
   unsigned int m_iNodeBudget;
+  ///0 = no limit
+  std::size_t m_iByteBudget;
+  std::function<std::size_t()> m_fBytesUsed;
 };
 
-///limits expansion to a few nodes (per instance i.e. per frame)
+///limits expansion to a few nodes (per instance i.e. per frame),
+///and prepares (see CDasherNode::PrepareChildren) as many again, the next best
 ///(collapsing is at present unlimited, have to test this...)
 class AmortizedPolicy : public BudgettingPolicy
 {
 public:
   AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget);
 	AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget, unsigned int iMaxExpands);
+  ///As BudgettingPolicy, with a byte budget too
+  AmortizedPolicy(CDasherModel *pModel, unsigned int iNodeBudget, std::size_t iByteBudget, const std::function<std::size_t()> &fBytesUsed);
   ~AmortizedPolicy() override = default;
   bool apply() override;
   double pushNode(CDasherNode *pNode, int iMin, int iMax, bool bExpand, double dParentCost) override;
 private:
 	unsigned int m_iMaxExpands;
-  void trim();
+  ///Discard all but the iKeep most beneficial nodes in sExpand
+  void trim(unsigned int iKeep);
 };
 }
 #endif /*defined __ExpansionPolicy_h__*/
@@ -0,0 +1,199 @@
+// FrozenPPMLanguageModel.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../../Common/Common.h"
+#include "FrozenPPMLanguageModel.h"
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CFrozenPPMLanguageModel::CFrozenPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms, int iMaxOrder)
+: CLanguageModel(iNumSyms), CSettingsUser(pCreator),
+  m_iMaxOrder(iMaxOrder<0 ? GetLongParameter(LP_LM_MAX_ORDER) : iMaxOrder),
+  m_bUpdateExclusion(GetLongParameter(LP_LM_UPDATE_EXCLUSION)!=0), m_ContextAlloc(1024), m_iNumContexts(0) {
+  SPPMSnapshotNode root;
+  root.iFirstChild = 0;
+  root.iVine = CPPMSnapshot::NO_NODE;
+  root.iSymbol = -1;
+  root.iCount = 1;
+  root.iNumChildren = 0;
+  m_vNodes.push_back(root);
+  m_pNodes = &m_vNodes[0];
+  m_iNumNodes = 1;
+}
+
+CFrozenPPMLanguageModel::CFrozenPPMLanguageModel(CSettingsUser *pCreator, const CPPMLanguageModel *pModel)
+: CLanguageModel(pModel->GetSize()-1), CSettingsUser(pCreator), m_iMaxOrder(pModel->GetMaxOrder()),
+  m_bUpdateExclusion(pModel->GetUpdateExclusion()), m_ContextAlloc(1024), m_iNumContexts(0) {
+  pModel->Flatten(m_vNodes);
+  m_pNodes = &m_vNodes[0];
+  m_iNumNodes = m_vNodes.size();
+}
+
+CFrozenPPMLanguageModel::CFrozenPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms, int iMaxOrder, std::vector<SPPMSnapshotNode> &vNodes)
+: CLanguageModel(iNumSyms), CSettingsUser(pCreator), m_iMaxOrder(iMaxOrder),
+  m_bUpdateExclusion(GetLongParameter(LP_LM_UPDATE_EXCLUSION)!=0), m_ContextAlloc(1024), m_iNumContexts(0) {
+  DASHER_ASSERT(!vNodes.empty() && vNodes[0].iVine == CPPMSnapshot::NO_NODE);
+  m_vNodes.swap(vNodes);
+  m_pNodes = &m_vNodes[0];
+  m_iNumNodes = m_vNodes.size();
+}
+
+CLanguageModel::Context CFrozenPPMLanguageModel::CreateEmptyContext() {
+  SContext *pCont = m_ContextAlloc.Alloc();
+  pCont->iNode = 0;
+  pCont->iOrder = 0;
+  m_iNumContexts++;
+  return (Context) pCont;
+}
+
+CLanguageModel::Context CFrozenPPMLanguageModel::CloneContext(Context context) {
+  SContext *pCont = m_ContextAlloc.Alloc();
+  *pCont = *(SContext *) context;
+  m_iNumContexts++;
+  return (Context) pCont;
+}
+
+void CFrozenPPMLanguageModel::ReleaseContext(Context context) {
+  m_ContextAlloc.Free((SContext *) context);
+  m_iNumContexts--;
+}
+
+void CFrozenPPMLanguageModel::EnterSymbol(Context c, int Symbol) {
+  if (Symbol==0)
+    return;
+
+  DASHER_ASSERT(Symbol >= 0 && Symbol < GetSize());
+
+  SContext &context(*(SContext *) c);
+
+  while (context.iNode != CPPMSnapshot::NO_NODE) {
+    if (context.iOrder < m_iMaxOrder) {
+      uint32 iFound = CPPMSnapshot::FindChild(m_pNodes, context.iNode, Symbol);
+      if (iFound != CPPMSnapshot::NO_NODE) {
+        context.iOrder++;
+        context.iNode = iFound;
+        return;
+      }
+    }
+    // If we can't extend the current context, follow vine pointer to shorten it and try again
+    context.iOrder--;
+    context.iNode = m_pNodes[context.iNode].iVine;
+  }
+  context.iNode = 0;
+  context.iOrder = 0;
+}
+
+void CFrozenPPMLanguageModel::GetProbs(Context context, std::vector<unsigned int> &probs, int norm, int iUniform) const {
+  ComputeProbs(((const SContext *) context)->iNode, probs, norm, iUniform,
+               GetLongParameter(LP_LM_ALPHA), GetLongParameter(LP_LM_BETA));
+}
+
+bool CFrozenPPMLanguageModel::GetProbsForKey(size_t iKey, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta) const {
+  ComputeProbs(static_cast<uint32>(iKey - 1), probs, norm, iUniform, alpha, beta);
+  return true;
+}
+
+void CFrozenPPMLanguageModel::ComputeProbs(uint32 iHead, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta) const {
+  const int iNumSymbols = GetSize();
+  probs.resize(iNumSymbols);
+
+  unsigned int iToSpend = norm;
+  unsigned int iUniformLeft = iUniform;
+
+  probs[0] = 0;
+  for (int i = 1; i < iNumSymbols; i++) {
+    probs[i] = iUniformLeft / (iNumSymbols - i);
+    iUniformLeft -= probs[i];
+    iToSpend -= probs[i];
+  }
+  DASHER_ASSERT(iUniformLeft == 0);
+
+  //As CPPMLanguageModel::GetProbs, but children are contiguous records.
+  for (uint32 iNode = iHead; iNode != CPPMSnapshot::NO_NODE; iNode = m_pNodes[iNode].iVine) {
+    const SPPMSnapshotNode *pChild = m_pNodes + m_pNodes[iNode].iFirstChild,
+      *const pEnd = pChild + m_pNodes[iNode].iNumChildren;
+    int iTotal = 0;
+    for (const SPPMSnapshotNode *p = pChild; p != pEnd; p++)
+      iTotal += p->iCount;
+    if (iTotal) {
+      const unsigned int size_of_slice = iToSpend;
+      for (; pChild != pEnd; pChild++) {
+        unsigned int p = static_cast < myint > (size_of_slice) * (100 * pChild->iCount - beta) / (100 * iTotal + alpha);
+        probs[pChild->iSymbol] += p;
+        iToSpend -= p;
+      }
+    }
+  }
+
+  const unsigned int size_of_slice = iToSpend;
+  const int symbolsleft = iNumSymbols - 1;
+  for (int i = 1; i < iNumSymbols; i++) {
+    unsigned int p = size_of_slice / symbolsleft;
+    probs[i] += p;
+    iToSpend -= p;
+  }
+
+  int iLeft = iNumSymbols-1;
+  for (int i = 1; i < iNumSymbols; i++) {
+    unsigned int p = iToSpend / iLeft;
+    probs[i] += p;
+    --iLeft;
+    iToSpend -= p;
+  }
+
+  DASHER_ASSERT(iToSpend == 0);
+}
+
+bool CFrozenPPMLanguageModel::ReadFromFile(std::string strFilename) {
+  if (!m_snapshot.Open(strFilename, GetSize())) return false;
+  m_iMaxOrder = m_snapshot.Header().iMaxOrder;
+  m_bUpdateExclusion = m_snapshot.Header().iUpdateExclusion != 0;
+  m_pNodes = m_snapshot.Nodes();
+  m_iNumNodes = m_snapshot.NumNodes();
+  std::vector<SPPMSnapshotNode>().swap(m_vNodes);
+  return true;
+}
+
+bool CFrozenPPMLanguageModel::WriteToString(std::string &strData, const std::string &strName) {
+  if (strName.length() > 0xFFFF - sizeof(SLMFileHeader)) return false;
+  SPPMSnapshotHeader header;
+  header.iByteOrder = CPPMSnapshot::BYTE_ORDER_MARK;
+  header.iNumNodes = m_iNumNodes;
+  header.iMaxOrder = m_iMaxOrder;
+  header.iUpdateExclusion = m_bUpdateExclusion ? 1 : 0;
+  header.iReserved = 0;
+  CPPMSnapshot::Serialize(strData, GetSize(), strName, header, m_pNodes);
+  return true;
+}
+
+bool CFrozenPPMLanguageModel::WriteToFile(std::string strFilename) {
+  std::string strData;
+  return WriteToString(strData, "") && CPPMSnapshot::WriteFile(strFilename, strData);
+}
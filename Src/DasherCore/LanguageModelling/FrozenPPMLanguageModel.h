@@ -0,0 +1,116 @@
+// FrozenPPMLanguageModel.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __FrozenPPMLanguageModel_h__
+#define __FrozenPPMLanguageModel_h__
+
+#include "../../Common/NoClones.h"
+#include "../../Common/Allocators/PooledAlloc.h"
+
+#include "LanguageModel.h"
+#include "PPMLanguageModel.h"
+#include "PPMSnapshot.h"
+#include "../SettingsStore.h"
+
+#include <vector>
+
+namespace Dasher {
+
+  ///
+  /// \ingroup LM
+  /// @{
+
+  /// Read-only PPM model: the trie of a trained CPPMLanguageModel, stored
+  /// contiguously in breadth-first order as SPPMSnapshotNodes (16 bytes each, with
+  /// 32-bit indices for vine and children, and children sorted by symbol) rather
+  /// than as individually allocated CPPMnodes. Predictions are identical to those of
+  /// the model it was made from, but use much less memory and have better locality.
+  /// The records may also be used directly from a (mapped) snapshot file; see ReadFromFile.
+  ///
+  /// LearnSymbol only moves the context on (as EnterSymbol); the model never changes.
+  class CFrozenPPMLanguageModel : public CLanguageModel, protected CSettingsUser, private NoClones {
+  public:
+    /// Make an empty model (i.e. just a root), ready for ReadFromFile.
+    /// \param iMaxOrder as CAbstractPPM; anything <0 means use LP_LM_MAX_ORDER.
+    CFrozenPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms, int iMaxOrder=-1);
+    /// Freeze the current state of a trained model; later changes to it are not seen.
+    CFrozenPPMLanguageModel(CSettingsUser *pCreator, const CPPMLanguageModel *pModel);
+    /// Use records already laid out as by CPPMLanguageModel::Flatten; takes them
+    /// over, leaving vNodes empty.
+    CFrozenPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms, int iMaxOrder, std::vector<SPPMSnapshotNode> &vNodes);
+
+    Context CreateEmptyContext();
+    Context CloneContext(Context context);
+    void ReleaseContext(Context context);
+    size_t ContextBytes() const {return m_iNumContexts * sizeof(SContext);}
+    void EnterSymbol(Context context, int Symbol);
+    ///Does not learn - just calls EnterSymbol.
+    void LearnSymbol(Context context, int Symbol) {EnterSymbol(context, Symbol);}
+
+    /// As CPPMLanguageModel::GetProbs
+    void GetProbs(Context context, std::vector<unsigned int> &Probs, int norm, int iUniform) const;
+    /// Index (plus one) of the record at the head of the context
+    size_t ContextKey(Context context) const {return ((const SContext *) context)->iNode + 1;}
+    /// Never changes, so no key does
+    void GetKeysChangedByLearning(Context context, int Symbol, std::vector<size_t> &vKeys) const {vKeys.clear();}
+    /// Needs nothing but the records, so is safe to call concurrently.
+    bool GetProbsForKey(size_t iKey, std::vector<unsigned int> &Probs, int norm, int iUniform, int alpha, int beta) const;
+
+    /// Map a snapshot (as written by CPPMLanguageModel::WriteToFile), and use its
+    /// records in place. Must be called before any contexts are created.
+    bool ReadFromFile(std::string strFilename);
+    bool WriteToFile(std::string strFilename);
+    bool WriteToString(std::string &strData, const std::string &strName);
+
+    /// Number of nodes in the trie (inc. root)
+    uint32 GetNumNodes() const {return m_iNumNodes;}
+    /// The records themselves: root first, then breadth-first (see CPPMSnapshot)
+    const SPPMSnapshotNode *GetNodes() const {return m_pNodes;}
+    int GetMaxOrder() const {return m_iMaxOrder;}
+    bool GetUpdateExclusion() const {return m_bUpdateExclusion;}
+
+    /// What a Context points to: the index of the record for the longest suffix
+    /// of the symbols entered which is in the trie, and that suffix's length.
+    struct SContext {
+      uint32 iNode;
+      int iOrder;
+    };
+
+  protected:
+    /// Records of the trie; either m_vNodes or in m_snapshot.
+    const SPPMSnapshotNode *m_pNodes;
+    uint32 m_iNumNodes;
+
+  private:
+    ///Body of GetProbs, for the context with head record iHead
+    void ComputeProbs(uint32 iHead, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta) const;
+    int m_iMaxOrder;
+    bool m_bUpdateExclusion;
+    std::vector<SPPMSnapshotNode> m_vNodes;
+    CPPMSnapshot m_snapshot;
+    CPooledAlloc<SContext> m_ContextAlloc;
+    ///Number of contexts outstanding
+    int m_iNumContexts;
+  };
+
+  /// @}
+}
+
+#endif // __FrozenPPMLanguageModel_h__
@@ -13,6 +13,7 @@
 
 
 #include <vector>
+#include <string>
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -87,6 +88,15 @@ public:
 
   virtual void LearnSymbol(Context context, int Symbol) = 0;
 
+  ///
+  /// Memory taken by the contexts currently outstanding, in bytes
+  /// (0 if the model doesn't know)
+  ///
+
+  virtual size_t ContextBytes() const {
+    return 0;
+  }
+
   /// @}
 
   /// @name Prediction
@@ -99,6 +109,41 @@ public:
 
   virtual void GetProbs(Context Context, std::vector < unsigned int >&Probs, int iNorm, int iUniform) const = 0;
 
+  ///
+  /// Identify contexts for which GetProbs would give the same distribution:
+  /// two with the same nonzero key do, until the model next learns something
+  /// affecting them (see GetKeysChangedByLearning).
+  /// (0 means no such guarantee; the default for all contexts.)
+  ///
+
+  virtual size_t ContextKey(Context context) const {
+    return 0;
+  }
+
+  ///
+  /// Of the given keys (see ContextKey), keep only those for which
+  /// LearnSymbol(context, Symbol), if called next, may change what GetProbs
+  /// gives (or which may then identify some other context); any others may
+  /// still be relied on afterwards. The default keeps them all.
+  ///
+
+  virtual void GetKeysChangedByLearning(Context context, int Symbol, std::vector<size_t> &vKeys) const {
+  }
+
+  ///
+  /// As GetProbs, for any context with the given (nonzero) key; but safe to call
+  /// from several threads at once, and concurrently with GetProbs and the context
+  /// manipulation functions - though not with LearnSymbol, or anything else
+  /// changing the model. Models giving nonzero keys should implement this;
+  /// returns false if not implemented.
+  /// \param iAlpha, iBeta values of LP_LM_ALPHA and LP_LM_BETA to use (for models
+  /// with such parameters), as settings may not be read from other threads
+  ///
+
+  virtual bool GetProbsForKey(size_t iKey, std::vector < unsigned int >&Probs, int iNorm, int iUniform, int iAlpha, int iBeta) const {
+    return false;
+  }
+
   /// @}
 
   /// @name Persistant storage
@@ -113,6 +158,16 @@ public:
     return false;
   };
 
+  ///
+  /// Write the same binary representation as WriteToFile, but into a string
+  /// (e.g. to pass to CFileUtils::WriteUserDataFile).
+  /// \param strName stored in the header in place of the alphabet name
+  ///
+
+  virtual bool WriteToString(std::string &strData, const std::string &strName) {
+    return false;
+  };
+
   /// @}
 
   ///
@@ -123,7 +178,7 @@ public:
     return 5;
   };
 
- protected:
+  ///Generic header at the start of a language model file
   struct SLMFileHeader {
     // Magic number ("%DLF" in ASCII)
     char szMagic[4];
@@ -148,6 +203,7 @@ public:
     return m_iNumSyms+1;
   }
 
+ protected:
   const int m_iNumSyms;
 
 };
@@ -0,0 +1,289 @@
+// LayeredPPMLanguageModel.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../../Common/Common.h"
+#include "LayeredPPMLanguageModel.h"
+
+#include <algorithm>
+
+using namespace Dasher;
+using namespace std;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CLayeredPPMLanguageModel::CLayeredPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms)
+: CLanguageModel(iNumSyms), CSettingsUser(pCreator), m_Contexts(1024), m_iNumContexts(0) {
+  m_pOverlay = new CPPMLanguageModel(this, iNumSyms);
+  m_pBase = new CFrozenPPMLanguageModel(this, iNumSyms, m_pOverlay->GetMaxOrder());
+}
+
+CLayeredPPMLanguageModel::~CLayeredPPMLanguageModel() {
+  delete m_pOverlay;
+  delete m_pBase;
+}
+
+CLanguageModel::Context CLayeredPPMLanguageModel::CreateEmptyContext() {
+  Context cont = m_Contexts.Alloc();
+  SContext &context(m_Contexts.Get(cont));
+  context.base.iNode = 0;
+  context.base.iOrder = 0;
+  context.overlay = m_pOverlay->CreateEmptyContext();
+  m_iNumContexts++;
+  return cont;
+}
+
+CLanguageModel::Context CLayeredPPMLanguageModel::CloneContext(Context copy) {
+  Context cont = m_Contexts.Alloc();
+  SContext &context(m_Contexts.Get(cont));
+  context.base = m_Contexts.Get(copy).base;
+  context.overlay = m_pOverlay->CloneContext(m_Contexts.Get(copy).overlay);
+  m_iNumContexts++;
+  return cont;
+}
+
+void CLayeredPPMLanguageModel::ReleaseContext(Context context) {
+  m_pOverlay->ReleaseContext(m_Contexts.Get(context).overlay);
+  m_Contexts.Free(context);
+  m_iNumContexts--;
+}
+
+void CLayeredPPMLanguageModel::EnterSymbol(Context c, int Symbol) {
+  SContext &context(m_Contexts.Get(c));
+  m_pBase->EnterSymbol((Context) &context.base, Symbol);
+  m_pOverlay->EnterSymbol(context.overlay, Symbol);
+}
+
+void CLayeredPPMLanguageModel::LearnSymbol(Context c, int Symbol) {
+  SContext &context(m_Contexts.Get(c));
+  m_pBase->EnterSymbol((Context) &context.base, Symbol);
+  m_pOverlay->LearnSymbol(context.overlay, Symbol);
+}
+
+void CLayeredPPMLanguageModel::GetProbs(Context context, std::vector<unsigned int> &probs, int norm, int iUniform) const {
+  const SContext *pContext = &m_Contexts.Get(context);
+  const SPPMSnapshotNode *const pNodes = m_pBase->GetNodes();
+
+  const int iNumSymbols = GetSize();
+  probs.resize(iNumSymbols);
+
+  unsigned int iToSpend = norm;
+  unsigned int iUniformLeft = iUniform;
+
+  probs[0] = 0;
+  for (int i = 1; i < iNumSymbols; i++) {
+    probs[i] = iUniformLeft / (iNumSymbols - i);
+    iUniformLeft -= probs[i];
+    iToSpend -= probs[i];
+  }
+  DASHER_ASSERT(iUniformLeft == 0);
+
+  const int alpha = GetLongParameter( LP_LM_ALPHA );
+  const int beta = GetLongParameter( LP_LM_BETA );
+
+  //Each context is the longest suffix present in its own trie, and vines shorten
+  // it by one symbol at a time; so, starting from the longer, both are at the
+  // same suffix once the order comes down to that of the shorter.
+  uint32 iBase = pContext->base.iNode;
+  const int iBaseOrder = pContext->base.iOrder;
+  const CAbstractPPM::CPPMContext &overlay(m_pOverlay->GetContext(pContext->overlay));
+  CAbstractPPM::CPPMnode *pOverlay = overlay.head;
+  const int iOverlayOrder = overlay.order;
+  for (int iOrder = max(iBaseOrder, iOverlayOrder); iOrder >= 0; iOrder--) {
+    const SPPMSnapshotNode *pBase = pNodes, *pBaseEnd = pNodes;
+    if (iOrder <= iBaseOrder) {
+      pBase += pNodes[iBase].iFirstChild;
+      pBaseEnd = pBase + pNodes[iBase].iNumChildren;
+    }
+    CAbstractPPM::CPPMnode *const pOver = (iOrder <= iOverlayOrder) ? pOverlay : NULL;
+
+    int iTotal = 0;
+    for (const SPPMSnapshotNode *p = pBase; p != pBaseEnd; p++)
+      iTotal += p->iCount;
+    if (pOver)
+      for (CAbstractPPM::ChildIterator it = pOver->children(); it != pOver->end(); it++)
+        iTotal += (*it)->count;
+
+    if (iTotal) {
+      const unsigned int size_of_slice = iToSpend;
+      //symbols in the base, plus any overlay count for the same symbol...
+      for (const SPPMSnapshotNode *p = pBase; p != pBaseEnd; p++) {
+        int iCount = p->iCount;
+        if (pOver)
+          if (CAbstractPPM::CPPMnode *pFound = pOver->find_symbol(p->iSymbol))
+            iCount += pFound->count;
+        unsigned int iP = static_cast < myint > (size_of_slice) * (100 * iCount - beta) / (100 * iTotal + alpha);
+        probs[p->iSymbol] += iP;
+        iToSpend -= iP;
+      }
+      //...then symbols only in the overlay.
+      if (pOver)
+        for (CAbstractPPM::ChildIterator it = pOver->children(); it != pOver->end(); it++) {
+          if (pBase != pBaseEnd && CPPMSnapshot::FindChild(pNodes, iBase, (*it)->sym) != CPPMSnapshot::NO_NODE)
+            continue;
+          unsigned int iP = static_cast < myint > (size_of_slice) * (100 * (*it)->count - beta) / (100 * iTotal + alpha);
+          probs[(*it)->sym] += iP;
+          iToSpend -= iP;
+        }
+    }
+    if (iOrder <= iBaseOrder) iBase = pNodes[iBase].iVine;
+    if (pOver) pOverlay = pOverlay->vine;
+  }
+
+  const unsigned int size_of_slice = iToSpend;
+  const int symbolsleft = iNumSymbols - 1;
+  for (int i = 1; i < iNumSymbols; i++) {
+    unsigned int p = size_of_slice / symbolsleft;
+    probs[i] += p;
+    iToSpend -= p;
+  }
+
+  int iLeft = iNumSymbols-1;
+  for (int i = 1; i < iNumSymbols; i++) {
+    unsigned int p = iToSpend / iLeft;
+    probs[i] += p;
+    --iLeft;
+    iToSpend -= p;
+  }
+
+  DASHER_ASSERT(iToSpend == 0);
+}
+
+bool CLayeredPPMLanguageModel::OverlayEmpty() const {
+  return m_pOverlay->m_pRoot->children() == m_pOverlay->m_pRoot->end();
+}
+
+void CLayeredPPMLanguageModel::Merge(std::vector<SPPMSnapshotNode> &vNodes) const {
+  const SPPMSnapshotNode *const pBase = m_pBase->GetNodes();
+  //As CPPMLanguageModel::Flatten, breadth-first; each output node comes from a
+  // base record (or NO_NODE) and/or an overlay node (or NULL) for the same string.
+  std::vector<std::pair<uint32, CAbstractPPM::CPPMnode *> > vSrc;
+  vNodes.clear();
+  vNodes.reserve(m_pBase->GetNumNodes());
+
+  SPPMSnapshotNode rec;
+  rec.iFirstChild = 0;
+  rec.iVine = CPPMSnapshot::NO_NODE;
+  rec.iSymbol = pBase[0].iSymbol;
+  rec.iCount = pBase[0].iCount;
+  rec.iNumChildren = 0;
+  vNodes.push_back(rec);
+  vSrc.push_back(std::make_pair(uint32(0), m_pOverlay->m_pRoot));
+
+  std::vector<std::pair<symbol, CAbstractPPM::CPPMnode *> > vOverlay;
+  for (uint32 i = 0; i < vSrc.size(); i++) {
+    const uint32 iBase = vSrc[i].first;
+    vOverlay.clear();
+    if (CAbstractPPM::CPPMnode *pOver = vSrc[i].second)
+      for (CAbstractPPM::ChildIterator it = pOver->children(); it != pOver->end(); it++)
+        vOverlay.push_back(std::make_pair((*it)->sym, *it));
+    std::sort(vOverlay.begin(), vOverlay.end());
+
+    uint32 c = 0, e = 0;
+    if (iBase != CPPMSnapshot::NO_NODE) {
+      c = pBase[iBase].iFirstChild;
+      e = c + pBase[iBase].iNumChildren;
+    }
+    std::vector<std::pair<symbol, CAbstractPPM::CPPMnode *> >::const_iterator it = vOverlay.begin();
+    vNodes[i].iFirstChild = vNodes.size();
+    while (c < e || it != vOverlay.end()) {
+      //Both child lists are sorted by symbol, so merge them
+      uint32 iChild = CPPMSnapshot::NO_NODE;
+      CAbstractPPM::CPPMnode *pChild = NULL;
+      if (it == vOverlay.end() || (c < e && pBase[c].iSymbol <= it->first)) {
+        iChild = c++;
+        rec.iSymbol = pBase[iChild].iSymbol;
+      } else
+        rec.iSymbol = it->first;
+      if (it != vOverlay.end() && it->first == rec.iSymbol) pChild = (it++)->second;
+
+      unsigned int iCount = (iChild == CPPMSnapshot::NO_NODE ? 0 : pBase[iChild].iCount)
+        + (pChild ? pChild->count : 0);
+      rec.iCount = min(iCount, 0xFFFFu);
+      //The union of the tries is closed under suffixes too, so (as in Flatten)
+      // the vine is the same-symbol child of the parent's vine.
+      rec.iVine = (i == 0) ? 0 : CPPMSnapshot::FindChild(&vNodes[0], vNodes[i].iVine, rec.iSymbol);
+      DASHER_ASSERT(rec.iVine != CPPMSnapshot::NO_NODE);
+      vNodes.push_back(rec);
+      vSrc.push_back(std::make_pair(iChild, pChild));
+    }
+    vNodes[i].iNumChildren = vNodes.size() - vNodes[i].iFirstChild;
+  }
+}
+
+bool CLayeredPPMLanguageModel::Freeze() {
+  if (m_iNumContexts) return false;
+  //Nothing to do - and keep the base mapped, if it is
+  if (OverlayEmpty()) return true;
+  std::vector<SPPMSnapshotNode> vNodes;
+  Merge(vNodes);
+  CFrozenPPMLanguageModel *pNewBase = new CFrozenPPMLanguageModel(this, m_iNumSyms, m_pBase->GetMaxOrder(), vNodes);
+  delete m_pBase;
+  m_pBase = pNewBase;
+  delete m_pOverlay;
+  m_pOverlay = new CPPMLanguageModel(this, m_iNumSyms);
+  return true;
+}
+
+bool CLayeredPPMLanguageModel::ReadFromFile(std::string strFilename) {
+  if (m_iNumContexts || !OverlayEmpty()) return false;
+  CFrozenPPMLanguageModel *pNewBase = new CFrozenPPMLanguageModel(this, m_iNumSyms, m_pOverlay->GetMaxOrder());
+  //Order and update exclusion must match those with which the overlay learns
+  if (!pNewBase->ReadFromFile(strFilename) || pNewBase->GetMaxOrder() != m_pOverlay->GetMaxOrder()
+      || pNewBase->GetUpdateExclusion() != m_pOverlay->GetUpdateExclusion()) {
+    delete pNewBase;
+    return false;
+  }
+  delete m_pBase;
+  m_pBase = pNewBase;
+  return true;
+}
+
+bool CLayeredPPMLanguageModel::ReadOverlayFromFile(const std::string &strFilename) {
+  if (m_iNumContexts || !OverlayEmpty()) return false;
+  return m_pOverlay->ReadFromFile(strFilename);
+}
+
+bool CLayeredPPMLanguageModel::WriteToString(std::string &strData, const std::string &strName) {
+  if (strName.length() > 0xFFFF - sizeof(SLMFileHeader)) return false;
+  std::vector<SPPMSnapshotNode> vNodes;
+  Merge(vNodes);
+
+  SPPMSnapshotHeader header;
+  header.iByteOrder = CPPMSnapshot::BYTE_ORDER_MARK;
+  header.iNumNodes = vNodes.size();
+  header.iMaxOrder = m_pOverlay->GetMaxOrder();
+  header.iUpdateExclusion = m_pOverlay->GetUpdateExclusion() ? 1 : 0;
+  header.iReserved = 0;
+  CPPMSnapshot::Serialize(strData, GetSize(), strName, header, &vNodes[0]);
+  return true;
+}
+
+bool CLayeredPPMLanguageModel::WriteToFile(std::string strFilename) {
+  std::string strData;
+  return WriteToString(strData, "") && CPPMSnapshot::WriteFile(strFilename, strData);
+}
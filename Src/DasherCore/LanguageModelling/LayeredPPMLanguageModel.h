@@ -0,0 +1,115 @@
+// LayeredPPMLanguageModel.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __LayeredPPMLanguageModel_h__
+#define __LayeredPPMLanguageModel_h__
+
+#include "../../Common/NoClones.h"
+#include "../../Common/Allocators/ContextTable.h"
+
+#include "LanguageModel.h"
+#include "PPMLanguageModel.h"
+#include "FrozenPPMLanguageModel.h"
+#include "../SettingsStore.h"
+
+#include <vector>
+
+namespace Dasher {
+
+  ///
+  /// \ingroup LM
+  /// @{
+
+  /// PPM model in two layers: an immutable base (a CFrozenPPMLanguageModel, which
+  /// may be mapped straight from a snapshot file) and a small adaptive overlay (an
+  /// ordinary CPPMLanguageModel) into which everything learnt goes. The two tries
+  /// are navigated side by side, and GetProbs adds together the counts of each
+  /// symbol at each order (see Merge) - so the base never needs to be
+  /// pointer-based or writable. Without update exclusion, this gives exactly the
+  /// counts of learning both into a single trie; with it (LP_LM_UPDATE_EXCLUSION,
+  /// the default), learning into the overlay excludes only on the overlay's own
+  /// counts, not the base's, so predictions differ slightly from a single trie's.
+  ///
+  /// CNodeCreationManager (via CLayeredTrainer) learns system text first and then
+  /// Freeze()s it into the base, so the overlay holds just what was learnt from the
+  /// user. CTrainingCache then keeps the base (ReadFromFile / WriteToString, with
+  /// the overlay empty) apart from the overlay (Read/WriteOverlay...), so the
+  /// latter can be saved cheaply on its own.
+  class CLayeredPPMLanguageModel : public CLanguageModel, protected CSettingsUser, private NoClones {
+  public:
+    /// Makes an empty model, i.e. both base and overlay just roots.
+    CLayeredPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms);
+    ~CLayeredPPMLanguageModel();
+
+    Context CreateEmptyContext();
+    Context CloneContext(Context context);
+    void ReleaseContext(Context context);
+    /// Inc. the contexts of the overlay which ours hold
+    size_t ContextBytes() const {return m_Contexts.LiveBytes() + m_pOverlay->ContextBytes();}
+    void EnterSymbol(Context context, int Symbol);
+    /// Learns into the overlay only; the base is just navigated.
+    void LearnSymbol(Context context, int Symbol);
+
+    /// As CPPMLanguageModel::GetProbs, with the counts of base and overlay summed.
+    void GetProbs(Context context, std::vector<unsigned int> &Probs, int norm, int iUniform) const;
+
+    /// Use a snapshot (e.g. as written by WriteToFile) as the base, mapped in place.
+    /// Only possible before anything has been learnt (or any contexts created).
+    bool ReadFromFile(std::string strFilename);
+    /// Write base and overlay merged into a single snapshot.
+    bool WriteToFile(std::string strFilename);
+    bool WriteToString(std::string &strData, const std::string &strName);
+
+    /// Save just what has been learnt in the overlay (a CPPMLanguageModel snapshot).
+    bool WriteOverlayToString(std::string &strData, const std::string &strName) {return m_pOverlay->WriteToString(strData, strName);}
+    /// Restore an overlay saved by WriteOverlayToString; as ReadFromFile, only
+    /// possible before anything has been learnt.
+    bool ReadOverlayFromFile(const std::string &strFilename);
+
+    /// Move everything learnt so far into the base, as a new frozen trie made by
+    /// Merge, leaving the overlay empty. Predictions are unchanged. Only possible
+    /// when there are no contexts outstanding (these point into the old tries).
+    /// \return false if there were contexts outstanding.
+    bool Freeze();
+
+    const CFrozenPPMLanguageModel *GetBase() const {return m_pBase;}
+
+  private:
+    struct SContext {
+      CFrozenPPMLanguageModel::SContext base;
+      ///Handle of a context of m_pOverlay
+      Context overlay;
+    };
+    /// Lay out the union of the two tries as snapshot records, with each node's
+    /// count the sum of its counts in base and overlay.
+    void Merge(std::vector<SPPMSnapshotNode> &vNodes) const;
+    /// Whether nothing has been learnt into the overlay
+    bool OverlayEmpty() const;
+
+    CFrozenPPMLanguageModel *m_pBase;
+    CPPMLanguageModel *m_pOverlay;
+    CContextTable<SContext> m_Contexts;
+    int m_iNumContexts;
+  };
+
+  /// @}
+}
+
+#endif // __LayeredPPMLanguageModel_h__
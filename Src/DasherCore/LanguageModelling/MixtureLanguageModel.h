@@ -12,6 +12,7 @@
 #include "LanguageModel.h"
 #include "PPMLanguageModel.h"
 #include "DictLanguageModel.h"
+#include "../../Common/Allocators/ContextTable.h"
 
 //#include <iostream>
 #include <vector>
@@ -29,12 +30,10 @@ namespace Dasher {
     /////////////////////////////////////////////////////////////////////////////
 
     CMixtureLanguageModel(CSettingsUser *pCreator, const CAlphInfo *pAlph, const CAlphabetMap *pAlphMap)
-    : CLanguageModel(pAlph->iEnd-1), CSettingsUser(pCreator) {
+    : CLanguageModel(pAlph->iEnd-1), CSettingsUser(pCreator), m_Contexts(1024) {
 
       //      std::cout << m_pAlphabet << std::endl;
 
-      NextContext = 0;
-
       lma = new CPPMLanguageModel(this, m_iNumSyms);
       lmb = new CDictLanguageModel(this, pAlph, pAlphMap);
 
@@ -62,15 +61,15 @@ namespace Dasher {
 
     // Update context with a character - only modifies context
     virtual void EnterSymbol(CLanguageModel::Context context, int Symbol) {
-      lma->EnterSymbol(ContextMap.find(context)->second->GetContextA(), Symbol);
-      lmb->EnterSymbol(ContextMap.find(context)->second->GetContextB(), Symbol);
+      lma->EnterSymbol(m_Contexts.Get(context).ca, Symbol);
+      lmb->EnterSymbol(m_Contexts.Get(context).cb, Symbol);
     };
 
     // Add character to the language model at the current context and update the context 
     // - modifies both the context and the LanguageModel
     virtual void LearnSymbol(CLanguageModel::Context context, int Symbol) {
-      lma->LearnSymbol(ContextMap[context]->GetContextA(), Symbol);
-      lmb->LearnSymbol(ContextMap[context]->GetContextB(), Symbol);
+      lma->LearnSymbol(m_Contexts.Get(context).ca, Symbol);
+      lmb->LearnSymbol(m_Contexts.Get(context).cb, Symbol);
     };
 
     /////////////////////////////////////////////////////////////////////////////
@@ -91,8 +90,8 @@ namespace Dasher {
       int iNormB(iNorm - iNormA);
       
       // TODO: Fix uniform here
-        lma->GetProbs(ContextMap.find(context)->second->GetContextA(), ProbsA, iNormA, 0);
-        lmb->GetProbs(ContextMap.find(context)->second->GetContextB(), ProbsB, iNormB, 0);
+        lma->GetProbs(m_Contexts.Get(context).ca, ProbsA, iNormA, 0);
+        lmb->GetProbs(m_Contexts.Get(context).cb, ProbsB, iNormB, 0);
 
       for(int i(1); i < iNumSymbols; i++) {
         Probs[i] = ProbsA[i] + ProbsB[i];
@@ -102,40 +101,13 @@ namespace Dasher {
     CLanguageModel * lma;
     CLanguageModel *lmb;
 
-    class CMixtureContext {
-    public:
-      CMixtureContext(CLanguageModel * _lma, CLanguageModel * _lmb):lma(_lma), lmb(_lmb) {
-        ca = lma->CreateEmptyContext();
-        cb = lmb->CreateEmptyContext();
-      };
-
-    CMixtureContext(CLanguageModel * _lma, CLanguageModel * _lmb, CLanguageModel::Context _ca, CLanguageModel::Context _cb):lma(_lma), lmb(_lmb), ca(_ca), cb(_cb) {
-      };
-
-      ~CMixtureContext() {
-        lma->ReleaseContext(ca);
-        lmb->ReleaseContext(cb);
-      };
-
-      CLanguageModel::Context GetContextA() {
-        return ca;
-      }
-
-      CLanguageModel::Context GetContextB() {
-        return cb;
-      }
-
-    private:
-      CLanguageModel * lma;
-      CLanguageModel *lmb;
-
+    /// A context in each of the two models
+    struct SMixtureContext {
       CLanguageModel::Context ca;
       CLanguageModel::Context cb;
     };
 
-    int NextContext;
-
-    std::map < int, CMixtureContext * >ContextMap;
+    CContextTable < SMixtureContext > m_Contexts;
 
   };
   /// \}
@@ -143,29 +115,27 @@ namespace Dasher {
 ///////////////////////////////////////////////////////////////////
 
   inline CLanguageModel::Context CMixtureLanguageModel::CreateEmptyContext() {
-    CMixtureContext *pCont = new CMixtureContext(lma, lmb);
-    ContextMap[NextContext] = pCont;
-    ++NextContext;
-    return NextContext - 1;
+    CLanguageModel::Context cont = m_Contexts.Alloc();
+    m_Contexts.Get(cont).ca = lma->CreateEmptyContext();
+    m_Contexts.Get(cont).cb = lmb->CreateEmptyContext();
+    return cont;
   }
 
 ///////////////////////////////////////////////////////////////////
 
   inline CLanguageModel::Context CMixtureLanguageModel::CloneContext(CLanguageModel::Context Copy) {
-    CMixtureContext *pCopy = ContextMap[Copy];
-    CMixtureContext *pCont = new CMixtureContext(lma, lmb, lma->CloneContext(pCopy->GetContextA()), lmb->CloneContext(pCopy->GetContextB()));
-
-    ContextMap[NextContext] = pCont;
-    ++NextContext;
-    return NextContext - 1;
+    CLanguageModel::Context cont = m_Contexts.Alloc();
+    m_Contexts.Get(cont).ca = lma->CloneContext(m_Contexts.Get(Copy).ca);
+    m_Contexts.Get(cont).cb = lmb->CloneContext(m_Contexts.Get(Copy).cb);
+    return cont;
   }
 
 ///////////////////////////////////////////////////////////////////
 
   inline void CMixtureLanguageModel::ReleaseContext(CLanguageModel::Context release) {
-    // m_ContextAlloc.Free( (CMixtureContext*) release );
-    delete ContextMap[release];
-    ContextMap[release] = NULL;
+    lma->ReleaseContext(m_Contexts.Get(release).ca);
+    lmb->ReleaseContext(m_Contexts.Get(release).cb);
+    m_Contexts.Free(release);
   }
 }
 
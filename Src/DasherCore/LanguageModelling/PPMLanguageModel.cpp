@@ -14,6 +14,10 @@
 #include <stack>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 using namespace Dasher;
 using namespace std;
@@ -30,116 +34,162 @@ static char THIS_FILE[] = __FILE__;
 
 /////////////////////////////////////////////////////////////////////
 
-CAbstractPPM::CAbstractPPM(CSettingsUser *pCreator, int iNumSyms, CPPMnode *pRoot, int iMaxOrder)
-: CLanguageModel(iNumSyms), CSettingsUser(pCreator), m_pRoot(pRoot), m_iMaxOrder(iMaxOrder<0 ? GetLongParameter(LP_LM_MAX_ORDER) : iMaxOrder), bUpdateExclusion( GetLongParameter(LP_LM_UPDATE_EXCLUSION)!=0 ), m_ContextAlloc(1024) {
-  m_pRootContext = m_ContextAlloc.Alloc();
+CAbstractPPM::CAbstractPPM(CSettingsUser *pCreator, int iNumSyms, CPPMnode *pRoot, int iMaxOrder, int iUpdateExclusion)
+: CLanguageModel(iNumSyms), CSettingsUser(pCreator), m_pRoot(pRoot), m_iMaxOrder(iMaxOrder<0 ? GetLongParameter(LP_LM_MAX_ORDER) : iMaxOrder),
+  bUpdateExclusion( (iUpdateExclusion<0 ? GetLongParameter(LP_LM_UPDATE_EXCLUSION) : iUpdateExclusion)!=0 ), m_Contexts(1024) {
+  m_pRootContext = &m_Contexts.Get(m_Contexts.Alloc());
   m_pRootContext->head = m_pRoot;
   m_pRootContext->order = 0;
 }
 
 bool CAbstractPPM::isValidContext(const Context context) const {
-  return m_setContexts.count((const CPPMContext *)context) > 0;
+  return m_Contexts.IsValid(context);
 }
 
 /////////////////////////////////////////////////////////////////////
 // Get the probability distribution at the context
 
 void CPPMLanguageModel::GetProbs(Context context, std::vector<unsigned int> &probs, int norm, int iUniform) const {
-  const CPPMContext *ppmcontext = (const CPPMContext *)(context);
+  const CPPMContext *ppmcontext = &GetContext(context);
 
-  DASHER_ASSERT(isValidContext(context));
-
-  int iNumSymbols = GetSize();
-  
-  probs.resize(iNumSymbols);
-
-  std::vector < bool > exclusions(iNumSymbols);
-  
-  unsigned int iToSpend = norm;
-  unsigned int iUniformLeft = iUniform;
-
-  // TODO: Sort out zero symbol case
-  probs[0] = 0;
-  exclusions[0] = false;
-
-  for (int i = 1; i < iNumSymbols; i++) {
-    probs[i] = iUniformLeft / (iNumSymbols - i);
-    iUniformLeft -= probs[i];
-    iToSpend -= probs[i];
-    exclusions[i] = false;
-  }
+  int alpha = GetLongParameter( LP_LM_ALPHA );
+  int beta = GetLongParameter( LP_LM_BETA );
 
-  DASHER_ASSERT(iUniformLeft == 0);
+  if (m_ProbCache.Lookup(ppmcontext->head, norm, iUniform, alpha, beta, probs))
+    return;
 
-  //  bool doExclusion = GetLongParameter( LP_LM_ALPHA );
-  bool doExclusion = 0; //FIXME
+  m_vChain.clear();
+  ComputeProbs(ppmcontext->head, probs, norm, iUniform, alpha, beta, &m_vChain, m_vSyms, m_vShares);
+  m_ProbCache.Store(ppmcontext->head, norm, iUniform, alpha, beta, m_vChain, probs);
+}
 
-  int alpha = GetLongParameter( LP_LM_ALPHA );
-  int beta = GetLongParameter( LP_LM_BETA );
+bool CPPMLanguageModel::GetProbsForKey(size_t iKey, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta) const {
+  //Nothing shared is written: no cache, and our own scratch buffers
+  std::vector<symbol> vSyms;
+  std::vector<unsigned int> vShares;
+  ComputeProbs(reinterpret_cast<const CPPMnode *>(iKey), probs, norm, iUniform, alpha, beta, NULL, vSyms, vShares);
+  return true;
+}
 
-  for (CPPMnode *pTemp = ppmcontext->head; pTemp; pTemp=pTemp->vine) {
-    int iTotal = 0;
+void CPPMLanguageModel::ComputeProbs(const CPPMnode *pHead, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta,
+                                     std::vector<const void *> *pvChain, std::vector<symbol> &vSyms, std::vector<unsigned int> &vShares) const {
+  int iNumSymbols = GetSize();
 
+  probs.resize(iNumSymbols);
+  probs[0] = 0;
+  if (iNumSymbols == 1) return;
+
+  // This computes exactly what the original, more obvious, version did, i.e.:
+  //  (1) spread iUniform over symbols 1..N-1, each getting iUniformLeft / (symbols left);
+  //  (2) working down the vine chain, give each child of each node a share
+  //      size_of_slice * (100*count - beta) / (100*total + alpha) of what's left;
+  //  (3) spread what's left of that equally over 1..N-1, by (iToSpend / (N-1));
+  //  (4) spread the remainder as in (1).
+  // But (1) and (4) put floor(X/(N-1)) on each symbol and one more on the last
+  // X % (N-1) symbols, so all but (2) is a constant with at most two steps in it;
+  // hence we gather the children of each node into contiguous (reused) buffers
+  // first, fill in the constant part, and add the shares from (2) last.
+  // (Exclusion, i.e. only counting each symbol at the highest order it
+  // occurs, was never enabled, so has gone.)
+  const unsigned int iSyms = iNumSymbols - 1;
+  unsigned int iToSpend = norm - iUniform;
+
+  vSyms.clear();
+  vShares.clear();
+  for (const CPPMnode *pTemp = pHead; pTemp; pTemp=pTemp->vine) {
+    if (pvChain) pvChain->push_back(pTemp);
+    const std::size_t iFirst = vSyms.size();
     for (ChildIterator pSymbol = pTemp->children(); pSymbol != pTemp->end(); pSymbol++) {
-      symbol sym = (*pSymbol)->sym;
-      if(!(exclusions[sym] && doExclusion))
-        iTotal += (*pSymbol)->count;
+      vSyms.push_back((*pSymbol)->sym);
+      vShares.push_back((*pSymbol)->count);
     }
+    const std::size_t iEnd = vSyms.size();
+    unsigned int *const pShares = vShares.empty() ? NULL : &vShares[0];
 
-    if(iTotal) {
-      unsigned int size_of_slice = iToSpend;
-      for (ChildIterator pSymbol = pTemp->children(); pSymbol != pTemp->end(); pSymbol++) {
-        if(!(exclusions[(*pSymbol)->sym] && doExclusion)) {
-          exclusions[(*pSymbol)->sym] = 1;
-
-          unsigned int p = static_cast < myint > (size_of_slice) * (100 * (*pSymbol)->count - beta) / (100 * iTotal + alpha);
-
-          probs[(*pSymbol)->sym] += p;
-          iToSpend -= p;
-        }
-        //                              Usprintf(debug,TEXT("sym %u counts %d p %u tospend %u \n"),sym,s->count,p,tospend);      
-        //                              DebugOutput(debug);
+    int iTotal = 0;
+    for (std::size_t i = iFirst; i < iEnd; i++)
+      iTotal += pShares[i];
+
+    if (iTotal) {
+      const unsigned int size_of_slice = iToSpend;
+      const myint iDenom = 100 * iTotal + alpha;
+      unsigned int iSpent = 0;
+      for (std::size_t i = iFirst; i < iEnd; i++) {
+        //replace count by share
+        pShares[i] = static_cast < myint > (size_of_slice) * (100 * static_cast<int>(pShares[i]) - beta) / iDenom;
+        iSpent += pShares[i];
       }
+      iToSpend -= iSpent;
+    } else {
+      //children with zero counts (only made by PrimeContext) get nothing
+      vSyms.resize(iFirst);
+      vShares.resize(iFirst);
     }
   }
 
-  unsigned int size_of_slice = iToSpend;
-  int symbolsleft = 0;
-
-  for(int i = 1; i < iNumSymbols; i++)
-    if(!(exclusions[i] && doExclusion))
-      symbolsleft++;
-
-//      std::ostringstream str;
-//      for (sym=0;sym<modelchars;sym++)
-//              str << probs[sym] << " ";
-//      str << std::endl;
-//      DASHER_TRACEOUTPUT("probs %s",str.str().c_str());
-
-//      std::ostringstream str2;
-//      for (sym=0;sym<modelchars;sym++)
-//              str2 << valid[sym] << " ";
-//      str2 << std::endl;
-//      DASHER_TRACEOUTPUT("valid %s",str2.str().c_str());
-
-  for(int i = 1; i < iNumSymbols; i++) {
-    if(!(exclusions[i] && doExclusion)) {
-      unsigned int p = size_of_slice / symbolsleft;
-      probs[i] += p;
-      iToSpend -= p;
-    }
+  const unsigned int iSlice = iToSpend / iSyms;
+  iToSpend -= iSlice * iSyms;
+
+  //Fill in everything but the shares: base, then +1 for the last (iUniform % iSyms)
+  // symbols, and +1 again for the last (iToSpend % iSyms).
+  const unsigned int iBase = iUniform / iSyms + iSlice + iToSpend / iSyms;
+  const unsigned int iStepA = iNumSymbols - iUniform % iSyms, iStepB = iNumSymbols - iToSpend % iSyms;
+  unsigned int *const pProbs = &probs[0];
+  for (unsigned int i = 1; i < static_cast<unsigned int>(iNumSymbols); i++)
+    pProbs[i] = iBase + (i >= iStepA) + (i >= iStepB);
+
+  for (std::size_t i = 0; i < vSyms.size(); i++)
+    pProbs[vSyms[i]] += vShares[i];
+}
+
+void CPPMLanguageModel::GetLearningChain(Context c, int Symbol) const {
+  m_vChain.clear();
+  for (const CPPMnode *pNode = GetContext(c).head; pNode; pNode = pNode->vine) {
+    m_vChain.push_back(pNode);
+    if (bUpdateExclusion && pNode->find_symbol(Symbol)) break;
   }
+}
 
-  int iLeft = iNumSymbols-1;
+void CPPMLanguageModel::LearnSymbol(Context c, int Symbol) {
+  if (Symbol && !m_ProbCache.Empty()) {
+    GetLearningChain(c, Symbol);
+    m_ProbCache.Invalidate(m_vChain);
+  }
+  CAbstractPPM::LearnSymbol(c, Symbol);
+  LimitNodes();
+}
 
-  for(int i = 1; i < iNumSymbols; i++) {
-    unsigned int p = iToSpend / iLeft;
-    probs[i] += p;
-    --iLeft;
-    iToSpend -= p;
+void CPPMLanguageModel::GetKeysChangedByLearning(Context c, int Symbol, std::vector<size_t> &vKeys) const {
+  if (!Symbol) {
+    vKeys.clear(); //learns nothing
+    return;
+  }
+  GetLearningChain(c, Symbol);
+  //Learning adds at most one node per node on the chain; if that could take us
+  // over the limit, pruning may free any nodes (and reuse them for other contexts)
+  if (m_iMaxNodes && NodesAllocated + static_cast<int>(m_vChain.size()) > m_iMaxNodes) return;
+  std::vector<size_t>::iterator out = vKeys.begin();
+  for (std::vector<size_t>::const_iterator it = vKeys.begin(); it != vKeys.end(); it++) {
+    for (const CPPMnode *pNode = reinterpret_cast<const CPPMnode *>(*it); pNode; pNode = pNode->vine)
+      if (std::find(m_vChain.begin(), m_vChain.end(), pNode) != m_vChain.end()) {
+        *out++ = *it;
+        break;
+      }
   }
+  vKeys.erase(out, vKeys.end());
+}
 
-  DASHER_ASSERT(iToSpend == 0);
+void CPPMLanguageModel::LimitNodes() {
+  if (m_iMaxNodes && NodesAllocated > m_iMaxNodes) {
+    //Each pass halves counts again, so eventually all below the first level
+    // are 1 and can go; stop if a pass removes nothing (only the first level left).
+    while (NodesAllocated > m_iMaxNodes / 4 * 3) {
+      const size_t iPruned = HalveAndPrune(m_vFreeNodes);
+      if (!iPruned) break;
+      NodesAllocated -= iPruned;
+    }
+    CountsChanged();
+  }
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -151,7 +201,7 @@ void CAbstractPPM::EnterSymbol(Context c, int Symbol) {
 
   DASHER_ASSERT(Symbol >= 0 && Symbol < GetSize());
 
-  CPPMContext & context = *(CPPMContext *) (c);
+  CPPMContext & context = GetContext(c);
 
   while(context.head) {
 
@@ -193,7 +243,7 @@ void CAbstractPPM::LearnSymbol(Context c, int Symbol) {
   
 
   DASHER_ASSERT(Symbol >= 0 && Symbol < GetSize());
-  CPPMContext & context = *(CPPMContext *) (c);
+  CPPMContext & context = GetContext(c);
   
   CPPMnode* n = AddSymbolToNode(context.head, Symbol);
   DASHER_ASSERT ( n == context.head->find_symbol(Symbol));
@@ -306,10 +356,236 @@ bool CAbstractPPM::eq(CAbstractPPM *other) {
   return true;
 }
 
+///Part of a Merge: the subtree under one child of the root, in both models.
+struct CAbstractPPM::SMergeTask {
+  CPPMnode *pMine;
+  const CPPMnode *pTheirs;
+  ///Nodes to use for those in pTheirs' subtree but not pMine's
+  std::vector<CPPMnode *> vFree;
+  ///Each of those nodes, and its parent, by depth below pMine
+  std::vector<std::vector<std::pair<CPPMnode *, CPPMnode *> > > vNew;
+};
+
+size_t CAbstractPPM::CountMissing(const CPPMnode *pMine, const CPPMnode *pTheirs) {
+  size_t iCount = 0;
+  for (ChildIterator it = pTheirs->children(); it != pTheirs->end(); it++) {
+    const CPPMnode *pChild = pMine ? pMine->find_symbol((*it)->sym) : NULL;
+    if (!pChild) iCount++;
+    iCount += CountMissing(pChild, *it);
+  }
+  return iCount;
+}
+
+///Call fn(i) for each i in [0,iTasks), on up to iThreads threads (inc. this one).
+static void runTasks(unsigned int iThreads, size_t iTasks, const std::function<void(size_t)> &fn) {
+  std::atomic<size_t> iNext(0);
+  auto worker = [&]() {
+    for (size_t i; (i = iNext++) < iTasks; ) fn(i);
+  };
+  std::vector<std::thread> vThreads;
+  for (unsigned int i = 1; i < iThreads && i < iTasks; i++) vThreads.push_back(std::thread(worker));
+  worker();
+  for (std::vector<std::thread>::iterator it = vThreads.begin(); it != vThreads.end(); it++) it->join();
+}
+
+void CAbstractPPM::Merge(const CAbstractPPM *pOther, unsigned int iThreads) {
+  DASHER_ASSERT(pOther->GetSize() == GetSize() && pOther->m_iMaxOrder == m_iMaxOrder);
+  //Each child of the root heads a subtree which can be merged independently of
+  // the others, so long as nothing is allocated or added to the root meanwhile.
+  // So first make any children of the root that we lack...
+  std::vector<SMergeTask> vTasks;
+  const int iRootHalvings = HalveToMerge(m_pRoot, pOther->m_pRoot);
+  for (ChildIterator it = pOther->m_pRoot->children(); it != pOther->m_pRoot->end(); it++) {
+    SMergeTask task;
+    task.pTheirs = *it;
+    task.pMine = m_pRoot->find_symbol((*it)->sym);
+    if (task.pMine)
+      task.pMine->count += HalvedCount((*it)->count, iRootHalvings);
+    else {
+      task.pMine = makeNode((*it)->sym);
+      task.pMine->count = HalvedCount((*it)->count, iRootHalvings);
+      task.pMine->vine = m_pRoot;
+      m_pRoot->AddChild(task.pMine, GetSize());
+    }
+    vTasks.push_back(task);
+  }
+  //...and all the nodes we will need below them.
+  std::vector<size_t> vMissing(vTasks.size());
+  runTasks(iThreads, vTasks.size(), [&](size_t i) {
+    vMissing[i] = CountMissing(vTasks[i].pMine, vTasks[i].pTheirs);
+  });
+  for (size_t i = 0; i < vTasks.size(); i++)
+    for (vTasks[i].vFree.reserve(vMissing[i]); vMissing[i]--; )
+      vTasks[i].vFree.push_back(makeNode(0));
+
+  //Then, for each subtree, walk the other trie alongside ours, summing counts and
+  // adding nodes we lack. Vines may point into other subtrees, not yet merged...
+  runTasks(iThreads, vTasks.size(), [&](size_t i) {
+    SMergeTask &task(vTasks[i]);
+    std::vector<std::pair<std::pair<CPPMnode *, const CPPMnode *>, unsigned int> > vStack;
+    vStack.push_back(std::make_pair(std::make_pair(task.pMine, task.pTheirs), 0u));
+    while (!vStack.empty()) {
+      CPPMnode *pMine = vStack.back().first.first;
+      const CPPMnode *pTheirs = vStack.back().first.second;
+      const unsigned int iDepth = vStack.back().second;
+      vStack.pop_back();
+      const int iHalvings = HalveToMerge(pMine, pTheirs);
+      for (ChildIterator it = pTheirs->children(); it != pTheirs->end(); it++) {
+        CPPMnode *pChild = pMine->find_symbol((*it)->sym);
+        if (pChild)
+          pChild->count += HalvedCount((*it)->count, iHalvings);
+        else {
+          pChild = task.vFree.back();
+          task.vFree.pop_back();
+          pChild->sym = (*it)->sym;
+          pChild->count = HalvedCount((*it)->count, iHalvings);
+          pMine->AddChild(pChild, GetSize());
+          if (task.vNew.size() <= iDepth) task.vNew.resize(iDepth+1);
+          task.vNew[iDepth].push_back(std::make_pair(pChild, pMine));
+        }
+        vStack.push_back(std::make_pair(std::make_pair(pChild, (const CPPMnode *) *it), iDepth+1));
+      }
+    }
+    DASHER_ASSERT(task.vFree.empty());
+  });
+  //...so only once all are done, point each new node at the same-symbol child of
+  // its parent's vine (which the union of two tries is sure to have), shallowest first.
+  runTasks(iThreads, vTasks.size(), [&](size_t i) {
+    for (unsigned int d = 0; d < vTasks[i].vNew.size(); d++)
+      for (std::vector<std::pair<CPPMnode *, CPPMnode *> >::iterator it = vTasks[i].vNew[d].begin(); it != vTasks[i].vNew[d].end(); it++) {
+        it->first->vine = it->second->vine->find_symbol(it->first->sym);
+        DASHER_ASSERT(it->first->vine);
+      }
+  });
+  //Lastly, without update exclusion, LearnSymbol also counts at the root whenever
+  // the symbol was already a child of it (halving the root's own count rather than
+  // reaching MAX_COUNT, i.e. back to MAX_COUNT/2+1 every MAX_COUNT/2 after that);
+  // with, the root count never changes.
+  if (!bUpdateExclusion) {
+    unsigned long iCount = 1;
+    for (ChildIterator it = m_pRoot->children(); it != m_pRoot->end(); it++)
+      iCount += (*it)->count - 1;
+    m_pRoot->count = (iCount <= MAX_COUNT) ? iCount : MAX_COUNT/2 + 1 + (iCount - MAX_COUNT - 1) % (MAX_COUNT/2) + 1;
+  }
+  CountsChanged();
+}
+
+int CAbstractPPM::HalveToMerge(CPPMnode *pMine, const CPPMnode *pTheirs) {
+  //Usually, even the largest counts add up without reaching the limit
+  unsigned int iMaxMine = 0, iMaxTheirs = 0;
+  for (ChildIterator it = pMine->children(); it != pMine->end(); it++)
+    iMaxMine = std::max<unsigned int>(iMaxMine, (*it)->count);
+  for (ChildIterator it = pTheirs->children(); it != pTheirs->end(); it++)
+    iMaxTheirs = std::max<unsigned int>(iMaxTheirs, (*it)->count);
+  if (iMaxMine + iMaxTheirs <= MAX_COUNT) return 0;
+
+  int iTimes = 0;
+  for (ChildIterator it = pTheirs->children(); it != pTheirs->end(); ) {
+    const CPPMnode *pChild = pMine->find_symbol((*it)->sym);
+    if ((pChild ? HalvedCount(pChild->count, iTimes) : 0) + HalvedCount((*it)->count, iTimes) > MAX_COUNT) {
+      //halve once more, and check all the children again
+      iTimes++;
+      it = pTheirs->children();
+    } else it++;
+  }
+  for (int i = 0; i < iTimes; i++) pMine->HalveChildCounts();
+  return iTimes;
+}
+
+void CAbstractPPM::PrimeContext(Context context, const std::vector<symbol> &vSyms) {
+  DASHER_ASSERT(m_pRoot->children() == m_pRoot->end());
+  for (std::vector<symbol>::const_iterator it = vSyms.begin(); it != vSyms.end(); it++)
+    LearnSymbol(context, *it);
+  //The trie contains only what was just learnt, so is small
+  std::vector<CPPMnode *> vNodes(1, m_pRoot);
+  while (!vNodes.empty()) {
+    CPPMnode *pNode = vNodes.back();
+    vNodes.pop_back();
+    pNode->count = 0;
+    for (ChildIterator it = pNode->children(); it != pNode->end(); it++)
+      vNodes.push_back(*it);
+  }
+  CountsChanged();
+}
+
+size_t CAbstractPPM::HalveAndPrune(std::vector<CPPMnode *> &vFreed) {
+  //Each node (with its parent) by depth; the root is the only node at depth 0.
+  std::vector<std::vector<std::pair<CPPMnode *, CPPMnode *> > > vLevels(1);
+  vLevels[0].push_back(std::make_pair(m_pRoot, (CPPMnode *) NULL));
+  m_pRoot->count = (m_pRoot->count + 1) / 2;
+  for (size_t d = 0; !vLevels[d].empty(); d++) {
+    vLevels.push_back(std::vector<std::pair<CPPMnode *, CPPMnode *> >());
+    for (std::vector<std::pair<CPPMnode *, CPPMnode *> >::iterator it = vLevels[d].begin(); it != vLevels[d].end(); it++) {
+      it->first->HalveChildCounts();
+      for (ChildIterator ch = it->first->children(); ch != it->first->end(); ch++)
+        vLevels[d+1].push_back(std::make_pair(*ch, it->first));
+    }
+  }
+
+  //Deepest first, so we know which nodes are still needed - as parent or vine -
+  // by those remaining below them. Only nodes (and their vines) one level
+  // shallower can need a node, so nodes more than a level down can be forgotten.
+  std::set<CPPMnode *> setNeeded, setNeededAbove, setPruned, setParents;
+  for (size_t d = vLevels.size() - 1; d >= 2; d--) {
+    setNeeded.swap(setNeededAbove);
+    setNeededAbove.clear();
+    for (std::vector<std::pair<CPPMnode *, CPPMnode *> >::iterator it = vLevels[d].begin(); it != vLevels[d].end(); it++) {
+      if (it->first->count <= 1 && !setNeeded.count(it->first)) {
+        setPruned.insert(it->first);
+        setParents.insert(it->second);
+      } else {
+        setNeededAbove.insert(it->first->vine);
+        setNeededAbove.insert(it->second);
+      }
+    }
+  }
+  if (setPruned.empty()) return 0;
+
+  //Move contexts off pruned nodes; their vines remain pointing into the trie.
+  for (size_t i = 0; i < m_Contexts.Size(); i++)
+    if (CPPMContext *pCont = m_Contexts.Live(i))
+      while (setPruned.count(pCont->head)) {
+        pCont->head = pCont->head->vine;
+        pCont->order--;
+      }
+
+  //Rebuild the child arrays of the remaining nodes which lost children...
+  std::vector<CPPMnode *> vKeep;
+  for (std::set<CPPMnode *>::iterator it = setParents.begin(); it != setParents.end(); it++) {
+    if (setPruned.count(*it)) continue;
+    vKeep.clear();
+    for (ChildIterator ch = (*it)->children(); ch != (*it)->end(); ch++)
+      if (!setPruned.count(*ch)) vKeep.push_back(*ch);
+    (*it)->ClearChildren();
+    for (std::vector<CPPMnode *>::iterator k = vKeep.begin(); k != vKeep.end(); k++)
+      (*it)->AddChild(*k, GetSize());
+  }
+  //...and hand back the pruned nodes, as new.
+  for (std::set<CPPMnode *>::iterator it = setPruned.begin(); it != setPruned.end(); it++) {
+    (*it)->ClearChildren();
+    (*it)->vine = NULL;
+    (*it)->count = 1;
+    vFreed.push_back(*it);
+  }
+  return setPruned.size();
+}
+
 ////////////////////////////////////////////////////////////////////////
 /// PPMnode definitions 
 ////////////////////////////////////////////////////////////////////////
 
+void CAbstractPPM::CPPMnode::ClearChildren() {
+  if (m_iNumChildSlots != 1)
+    delete[] m_ppChildren;
+  m_ppChildren = NULL;
+  m_iNumChildSlots = 0;
+}
+
+void CAbstractPPM::CPPMnode::HalveChildCounts() {
+  for (ChildIterator it = children(); it != end(); it++)
+    (*it)->count = ((*it)->count + 1) / 2;
+}
+
 bool CAbstractPPM::CPPMnode::eq(CAbstractPPM::CPPMnode *other, std::map<CPPMnode *,CPPMnode *> &equivs) {
   if (sym != other->sym)
     return false;
@@ -426,11 +702,19 @@ CAbstractPPM::CPPMnode * CAbstractPPM::AddSymbolToNode(CPPMnode *pNode, symbol s
   //      std::cout << sym << ",";
 
   if(pReturn != NULL) {
+    if (pReturn->count == MAX_COUNT) pNode->HalveChildCounts();
     pReturn->count++;
     if (!bUpdateExclusion) {
       //update vine contexts too. Guaranteed to exist if child does!
-      for (CPPMnode *v = pReturn->vine; v; v=v->vine) {
+      // Each is a child of the corresponding node down pNode's vine chain,
+      // except the last, the root, which has no parent.
+      CPPMnode *pParent = pNode->vine;
+      for (CPPMnode *v = pReturn->vine; v; v=v->vine, pParent = pParent ? pParent->vine : NULL) {
         DASHER_ASSERT(v == m_pRoot || v->sym == sym);
+        if (v->count == MAX_COUNT) {
+          if (pParent) pParent->HalveChildCounts();
+          else v->count = (v->count + 1) / 2;
+        }
         v->count++;
       }
     }
@@ -445,146 +729,116 @@ CAbstractPPM::CPPMnode * CAbstractPPM::AddSymbolToNode(CPPMnode *pNode, symbol s
 }
 
 CPPMLanguageModel::CPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms)
-: CAbstractPPM(pCreator, iNumSyms, new CPPMnode(-1)), NodesAllocated(0), m_NodeAlloc(8192) {
+: CAbstractPPM(pCreator, iNumSyms, new CPPMnode(-1)), NodesAllocated(0),
+  //Pruning never removes the first level (up to one node per symbol), so leave room for more
+  m_iMaxNodes(GetLongParameter(LP_LM_MAX_NODES) ? std::max<int>(GetLongParameter(LP_LM_MAX_NODES), 4 * (iNumSyms+1)) : 0),
+  m_ProbCache(iNumSyms+1), m_NodeAlloc(8192) {
+}
+
+CPPMLanguageModel::CPPMLanguageModel(CPPMLanguageModel *pLike)
+: CAbstractPPM(pLike, pLike->GetSize()-1, new CPPMnode(-1), pLike->m_iMaxOrder, pLike->bUpdateExclusion ? 1 : 0),
+  NodesAllocated(0), m_iMaxNodes(0), m_ProbCache(pLike->GetSize()), m_NodeAlloc(8192) {
 }
 
 CAbstractPPM::CPPMnode *CPPMLanguageModel::makeNode(int sym) {
-  CPPMnode *res = m_NodeAlloc.Alloc();
+  CPPMnode *res;
+  if (m_vFreeNodes.empty())
+    res = m_NodeAlloc.Alloc();
+  else {
+    res = m_vFreeNodes.back();
+    m_vFreeNodes.pop_back();
+  }
   res->sym = sym;
   ++NodesAllocated;
   return res;
 }
 
-struct BinaryRecord {
-  int m_iIndex;
-  int m_iChild;
-  int m_iNext;
-  int m_iVine;
-  unsigned short int m_iCount;
-  short int m_iSymbol;
-};
-
 bool CPPMLanguageModel::WriteToFile(std::string strFilename) {
-
-  std::map<CPPMnode *, int> mapIdx;
-  int iNextIdx(1); // Index of 0 means NULL;
-
-  std::ofstream oOutputFile(strFilename.c_str());
-
-  RecursiveWrite(m_pRoot, NULL, &mapIdx, &iNextIdx, &oOutputFile);
-
-  oOutputFile.close();
-
-  return false;
+  std::string strData;
+  return WriteToString(strData, "") && CPPMSnapshot::WriteFile(strFilename, strData);
 }
 
-bool CPPMLanguageModel::RecursiveWrite(CPPMnode *pNode, CPPMnode *pNextSibling, std::map<CPPMnode *, int> *pmapIdx, int *pNextIdx, std::ofstream *pOutputFile) {
-
-  // Dump node here
-
-  BinaryRecord sBR;
-
-  sBR.m_iIndex = GetIndex(pNode, pmapIdx, pNextIdx); 
-  sBR.m_iNext = GetIndex(pNextSibling, pmapIdx, pNextIdx); 
-  sBR.m_iVine = GetIndex(pNode->vine, pmapIdx, pNextIdx);
-  sBR.m_iCount = pNode->count;
-  sBR.m_iSymbol = pNode->sym;
-
-  ChildIterator it =pNode->children();
-  CPPMnode *pCurrentChild = (it == pNode->end()) ? NULL : *it++;
-  sBR.m_iChild = GetIndex(pCurrentChild, pmapIdx, pNextIdx); 
-  
-  pOutputFile->write(reinterpret_cast<char*>(&sBR), sizeof(BinaryRecord));
-
-  if (pCurrentChild) {
-    for (CPPMnode *pNextChild; it != pNode->end(); pCurrentChild = pNextChild) {
-      pNextChild = *it++;
-      RecursiveWrite(pCurrentChild, pNextChild, pmapIdx, pNextIdx, pOutputFile);
-    }
-    RecursiveWrite(pCurrentChild, NULL, pmapIdx, pNextIdx, pOutputFile);
-  }
-
+bool CPPMLanguageModel::WriteToString(std::string &strData, const std::string &strName) {
+  //SLMFileHeader's size field is only 16 bits...
+  if (strName.length() > 0xFFFF - sizeof(SLMFileHeader)) return false;
+  std::vector<SPPMSnapshotNode> vNodes;
+  Flatten(vNodes);
+
+  SPPMSnapshotHeader header;
+  header.iByteOrder = CPPMSnapshot::BYTE_ORDER_MARK;
+  header.iNumNodes = vNodes.size();
+  header.iMaxOrder = m_iMaxOrder;
+  header.iUpdateExclusion = bUpdateExclusion ? 1 : 0;
+  header.iReserved = 0;
+  CPPMSnapshot::Serialize(strData, GetSize(), strName, header, &vNodes[0]);
   return true;
 }
 
-int CPPMLanguageModel::GetIndex(CPPMnode *pAddr, std::map<CPPMnode *, int> *pmapIdx, int *pNextIdx) {
-
-  int iIndex;
-  if(pAddr == NULL)
-    iIndex = 0;
-  else {
-    std::map<CPPMnode *, int>::iterator it(pmapIdx->find(pAddr));
-    
-    if(it == pmapIdx->end()) {
-      iIndex = *pNextIdx;
-      pmapIdx->insert(std::pair<CPPMnode *, int>(pAddr, iIndex));
-      ++(*pNextIdx);
-    }
-    else {
-      iIndex = it->second;
+void CPPMLanguageModel::Flatten(std::vector<SPPMSnapshotNode> &vNodes) const {
+  //Lay the trie out breadth-first, so each node's children are contiguous; nodes
+  // are identified by index into vSrc (& the records), so no address map is needed.
+  std::vector<CPPMnode *> vSrc;
+  vNodes.clear();
+  vNodes.reserve(NodesAllocated+1);
+  vSrc.reserve(NodesAllocated+1);
+
+  SPPMSnapshotNode rec;
+  rec.iFirstChild = 0;
+  rec.iVine = CPPMSnapshot::NO_NODE;
+  rec.iSymbol = m_pRoot->sym;
+  rec.iCount = m_pRoot->count;
+  rec.iNumChildren = 0;
+  vNodes.push_back(rec);
+  vSrc.push_back(m_pRoot);
+
+  std::vector<std::pair<symbol, CPPMnode *> > vChildren;
+  for (uint32 i = 0; i < vSrc.size(); i++) {
+    vChildren.clear();
+    for (ChildIterator it = vSrc[i]->children(); it != vSrc[i]->end(); it++)
+      vChildren.push_back(std::pair<symbol, CPPMnode *>((*it)->sym, *it));
+    std::sort(vChildren.begin(), vChildren.end());
+    vNodes[i].iFirstChild = vNodes.size();
+    vNodes[i].iNumChildren = vChildren.size();
+    for (std::vector<std::pair<symbol, CPPMnode *> >::iterator it = vChildren.begin(); it != vChildren.end(); it++) {
+      rec.iSymbol = it->first;
+      rec.iCount = it->second->count;
+      //The vine of a child is the same-symbol child of its parent's vine, which
+      // being shallower has already been laid out.
+      rec.iVine = (i == 0) ? 0 : CPPMSnapshot::FindChild(&vNodes[0], vNodes[i].iVine, rec.iSymbol);
+      DASHER_ASSERT(rec.iVine != CPPMSnapshot::NO_NODE && vSrc[rec.iVine] == it->second->vine);
+      vNodes.push_back(rec);
+      vSrc.push_back(it->second);
     }
   }
-  return iIndex;
 }
 
 bool CPPMLanguageModel::ReadFromFile(std::string strFilename) {
-  
-  std::ifstream oInputFile(strFilename.c_str());
-  //map from file index, to address of node object with that index
-  std::map<int, CPPMnode*> oMap;
-  //map from file index, to address of *parent* for that node
-  // - only stored for the child that will *next* be read.
-  std::map<int, CPPMnode *> parentMap;
-  BinaryRecord sBR;
-  bool bStarted(false);
-
-  while(!oInputFile.eof()) {
-    oInputFile.read(reinterpret_cast<char *>(&sBR), sizeof(BinaryRecord));
-
-    CPPMnode *pCurrent(GetAddress(sBR.m_iIndex, &oMap));
-
-    pCurrent->vine = GetAddress(sBR.m_iVine, &oMap);
-    pCurrent->count = sBR.m_iCount;
-    pCurrent->sym = sBR.m_iSymbol;
-
-    //if this node has a parent...
-    std::map<int,CPPMnode *>::iterator it(parentMap.find(sBR.m_iIndex));
-    if (it != parentMap.end()) {
-      CPPMnode *parent = it->second;
-      parent->AddChild(pCurrent,GetSize());
-      //erase the record of parent hood, now we've realized it
-      parentMap.erase(it);
-      //add mapping for the _next_ sibling; since siblings will be read in the order
-      // they were written out, when the next sibling is read it will find the mapping.
-      if (sBR.m_iNext) parentMap.insert(pair<int,CPPMnode *>(sBR.m_iNext,parent));
-    }
-    
-    //if the node has children, record for the benefit of the first child
-    // this node's address...(said child will be the first one read)
-    if (sBR.m_iChild) parentMap.insert(pair<int,CPPMnode *>(sBR.m_iChild, pCurrent));
-    
-    if(!bStarted) {
-      m_pRoot = pCurrent;
-      bStarted = true;
-    }
-  }
-
-  oInputFile.close();
-
-  return false;
+  CPPMSnapshot snapshot;
+  return snapshot.Open(strFilename, GetSize()) && LoadSnapshot(snapshot);
 }
 
-CPPMLanguageModel::CPPMnode *CPPMLanguageModel::GetAddress(int iIndex, std::map<int, CPPMnode*> *pMap) {
-  if (iIndex==0) return NULL;
-  std::map<int, CPPMnode*>::iterator it(pMap->find(iIndex));
-
-  if(it == pMap->end()) {
-    CPPMnode *pNewNode;
-    pNewNode = m_NodeAlloc.Alloc();
-    pMap->insert(std::pair<int, CPPMnode*>(iIndex, pNewNode));
-    return pNewNode;
-  }
-  else {
-    return it->second;
+bool CPPMLanguageModel::LoadSnapshot(const CPPMSnapshot &snapshot) {
+  const SPPMSnapshotHeader &header(snapshot.Header());
+  if (header.iMaxOrder != m_iMaxOrder || (header.iUpdateExclusion != 0) != bUpdateExclusion)
+    return false;
+  if (m_pRoot->children() != m_pRoot->end())
+    return false; //already trained
+
+  const SPPMSnapshotNode *pNodes = snapshot.Nodes();
+  //CPPMSnapshot::Open checked the layout: every child and vine index is in range,
+  // and each vine precedes the node referring to it, so has been created already.
+  std::vector<CPPMnode *> vNodes(snapshot.NumNodes());
+  vNodes[0] = m_pRoot;
+  m_pRoot->count = pNodes[0].iCount;
+  for (uint32 i = 0; i < vNodes.size(); i++) {
+    for (uint32 c = pNodes[i].iFirstChild, e = c + pNodes[i].iNumChildren; c < e; c++) {
+      CPPMnode *pChild = makeNode(pNodes[c].iSymbol);
+      pChild->count = pNodes[c].iCount;
+      pChild->vine = vNodes[pNodes[c].iVine];
+      vNodes[i]->AddChild(pChild, GetSize());
+      vNodes[c] = pChild;
+    }
   }
+  CountsChanged();
+  return true;
 }
@@ -11,8 +11,11 @@
 
 #include "../../Common/NoClones.h"
 #include "../../Common/Allocators/PooledAlloc.h"
+#include "../../Common/Allocators/ContextTable.h"
 
 #include "LanguageModel.h"
+#include "PPMSnapshot.h"
+#include "PPMProbCache.h"
 #include "../SettingsStore.h"
 #include "stdlib.h"
 #include <vector>
@@ -35,6 +38,8 @@ namespace Dasher {
   /// using a pooled allocator).
   ///
   class CAbstractPPM :public CLanguageModel, protected CSettingsUser, private NoClones {
+    ///Reads the trie and contexts of its overlay model directly
+    friend class CLayeredPPMLanguageModel;
   protected:
     class ChildIterator;
     class CPPMnode {
@@ -55,6 +60,11 @@ namespace Dasher {
       const ChildIterator end() const;
       void AddChild(CPPMnode *pNewChild, int numSymbols);
       CPPMnode * find_symbol(symbol sym)const;
+      ///Remove all children (without freeing them), releasing any array for them.
+      void ClearChildren();
+      ///Halve the counts of all children, rounding up (so none seen becomes zero);
+      /// for when one of them would overflow.
+      void HalveChildCounts();
       CPPMnode *vine;
       unsigned short int count;
       symbol sym;
@@ -101,18 +111,43 @@ namespace Dasher {
     /// is required by the subclass, for the specified symbol. (Initial count will be 1.)
     virtual CPPMnode *makeNode(int sym)=0;
     /// \param iMaxOrder max order of model; anything <0 means to use LP_LM_MAX_ORDER.
-    CAbstractPPM(CSettingsUser *pCreator, int iNumSyms, CPPMnode *pRoot, int iMaxOrder=-1);
+    /// \param iUpdateExclusion likewise, nonzero to use update exclusion; <0 means
+    /// to use LP_LM_UPDATE_EXCLUSION.
+    CAbstractPPM(CSettingsUser *pCreator, int iNumSyms, CPPMnode *pRoot, int iMaxOrder=-1, int iUpdateExclusion=-1);
     
+    ///Called after counts may have changed other than by LearnSymbol (e.g. Merge),
+    /// so subclasses can drop anything they have computed from them.
+    virtual void CountsChanged() {}
+
+    /// Halve every count in the trie (rounding up, as HalveChildCounts), then remove
+    /// nodes below the first level whose count is then at most 1 - deepest first,
+    /// and only where no remaining node is a child of them or has its vine pointer
+    /// to them, so every vine still points into the trie. Contexts at removed nodes
+    /// are moved down the vine chain to the longest suffix that remains (i.e. to
+    /// where EnterSymbol would now have left them).
+    /// \param vFreed removed nodes are appended here, childless and with count 1
+    /// and no vine, so the subclass can reuse them in makeNode.
+    /// \return number of nodes removed
+    size_t HalveAndPrune(std::vector<CPPMnode *> &vFreed);
+
     void dumpSymbol(symbol sym);
     void dumpString(char *str, int pos, int len);
     void dumpTrie(CPPMnode * t, int d);
     
+    ///The context (and CPPMContext) a Context handle refers to
+    CPPMContext &GetContext(Context c) {return m_Contexts.Get(c);}
+    const CPPMContext &GetContext(Context c) const {return m_Contexts.Get(c);}
+
+    ///Template for new contexts; a slot in m_Contexts, but never handed out
     CPPMContext *m_pRootContext;
     CPPMnode *m_pRoot;
     
     /// Cache parameters that don't make sense to adjust during the life of a language model...
     const int m_iMaxOrder; 
     const bool bUpdateExclusion;
+
+    ///Counts are halved (see CPPMnode::HalveChildCounts) rather than reaching this
+    static const unsigned short MAX_COUNT = 0xFFFF;
     
   public:
     virtual bool eq(CAbstractPPM *other);
@@ -121,39 +156,128 @@ namespace Dasher {
     Context CreateEmptyContext();
     void ReleaseContext(Context context);
     Context CloneContext(Context context);
+    size_t ContextBytes() const;
 
     virtual void EnterSymbol(Context context, int Symbol);
     virtual void LearnSymbol(Context context, int Symbol);
 
     void dump();
     bool isValidContext(const Context c) const ;
+
+    /// Add everything another model (of the same size and max order, e.g. trained
+    /// on another part of the text) has learnt into this one: nodes present in
+    /// either are kept, with counts summed, and vine pointers are made for any
+    /// new nodes. Without update exclusion, the result is exactly that of learning
+    /// the other model's text in the same way as this one's. Only the symbols and
+    /// counts of nodes are merged, not any extra data subclasses keep in them.
+    /// \param iThreads number of threads (inc. the calling one) over which to divide
+    /// the work; each handles whole subtrees under children of the root.
+    void Merge(const CAbstractPPM *pOther, unsigned int iThreads=1);
+
+    /// For a model which has learnt nothing yet, and is to be merged into one
+    /// which has learnt the given symbols (in the same context): make the nodes that
+    /// learning them would (so that the context then points at the same depth), but
+    /// leave all counts at zero. Learning symbols in the context afterwards counts them as
+    /// they would be in the other model, so long as there are at least m_iMaxOrder
+    /// symbols here or they start at the beginning of a context.
+    void PrimeContext(Context context, const std::vector<symbol> &vSyms);
+    int GetMaxOrder() const {return m_iMaxOrder;}
+    bool GetUpdateExclusion() const {return bUpdateExclusion;}
   private:
     CPPMnode *AddSymbolToNode(CPPMnode * pNode, symbol sym);
+    struct SMergeTask;
+    ///Count nodes in the subtree of pTheirs (not inc. itself) which pMine (may be NULL) lacks.
+    static size_t CountMissing(const CPPMnode *pMine, const CPPMnode *pTheirs);
+    ///For Merge: halve the counts of pMine's children (as HalveChildCounts) as many
+    /// times as needed for those of pTheirs, halved as often, to be added to them
+    /// without exceeding MAX_COUNT - as AddSymbolToNode halves rather than reach it.
+    /// \return the number of halvings, for HalvedCount of pTheirs' children.
+    static int HalveToMerge(CPPMnode *pMine, const CPPMnode *pTheirs);
+    ///A count after being halved (rounding up, as HalveChildCounts) iTimes over.
+    static unsigned int HalvedCount(unsigned int iCount, int iTimes) {return (iCount + (1u << iTimes) - 1) >> iTimes;}
 
-    CPooledAlloc < CPPMContext > m_ContextAlloc;
-    
-    std::set<const CPPMContext *> m_setContexts;
+    ///Every context, inc. m_pRootContext (so HalveAndPrune can find them all)
+    CContextTable < CPPMContext > m_Contexts;
   };
 
   ///"Standard" PPM language model: GetProbs uses counts in PPM child nodes,
   /// universal alpha+beta values read from LP_LM_ALPHA and LP_LM_BETA,
   /// max order from LP_LM_MAX_ORDER.
+  ///
+  /// If LP_LM_MAX_NODES is nonzero, the trie is kept to about that many nodes
+  /// (each ~40 bytes, plus child arrays): whenever learning takes it over, all
+  /// counts are halved and rare deep contexts pruned (see HalveAndPrune), until it
+  /// is back under 3/4 of the limit. Pruned nodes are reused for new ones.
   class CPPMLanguageModel : public CAbstractPPM {
   public:
     CPPMLanguageModel(CSettingsUser *pCreator, int iNumSyms);
+    /// Makes an empty model with the same alphabet size, max order and update
+    /// exclusion as another, but which never prunes: e.g. to learn part of a text
+    /// for Merge into that one (which may then LimitNodes). Reads no settings, so
+    /// may be made on any thread.
+    explicit CPPMLanguageModel(CPPMLanguageModel *pLike);
+    /// Results are cached (see CPPMProbCache), so re-expanding a node, or
+    /// expanding another with the same context head, need not recompute them.
+    /// Doesn't allocate, once the scratch buffers have grown to size.
     virtual void GetProbs(Context context, std::vector < unsigned int >&Probs, int norm, int iUniform) const;
+    /// The head node, on whose vine chain alone GetProbs depends
+    virtual size_t ContextKey(Context context) const {return reinterpret_cast<size_t>(GetContext(context).head);}
+    /// As GetProbs for the context whose key this is, but neither using nor
+    /// filling the cache, so may be called from several threads at once.
+    virtual bool GetProbsForKey(size_t iKey, std::vector<unsigned int> &Probs, int norm, int iUniform, int alpha, int beta) const;
+    /// Keeps the keys whose head has, on its vine chain, a node whose children
+    /// learning changes; or all of them, if learning may prune the trie.
+    virtual void GetKeysChangedByLearning(Context context, int Symbol, std::vector<size_t> &vKeys) const;
+    /// Also drops any cached results affected by the counts changing, and
+    /// prunes the trie if it has outgrown LP_LM_MAX_NODES.
+    virtual void LearnSymbol(Context context, int Symbol);
+    /// Halve counts and prune (as HalveAndPrune) until the trie is back under 3/4
+    /// of LP_LM_MAX_NODES, if it has outgrown that; as LearnSymbol does, but also
+    /// needed after Merge.
+    void LimitNodes();
+
+    /// Writes the trie as a snapshot (see CPPMSnapshot): records in breadth-first
+    /// order, linked by index rather than pointer.
+    virtual bool WriteToFile(std::string strFilename);
+    /// As WriteToFile, but into a string, with strName in the header.
+    virtual bool WriteToString(std::string &strData, const std::string &strName);
+    /// Bulk-loads a snapshot made by WriteToFile, in a single pass over the records.
+    /// Only possible if this model has not yet learnt anything, and the snapshot
+    /// was made with the same alphabet size, max order and update exclusion.
+    virtual bool ReadFromFile(std::string strFilename);
+    /// As ReadFromFile, but from an already-open snapshot.
+    bool LoadSnapshot(const CPPMSnapshot &snapshot);
+    /// Lay out the trie as snapshot records (see SPPMSnapshotNode), e.g. for
+    /// CFrozenPPMLanguageModel.
+    void Flatten(std::vector<SPPMSnapshotNode> &vNodes) const;
   protected:
     /// Makes a standard CPPMnode, but using a pooled allocator (m_NodeAlloc) - faster!
     virtual CPPMnode *makeNode(int sym);
-    
-    virtual bool WriteToFile(std::string strFilename);
-    virtual bool ReadFromFile(std::string strFilename);
+    void CountsChanged() {m_ProbCache.Clear();}
   private:
+    ///Body of GetProbs, from the head of a context, given alpha & beta; appends
+    /// the vine chain to pvChain if non-NULL. vSyms and vShares are scratch space.
+    void ComputeProbs(const CPPMnode *pHead, std::vector<unsigned int> &probs, int norm, int iUniform, int alpha, int beta,
+                      std::vector<const void *> *pvChain, std::vector<symbol> &vSyms, std::vector<unsigned int> &vShares) const;
+    ///Put in m_vChain the nodes whose children learning the symbol in the
+    /// context will change: down the vine chain from the head, as far as the
+    /// first already having the symbol - or, without update exclusion, all the
+    /// way (as the symbol's own vines are counted too).
+    void GetLearningChain(Context context, int Symbol) const;
+    ///Nodes in the trie, not inc. root or those in m_vFreeNodes
     int NodesAllocated;
+    ///Limit on NodesAllocated, or 0 for none
+    const int m_iMaxNodes;
+    ///Nodes pruned from the trie, for makeNode to reuse
+    std::vector<CPPMnode *> m_vFreeNodes;
 
-    bool RecursiveWrite(CPPMnode *pNode, CPPMnode *pNextSibling, std::map<CPPMnode *, int> *pmapIdx, int *pNextIdx, std::ofstream *pOutputFile);
-    int GetIndex(CPPMnode *pAddr, std::map<CPPMnode *, int> *pmapIdx, int *pNextIdx);
-    CPPMnode *GetAddress(int iIndex, std::map<int, CPPMnode*> *pMap);
+    mutable CPPMProbCache m_ProbCache;
+    ///Scratch space for GetProbs and LearnSymbol, to list the nodes on a vine chain
+    mutable std::vector<const void *> m_vChain;
+    ///Scratch space for GetProbs: the children of all nodes on the vine chain,
+    /// as symbol and count (then share of probability), reused to avoid allocating
+    mutable std::vector<symbol> m_vSyms;
+    mutable std::vector<unsigned int> m_vShares;
 
     mutable CSimplePooledAlloc < CPPMnode > m_NodeAlloc;
   };
@@ -192,29 +316,23 @@ namespace Dasher {
   }
 
   inline CLanguageModel::Context CAbstractPPM::CreateEmptyContext() {
-    CPPMContext *pCont = m_ContextAlloc.Alloc();
-    *pCont = *m_pRootContext;
-
-    m_setContexts.insert(pCont);
-
-    return (Context) pCont;
+    Context cont = m_Contexts.Alloc();
+    m_Contexts.Get(cont) = *m_pRootContext;
+    return cont;
   }
 
   inline CLanguageModel::Context CAbstractPPM::CloneContext(Context Copy) {
-    CPPMContext *pCont = m_ContextAlloc.Alloc();
-    CPPMContext *pCopy = (CPPMContext *) Copy;
-    *pCont = *pCopy;
-
-    m_setContexts.insert(pCont);
-
-    return (Context) pCont;
+    Context cont = m_Contexts.Alloc();
+    m_Contexts.Get(cont) = m_Contexts.Get(Copy);
+    return cont;
   }
 
   inline void CAbstractPPM::ReleaseContext(Context release) {
+    m_Contexts.Free(release);
+  }
 
-    m_setContexts.erase(m_setContexts.find((CPPMContext *) release));
-
-    m_ContextAlloc.Free((CPPMContext *) release);
+  inline size_t CAbstractPPM::ContextBytes() const {
+    return m_Contexts.LiveBytes();
   }
 }                               // end namespace Dasher
 
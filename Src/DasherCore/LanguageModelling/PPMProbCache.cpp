@@ -0,0 +1,106 @@
+// PPMProbCache.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../../Common/Common.h"
+#include "PPMProbCache.h"
+
+#include <algorithm>
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+//However large the alphabet, keep a few entries (enough for the siblings
+// being expanded at once); and for small alphabets, no more than is useful.
+static const std::size_t MIN_ENTRIES = 8, MAX_ENTRIES = 256;
+
+//Learning this many symbols without a prediction in between is not the user writing
+static const int MAX_INVALIDATIONS = 64;
+
+bool CPPMProbCache::SKey::operator<(const SKey &other) const {
+  if (pHead != other.pHead) return pHead < other.pHead;
+  if (iNorm != other.iNorm) return iNorm < other.iNorm;
+  if (iUniform != other.iUniform) return iUniform < other.iUniform;
+  if (iAlpha != other.iAlpha) return iAlpha < other.iAlpha;
+  return iBeta < other.iBeta;
+}
+
+CPPMProbCache::CPPMProbCache(int iNumSymbols)
+: m_iCapacity(std::max(MIN_ENTRIES, std::min(MAX_ENTRIES, MAX_BYTES / (std::max(iNumSymbols, 1) * sizeof(unsigned int))))),
+  m_iInvalidations(0) {
+}
+
+bool CPPMProbCache::Lookup(const void *pHead, int iNorm, int iUniform, int iAlpha, int iBeta, std::vector<unsigned int> &probs) {
+  m_iInvalidations = 0;
+  const SKey key = {pHead, iNorm, iUniform, iAlpha, iBeta};
+  std::map<SKey, std::list<SEntry>::iterator>::iterator it = m_mIndex.find(key);
+  if (it == m_mIndex.end()) return false;
+  m_lEntries.splice(m_lEntries.begin(), m_lEntries, it->second);
+  probs = it->second->vProbs;
+  return true;
+}
+
+void CPPMProbCache::Store(const void *pHead, int iNorm, int iUniform, int iAlpha, int iBeta,
+                          const std::vector<const void *> &vChain, const std::vector<unsigned int> &probs) {
+  const SKey key = {pHead, iNorm, iUniform, iAlpha, iBeta};
+  if (m_mIndex.count(key)) return;
+  if (m_lEntries.size() < m_iCapacity)
+    m_lEntries.push_front(SEntry());
+  else {
+    //reuse the least recently used entry (and its buffers)
+    m_mIndex.erase(m_lEntries.back().key);
+    m_lEntries.splice(m_lEntries.begin(), m_lEntries, --m_lEntries.end());
+  }
+  SEntry &entry(m_lEntries.front());
+  entry.key = key;
+  entry.vChain = vChain;
+  entry.vProbs = probs;
+  m_mIndex[key] = m_lEntries.begin();
+}
+
+void CPPMProbCache::Invalidate(const std::vector<const void *> &vChanged) {
+  if (m_lEntries.empty() || vChanged.empty()) return;
+  if (++m_iInvalidations > MAX_INVALIDATIONS) {
+    Clear();
+    return;
+  }
+  for (std::list<SEntry>::iterator it = m_lEntries.begin(); it != m_lEntries.end(); ) {
+    bool bAffected = false;
+    for (std::vector<const void *>::const_iterator n = it->vChain.begin(); n != it->vChain.end() && !bAffected; n++)
+      bAffected = std::find(vChanged.begin(), vChanged.end(), *n) != vChanged.end();
+    if (bAffected) {
+      m_mIndex.erase(it->key);
+      it = m_lEntries.erase(it);
+    } else it++;
+  }
+}
+
+void CPPMProbCache::Clear() {
+  m_lEntries.clear();
+  m_mIndex.clear();
+}
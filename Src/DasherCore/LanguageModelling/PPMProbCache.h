@@ -0,0 +1,95 @@
+// PPMProbCache.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __PPMProbCache_h__
+#define __PPMProbCache_h__
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace Dasher {
+
+  ///
+  /// \ingroup LM
+  /// @{
+
+  /// Bounded, least-recently-used cache of probability distributions computed by a
+  /// PPM model's GetProbs. Entries are keyed on the node at the head of the context
+  /// (plus the other arguments to GetProbs, and the LP_LM_ALPHA/BETA used), as the
+  /// distribution depends only on the children of the nodes on that node's vine
+  /// chain; each entry records that chain, so the model can drop just the entries
+  /// affected when learning changes the children of some of those nodes.
+  /// Nodes are identified only by address, so the cache works for any trie whose
+  /// nodes neither move nor change their vine pointers while it is in use.
+  class CPPMProbCache {
+  public:
+    /// \param iNumSymbols size of each distribution; the number of entries is
+    /// chosen to keep the cache to roughly MAX_BYTES.
+    CPPMProbCache(int iNumSymbols);
+
+    /// If a distribution for these arguments is cached, copy it into probs, and
+    /// make it the most recently used.
+    /// \return true if found
+    bool Lookup(const void *pHead, int iNorm, int iUniform, int iAlpha, int iBeta, std::vector<unsigned int> &probs);
+
+    /// Store a distribution just computed, evicting the least recently used if full.
+    /// \param vChain the vine chain of pHead (inc. itself), i.e. every node whose
+    /// children were used to compute it.
+    void Store(const void *pHead, int iNorm, int iUniform, int iAlpha, int iBeta,
+               const std::vector<const void *> &vChain, const std::vector<unsigned int> &probs);
+
+    /// Drop every entry whose chain contains any of the given nodes, i.e. those
+    /// whose children have changed. After a long run of calls with no Lookup in
+    /// between (e.g. while importing training text), just empties the cache.
+    void Invalidate(const std::vector<const void *> &vChanged);
+
+    /// Drop everything, e.g. when the counts of many nodes may have changed.
+    void Clear();
+
+    bool Empty() const {return m_lEntries.empty();}
+
+    /// Approximate total size of the distributions cached
+    static const std::size_t MAX_BYTES = 1 << 20;
+
+  private:
+    struct SKey {
+      const void *pHead;
+      int iNorm, iUniform, iAlpha, iBeta;
+      bool operator<(const SKey &other) const;
+    };
+    struct SEntry {
+      SKey key;
+      std::vector<const void *> vChain;
+      std::vector<unsigned int> vProbs;
+    };
+    /// Most recently used at the front
+    std::list<SEntry> m_lEntries;
+    std::map<SKey, std::list<SEntry>::iterator> m_mIndex;
+    const std::size_t m_iCapacity;
+    /// Calls to Invalidate since the last Lookup
+    int m_iInvalidations;
+  };
+
+  /// @}
+}
+
+#endif // __PPMProbCache_h__
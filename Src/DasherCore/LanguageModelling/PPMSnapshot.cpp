@@ -0,0 +1,185 @@
+// PPMSnapshot.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../../Common/Common.h"
+#include "PPMSnapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+///Offset of the PPM header: the generic header (which may be followed by a
+/// variable-length alphabet name), rounded up to keep the records aligned.
+static std::size_t DataOffset(const CLanguageModel::SLMFileHeader &header) {
+  return (header.iHeaderSize + 3) & ~3;
+}
+
+CPPMSnapshot::CPPMSnapshot() : m_pData(NULL), m_iMappedSize(0), m_pHeader(NULL), m_pNodes(NULL) {
+}
+
+CPPMSnapshot::~CPPMSnapshot() {
+  Close();
+}
+
+void CPPMSnapshot::Close() {
+#ifdef HAVE_MMAP
+  if (m_iMappedSize)
+    munmap(const_cast<char *>(m_pData), m_iMappedSize);
+#endif
+  m_iMappedSize = 0;
+  std::vector<char>().swap(m_vBuffer);
+  m_pData = NULL;
+  m_pHeader = NULL;
+  m_pNodes = NULL;
+}
+
+bool CPPMSnapshot::Open(const std::string &strFilename, int iAlphabetSize) {
+  Close();
+  std::size_t iSize(0);
+#ifdef HAVE_MMAP
+  int fd = open(strFilename.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  struct stat sb;
+  if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+    void *pMap = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pMap != MAP_FAILED) {
+      m_pData = static_cast<const char *>(pMap);
+      iSize = m_iMappedSize = sb.st_size;
+    }
+  }
+  close(fd);
+#endif
+  if (!m_pData) {
+    //No mmap: read the whole file with a single call instead.
+    std::ifstream in(strFilename.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    std::streamoff iLen = in.tellg();
+    if (iLen <= 0) return false;
+    in.seekg(0, std::ios::beg);
+    m_vBuffer.resize(static_cast<std::size_t>(iLen));
+    if (!in.read(&m_vBuffer[0], iLen)) {
+      Close();
+      return false;
+    }
+    m_pData = &m_vBuffer[0];
+    iSize = m_vBuffer.size();
+  }
+  if (!Validate(iSize, iAlphabetSize)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool CPPMSnapshot::Validate(std::size_t iSize, int iAlphabetSize) {
+  if (iSize < sizeof(CLanguageModel::SLMFileHeader)) return false;
+  const CLanguageModel::SLMFileHeader &header(*reinterpret_cast<const CLanguageModel::SLMFileHeader *>(m_pData));
+  if (memcmp(header.szMagic, "%DLF", 4) || header.iHeaderVersion != 1
+      || header.iLMID != LM_ID || header.iLMMinVersion > LM_VERSION
+      || header.iAlphabetSize != iAlphabetSize
+      || header.iHeaderSize < sizeof(CLanguageModel::SLMFileHeader))
+    return false;
+
+  std::size_t iOffset = DataOffset(header);
+  if (iSize < iOffset + sizeof(SPPMSnapshotHeader)) return false;
+  m_pHeader = reinterpret_cast<const SPPMSnapshotHeader *>(m_pData + iOffset);
+  if (m_pHeader->iByteOrder != BYTE_ORDER_MARK || m_pHeader->iNumNodes == 0) return false;
+  iOffset += sizeof(SPPMSnapshotHeader);
+  if ((iSize - iOffset) / sizeof(SPPMSnapshotNode) < m_pHeader->iNumNodes) return false;
+  const SPPMSnapshotNode *pNodes = reinterpret_cast<const SPPMSnapshotNode *>(m_pData + iOffset);
+
+  //Check the records really are breadth-first, so users need not bounds-check:
+  // each node's children must follow on directly from the previous node's.
+  if (pNodes[0].iVine != NO_NODE) return false;
+  uint32 iNext = 1;
+  for (uint32 i = 0; i < m_pHeader->iNumNodes; i++) {
+    const SPPMSnapshotNode &node(pNodes[i]);
+    if (i > 0 && (node.iVine >= i || node.iSymbol <= 0 || node.iSymbol >= iAlphabetSize))
+      return false;
+    if (node.iNumChildren) {
+      if (node.iFirstChild != iNext || m_pHeader->iNumNodes - iNext < node.iNumChildren)
+        return false;
+      for (uint32 c = iNext + 1; c < iNext + node.iNumChildren; c++)
+        if (pNodes[c].iSymbol <= pNodes[c - 1].iSymbol) return false;
+      iNext += node.iNumChildren;
+    }
+  }
+  if (iNext != m_pHeader->iNumNodes) return false;
+  m_pNodes = pNodes;
+  return true;
+}
+
+uint32 CPPMSnapshot::FindChild(const SPPMSnapshotNode *pNodes, uint32 iParent, symbol sym) {
+  uint32 lo = pNodes[iParent].iFirstChild, hi = lo + pNodes[iParent].iNumChildren;
+  while (lo < hi) {
+    uint32 mid = lo + (hi - lo) / 2;
+    if (pNodes[mid].iSymbol < sym) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < pNodes[iParent].iFirstChild + pNodes[iParent].iNumChildren && pNodes[lo].iSymbol == sym)
+    return lo;
+  return NO_NODE;
+}
+
+void CPPMSnapshot::Serialize(std::string &strData, int iAlphabetSize, const std::string &strName, const SPPMSnapshotHeader &ppmHeader, const SPPMSnapshotNode *pNodes) {
+  CLanguageModel::SLMFileHeader header;
+  memcpy(header.szMagic, "%DLF", 4);
+  header.iHeaderVersion = 1;
+  header.iHeaderSize = sizeof(CLanguageModel::SLMFileHeader) + strName.length();
+  header.iLMID = LM_ID;
+  header.iLMVersion = LM_VERSION;
+  header.iLMMinVersion = LM_MIN_VERSION;
+  header.iAlphabetSize = iAlphabetSize;
+
+  const std::size_t iOffset = DataOffset(header);
+  strData.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+  strData += strName;
+  strData.resize(iOffset, '\0');
+  strData.append(reinterpret_cast<const char *>(&ppmHeader), sizeof(ppmHeader));
+  strData.append(reinterpret_cast<const char *>(pNodes), ppmHeader.iNumNodes * sizeof(SPPMSnapshotNode));
+}
+
+bool CPPMSnapshot::WriteFile(const std::string &strFilename, const std::string &strData) {
+  FILE *OutputFile = fopen(strFilename.c_str(), "wb");
+  if (!OutputFile) return false;
+  bool bOk = fwrite(strData.data(), 1, strData.size(), OutputFile) == strData.size();
+  if (fclose(OutputFile)) bOk = false;
+  return bOk;
+}
@@ -0,0 +1,117 @@
+// PPMSnapshot.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __PPMSnapshot_h__
+#define __PPMSnapshot_h__
+
+#include "../../Common/NoClones.h"
+#include "../../Common/Types/int.h"
+#include "LanguageModel.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace Dasher {
+
+  ///
+  /// \ingroup LM
+  /// @{
+
+  /// PPM-specific header, following the generic CLanguageModel::SLMFileHeader
+  /// (padded to a multiple of 4 bytes) in a snapshot file.
+  struct SPPMSnapshotHeader {
+    /// CPPMSnapshot::BYTE_ORDER_MARK as written by the host which made the file
+    uint32 iByteOrder;
+    /// Number of SPPMSnapshotNode records following this header (>=1, the root)
+    uint32 iNumNodes;
+    /// LP_LM_MAX_ORDER and LP_LM_UPDATE_EXCLUSION the model was trained with
+    unsigned short int iMaxOrder;
+    unsigned short int iUpdateExclusion;
+    uint32 iReserved;
+  };
+
+  /// One node of the trie. Records are stored in breadth-first order from the
+  /// root (record 0), so the children of each node are contiguous and sorted
+  /// by symbol, and every vine refers to an earlier record. All links are
+  /// indices into the record array, so the file can be used wherever it is mapped.
+  struct SPPMSnapshotNode {
+    /// Index of first child (meaningless if iNumChildren==0)
+    uint32 iFirstChild;
+    /// Index of vine (shorter context), or CPPMSnapshot::NO_NODE for the root
+    uint32 iVine;
+    int32 iSymbol;
+    unsigned short int iCount;
+    unsigned short int iNumChildren;
+  };
+
+  /// A PPM snapshot file opened for reading: mmap()ed where the platform allows,
+  /// otherwise read into memory in a single pass. The records can then be used
+  /// directly, or bulk-loaded into a CPPMLanguageModel (see ReadFromFile).
+  class CPPMSnapshot : private NoClones {
+  public:
+    /// Value of SLMFileHeader::iLMID for PPM (as LP_LANGUAGE_MODEL_ID)
+    static const unsigned short int LM_ID = 0;
+    static const unsigned short int LM_VERSION = 1;
+    static const unsigned short int LM_MIN_VERSION = 1;
+    static const uint32 BYTE_ORDER_MARK = 0x01020304;
+    static const uint32 NO_NODE = 0xFFFFFFFF;
+
+    CPPMSnapshot();
+    ~CPPMSnapshot();
+
+    /// Open a snapshot and check that it is well-formed.
+    /// \param iAlphabetSize size of the model it is for (i.e. CLanguageModel::GetSize()),
+    /// \return false if the file could not be read, was written by an incompatible
+    /// version or host, or is for a different sized alphabet.
+    bool Open(const std::string &strFilename, int iAlphabetSize);
+    void Close();
+
+    bool IsOpen() const {return m_pNodes!=NULL;}
+    const SPPMSnapshotHeader &Header() const {return *m_pHeader;}
+    const SPPMSnapshotNode *Nodes() const {return m_pNodes;}
+    uint32 NumNodes() const {return m_pHeader->iNumNodes;}
+
+    /// Find the child of a node with the specified symbol, by binary search.
+    /// \return index of child, or NO_NODE if there is none.
+    static uint32 FindChild(const SPPMSnapshotNode *pNodes, uint32 iParent, symbol sym);
+
+    /// Serialize a complete snapshot (generic header, PPM header, then records)
+    /// \param strName stored in the generic header in place of the alphabet name
+    /// \param pNodes header.iNumNodes records to write
+    static void Serialize(std::string &strData, int iAlphabetSize, const std::string &strName, const SPPMSnapshotHeader &header, const SPPMSnapshotNode *pNodes);
+
+    /// Write serialized data out to a file (replacing any existing)
+    /// \return true if successful
+    static bool WriteFile(const std::string &strFilename, const std::string &strData);
+
+  private:
+    bool Validate(std::size_t iSize, int iAlphabetSize);
+    const char *m_pData;
+    std::size_t m_iMappedSize;
+    std::vector<char> m_vBuffer;
+    const SPPMSnapshotHeader *m_pHeader;
+    const SPPMSnapshotNode *m_pNodes;
+  };
+
+  /// @}
+}
+
+#endif // __PPMSnapshot_h__
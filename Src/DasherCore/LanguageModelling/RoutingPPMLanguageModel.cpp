@@ -29,7 +29,7 @@ CRoutingPPMLanguageModel::CRoutingPPMLanguageModel(CSettingsUser *pCreator, cons
 }
 
 void CRoutingPPMLanguageModel::GetProbs(Context context, std::vector<unsigned int> &probs, int norm, int iUniform) const {
-  const CPPMContext *ppmcontext = (const CPPMContext *)(context);
+  const CPPMContext *ppmcontext = &GetContext(context);
 
   const int iNumSymbols(m_pBaseSyms->size()); //i.e., the #routes - so loop from i=1 to <iNumSymbols
   probs.resize(iNumSymbols);
@@ -129,7 +129,7 @@ void CRoutingPPMLanguageModel::GetProbs(Context context, std::vector<unsigned in
 /////////////////////////////////////////////////////////////////////
 
 symbol CRoutingPPMLanguageModel::GetBestRoute(Context ctx) {
-  const CPPMContext *context = (const CPPMContext *)ctx;
+  const CPPMContext *context = &GetContext(ctx);
   DASHER_ASSERT(context->head && context->head != m_pRoot);
   
   map<symbol,unsigned int> probs; //of the routes leading to this base sym
@@ -180,7 +180,7 @@ void CRoutingPPMLanguageModel::LearnSymbol(Context ctx, int sym) {
   //ctx now updated, points to node for learnt base sym
   DASHER_ASSERT((*m_pRoutes)[base].size());
   if ((*m_pRoutes)[base].size()==1) return; //no need to store, saves computation if we don't
-  for (CPPMnode *node=((CPPMContext*)ctx)->head; node!=m_pRoot; node=node->vine) {
+  for (CPPMnode *node=GetContext(ctx).head; node!=m_pRoot; node=node->vine) {
     if (node->vine!=m_pRoot && !m_bRoutesContextSensitive) continue;
     else if (static_cast<CRoutingPPMnode*>(node)->m_routes[sym]++) //returns old value, i.e. 0 if not present
       if (bUpdateExclusion) break;
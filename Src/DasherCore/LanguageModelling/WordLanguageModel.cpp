@@ -124,7 +124,7 @@ CWordLanguageModel::CWordnode * CWordLanguageModel::AddSymbolToNode(CWordnode *p
 CWordLanguageModel::CWordLanguageModel(CSettingsUser *pCreator, 
 				       const CAlphInfo *pAlph, const CAlphabetMap *pAlphMap)
   :CLanguageModel(pAlph->iEnd-1), CSettingsUser(pCreator), m_iSpaceSymbol(pAlph->GetSpaceSymbol()), NodesAllocated(0),
-   max_order(2), m_NodeAlloc(8192), m_ContextAlloc(1024) {
+   max_order(2), m_NodeAlloc(8192), m_Contexts(1024) {
   
   // Construct a root node for the trie
 
@@ -138,10 +138,12 @@ CWordLanguageModel::CWordLanguageModel(CSettingsUser *pCreator,
 
   // Construct a root context
   
-  m_rootcontext = new CWordContext(m_pRoot, 0);
+  m_rootcontext = m_Contexts.Alloc();
+  CWordContext &rootcontext(m_Contexts.Get(m_rootcontext));
+  rootcontext = CWordContext(m_pRoot, 0);
   
-  m_rootcontext->m_pSpellingModel = pSpellingModel;
-  m_rootcontext->oSpellingContext = pSpellingModel->CreateEmptyContext();
+  rootcontext.m_pSpellingModel = pSpellingModel;
+  rootcontext.oSpellingContext = pSpellingModel->CreateEmptyContext();
 
   iWordStart = 8192;
 
@@ -153,7 +155,6 @@ CWordLanguageModel::CWordLanguageModel(CSettingsUser *pCreator,
 
 CWordLanguageModel::~CWordLanguageModel() {
 
-  delete m_rootcontext;
   delete pSpellingModel;
 
   // A non-recursive node deletion algorithm using a stack
@@ -203,7 +204,7 @@ int CWordLanguageModel::lookup_word_const(const std::string &w) const {
 void CWordLanguageModel::GetProbs(Context context, std::vector<unsigned int> &probs, int norm, int iUniform) const {
   // Got rid of const below
 
-  CWordLanguageModel::CWordContext * wordcontext = (CWordContext *) (context);
+  CWordLanguageModel::CWordContext * wordcontext = &m_Contexts.Get(context);
 
   // Make sure that the probability vector has the right length
 
@@ -519,7 +520,7 @@ void CWordLanguageModel::CollapseContext(CWordLanguageModel::CWordContext &conte
 }
 
 void CWordLanguageModel::LearnSymbol(Context c, int Symbol) {
-  CWordContext & context = *(CWordContext *) (c);
+  CWordContext & context = m_Contexts.Get(c);
   AddSymbol(context, Symbol, true);
 }
 
@@ -601,6 +602,6 @@ void CWordLanguageModel::AddSymbol(CWordLanguageModel::CWordContext &context, sy
 void CWordLanguageModel::EnterSymbol(Context c, int Symbol) {
   // Same as AddSymbol but without learning in CollapseContext 
 
-  CWordContext & context = *(CWordContext *) (c);
+  CWordContext & context = m_Contexts.Get(c);
   AddSymbol(context, Symbol, false);
 }
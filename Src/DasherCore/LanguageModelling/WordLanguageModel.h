@@ -13,6 +13,7 @@
 
 #include "../../Common/NoClones.h"
 #include "../../Common/Allocators/PooledAlloc.h"
+#include "../../Common/Allocators/ContextTable.h"
 #include "PPMLanguageModel.h"
 #include "../SettingsStore.h"
 #include "../Alphabet/AlphInfo.h"
@@ -116,7 +117,8 @@ namespace Dasher {
 
     const int m_iSpaceSymbol;
     
-    CWordContext *m_rootcontext;
+    ///Template for new contexts (a slot in m_Contexts, never handed out)
+    Context m_rootcontext;
     CWordnode *m_pRoot;
 
     std::map < std::string, int >dict;  // Dictionary
@@ -133,7 +135,8 @@ namespace Dasher {
 
 
     mutable CSimplePooledAlloc < CWordnode > m_NodeAlloc;
-    CPooledAlloc < CWordContext > m_ContextAlloc;
+    ///Mutable as GetProbs caches the spelling model's predictions in the context
+    mutable CContextTable < CWordContext > m_Contexts;
   };
   /// \}
 
@@ -158,32 +161,31 @@ namespace Dasher {
 ///////////////////////////////////////////////////////////////////
 
   inline CLanguageModel::Context CWordLanguageModel::CreateEmptyContext() {
-    return CloneContext((Context)m_rootcontext);
+    return CloneContext(m_rootcontext);
   }
 
 ///////////////////////////////////////////////////////////////////
 
   inline CLanguageModel::Context CWordLanguageModel::CloneContext(Context Copy) {
-    CWordContext *pCont = m_ContextAlloc.Alloc();
-    CWordContext *pCopy = (CWordContext *) Copy;
-    *pCont = *pCopy;
+    Context cont = m_Contexts.Alloc();
+    CWordContext &context(m_Contexts.Get(cont));
+    context = m_Contexts.Get(Copy);
 
     // Create a clone of the spelling context
 
-    pCont->oSpellingContext = pCont->m_pSpellingModel->CloneContext(pCopy->oSpellingContext);
+    context.oSpellingContext = context.m_pSpellingModel->CloneContext(m_Contexts.Get(Copy).oSpellingContext);
 
-    return (Context) pCont;
+    return cont;
   }
 
 ///////////////////////////////////////////////////////////////////
 
   inline void CWordLanguageModel::ReleaseContext(Context release) {
-    // Urgh!
-    CWordContext *pCont(reinterpret_cast<CWordContext *>(release));
-    
-    pCont->m_pSpellingModel->ReleaseContext(pCont->oSpellingContext);
+    CWordContext &context(m_Contexts.Get(release));
+
+    context.m_pSpellingModel->ReleaseContext(context.oSpellingContext);
 
-    m_ContextAlloc.Free(pCont);
+    m_Contexts.Free(release);
   }
 
 ///////////////////////////////////////////////////////////////////
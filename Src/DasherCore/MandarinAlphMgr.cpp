@@ -48,7 +48,7 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 CMandarinAlphMgr::CMandarinAlphMgr(CSettingsUser *pCreator, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager, const CAlphInfo *pAlphabet)
-  : CAlphabetManager(pCreator, pInterface, pNCManager, pAlphabet) {
+  : CAlphabetManager(pCreator, pInterface, pNCManager, pAlphabet), m_iCHLabelBytes(0) {
   
   DASHER_ASSERT(pAlphabet->m_iConversionID==2);
 }
@@ -143,6 +143,11 @@ void CMandarinAlphMgr::MakeLabels(CDasherScreen *pScreen) {
   CAlphabetManager::MakeLabels(pScreen);
 }
 
+void CMandarinAlphMgr::GetMemoryUsage(SMemoryUsage &usage) const {
+  CAlphabetManager::GetMemoryUsage(usage);
+  usage.iLabels += m_iCHLabelBytes;
+}
+
 SGroupInfo *CMandarinAlphMgr::copyGroups(const SGroupInfo *in, CDasherScreen *pScreen) {
   return CAlphabetManager::copyGroups(in==m_pAlphabet ? m_pPYgroups : in, pScreen);
 }
@@ -154,7 +159,7 @@ const string &CMandarinAlphMgr::GetLabelText(symbol i) const {
 CMandarinAlphMgr::~CMandarinAlphMgr() {
   for (vector<CDasherScreen::Label *>::iterator it=m_vCHLabels.begin(); it!=m_vCHLabels.end(); it++)
     delete *it;
-  m_pPYgroups->RecursiveDelete();
+  SGroupInfo::RecursiveDelete(m_pPYgroups);
 }
 
 void CMandarinAlphMgr::CreateLanguageModel() {
@@ -262,12 +267,12 @@ void CMandarinAlphMgr::CMandarinTrainer::Train(CAlphabetMap::SymbolStream &syms)
 }
 
 
-CTrainer *CMandarinAlphMgr::GetTrainer() {
-  return new CMandarinTrainer(m_pInterface, this);
+CTrainer *CMandarinAlphMgr::GetTrainer(CMessageDisplay *pMsgs) {
+  return new CMandarinTrainer(pMsgs, this);
 }
 
 CAlphabetManager::CAlphNode *CMandarinAlphMgr::CreateSymbolRoot(int iOffset, CLanguageModel::Context ctx, symbol chSym) {
-  return new CMandSym(iOffset, this, chSym, 0);
+  return m_NodeAlloc.Make<CMandSym>(iOffset, this, chSym, 0);
 }
 
 int CMandarinAlphMgr::GetColour(symbol CHsym, int iOffset) const {
@@ -303,17 +308,17 @@ CDasherNode *CMandarinAlphMgr::CreateSymbolNode(CAlphNode *pParent, symbol iSymb
   if (convs.size()>1 || m_vLabels[iSymbol])
     return CreateConvRoot(pParent, iSymbol);
   //elide CConvRoot...
-  return CreateCHSymbol(pParent,pParent->iContext, *(convs.begin()), iSymbol);
+  return CreateCHSymbol(pParent,pParent->GetLMContext(), *(convs.begin()), iSymbol);
 }
 
 CMandarinAlphMgr::CConvRoot *CMandarinAlphMgr::CreateConvRoot(CAlphNode *pParent, symbol iPYsym) {
   
   // the same offset as we've still not entered/selected a symbol (leaf);
   // Colour is always 9 so ignore iBkgCol
-  CConvRoot *pConv = new CConvRoot(pParent->offset(), this, iPYsym);
+  CConvRoot *pConv = m_NodeAlloc.Make<CConvRoot>(pParent->offset(), this, iPYsym);
     
   // and use the same context too (pinyin syll+tone is _not_ used as part of the LM context)
-  pConv->iContext = m_pLanguageModel->CloneContext(pParent->iContext);
+  pConv->iContext = m_pLanguageModel->CloneContext(pParent->GetLMContext());
   return pConv;
 }
 
@@ -357,9 +362,11 @@ void CMandarinAlphMgr::CConvRoot::PopulateChildrenWithExisting(CMandSym *existin
 CMandarinAlphMgr::CMandSym *CMandarinAlphMgr::CreateCHSymbol(CDasherNode *pParent, CLanguageModel::Context iContext, symbol iCHsym, symbol iPYparent) {
   int iNewOffset = pParent->offset()+1;
   if (m_vCHtext[iCHsym] == "\r\n") iNewOffset++;
-  CMandSym *pNewNode = new CMandSym(iNewOffset, this, iCHsym, iPYparent);
-  pNewNode->iContext = m_pLanguageModel->CloneContext(iContext);
-  m_pLanguageModel->EnterSymbol(pNewNode->iContext, iCHsym);
+  CMandSym *pNewNode = m_NodeAlloc.Make<CMandSym>(iNewOffset, this, iCHsym, iPYparent);
+  //(parent may be a CConvRoot, so can't defer to CAlphNode::GetLMContext)
+  CLanguageModel::Context ctx = m_pLanguageModel->CloneContext(iContext);
+  m_pLanguageModel->EnterSymbol(ctx, iCHsym);
+  pNewNode->SetLMContext(ctx);
   return pNewNode;
 }
 
@@ -469,7 +476,9 @@ CDasherScreen::Label *CMandarinAlphMgr::GetCHLabel(int iCHsym) {
   } else if (m_vCHLabels[iCHsym]) {
     return m_vCHLabels[iCHsym];
   }
-  return m_vCHLabels[iCHsym] = m_pScreen->MakeLabel(m_vCHdisplayText[iCHsym]);
+  m_vCHLabels[iCHsym] = m_pScreen->MakeLabel(m_vCHdisplayText[iCHsym]);
+  m_iCHLabelBytes += m_vCHLabels[iCHsym]->Bytes();
+  return m_vCHLabels[iCHsym];
 }
 
 CMandarinAlphMgr::CMandSym::CMandSym(int iOffset, CMandarinAlphMgr *pMgr, symbol iSymbol, symbol pyParent)
@@ -515,7 +524,7 @@ void CMandarinAlphMgr::CMandSym::RebuildForwardsFromAncestor(CAlphNode *pNewNode
         //compute probability of each chinese symbol for that pinyin (=by filtering)
         // context is the same as the ancestor = previous chinese, as pinyin not part of context
         vector<pair<symbol, unsigned int> > vChineseProbs;
-        mgr()->GetConversions(vChineseProbs, *p_it, pNewNode->iContext);
+        mgr()->GetConversions(vChineseProbs, *p_it, pNewNode->GetLMContext());
         //now find us in that list
         long thisProb; //i.e. P(this pinyin) * P(this chinese | this pinyin)
         for (vector<pair<symbol,unsigned int> >::iterator c_it = vChineseProbs.begin(); ;) {
@@ -92,7 +92,7 @@ namespace Dasher {
     ~CMandarinAlphMgr();
     
     ///ACL: returns a MandarinTrainer too.
-    CTrainer *GetTrainer();
+    CTrainer *GetTrainer(CMessageDisplay *pMsgs);
     
     ///Disable game mode. The target sentence might appear in several places...!!
     CWordGeneratorBase *GetGameWords() {return NULL;}
@@ -117,6 +117,8 @@ namespace Dasher {
     
     ///Override just to cache the screen so we can make (CH) labels lazily
     void MakeLabels(CDasherScreen *pScreen);
+    ///Override to add the (CH) labels made so far
+    void GetMemoryUsage(SMemoryUsage &usage) const;
 
     ///Override just to create root of tree from m_pPYgroups instead of m_pAlphabet
     SGroupInfo *copyGroups(const SGroupInfo *pBase, CDasherScreen *pScreen);
@@ -165,6 +167,7 @@ namespace Dasher {
       void PopulateChildrenWithExisting(CMandSym *existing);
       int ExpectedNumChildren();
       CLanguageModel::Context iContext;
+      CLanguageModel::Context GetLMContext() {return iContext;}
       void SetFlag(int iFlag, bool bValue);
       const symbol m_pySym;
       ///A "symbol" to be rebuilt, is a PY sound, i.e. potentially this
@@ -227,6 +230,8 @@ namespace Dasher {
     int m_iCHpara;
     ///Labels for rehashed chinese symbols, as previous
     std::vector<CDasherScreen::Label *> m_vCHLabels;
+    ///Memory taken by the labels in m_vCHLabels
+    std::size_t m_iCHLabelBytes;
     
     ///Keys are sound (Pinyin) numbers, i.e. the first index in an SGroupInfo
     /// containing any child symbols; values are the list of target(CH) alphabet
@@ -32,6 +32,8 @@
 
 class CMessageDisplay {
 public:
+  virtual ~CMessageDisplay() {}
+
   ///Displays a message to the user - somehow. Two styles
   /// of message are supported: (1) modal messages, i.e. which interrupt text entry;
   /// these should be explicitly dismissed (somehow) before text entry resumes; and
@@ -0,0 +1,85 @@
+// NodeAllocator.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+#include "NodeAllocator.h"
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+std::size_t CNodeAllocator::s_iTotalLiveBytes = 0;
+
+CNodeAllocator::CNodeAllocator() : m_iLiveObjects(0), m_iLiveBytes(0), m_iReservedBytes(0) {
+}
+
+CNodeAllocator::~CNodeAllocator() {
+  for (std::vector<SHeader *>::iterator it = m_vSlabs.begin(); it != m_vSlabs.end(); it++)
+    delete[] *it;
+}
+
+void *CNodeAllocator::Alloc(std::size_t iSize) {
+  //Slot holds header + object, rounded up to a whole number of headers
+  const std::size_t iUnits = 1 + (iSize + sizeof(SHeader) - 1) / sizeof(SHeader);
+  if (iUnits >= m_vPools.size()) m_vPools.resize(iUnits + 1);
+  SPool &pool(m_vPools[iUnits]);
+  if (!pool.pFree) {
+    //Carve a new slab into slots, and chain them all onto the free list
+    const std::size_t iSlot = iUnits * sizeof(SHeader);
+    const std::size_t iNum = (SLAB_BYTES < iSlot) ? 1 : SLAB_BYTES / iSlot;
+    SHeader *pSlab = new SHeader[iUnits * iNum];
+    m_vSlabs.push_back(pSlab);
+    m_iReservedBytes += iSlot * iNum;
+    for (std::size_t i = iNum; i-- > 0; ) {
+      void **pSlot = reinterpret_cast<void **>(pSlab + i * iUnits);
+      *pSlot = pool.pFree;
+      pool.pFree = pSlot;
+    }
+  }
+  SHeader *pHeader = static_cast<SHeader *>(pool.pFree);
+  pool.pFree = *static_cast<void **>(pool.pFree);
+  pHeader->pAlloc = this;
+  m_iLiveObjects++;
+  m_iLiveBytes += iSize;
+  s_iTotalLiveBytes += iSize;
+  return pHeader + 1;
+}
+
+void CNodeAllocator::Free(void *p, std::size_t iSize) {
+  if (!p) return;
+  SHeader *pHeader = static_cast<SHeader *>(p) - 1;
+  CNodeAllocator *pAlloc = pHeader->pAlloc;
+  const std::size_t iUnits = 1 + (iSize + sizeof(SHeader) - 1) / sizeof(SHeader);
+  DASHER_ASSERT(iUnits < pAlloc->m_vPools.size() && pAlloc->m_iLiveObjects > 0);
+  SPool &pool(pAlloc->m_vPools[iUnits]);
+  *reinterpret_cast<void **>(pHeader) = pool.pFree;
+  pool.pFree = pHeader;
+  pAlloc->m_iLiveObjects--;
+  pAlloc->m_iLiveBytes -= iSize;
+  s_iTotalLiveBytes -= iSize;
+}
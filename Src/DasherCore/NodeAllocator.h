@@ -0,0 +1,95 @@
+// NodeAllocator.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __NodeAllocator_h__
+#define __NodeAllocator_h__
+
+#include "../Common/NoClones.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Dasher {
+
+/// \ingroup Model
+/// @{
+
+/// Allocates CDasherNodes (of all subclasses) in slabs, one pool per object size
+/// (so in effect per node type), each with a free list; so expanding and
+/// collapsing nodes many times per second does not go through the heap.
+/// Each node manager owns one (see CNodeManager), from which it makes all its nodes
+/// (by Make); deleting a node returns it to the allocator it came from. All nodes
+/// must be deleted before the allocator; slabs are only released then.
+class CNodeAllocator : private NoClones {
+public:
+  CNodeAllocator();
+  ~CNodeAllocator();
+
+  /// Make a node of type T (a CDasherNode subclass) from this allocator, passing
+  /// the arguments to its constructor. (Pointer arguments must be typed, i.e.
+  /// not a bare NULL.)
+  template<typename T, typename... Args> T *Make(Args&&... args) {
+    return new (this) T(std::forward<Args>(args)...);
+  }
+
+  /// Memory for an object of iSize bytes; used by CDasherNode::operator new.
+  void *Alloc(std::size_t iSize);
+  /// Return memory from Alloc (by whichever allocator made it) to its pool;
+  /// used by CDasherNode::operator delete, as the size must be that given to Alloc.
+  static void Free(void *p, std::size_t iSize);
+
+  /// Number of nodes currently allocated from this allocator
+  std::size_t GetLiveObjects() const {return m_iLiveObjects;}
+  /// Total size of those nodes (not inc. anything they allocate themselves)
+  std::size_t GetLiveBytes() const {return m_iLiveBytes;}
+  /// Total size of slabs held, whether in use or free
+  std::size_t GetReservedBytes() const {return m_iReservedBytes;}
+
+  /// Total size of nodes currently allocated, by all allocators
+  static std::size_t TotalLiveBytes() {return s_iTotalLiveBytes;}
+
+private:
+  /// Each object is preceded by a pointer back to its allocator
+  union SHeader {
+    CNodeAllocator *pAlloc;
+    double dAlign;
+  };
+  /// Objects in a pool are in slabs of (at least) this many bytes
+  static const std::size_t SLAB_BYTES = 16384;
+
+  struct SPool {
+    SPool() : pFree(NULL) {}
+    /// First free slot; each free slot holds the address of the next
+    void *pFree;
+  };
+  /// Pool for objects of (up to) i*sizeof(SHeader) bytes is m_vPools[i]
+  std::vector<SPool> m_vPools;
+  std::vector<SHeader *> m_vSlabs;
+
+  std::size_t m_iLiveObjects, m_iLiveBytes, m_iReservedBytes;
+  static std::size_t s_iTotalLiveBytes;
+};
+
+/// @}
+
+}
+
+#endif // __NodeAllocator_h__
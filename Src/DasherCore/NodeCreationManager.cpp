@@ -5,24 +5,122 @@
 #include "RoutingAlphMgr.h"
 #include "ConvertingAlphMgr.h"
 #include "ControlManager.h"
+#include "TrainingCache.h"
 #include "Observable.h"
 
 #include <string.h>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 using namespace Dasher;
 
+namespace Dasher {
+///Passes progress and messages from a thread training the LM in the background,
+/// to the interface: they are stored until the thread that started training
+/// calls Poll. Once training has finished, messages are passed straight on.
+class CTrainingStatus : public CMessageDisplay {
+public:
+  CTrainingStatus(CDasherInterfaceBase *pInterface)
+  : m_pInterface(pInterface), m_pCache(NULL), m_pUserCache(NULL), m_bDeferring(false), m_bCancel(false), m_bDone(false),
+    m_bSystem(false), m_bUser(false), m_iPercent(-1), m_iReported(-1) { }
+  ///Stops the thread, if it's still training.
+  ~CTrainingStatus() {
+    m_bCancel = true;
+    if (m_thread.joinable()) m_thread.join();
+    delete m_pCache;
+    delete m_pUserCache;
+  }
+  void Message(const string &strText, bool bInterrupt) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_bDeferring) {
+        m_vMessages.push_back(make_pair(strText, bInterrupt));
+        return;
+      }
+    }
+    m_pInterface->Message(strText, bInterrupt);
+  }
+  void SetProgress(const string &strText, int iPercent) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_strText = strText;
+    m_iPercent = iPercent;
+  }
+  ///Pass on progress & messages so far; returns true (having joined the
+  /// thread) if it has finished training.
+  bool Poll(bool bWait) {
+    if (bWait && m_thread.joinable()) m_thread.join();
+    //read before the messages, so none the thread sent before finishing are missed
+    const bool bDone(m_bDone);
+    vector<pair<string, bool> > vMessages;
+    string strText;
+    int iPercent;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      vMessages.swap(m_vMessages);
+      strText = m_strText;
+      iPercent = m_iPercent;
+      if (bDone) m_bDeferring = false;
+    }
+    for (vector<pair<string, bool> >::iterator it = vMessages.begin(); it != vMessages.end(); it++)
+      m_pInterface->Message(it->first, it->second);
+    if (!bDone) {
+      if (iPercent != m_iReported || strText != m_strReported)
+        m_pInterface->SetTrainingStatus(m_strReported = strText, m_iReported = iPercent);
+      return false;
+    }
+    if (m_thread.joinable()) m_thread.join();
+    return true;
+  }
+
+  CDasherInterfaceBase * const m_pInterface;
+  ///Made on the UI thread, used by the training thread; for a layered LM,
+  /// m_pCache holds the base, and m_pUserCache the overlay (else NULL)
+  CTrainingCache *m_pCache, *m_pUserCache;
+  std::thread m_thread;
+  ///Whether messages are being stored for Poll, rather than passed straight on
+  bool m_bDeferring;
+  ///Set to tell the thread to stop training as soon as it can
+  std::atomic<bool> m_bCancel;
+  ///Set by the thread when it has finished
+  std::atomic<bool> m_bDone;
+  ///Whether system/user training text was found; valid once m_bDone
+  bool m_bSystem, m_bUser;
+private:
+  std::mutex m_mutex;
+  vector<pair<string, bool> > m_vMessages;
+  string m_strText, m_strReported;
+  int m_iPercent, m_iReported;
+};
+}
+
 //Wraps the ParseFile of a provided Trainer, to setup progress notification
 // - and then passes self, as a ProgressIndicator, to the Trainer's ParseFile method.
+// If given a CTrainingStatus (i.e. when training in the background), reports
+// progress to that, and stops reading when it is cancelled; otherwise locks Dasher.
 class ProgressNotifier : public AbstractParser, private CTrainer::ProgressIndicator {
 public:
-  ProgressNotifier(CDasherInterfaceBase *pInterface, CTrainer *pTrainer)
-  : AbstractParser(pInterface), m_bSystem(false), m_bUser(false), m_pInterface(pInterface), m_pTrainer(pTrainer) { }
+  ProgressNotifier(CDasherInterfaceBase *pInterface, CTrainer *pTrainer, CTrainingStatus *pStatus=NULL)
+  : AbstractParser(pStatus ? static_cast<CMessageDisplay *>(pStatus) : pInterface), m_bSystem(false), m_bUser(false),
+    m_pInterface(pInterface), m_pTrainer(pTrainer), m_pStatus(pStatus), m_pResume(NULL), m_bFilter(false), m_pIn(NULL) { }
   void bytesRead(off_t n) {
+    if (m_pStatus && m_pStatus->m_bCancel) {
+      //make the trainer think it has reached the end of the file
+      m_pIn->setstate(ios::failbit);
+      return;
+    }
     int iNewPercent = ((m_iStart + n)*100)/m_iStop;
     if (iNewPercent != m_iPercent) {
-      m_pInterface->SetLockStatus(m_strDisplay, m_iPercent = iNewPercent);
+      Report(m_iPercent = iNewPercent);
     }
   }
+  ///Only train on the parts of files the LM hasn't already seen, i.e. as loaded
+  /// by CTrainingCache::Restore: files not in the map are skipped entirely,
+  /// files in it are trained from the given offset.
+  void SetResume(const map<string, off_t> *pResume) {m_pResume = pResume;}
+  ///Only train on user files (if bUser) or system files (if not), skipping the others
+  void SetOnly(bool bUser) {m_bFilter = true; m_bOnlyUser = bUser;}
   bool ParseFile(const string &strFilename, bool bUser) {
     m_iStart = 0;
     m_iStop = m_pInterface->GetFileSize(strFilename);
@@ -30,17 +128,40 @@ public:
     return AbstractParser::ParseFile(strFilename, bUser);
   }
   bool Parse(const string &strUrl, istream &in, bool bUser) {
+    if (m_pStatus && m_pStatus->m_bCancel) return false;
+    if (m_bFilter && bUser != m_bOnlyUser) return true;
+    if (m_pResume) {
+      map<string, off_t>::const_iterator it = m_pResume->find(strUrl);
+      if (it == m_pResume->end()) {
+        //already in the model
+        if (bUser) m_bUser=true; else m_bSystem=true;
+        return true;
+      }
+      in.seekg(m_iStart = it->second);
+    }
     m_strDisplay = bUser ? _("Training on User Text") : _("Training on System Text");
-    m_pInterface->SetLockStatus(m_strDisplay, m_iPercent=0);
+    Report(m_iPercent=0);
+    m_pIn = &in;
     m_pTrainer->SetProgressIndicator(this);
-    if (!m_pTrainer->Parse(strUrl, in, bUser)) return false;
+    bool bOk = m_pTrainer->Parse(strUrl, in, bUser);
+    m_pTrainer->SetProgressIndicator(NULL);
+    m_pIn = NULL;
+    if (!bOk) return false;
     if (bUser) m_bUser=true; else m_bSystem=true;
     return true;
   }
   bool m_bSystem, m_bUser;
 private:
+  void Report(int iPercent) {
+    if (m_pStatus) m_pStatus->SetProgress(m_strDisplay, iPercent);
+    else m_pInterface->SetLockStatus(m_strDisplay, iPercent);
+  }
   CDasherInterfaceBase *m_pInterface;
   CTrainer *m_pTrainer;
+  CTrainingStatus *m_pStatus;
+  const map<string, off_t> *m_pResume;
+  bool m_bFilter, m_bOnlyUser;
+  istream *m_pIn;
   off_t m_iStart, m_iStop;
   int m_iPercent;
   string m_strDisplay;
@@ -52,7 +173,7 @@ CNodeCreationManager::CNodeCreationManager(
   const Dasher::CAlphIO *pAlphIO,
   const Dasher::CControlBoxIO *pControlBoxIO
   ) : CSettingsUserObserver(pCreateFrom),
-  m_pInterface(pInterface), m_pControlManager(NULL), m_pScreen(NULL) {
+  m_pInterface(pInterface), m_pStatus(new CTrainingStatus(pInterface)), m_pControlManager(NULL), m_pScreen(NULL) {
 
   const Dasher::CAlphInfo *pAlphInfo(pAlphIO->GetInfo(GetStringParameter(SP_ALPHABET_ID)));
 
@@ -80,22 +201,8 @@ CNodeCreationManager::CNodeCreationManager(
   //all other configuration changes, etc., that might be necessary for a particular conversion mode,
   // are implemented by AlphabetManager subclasses overriding the following two methods:
   m_pAlphabetManager->Setup();
-  m_pTrainer = m_pAlphabetManager->GetTrainer();
-    
-  if (!pAlphInfo->GetTrainingFile().empty()) {
-    ProgressNotifier pn(pInterface, m_pTrainer);
-    pInterface->ScanFiles(&pn,pAlphInfo->GetTrainingFile());
-    if (!pn.m_bUser) {
-      ///TRANSLATORS: These 3 messages will be displayed when the user has just chosen a new alphabet. The %s parameter will be the name of the alphabet.
-      const char *msg = pn.m_bSystem ? _("No user training text found - if you have written in \"%s\" before, this means Dasher may not be learning from previous sessions")
-      : _("No training text (user or system) found for \"%s\". Dasher will still work but entry will be slower. We suggest downloading a training text file from the Dasher website, or constructing your own.");
-      pInterface->FormatMessageWithString(msg, pAlphInfo->GetID().c_str());
-    }
-    //3. Finished, so unlock.
-    m_pInterface->SetLockStatus("", -1);
-  }  else {
-    pInterface->FormatMessageWithString(_("\"%s\" does not specify training file. Dasher will work but entry will be slower. Check you have the latest version of the alphabet definition."), pAlphInfo->GetID().c_str());
-  }
+  m_pTrainer = m_pAlphabetManager->GetTrainer(m_pStatus);
+
 #ifdef DEBUG_LM_READWRITE
   {
     //test...
@@ -116,12 +223,84 @@ CNodeCreationManager::CNodeCreationManager(
 }
 
 CNodeCreationManager::~CNodeCreationManager() {
+  //first stop any training, which uses the LM and trainer
+  delete m_pStatus;
   delete m_pAlphabetManager;
   delete m_pTrainer;
   
   delete m_pControlManager;
 }
 
+bool CNodeCreationManager::StartTraining() {
+  const CAlphInfo *pAlphInfo(GetAlphabet());
+  if (pAlphInfo->GetTrainingFile().empty()) {
+    m_pInterface->FormatMessageWithString(_("\"%s\" does not specify training file. Dasher will work but entry will be slower. Check you have the latest version of the alphabet definition."), pAlphInfo->GetID().c_str());
+    return false;
+  }
+  if (CLayeredPPMLanguageModel *pLayered = m_pTrainer->GetLayeredModel()) {
+    m_pStatus->m_pCache = new CTrainingCache(this, m_pInterface, pAlphInfo, pLayered, false);
+    m_pStatus->m_pUserCache = new CTrainingCache(this, m_pInterface, pAlphInfo, pLayered, true);
+  } else
+    m_pStatus->m_pCache = new CTrainingCache(this, m_pInterface, pAlphInfo, m_pTrainer->GetLanguageModel());
+  m_pStatus->m_bDeferring = true;
+  m_pStatus->m_thread = std::thread(&CNodeCreationManager::Train, this);
+  return true;
+}
+
+void CNodeCreationManager::Train() {
+  ProgressNotifier pn(m_pInterface, m_pTrainer, m_pStatus);
+  //Load the model from cache if we can; then we need only train on any
+  // text appended to the user training file since.
+  map<string, off_t> mTails;
+  if (CLayeredPPMLanguageModel *pLayered = m_pTrainer->GetLayeredModel()) {
+    //Learn the system text first, and freeze it into the base, so that the
+    // overlay learns (and its cache holds) only the user's text.
+    pn.SetOnly(false);
+    if (m_pStatus->m_pCache->Restore(mTails)) pn.SetResume(&mTails);
+    m_pInterface->ScanFiles(&pn, GetAlphabet()->GetTrainingFile());
+    //(Freeze fails only if contexts are in use; then leave everything in the
+    // overlay, and cache neither layer)
+    const bool bFrozen(!m_pStatus->m_bCancel && pLayered->Freeze());
+    if (bFrozen) m_pStatus->m_pCache->Store();
+    pn.SetOnly(true);
+    pn.SetResume(NULL);
+    mTails.clear();
+    if (bFrozen && m_pStatus->m_pUserCache->Restore(mTails)) pn.SetResume(&mTails);
+    m_pInterface->ScanFiles(&pn, GetAlphabet()->GetTrainingFile());
+    if (bFrozen && !m_pStatus->m_bCancel) m_pStatus->m_pUserCache->Store();
+  } else {
+    if (m_pStatus->m_pCache->Restore(mTails)) pn.SetResume(&mTails);
+    m_pInterface->ScanFiles(&pn, GetAlphabet()->GetTrainingFile());
+    //Don't cache a model we stopped training part way through
+    if (!m_pStatus->m_bCancel) m_pStatus->m_pCache->Store();
+  }
+  m_pStatus->m_bSystem = pn.m_bSystem;
+  m_pStatus->m_bUser = pn.m_bUser;
+  m_pStatus->m_bDone = true;
+}
+
+bool CNodeCreationManager::PollTraining(bool bWait) {
+  if (!m_pStatus->Poll(bWait)) return false;
+  if (!m_pStatus->m_bUser) {
+    ///TRANSLATORS: These 3 messages will be displayed when the user has just chosen a new alphabet. The %s parameter will be the name of the alphabet.
+    const char *msg = m_pStatus->m_bSystem ? _("No user training text found - if you have written in \"%s\" before, this means Dasher may not be learning from previous sessions")
+    : _("No training text (user or system) found for \"%s\". Dasher will still work but entry will be slower. We suggest downloading a training text file from the Dasher website, or constructing your own.");
+    m_pInterface->FormatMessageWithString(msg, GetAlphabet()->GetID().c_str());
+  }
+  //Finished, so remove the progress report
+  m_pInterface->SetTrainingStatus("", -1);
+  return true;
+}
+
+void CNodeCreationManager::TakeOverTrainText(CNodeCreationManager *pOld) {
+  const string strText(pOld->m_pAlphabetManager->TakeTrainText());
+  if (strText.empty()) return;
+  m_pInterface->WriteTrainFile(GetAlphabet()->GetTrainingFile(), strText);
+  //This is in training file format, so just feed it to our trainer
+  istringstream in(strText);
+  m_pTrainer->Parse("", in, true);
+}
+
 void CNodeCreationManager::ChangeScreen(CDasherScreen *pScreen) {
   if (m_pScreen == pScreen) return;
   m_pScreen = pScreen;
@@ -129,6 +308,13 @@ void CNodeCreationManager::ChangeScreen(CDasherScreen *pScreen) {
   if (m_pControlManager) m_pControlManager->ChangeScreen(pScreen);
 }
 
+SMemoryUsage CNodeCreationManager::GetMemoryUsage() const {
+  SMemoryUsage usage;
+  m_pAlphabetManager->GetMemoryUsage(usage);
+  if (m_pControlManager) m_pControlManager->GetMemoryUsage(usage);
+  return usage;
+}
+
 void CNodeCreationManager::CreateControlBox(const CControlBoxIO* pControlIO) {
   delete m_pControlManager;
   unsigned long iControlSpace;
@@ -146,18 +332,21 @@ void CNodeCreationManager::CreateControlBox(const CControlBoxIO* pControlIO) {
 }
 
 void CNodeCreationManager::AddExtras(CDasherNode *pParent) {
-  //control mode:
-  DASHER_ASSERT(pParent->GetChildren().back()->Hbnd() == m_iAlphNorm);
+  //control mode: goes above the alphabet children - which, if the parent makes
+  // them only when onscreen (NF_LAZY), may not have been made yet.
+  DASHER_ASSERT(pParent->GetFlag(NF_LAZY) || pParent->GetChildren().back()->Hbnd() == m_iAlphNorm);
   if (m_pControlManager) {
     //ACL leave offset as is - like its groupnode parent, but unlike its alphnode siblings,
     //the control node does not enter a symbol....
     CDasherNode *ctl = m_pControlManager->GetRoot(pParent, pParent->offset());
-    ctl->Reparent(pParent, pParent->GetChildren().back()->Hbnd(), CDasherModel::NORMALIZATION);
+    ctl->Reparent(pParent, m_iAlphNorm, CDasherModel::NORMALIZATION);
   }
 }
 
 void 
 CNodeCreationManager::ImportTrainingText(const std::string &strPath) {
+  m_pAlphabetManager->StopSpeculating();
   ProgressNotifier pn(m_pInterface, m_pTrainer);
 	pn.ParseFile(strPath, true);
+  m_pAlphabetManager->ModelChanged();
 }
@@ -6,6 +6,7 @@
 #include "AlphabetManager.h"
 #include "ConversionManager.h"
 #include "ControlManager.h"
+#include "NodeManager.h"
 #include "LanguageModelling/LanguageModel.h"
 #include "Trainer.h"
 #include "Event.h"
@@ -20,17 +21,41 @@ namespace Dasher {
   class CControlManager;
   class CDasherScreen;
   class CControlBoxIO;
+  class CTrainingStatus;
 }
 //TODO why is CNodeCreationManager _not_ in namespace Dasher?!?!
 /// \ingroup Model
 /// @{
 class CNodeCreationManager : public Dasher::CSettingsUserObserver {
  public:
+  ///Creates the managers for the current alphabet (SP_ALPHABET_ID), with an
+  /// untrained language model; see StartTraining.
   CNodeCreationManager(Dasher::CSettingsUser *pCreateFrom,
                        Dasher::CDasherInterfaceBase *pInterface,
                        const Dasher::CAlphIO *pAlphIO,
                        const Dasher::CControlBoxIO *pControlBoxIO);
+  ///Stops any training still in progress (waiting for the thread to notice).
   ~CNodeCreationManager();
+
+  ///Starts training the language model on the alphabet's training files, on a
+  /// new thread. Until PollTraining returns true, nothing else may use the model
+  /// (so the manager should not be used to build nodes); meanwhile, progress and
+  /// any messages are held for PollTraining to pass on.
+  /// \return false (having told the user) if the alphabet has no training file,
+  /// i.e. there is nothing to do; the manager may then be used straightaway.
+  bool StartTraining();
+
+  ///Called periodically, on the thread which called StartTraining, to report progress
+  /// (via CDasherInterfaceBase::SetTrainingStatus) and any messages from the trainer.
+  /// \param bWait if true, don't return until training has finished.
+  /// \return true if training has finished, i.e. the manager is now usable.
+  bool PollTraining(bool bWait);
+
+  ///Learn (and write to the training file) anything written using another
+  /// manager for the same alphabet, which this one is about to replace. Call
+  /// only once training has finished: the other manager holds back any text
+  /// written while this one was training (see CAlphabetManager::WriteTrainFileFull).
+  void TakeOverTrainText(CNodeCreationManager *pOld);
   
   ///Tells us the screen on which all created node labels must be rendered
   void ChangeScreen(Dasher::CDasherScreen *pScreen);
@@ -47,6 +72,9 @@ class CNodeCreationManager : public Dasher::CSettingsUserObserver {
   Dasher::CAlphabetManager *GetAlphabetManager() {return m_pAlphabetManager;}
 
   Dasher::CControlManager *GetControlManager() {return m_pControlManager;}
+
+  ///Memory used by the nodes of all our managers (see CNodeManager::GetMemoryUsage)
+  Dasher::SMemoryUsage GetMemoryUsage() const;
   
   ///
   /// Get a reference to the current alphabet
@@ -64,9 +92,15 @@ class CNodeCreationManager : public Dasher::CSettingsUserObserver {
   /// Default is just to add the control node, if appropriate.
   void AddExtras(Dasher::CDasherNode *pParent);
  private:
+  ///Body of the thread started by StartTraining
+  void Train();
+
   Dasher::CTrainer *m_pTrainer;
-  
+
   Dasher::CDasherInterfaceBase *m_pInterface;
+
+  ///Messages from the trainer, and progress of training in the background
+  Dasher::CTrainingStatus *m_pStatus;
   
   Dasher::CAlphabetManager *m_pAlphabetManager;
   Dasher::CControlManager *m_pControlManager;
@@ -1,10 +1,50 @@
 #ifndef __nodemanager_h__
 #define __nodemanager_h__
+
+#include "NodeAllocator.h"
+
+#include <cstddef>
+
 namespace Dasher {
-  
-  /// A marker class for anything that can be returned by CDasherNode::mgr()
+
+  /// Memory (in bytes) used by the nodes of a node manager, and by the manager
+  /// on their behalf; see CNodeManager::GetMemoryUsage.
+  struct SMemoryUsage {
+    SMemoryUsage() : iNodes(0), iProbs(0), iContexts(0), iLabels(0) {}
+    ///Node objects themselves (see CNodeAllocator), and their places in their
+    /// parents' child lists (which are made to exactly the right size)
+    std::size_t iNodes;
+    ///Probability tables computed for nodes
+    std::size_t iProbs;
+    ///Language model contexts
+    std::size_t iContexts;
+    ///Labels, as far as known (see CDasherScreen::Label::Bytes)
+    std::size_t iLabels;
+    std::size_t Total() const {return iNodes + iProbs + iContexts + iLabels;}
+  };
+
+  /// Superclass of anything that can be returned by CDasherNode::mgr()
   ///  - as a void* return type can't be covariantly overridden :-(
+  /// Each manager has its own CNodeAllocator, so the memory its nodes use
+  /// can be accounted for separately.
   class CNodeManager {
+  public:
+    virtual ~CNodeManager() {}
+    ///Add to usage the memory used by this manager's nodes, and what it holds
+    /// for them. The default counts just the node objects; subclasses add the rest.
+    virtual void GetMemoryUsage(SMemoryUsage &usage) const {
+      usage.iNodes += m_NodeAlloc.GetLiveBytes() + m_NodeAlloc.GetLiveObjects() * sizeof(void *);
+    }
+    ///Average memory per node currently made (inc. its place in its parent's
+    /// child list), in bytes; 0 if none.
+    std::size_t AverageNodeBytes() const {
+      const std::size_t iNodes(m_NodeAlloc.GetLiveObjects());
+      return iNodes ? m_NodeAlloc.GetLiveBytes() / iNodes + sizeof(void *) : 0;
+    }
+  protected:
+    ///All nodes this manager makes must come from here (see CNodeAllocator::Make);
+    /// so the manager must not be deleted until all its nodes have been.
+    CNodeAllocator m_NodeAlloc;
   };
 }
 #endif
@@ -33,17 +33,15 @@ bool COneButtonFilter::DecorateView(CDasherView *pView, CDasherInput *pInput) {
       return true;
     }
     //reverse!
+    const myint x[4] = {2048, 4096, 4096, 2048}, y[4] = {0, 0, 4096, 4096};
     CDasherScreen::point p[4];
-    pView->Dasher2Screen(2048, 0, p[0].x, p[0].y);
-    pView->Dasher2Screen(4096, 0, p[1].x, p[1].y);
-    pView->Dasher2Screen(4096, 4096, p[2].x, p[2].y);
-    pView->Dasher2Screen(2048, 4096, p[3].x, p[3].y);
+    pView->Dasher2Screen(x, y, p, 4);
     pScreen->Polyline(p, 4, 1, 1);
   } else {
+    const myint x[2] = {-100, -1000}, y[2] = {iLocation, iLocation};
     CDasherScreen::point p[2];
 
-    pView->Dasher2Screen(-100, iLocation, p[0].x, p[0].y);
-    pView->Dasher2Screen(-1000, iLocation, p[1].x, p[1].y);
+    pView->Dasher2Screen(x, y, p, 2);
     pScreen->Polyline(p, 2, 1, 1);
   }
   m_bNoDecorations = false;
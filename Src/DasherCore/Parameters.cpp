@@ -125,6 +125,11 @@ const lp_table longparamtable[] = {
   {LP_X_LIMIT_SPEED, "XLimitSpeed", Persistence::PERSISTENT, 800, "X Co-ordinate at which maximum speed is reached (&lt;2048=xhair)"},
   {LP_GAME_HELP_DIST, "GameHelpDistance", Persistence::PERSISTENT, 1920, "Distance of sentence from center to decide user needs help"},
   {LP_GAME_HELP_TIME, "GameHelpTime", Persistence::PERSISTENT, 0, "Time for which user must need help before help drawn"},
+  {LP_LM_MAX_NODES, "LMMaxNodes", Persistence::PERSISTENT, 0, "Max nodes in PPM trie before counts are halved and rare contexts pruned (0=unlimited)"},
+  {LP_LAZY_CHILDREN, "LazyChildren", Persistence::PERSISTENT, 0, "Make only onscreen children of nodes with at least this many (0=always make all)"},
+  {LP_NODE_MEMORY_BUDGET, "NodeMemoryBudget", Persistence::PERSISTENT, 0, "Max memory (in KB) for nodes and their probability tables, contexts and labels (0=no limit)"},
+  {LP_ROOT_HISTORY_BUDGET, "RootHistoryBudget", Persistence::PERSISTENT, 256, "Max memory (in KB) for old roots kept for reversing; half for whole nodes, half for recipes to remake them"},
+  {LP_SPECULATION_THREADS, "SpeculationThreads", Persistence::PERSISTENT, 1, "Threads computing probabilities for nodes likely to be expanded soon (0=none; at most one less than the number of cores)"},
 };
 
 const sp_table stringparamtable[] = {
@@ -64,7 +64,8 @@ enum {
   LP_DEMO_SPRING, LP_DEMO_NOISE_MEM, LP_DEMO_NOISE_MAG, LP_MAXZOOM, 
   LP_DYNAMIC_SPEED_INC, LP_DYNAMIC_SPEED_FREQ, LP_DYNAMIC_SPEED_DEC,
   LP_TAP_TIME, LP_MARGIN_WIDTH, LP_TARGET_OFFSET, LP_X_LIMIT_SPEED,
-  LP_GAME_HELP_DIST, LP_GAME_HELP_TIME,
+  LP_GAME_HELP_DIST, LP_GAME_HELP_TIME, LP_LM_MAX_NODES, LP_LAZY_CHILDREN, LP_NODE_MEMORY_BUDGET,
+  LP_ROOT_HISTORY_BUDGET, LP_SPECULATION_THREADS,
   END_OF_LPS
 };
 
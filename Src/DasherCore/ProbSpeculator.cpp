@@ -0,0 +1,108 @@
+// ProbSpeculator.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+#include "ProbSpeculator.h"
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CProbSpeculator::CProbSpeculator(unsigned int iThreads, const Compute &fnCompute)
+  : m_iThreads(iThreads), m_fnCompute(fnCompute), m_iBusy(0), m_iGeneration(0), m_bQuit(false) {
+  DASHER_ASSERT(iThreads > 0);
+}
+
+CProbSpeculator::~CProbSpeculator() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bQuit = true;
+  }
+  m_cvWork.notify_all();
+  for (std::vector<std::thread>::iterator it = m_vThreads.begin(); it != m_vThreads.end(); it++)
+    it->join();
+}
+
+void CProbSpeculator::Request(std::size_t key) {
+  DASHER_ASSERT(key);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_sPending.count(key) || m_mResults.count(key)) return;
+    if (m_deQueue.size() >= MAX_QUEUE) {
+      m_sPending.erase(m_deQueue.front());
+      m_deQueue.pop_front();
+    }
+    m_deQueue.push_back(key);
+    m_sPending.insert(key);
+    if (m_vThreads.empty())
+      for (unsigned int i = 0; i < m_iThreads; i++)
+        m_vThreads.push_back(std::thread(&CProbSpeculator::Work, this));
+  }
+  m_cvWork.notify_one();
+}
+
+bool CProbSpeculator::Take(std::size_t key, Table &table) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::map<std::size_t, Table>::iterator it = m_mResults.find(key);
+  if (it == m_mResults.end()) return false;
+  table.swap(it->second);
+  m_mResults.erase(it);
+  return true;
+}
+
+void CProbSpeculator::Stop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_deQueue.clear();
+  m_sPending.clear();
+  m_mResults.clear();
+  m_iGeneration++;
+  m_cvIdle.wait(lock, [this]() {return m_iBusy == 0;});
+}
+
+void CProbSpeculator::Work() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cvWork.wait(lock, [this]() {return m_bQuit || !m_deQueue.empty();});
+    if (m_bQuit) return;
+    const std::size_t key = m_deQueue.front();
+    m_deQueue.pop_front();
+    const unsigned int iGeneration = m_iGeneration;
+    m_iBusy++;
+    //compute without the lock, so others can queue or take meanwhile
+    lock.unlock();
+    Table table;
+    const bool bOk = m_fnCompute(key, table);
+    lock.lock();
+    m_iBusy--;
+    if (iGeneration == m_iGeneration) {
+      m_sPending.erase(key);
+      if (bOk && m_mResults.size() < MAX_RESULTS) m_mResults[key].swap(table);
+    }
+    if (!m_iBusy) m_cvIdle.notify_all();
+  }
+}
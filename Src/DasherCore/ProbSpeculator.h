@@ -0,0 +1,105 @@
+// ProbSpeculator.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __ProbSpeculator_h__
+#define __ProbSpeculator_h__
+
+#include "../Common/NoClones.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace Dasher {
+
+/// \ingroup Model
+/// @{
+
+/// Computes probability tables on worker threads, for nodes likely to be
+/// expanded soon (see CDasherNode::PrepareChildren), so that expanding them
+/// later need only pick up the result. Requests and results are identified by
+/// context key (see CLanguageModel::ContextKey); the computation itself is
+/// supplied by the owner, and must be safe to run on several threads at once
+/// (e.g. using CLanguageModel::GetProbsForKey).
+///
+/// The owner must call Stop before doing anything that could change the results
+/// (e.g. learning), or make the keys invalid. Threads are started by the first
+/// Request, so a speculator never asked for anything costs nothing.
+class CProbSpeculator : private NoClones {
+public:
+  typedef std::vector<unsigned int> Table;
+  /// Fill in the table for a key; returns false if it can't. Called on the workers.
+  typedef std::function<bool(std::size_t, Table &)> Compute;
+
+  CProbSpeculator(unsigned int iThreads, const Compute &fnCompute);
+  /// Waits for the workers to finish what they are doing.
+  ~CProbSpeculator();
+
+  /// Ask for the table for a (nonzero) key, unless already asked for or
+  /// computed. Requests are served oldest first; beyond MAX_QUEUE waiting, the
+  /// oldest are dropped.
+  void Request(std::size_t key);
+  /// If the table for a key has been computed, swap it into table (and forget it).
+  bool Take(std::size_t key, Table &table);
+  /// Drop all requests and results, waiting for any computation in progress to
+  /// finish (and then discarding that too).
+  void Stop();
+
+  /// Most requests to keep waiting
+  static const unsigned int MAX_QUEUE = 64;
+  /// Most results to keep, if not taken
+  static const unsigned int MAX_RESULTS = 64;
+
+private:
+  /// Body of each worker thread
+  void Work();
+
+  const unsigned int m_iThreads;
+  const Compute m_fnCompute;
+  std::vector<std::thread> m_vThreads;
+
+  /// Protects everything below
+  std::mutex m_mutex;
+  /// Signalled when a request is added, or we are quitting
+  std::condition_variable m_cvWork;
+  /// Signalled when no computation is in progress
+  std::condition_variable m_cvIdle;
+  std::deque<std::size_t> m_deQueue;
+  /// Keys queued or being computed
+  std::set<std::size_t> m_sPending;
+  std::map<std::size_t, Table> m_mResults;
+  /// Number of computations in progress
+  unsigned int m_iBusy;
+  /// Incremented by Stop, so results of computations then in progress are dropped
+  unsigned int m_iGeneration;
+  bool m_bQuit;
+};
+
+/// @}
+
+}
+
+#endif // __ProbSpeculator_h__
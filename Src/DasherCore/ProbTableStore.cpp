@@ -0,0 +1,163 @@
+// ProbTableStore.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+#include "ProbTableStore.h"
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CProbTableStore::CProbTableStore() : m_pOldest(NULL), m_pNewest(NULL), m_iIdle(0), m_iIdleBytes(0), m_iInUse(0), m_iBytes(0) {
+}
+
+CProbTableStore::~CProbTableStore() {
+  DASHER_ASSERT(m_iInUse == 0);
+  while (SEntry *pEntry = m_pOldest) {
+    unlink(pEntry);
+    delete pEntry;
+  }
+}
+
+CProbTableStore::Table *CProbTableStore::Find(std::size_t key) {
+  if (!key) {
+    m_stats.iUnkeyed++;
+    return NULL;
+  }
+  std::map<std::size_t, SEntry *>::iterator it = m_mIndex.find(key);
+  if (it == m_mIndex.end()) {
+    m_stats.iMissed++;
+    return NULL;
+  }
+  SEntry *pEntry = it->second;
+  if (pEntry->iRefs++ == 0) {
+    unlink(pEntry);
+    m_iInUse++;
+    m_stats.iRehydrated++;
+  } else m_stats.iShared++;
+  return pEntry;
+}
+
+CProbTableStore::Table *CProbTableStore::Alloc() {
+  SEntry *pEntry = m_pOldest;
+  if (pEntry && (pEntry->key == 0 || m_iIdle > MIN_IDLE || m_iIdleBytes > MAX_IDLE_BYTES/2)) {
+    //recycle, keeping the buffer
+    forget(pEntry);
+  } else {
+    pEntry = new SEntry();
+    pEntry->key = 0;
+    pEntry->iBytes = sizeof(SEntry);
+    m_iBytes += pEntry->iBytes;
+  }
+  pEntry->iRefs = 1;
+  m_iInUse++;
+  return pEntry;
+}
+
+void CProbTableStore::Insert(std::size_t key, Table *pTable) {
+  SEntry *pEntry = static_cast<SEntry *>(pTable);
+  DASHER_ASSERT(pEntry->iRefs > 0 && pEntry->key == 0);
+  const std::size_t iBytes(sizeof(SEntry) + pEntry->capacity() * sizeof(unsigned int));
+  m_iBytes += iBytes - pEntry->iBytes;
+  pEntry->iBytes = iBytes;
+  if (key && m_mIndex.insert(std::make_pair(key, pEntry)).second)
+    pEntry->key = key;
+}
+
+void CProbTableStore::Release(Table *pTable) {
+  SEntry *pEntry = static_cast<SEntry *>(pTable);
+  DASHER_ASSERT(pEntry->iRefs > 0);
+  if (--pEntry->iRefs) return;
+  m_iInUse--;
+  link(pEntry);
+  while (m_iIdle > MAX_IDLE || m_iIdleBytes > MAX_IDLE_BYTES) {
+    SEntry *pOld = m_pOldest;
+    forget(pOld);
+    m_iBytes -= pOld->iBytes;
+    delete pOld;
+  }
+}
+
+void CProbTableStore::Clear() {
+  for (std::map<std::size_t, SEntry *>::iterator it = m_mIndex.begin(); it != m_mIndex.end(); it++)
+    it->second->key = 0;
+  m_mIndex.clear();
+}
+
+void CProbTableStore::GetKeys(std::vector<std::size_t> &vKeys) const {
+  vKeys.clear();
+  for (std::map<std::size_t, SEntry *>::const_iterator it = m_mIndex.begin(); it != m_mIndex.end(); it++)
+    vKeys.push_back(it->first);
+}
+
+void CProbTableStore::Forget(const std::vector<std::size_t> &vKeys) {
+  for (std::vector<std::size_t>::const_iterator it = vKeys.begin(); it != vKeys.end(); it++) {
+    std::map<std::size_t, SEntry *>::iterator f = m_mIndex.find(*it);
+    if (f == m_mIndex.end()) continue;
+    SEntry *pEntry = f->second;
+    if (pEntry->iRefs) {
+      pEntry->key = 0;
+      m_mIndex.erase(f);
+    } else {
+      //no longer findable, so move to be recycled first
+      forget(pEntry);
+      link(pEntry);
+    }
+  }
+}
+
+void CProbTableStore::unlink(SEntry *pEntry) {
+  (pEntry->pPrev ? pEntry->pPrev->pNext : m_pOldest) = pEntry->pNext;
+  (pEntry->pNext ? pEntry->pNext->pPrev : m_pNewest) = pEntry->pPrev;
+  m_iIdle--;
+  m_iIdleBytes -= pEntry->iBytes;
+}
+
+void CProbTableStore::link(SEntry *pEntry) {
+  if (pEntry->key) {
+    pEntry->pPrev = m_pNewest;
+    pEntry->pNext = NULL;
+    (m_pNewest ? m_pNewest->pNext : m_pOldest) = pEntry;
+    m_pNewest = pEntry;
+  } else {
+    pEntry->pPrev = NULL;
+    pEntry->pNext = m_pOldest;
+    (m_pOldest ? m_pOldest->pPrev : m_pNewest) = pEntry;
+    m_pOldest = pEntry;
+  }
+  m_iIdle++;
+  m_iIdleBytes += pEntry->iBytes;
+}
+
+void CProbTableStore::forget(SEntry *pEntry) {
+  unlink(pEntry);
+  if (pEntry->key) {
+    m_mIndex.erase(pEntry->key);
+    pEntry->key = 0;
+  }
+}
@@ -0,0 +1,144 @@
+// ProbTableStore.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __ProbTableStore_h__
+#define __ProbTableStore_h__
+
+#include "../Common/NoClones.h"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace Dasher {
+
+/// \ingroup Model
+/// @{
+
+/// Pool of the (cumulative) probability tables which alphabet nodes compute
+/// from their LM contexts, to save allocating a new std::vector per node
+/// expanded. Tables are reference counted: one stored under a key (see
+/// CLanguageModel::ContextKey) is shared by every node asking for that key while
+/// it is referenced, and kept for a while once not (in case e.g. a node is
+/// rebuilt after being collapsed); only then is its buffer reused, least
+/// recently released first. Beyond MAX_IDLE unreferenced tables (or
+/// MAX_IDLE_BYTES of them), the oldest are freed.
+///
+/// The unreferenced tables thus act as a cache of the "ghosts" of recently
+/// collapsed subtrees: when a node is collapsed, the tables of its descendants
+/// are released, and if it is re-expanded soon after, the new children find
+/// their tables again here rather than recomputing them (see GetStats).
+class CProbTableStore : private NoClones {
+public:
+  typedef std::vector<unsigned int> Table;
+
+  CProbTableStore();
+  /// All tables must have been released by now.
+  ~CProbTableStore();
+
+  /// The table stored under a (nonzero) key, with a new reference to it.
+  /// \return NULL if none (or key==0)
+  Table *Find(std::size_t key);
+  /// Whether a table is stored under a key (without referencing it, or counting in the stats)
+  bool Contains(std::size_t key) const {return key && m_mIndex.count(key);}
+  /// A table for the caller to fill in (with one reference, i.e. the caller's);
+  /// recycles an unreferenced one if there are enough. Contents unspecified.
+  Table *Alloc();
+  /// Store a table from Alloc (once filled in) under the given key, for Find to
+  /// return. Does nothing if key==0, or another table is already stored under it.
+  void Insert(std::size_t key, Table *pTable);
+  /// Drop a reference to a table from Find or Alloc.
+  void Release(Table *pTable);
+  /// Forget all the keys, e.g. when the parameters used to compute the tables
+  /// change. Tables still referenced are unaffected, but will not be found again.
+  void Clear();
+  /// The keys under which tables are stored (referenced or not)
+  void GetKeys(std::vector<std::size_t> &vKeys) const;
+  /// Forget the given keys (as Clear, all), e.g. those whose probabilities
+  /// learning a symbol will change (see CLanguageModel::GetKeysChangedByLearning).
+  void Forget(const std::vector<std::size_t> &vKeys);
+
+  /// Memory taken by all tables, referenced or not (as of when each was last
+  /// stored by Insert).
+  std::size_t Bytes() const {return m_iBytes;}
+
+  /// Counts of calls to Find, by outcome
+  struct SStats {
+    SStats() : iShared(0), iRehydrated(0), iMissed(0), iUnkeyed(0) {}
+    /// Found a table referenced by some other node
+    unsigned long iShared;
+    /// Found an unreferenced table, e.g. of a node since collapsed
+    unsigned long iRehydrated;
+    /// Key not found, so the caller had to compute a new table
+    unsigned long iMissed;
+    /// Key 0, i.e. nothing could be found
+    unsigned long iUnkeyed;
+    /// Proportion of all calls which found a table
+    double HitRate() const {
+      const unsigned long iTotal(iShared + iRehydrated + iMissed + iUnkeyed);
+      return iTotal ? (iShared + iRehydrated) / static_cast<double>(iTotal) : 0.0;
+    }
+  };
+  const SStats &GetStats() const {return m_stats;}
+  void ResetStats() {m_stats = SStats();}
+
+  /// Most unreferenced tables to keep, for reuse
+  static const unsigned int MAX_IDLE = 64;
+  /// Most memory to keep in unreferenced tables (so collapsing nodes frees
+  /// most of what their tables took, even for large alphabets)
+  static const std::size_t MAX_IDLE_BYTES = 1 << 18;
+  /// Fewest unreferenced tables to keep under their keys, rather than recycling
+  /// (unless they take over half of MAX_IDLE_BYTES)
+  static const unsigned int MIN_IDLE = 16;
+
+private:
+  struct SEntry : public Table {
+    /// Key under which stored in m_mIndex, or 0 if not
+    std::size_t key;
+    unsigned int iRefs;
+    /// Counted in m_iBytes
+    std::size_t iBytes;
+    /// Neighbours in the list of unreferenced entries (iff iRefs==0)
+    SEntry *pPrev, *pNext;
+  };
+  void unlink(SEntry *pEntry);
+  /// Add an unreferenced entry to the list: those with keys at the newest end,
+  /// those without at the oldest (i.e. recycled first).
+  void link(SEntry *pEntry);
+  /// Remove an unreferenced entry from the list and its key from m_mIndex
+  void forget(SEntry *pEntry);
+
+  std::map<std::size_t, SEntry *> m_mIndex;
+  /// Unreferenced entries, oldest first
+  SEntry *m_pOldest, *m_pNewest;
+  unsigned int m_iIdle;
+  /// Memory taken by those
+  std::size_t m_iIdleBytes;
+  /// Entries referenced by somebody
+  unsigned int m_iInUse;
+  std::size_t m_iBytes;
+  SStats m_stats;
+};
+
+/// @}
+
+}
+
+#endif // __ProbTableStore_h__
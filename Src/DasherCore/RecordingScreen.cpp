@@ -0,0 +1,128 @@
+// RecordingScreen.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+#include "RecordingScreen.h"
+
+#include <algorithm>
+
+using namespace Dasher;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+CRecordingScreen::CRecordingScreen(screenint iWidth, screenint iHeight, bool bRecord)
+  : CDasherScreen(iWidth, iHeight), m_bRecord(bRecord) {
+}
+
+void CRecordingScreen::record(Op op, int iArgs, const int *pArgs) {
+  m_vCommands.push_back(op);
+  m_vCommands.insert(m_vCommands.end(), pArgs, pArgs + iArgs);
+}
+
+void CRecordingScreen::recordPoints(const point *pPoints, int iNum) {
+  for (int i = 0; i < iNum; i++) {
+    m_vCommands.push_back(pPoints[i].x);
+    m_vCommands.push_back(pPoints[i].y);
+  }
+}
+
+std::pair<screenint,screenint> CRecordingScreen::TextSize(Label *label, unsigned int iFontSize) {
+  //count characters, not octets (i.e. skip UTF-8 continuation bytes)
+  int iChars = 0;
+  for (std::string::const_iterator it = label->m_strText.begin(); it != label->m_strText.end(); it++)
+    if ((*it & 0xC0) != 0x80) iChars++;
+  const screenint iWidth((iChars * static_cast<int>(iFontSize) * 6) / 10);
+  if (!label->m_iWrapSize || iWidth <= GetWidth() || GetWidth() <= 0)
+    return std::pair<screenint,screenint>(iWidth, iFontSize);
+  const screenint iLines((iWidth + GetWidth() - 1) / GetWidth());
+  return std::pair<screenint,screenint>(GetWidth(), iLines * iFontSize);
+}
+
+void CRecordingScreen::DrawString(Label *label, screenint x, screenint y, unsigned int iFontSize, int iColour) {
+  m_counts.iStrings++;
+  if (!m_bRecord) return;
+  const int aArgs[] = {static_cast<int>(m_vLabels.size()), x, y, static_cast<int>(iFontSize), iColour};
+  m_vLabels.push_back(label);
+  record(STRING, 5, aArgs);
+}
+
+void CRecordingScreen::SendMarker(int iMarker) {
+  m_counts.iMarkers++;
+  if (m_bRecord) record(MARKER, 1, &iMarker);
+}
+
+void CRecordingScreen::DrawRectangle(screenint x1, screenint y1, screenint x2, screenint y2, int Colour, int iOutlineColour, int iThickness) {
+  m_counts.iRectangles++;
+  if (!m_bRecord) return;
+  const int aArgs[] = {x1, y1, x2, y2, Colour, iOutlineColour, iThickness};
+  record(RECTANGLE, 7, aArgs);
+}
+
+void CRecordingScreen::DrawCircle(screenint iCX, screenint iCY, screenint iR, int iFillColour, int iLineColour, int iLineWidth) {
+  m_counts.iCircles++;
+  if (!m_bRecord) return;
+  const int aArgs[] = {iCX, iCY, iR, iFillColour, iLineColour, iLineWidth};
+  record(CIRCLE, 6, aArgs);
+}
+
+void CRecordingScreen::Polyline(point *Points, int Number, int iWidth, int Colour) {
+  m_counts.iPolylines++;
+  m_counts.iPoints += Number;
+  if (!m_bRecord) return;
+  const int aArgs[] = {Number, iWidth, Colour};
+  record(POLYLINE, 3, aArgs);
+  recordPoints(Points, Number);
+}
+
+void CRecordingScreen::Polygon(point *Points, int Number, int fillColour, int outlineColour, int lineWidth) {
+  m_counts.iPolygons++;
+  m_counts.iPoints += Number;
+  if (!m_bRecord) return;
+  const int aArgs[] = {Number, fillColour, outlineColour, lineWidth};
+  record(POLYGON, 4, aArgs);
+  recordPoints(Points, Number);
+}
+
+void CRecordingScreen::Display() {
+  m_counts.iFrames++;
+  //keep both buffers' capacity, so recording doesn't allocate once warmed up
+  m_vFrame.swap(m_vCommands);
+  m_vCommands.clear();
+  m_vFrameLabels.swap(m_vLabels);
+  m_vLabels.clear();
+}
+
+uint32_t CRecordingScreen::Checksum() const {
+  //32-bit FNV-1a, over each command word
+  uint32_t iHash = 2166136261u;
+  for (std::vector<int>::const_iterator it = m_vFrame.begin(); it != m_vFrame.end(); it++) {
+    iHash ^= static_cast<uint32_t>(*it);
+    iHash *= 16777619u;
+  }
+  return m_vFrame.empty() ? 0 : iHash;
+}
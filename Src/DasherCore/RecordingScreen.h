@@ -0,0 +1,108 @@
+// RecordingScreen.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __RecordingScreen_h__
+#define __RecordingScreen_h__
+
+#include "DasherScreen.h"
+#include "../Common/NoClones.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Dasher {
+  class CRecordingScreen;
+}
+
+/// \ingroup View
+/// @{
+
+/// Headless CDasherScreen, needing no display: drawing operations are just
+/// counted and (unless made counting-only) recorded into a compact command
+/// buffer, one frame at a time. For measuring the cost of rendering (and the
+/// rest of a frame) e.g. in benchmarks, and checking what was drawn.
+///
+/// Text is measured as if every character were 0.6 of the font size wide, and
+/// the font size high, so layout is deterministic; wrapped labels are broken
+/// into as many lines as needed to fit the screen width.
+class Dasher::CRecordingScreen : public Dasher::CDasherScreen, private NoClones {
+public:
+  /// \param bRecord false to only count operations (see GetCounts), not record them
+  CRecordingScreen(screenint iWidth, screenint iHeight, bool bRecord=true);
+
+  /// Opcodes in the command buffer. Each command is its opcode followed by its
+  /// arguments, as they were passed (in order), all as ints; for POLYLINE and
+  /// POLYGON the number of points comes first, and the points (x,y pairs) last.
+  /// STRING has, in place of the label, its index in GetLabels.
+  enum Op {RECTANGLE, CIRCLE, POLYLINE, POLYGON, STRING, MARKER};
+
+  /// Number of each operation since ResetCounts
+  struct SCounts {
+    SCounts() : iRectangles(0), iCircles(0), iPolylines(0), iPolygons(0), iStrings(0), iMarkers(0), iPoints(0), iFrames(0) {}
+    unsigned long iRectangles, iCircles, iPolylines, iPolygons, iStrings, iMarkers;
+    /// Total in all Polylines and Polygons
+    unsigned long iPoints;
+    /// Calls to Display
+    unsigned long iFrames;
+  };
+  const SCounts &GetCounts() const {return m_counts;}
+  void ResetCounts() {m_counts = SCounts();}
+
+  /// Commands for the last complete frame (i.e. up to the last Display);
+  /// empty if counting only.
+  const std::vector<int> &GetCommands() const {return m_vFrame;}
+  /// Labels drawn by the last complete frame, in order of STRING commands. Only
+  /// valid as long as the client keeps the labels, which may not be long.
+  const std::vector<Label *> &GetLabels() const {return m_vFrameLabels;}
+  /// Hash of the last complete frame's commands (not including label text),
+  /// e.g. to check rendering is unchanged; 0 if counting only. The same on
+  /// every platform, whatever the size of long.
+  uint32_t Checksum() const;
+
+  /// Change the dimensions (as a window being resized would); the caller
+  /// should tell the interface (ScreenResized).
+  void SetSize(screenint iWidth, screenint iHeight) {resize(iWidth, iHeight);}
+
+  std::pair<screenint,screenint> TextSize(Label *label, unsigned int iFontSize);
+  void DrawString(Label *label, screenint x, screenint y, unsigned int iFontSize, int iColour);
+  void SendMarker(int iMarker);
+  void DrawRectangle(screenint x1, screenint y1, screenint x2, screenint y2, int Colour, int iOutlineColour, int iThickness);
+  void DrawCircle(screenint iCX, screenint iCY, screenint iR, int iFillColour, int iLineColour, int iLineWidth);
+  void Polyline(point *Points, int Number, int iWidth, int Colour);
+  void Polygon(point *Points, int Number, int fillColour, int outlineColour, int lineWidth);
+  /// Ends the frame: what was recorded since the last call becomes GetCommands.
+  void Display();
+  void SetColourScheme(const CColourIO::ColourInfo *pColourScheme) {}
+  bool IsWindowUnderCursor() {return true;}
+
+private:
+  /// Append a command's opcode and first iArgs args (the rest are added by the caller)
+  void record(Op op, int iArgs, const int *pArgs);
+  void recordPoints(const point *pPoints, int iNum);
+  const bool m_bRecord;
+  SCounts m_counts;
+  /// Being recorded, and last complete frame (buffers swapped by Display)
+  std::vector<int> m_vCommands, m_vFrame;
+  std::vector<Label *> m_vLabels, m_vFrameLabels;
+};
+/// @}
+
+#endif // __RecordingScreen_h__
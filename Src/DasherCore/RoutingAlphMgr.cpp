@@ -77,7 +77,7 @@ CAlphabetManager::CAlphNode *CRoutingAlphMgr::CreateSymbolRoot(int iOffset, CLan
   // TODO unless this is the completely-empty context,
   // so ask the LM for which way it's most likely to have been entered
   sym = static_cast<CRoutingPPMLanguageModel*>(m_pLanguageModel)->GetBestRoute(ctx);
-  return new CRoutedSym(iOffset, m_vLabels[sym], this, sym);
+  return m_NodeAlloc.Make<CRoutedSym>(iOffset, m_vLabels[sym], this, sym);
 }
 
 int CRoutingAlphMgr::GetColour(symbol route, int iOffset) const {
@@ -103,13 +103,12 @@ CDasherNode *CRoutingAlphMgr::CreateSymbolNode(CAlphNode *pParent, symbol iSymbo
 
   int iNewOffset = pParent->offset()+1;
   if (m_pAlphabet->GetText(iSymbol)=="\r\n") iNewOffset++;
-  CSymbolNode *pAlphNode = new CRoutedSym(iNewOffset, m_vLabels[iSymbol], this, iSymbol);
-  
-  pAlphNode->iContext = m_pLanguageModel->CloneContext(pParent->iContext);
+  CSymbolNode *pAlphNode = m_NodeAlloc.Make<CRoutedSym>(iNewOffset, m_vLabels[iSymbol], this, iSymbol);
   
+  //Context (made only if needed) is the parent's plus this symbol -
   //namely, we want to enter only the BASE symbol into the LM, not the route
   // (which would be out of range):
-  m_pLanguageModel->EnterSymbol(pAlphNode->iContext, m_vBaseSyms[iSymbol]);
+  pAlphNode->DeferLMContext(m_vBaseSyms[iSymbol]);
   // (Unfortunately, we can't make EnterSymbol take route numbers, because
   // it has base symbols passed to it from the alphabet map)
   return pAlphNode;
@@ -185,9 +184,9 @@ void CRoutingAlphMgr::CRoutingTrainer::Train(CAlphabetMap::SymbolStream &syms) {
 }
 
 
-CTrainer *CRoutingAlphMgr::GetTrainer() {
+CTrainer *CRoutingAlphMgr::GetTrainer(CMessageDisplay *pMsgs) {
   //We pass in the pinyin alphabet to define the context-switch escape character, and the default context.
   // Although the default context will be symbolified via the _chinese_ alphabet, this seems reasonable
   // as it is the Pinyin alphabet which defines the conversion mapping (i.e. m_strConversionTarget!)
-  return new CRoutingTrainer(m_pInterface, this);
+  return new CRoutingTrainer(pMsgs, this);
 }
@@ -46,7 +46,7 @@ namespace Dasher {
     CRoutingAlphMgr(CSettingsUser *pCreator, CDasherInterfaceBase *pInterface, CNodeCreationManager *pNCManager, const CAlphInfo *pAlphabet);
     
     ///Override to return a CRoutingTrainer
-    CTrainer *GetTrainer();
+    CTrainer *GetTrainer(CMessageDisplay *pMsgs);
     
     ///Disable game mode. The target sentence might appear in several places...!!
     CWordGeneratorBase *GetGameWords() {return NULL;}
@@ -4,6 +4,8 @@
 #include "Trainer.h"
 #include "LanguageModelling/PPMPYLanguageModel.h"
 #include <vector>
+#include <algorithm>
+#include <thread>
 #include <cstring>
 #include <sstream>
 #include <string>
@@ -55,6 +57,16 @@ void CTrainer::Train(CAlphabetMap::SymbolStream &syms) {
 }
 
 bool CTrainer::readEscape(CLanguageModel::Context &sContext, symbol sym, CAlphabetMap::SymbolStream &syms) {
+  vector<symbol> vCtx;
+  if (!readEscape(vCtx, sym, syms)) return false;
+  //ok, so switch context. release the old, start a new...
+  m_pLanguageModel->ReleaseContext(sContext);
+  sContext = m_pLanguageModel->CreateEmptyContext();
+  for (vector<symbol>::iterator it=vCtx.begin(); it!=vCtx.end(); it++) m_pLanguageModel->EnterSymbol(sContext, *it);
+  return true;
+}
+
+bool CTrainer::readEscape(vector<symbol> &vCtx, symbol sym, CAlphabetMap::SymbolStream &syms) {
   if (sym != m_iCtxEsc) return false;
   
   //that was a quick check, to avoid calling slow peekBack() in most cases. Now make sure...
@@ -68,17 +80,13 @@ bool CTrainer::readEscape(CLanguageModel::Context &sContext, symbol sym, CAlphab
   if (delim == m_pInfo->GetContextEscapeChar()) {
     return false;
   }
-  //ok, so switch context. release the old, start a new...
-  m_pLanguageModel->ReleaseContext(sContext);
-  sContext = m_pLanguageModel->CreateEmptyContext();
-  //enter the alphabet default context first...
-  vector<symbol> defCtx;
-  m_pAlphabet->GetSymbols(defCtx, m_pInfo->GetDefaultContext());
-  for (vector<symbol>::iterator it=defCtx.begin(); it!=defCtx.end(); it++) m_pLanguageModel->EnterSymbol(sContext, *it);
+  //the new context starts with the alphabet default context...
+  vCtx.clear();
+  m_pAlphabet->GetSymbols(vCtx, m_pInfo->GetDefaultContext());
   //and read the first delimiter; everything until the second occurrence of this, is _context_ only.
   for (symbol sym; (sym=syms.next(m_pAlphabet))!=-1; ) {
     if (syms.peekBack()==delim) break;
-    m_pLanguageModel->EnterSymbol(sContext, sym);
+    vCtx.push_back(sym);
   }
   return true;  
 }
@@ -108,4 +116,146 @@ Dasher::CTrainer::Parse(const string &strDesc, istream &in, bool bUser) {
   Train(syms);
   m_strDesc=oldDesc;
   return true;
-}
\ No newline at end of file
+}
+
+//Pieces of text shorter than this (in symbols) aren't worth a thread of their own
+static const size_t MIN_PIECE = 1<<16;
+//When training on several threads, percentage of the progress through a file
+// reported while reading it; learning it (and merging) takes the rest.
+static const off_t READ_PERCENT = 10;
+
+///Passes on progress reading a file, scaled down to READ_PERCENT; then, that
+/// of the learning and merging, up to the end of the file.
+class CPPMTrainer::CPhasedProgress : public CTrainer::ProgressIndicator {
+public:
+  CPhasedProgress(ProgressIndicator *pNext) : m_pNext(pNext), m_iRead(0) {}
+  void bytesRead(off_t n) {
+    m_pNext->bytesRead((m_iRead = n) * READ_PERCENT / 100);
+  }
+  ///Having read everything, report the given fraction of the rest done
+  void Learnt(double dFraction) {
+    const off_t iReadPart = m_iRead * READ_PERCENT / 100;
+    m_pNext->bytesRead(iReadPart + static_cast<off_t>((m_iRead - iReadPart) * dFraction));
+  }
+private:
+  ProgressIndicator * const m_pNext;
+  off_t m_iRead;
+};
+
+CPPMTrainer::CPPMTrainer(CSettingsUser *pCreateFrom, CMessageDisplay *pMsgs, CPPMLanguageModel *pLanguageModel, const CAlphInfo *pInfo, const CAlphabetMap *pAlphabet, unsigned int iThreads)
+: CTrainer(pMsgs, pLanguageModel, pInfo, pAlphabet), CSettingsUser(pCreateFrom), m_pPPM(pLanguageModel),
+  m_iThreads(iThreads ? iThreads : std::thread::hardware_concurrency()), m_pProgress(NULL) {
+}
+
+bool CPPMTrainer::Parallel() const {
+  //Only without update exclusion - and LP_LM_UPDATE_EXCLUSION defaults on, so by
+  // default all training is sequential, on the one thread.
+  return !m_pPPM->GetUpdateExclusion() && m_iThreads > 1;
+}
+
+bool CPPMTrainer::Parse(const string &strDesc, istream &in, bool bUser) {
+  ProgressIndicator *const pProg(GetProgressIndicator());
+  if (!pProg || !Parallel()) return CTrainer::Parse(strDesc, in, bUser);
+  CPhasedProgress progress(pProg);
+  SetProgressIndicator(m_pProgress = &progress);
+  const bool bRes = CTrainer::Parse(strDesc, in, bUser);
+  SetProgressIndicator(pProg);
+  m_pProgress = NULL;
+  return bRes;
+}
+
+void CPPMTrainer::Learn(const vector<symbol> &vSyms, size_t iCtx, size_t iLearn, size_t iEnd, double dFrom, double dTo) {
+  CLanguageModel::Context sContext = m_pPPM->CreateEmptyContext();
+  for (size_t i = iCtx; i < iLearn; i++) m_pPPM->EnterSymbol(sContext, vSyms[i]);
+  for (size_t i = iLearn; i < iEnd; i++) {
+    m_pPPM->LearnSymbol(sContext, vSyms[i]);
+    if (m_pProgress && ((i - iLearn) & 0xFFF) == 0xFFF)
+      m_pProgress->Learnt(dFrom + (dTo - dFrom) * (i - iLearn) / (iEnd - iLearn));
+  }
+  m_pPPM->ReleaseContext(sContext);
+}
+
+void CPPMTrainer::Train(CAlphabetMap::SymbolStream &syms) {
+  if (!Parallel()) {
+    CTrainer::Train(syms);
+    return;
+  }
+  //1. Read the whole text. Each context-switch starts a new run: vRuns holds the
+  // indices in vSyms of the run's context (to enter) and of its text (to learn),
+  // which continues until the next run.
+  vector<symbol> vSyms, vCtx;
+  vector<pair<size_t, size_t> > vRuns(1, make_pair(size_t(0), size_t(0)));
+  for (symbol sym; (sym=syms.next(m_pAlphabet))!=-1;) {
+    if (readEscape(vCtx, sym, syms)) {
+      vRuns.push_back(make_pair(vSyms.size(), vSyms.size() + vCtx.size()));
+      vSyms.insert(vSyms.end(), vCtx.begin(), vCtx.end());
+    } else
+      vSyms.push_back(sym);
+  }
+  //Progress from here on: learning each symbol counts once, and merging it again.
+  size_t iTotal = 0, iDone = 0;
+  for (size_t r = 0; r < vRuns.size(); r++)
+    iTotal += 2 * (((r+1 < vRuns.size()) ? vRuns[r+1].first : vSyms.size()) - vRuns[r].second);
+  const double dTotal = static_cast<double>(max<size_t>(iTotal, 1));
+
+  const symbol iPara = m_pInfo->GetParagraphSymbol();
+  const int iMaxOrder = m_pPPM->GetMaxOrder();
+  for (size_t r = 0; r < vRuns.size(); r++) {
+    const size_t iCtx = vRuns[r].first, iLearn = vRuns[r].second,
+      iEnd = (r+1 < vRuns.size()) ? vRuns[r+1].first : vSyms.size();
+    //2. Split long runs into pieces, at paragraph boundaries if there are any
+    // nearby. Each piece but the first needs the last iMaxOrder symbols learnt
+    // before it (ignoring unknown symbols, which LearnSymbol skips) to prime its context.
+    const size_t iPieces = min<size_t>(m_iThreads, (iEnd - iLearn) / MIN_PIECE);
+    vector<size_t> vStarts;
+    vector<vector<symbol> > vPrimes;
+    for (size_t i = 1; i < iPieces; i++) {
+      size_t iStart = iLearn + (iEnd - iLearn) * i / iPieces;
+      for (size_t j = iStart, iStop = min(iEnd, iStart + MIN_PIECE/4); j < iStop; j++)
+        if (vSyms[j] == iPara) {
+          iStart = j+1;
+          break;
+        }
+      vector<symbol> vPrime;
+      for (size_t j = iStart; j > iLearn && vPrime.size() < static_cast<size_t>(iMaxOrder); )
+        if (vSyms[--j]) vPrime.insert(vPrime.begin(), vSyms[j]);
+      if (vPrime.size() < static_cast<size_t>(iMaxOrder)) continue;
+      vStarts.push_back(iStart);
+      vPrimes.push_back(vPrime);
+    }
+    vStarts.push_back(iEnd);
+
+    //3. Learn each piece after the first into a model of its own, on its own thread
+    // (made here, as the threads must not read settings; and not pruning, which
+    // depends on the order of learning, so is left until after merging)...
+    vector<CPPMLanguageModel *> vModels;
+    vector<std::thread> vThreads;
+    for (size_t i = 0; i + 1 < vStarts.size(); i++) {
+      CPPMLanguageModel *pModel = new CPPMLanguageModel(m_pPPM);
+      vModels.push_back(pModel);
+      const vector<symbol> &vPrime(vPrimes[i]);
+      const size_t iStart = vStarts[i], iStop = vStarts[i+1];
+      vThreads.push_back(std::thread([pModel, &vSyms, &vPrime, iStart, iStop]() {
+        CLanguageModel::Context sContext = pModel->CreateEmptyContext();
+        pModel->PrimeContext(sContext, vPrime);
+        for (size_t j = iStart; j < iStop; j++) pModel->LearnSymbol(sContext, vSyms[j]);
+        pModel->ReleaseContext(sContext);
+      }));
+    }
+    //...while learning the first straight into the model (all pieces being about
+    // the same size, progress through it stands for that through the others);
+    Learn(vSyms, iCtx, iLearn, vStarts[0], iDone / dTotal, (iDone + iEnd - iLearn) / dTotal);
+    iDone += (iEnd - iLearn) + (vStarts[0] - iLearn);
+    if (m_pProgress) m_pProgress->Learnt(iDone / dTotal);
+    //4. then merge in the others.
+    for (size_t i = 0; i < vThreads.size(); i++) {
+      vThreads[i].join();
+      m_pPPM->Merge(vModels[i], m_iThreads);
+      delete vModels[i];
+      iDone += vStarts[i+1] - vStarts[i];
+      if (m_pProgress) m_pProgress->Learnt(iDone / dTotal);
+    }
+  }
+  //Pieces were learnt without pruning, so do that now if needed.
+  m_pPPM->LimitNodes();
+}
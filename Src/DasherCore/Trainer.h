@@ -2,6 +2,7 @@
 #define __trainer_h__
 
 #include "LanguageModelling/PPMPYLanguageModel.h"
+#include "LanguageModelling/LayeredPPMLanguageModel.h"
 #include "Alphabet/AlphInfo.h"
 #include "AbstractXMLParser.h"
 
@@ -18,6 +19,12 @@ namespace Dasher {
     
     void SetProgressIndicator(ProgressIndicator *pProg) {m_pProg = pProg;}
 
+    ///The model being trained
+    CLanguageModel *GetLanguageModel() const {return m_pLanguageModel;}
+    ///The model being trained, if a CLayeredPPMLanguageModel (whose base and
+    /// overlay are then trained, and cached, from system and user text apart)
+    virtual CLayeredPPMLanguageModel *GetLayeredModel() const {return NULL;}
+
     ///Parses a text file; bUser ignored.
     bool Parse(const std::string &strDesc, std::istream &in, bool bUser);
   
@@ -38,10 +45,15 @@ namespace Dasher {
     ///  with the stream positioned just after the second ctx-switch character
     ///  (ready to continue reading as per normal)
     bool readEscape(CLanguageModel::Context &sContext, symbol sym, CAlphabetMap::SymbolStream &syms);
+    ///As above, but rather than reinitializing a context, returns the symbols
+    /// to enter into a new, empty one.
+    /// \param vCtx filled with the symbols of the new context, if a context-switch was found
+    bool readEscape(std::vector<symbol> &vCtx, symbol sym, CAlphabetMap::SymbolStream &syms);
 
     ///Returns the description of the file as passed to Parse()
     /// (usually a filename)
     const std::string &GetDesc() {return m_strDesc;}
+    ProgressIndicator *GetProgressIndicator() const {return m_pProg;}
     const CAlphabetMap * const m_pAlphabet;
     CLanguageModel * const m_pLanguageModel;
     const CAlphInfo * const m_pInfo;
@@ -52,6 +64,50 @@ namespace Dasher {
     std::string m_strDesc;
   };
 
+  ///Trainer for a CLayeredPPMLanguageModel: trains as CTrainer, but identifies
+  /// the model so system text can be frozen into its base before user text is learnt.
+  class CLayeredTrainer : public CTrainer {
+  public:
+    CLayeredTrainer(CMessageDisplay *pMsgs, CLayeredPPMLanguageModel *pLanguageModel, const CAlphInfo *pInfo, const CAlphabetMap *pAlphabet)
+    : CTrainer(pMsgs, pLanguageModel, pInfo, pAlphabet), m_pLayered(pLanguageModel) {}
+    CLayeredPPMLanguageModel *GetLayeredModel() const {return m_pLayered;}
+  private:
+    CLayeredPPMLanguageModel * const m_pLayered;
+  };
+
+  ///Trainer for a standard CPPMLanguageModel, which can train on several threads:
+  /// the text is split into pieces, which are learnt into separate models and then
+  /// merged (CAbstractPPM::Merge). As counts only add up the same if learning one
+  /// symbol does not depend on what else has been learnt, this is only done without
+  /// update exclusion (LP_LM_UPDATE_EXCLUSION); the result is then identical to
+  /// learning the whole text in order - unless LP_LM_MAX_NODES makes the model
+  /// prune, as the models for the pieces do not; the merged model is pruned at the end.
+  class CPPMTrainer : public CTrainer, protected CSettingsUser {
+  public:
+    /// \param iThreads most threads to learn on (inc. the calling one); 0 means
+    /// one per core.
+    CPPMTrainer(CSettingsUser *pCreateFrom, CMessageDisplay *pMsgs, CPPMLanguageModel *pLanguageModel, const CAlphInfo *pInfo, const CAlphabetMap *pAlphabet, unsigned int iThreads=0);
+    ///As CTrainer, but when learning on several threads, reading the text is only
+    /// the first part of the progress reported; the rest follows the learning and merging.
+    bool Parse(const std::string &strDesc, std::istream &in, bool bUser);
+  protected:
+    void Train(CAlphabetMap::SymbolStream &syms);
+  private:
+    class CPhasedProgress;
+    ///Whether to learn on several threads
+    bool Parallel() const;
+    ///Learn part of the text into the model, in order.
+    /// \param iCtx index into vSyms of the first symbol of the (entered) context
+    /// \param iLearn index of the first symbol to learn; symbols from iCtx up to here are entered
+    /// \param iEnd index after the last symbol to learn
+    /// \param dFrom, dTo if reporting progress (m_pProgress), the fractions of the
+    /// learning & merging done before and after this
+    void Learn(const std::vector<symbol> &vSyms, size_t iCtx, size_t iLearn, size_t iEnd, double dFrom, double dTo);
+    CPPMLanguageModel * const m_pPPM;
+    const unsigned int m_iThreads;
+    ///Progress of the current Parse, if it is on several threads and reporting any
+    CPhasedProgress *m_pProgress;
+  };
 }
 
 #endif
@@ -0,0 +1,213 @@
+// TrainingCache.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include "../Common/Common.h"
+
+#include "TrainingCache.h"
+#include "AbstractXMLParser.h"
+#include "DasherInterfaceBase.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace Dasher;
+using namespace std;
+
+// Track memory leaks on Windows to the line that new'd the memory
+#ifdef _WIN32
+#ifdef _DEBUG_MEMLEAKS
+#define DEBUG_NEW new( _NORMAL_BLOCK, THIS_FILE, __LINE__ )
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+#endif
+
+//64-bit FNV-1a: not cryptographic, but quick, and plenty to notice edited files.
+static const uint64 FNV_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64 FNV_PRIME = 0x100000001b3ULL;
+
+static uint64 hashString(const string &str) {
+  uint64 iHash = FNV_OFFSET;
+  for (string::const_iterator it = str.begin(); it != str.end(); it++)
+    iHash = (iHash ^ static_cast<unsigned char>(*it)) * FNV_PRIME;
+  return iHash;
+}
+
+///Reads just the SLMFileHeader and name (i.e. fingerprint) from a cache file
+/// in the user data directory, and remembers its path for ReadFromFile.
+class CTrainingCache::CCacheReader : public AbstractParser {
+public:
+  CCacheReader(CMessageDisplay *pMsgs) : AbstractParser(pMsgs) {}
+  bool ParseFile(const string &strPath, bool bUser) {
+    //We only ever write to the user directory
+    if (!bUser) return false;
+    m_strPath = strPath;
+    return AbstractParser::ParseFile(strPath, bUser);
+  }
+  bool Parse(const string &strDesc, istream &in, bool bUser) {
+    CLanguageModel::SLMFileHeader header;
+    if (m_strPath.empty() || !in.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || memcmp(header.szMagic, "%DLF", 4) || header.iHeaderSize < sizeof(header))
+      return false;
+    m_strFingerprint.resize(header.iHeaderSize - sizeof(header));
+    if (!m_strFingerprint.empty() && !in.read(&m_strFingerprint[0], m_strFingerprint.size()))
+      return false;
+    m_strFound = m_strPath;
+    return true;
+  }
+  string m_strFound, m_strFingerprint;
+private:
+  string m_strPath;
+};
+
+///Hashes each training file; for files previously cached, also hashes the prefix
+/// of the length that was cached, so we can tell if the file has only been appended to.
+class CTrainingCache::CFingerprinter : public AbstractParser {
+public:
+  CFingerprinter(CMessageDisplay *pMsgs, const CTrainingCache *pCache, const map<string, SFileInfo> &mCached, map<string, SFileInfo> &mFiles)
+  : AbstractParser(pMsgs), m_pCache(pCache), m_mCached(mCached), m_mFiles(mFiles) {}
+  bool Parse(const string &strDesc, istream &in, bool bUser) {
+    if (in.fail()) return false;
+    //Files for the other layer are nothing to do with this cache
+    if (!m_pCache->Covers(bUser)) return true;
+    SFileInfo &info(m_mFiles[strDesc]);
+    info.bUser = bUser;
+    map<string, SFileInfo>::const_iterator it = m_mCached.find(strDesc);
+    info.iPrefixLen = (it == m_mCached.end()) ? -1 : it->second.iSize;
+    info.iPrefixHash = 0;
+    uint64 iHash = FNV_OFFSET;
+    off_t iLen = 0;
+    char buf[4096];
+    do {
+      in.read(buf, sizeof(buf));
+      for (streamsize i = 0; i < in.gcount(); i++) {
+        if (iLen++ == info.iPrefixLen) info.iPrefixHash = iHash;
+        iHash = (iHash ^ static_cast<unsigned char>(buf[i])) * FNV_PRIME;
+      }
+    } while (in);
+    if (iLen == info.iPrefixLen) info.iPrefixHash = iHash;
+    info.iSize = iLen;
+    info.iHash = iHash;
+    return true;
+  }
+private:
+  const CTrainingCache * const m_pCache;
+  const map<string, SFileInfo> &m_mCached;
+  map<string, SFileInfo> &m_mFiles;
+};
+
+CTrainingCache::CTrainingCache(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, const CAlphInfo *pAlphabet, CLanguageModel *pLanguageModel)
+: CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pAlphabet(pAlphabet), m_pLanguageModel(pLanguageModel),
+  m_pLayered(NULL), m_eFiles(ALL_FILES), m_bUpToDate(false) {
+  Init("lmcache_");
+}
+
+CTrainingCache::CTrainingCache(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, const CAlphInfo *pAlphabet, CLayeredPPMLanguageModel *pLanguageModel, bool bUser)
+: CSettingsUser(pCreateFrom), m_pInterface(pInterface), m_pAlphabet(pAlphabet), m_pLanguageModel(pLanguageModel),
+  m_pLayered(pLanguageModel), m_eFiles(bUser ? USER_FILES : SYSTEM_FILES), m_bUpToDate(false) {
+  Init(bUser ? "lmuser_" : "lmbase_");
+}
+
+void CTrainingCache::Init(const string &strPrefix) {
+  //Alphabet IDs may contain characters not allowed in filenames, so use a hash.
+  ostringstream name;
+  name << strPrefix << hex << hashString(m_pAlphabet->GetID() + "\n" + m_pAlphabet->GetTrainingFile()) << ".dlf";
+  m_strCacheFile = name.str();
+  //Read the settings now, as Restore and Store may be called on another thread
+  ostringstream settings;
+  settings << "lm " << GetLongParameter(LP_LANGUAGE_MODEL_ID) << " " << GetLongParameter(LP_LM_MAX_ORDER)
+           << " " << GetLongParameter(LP_LM_UPDATE_EXCLUSION) << " " << GetLongParameter(LP_LM_MAX_NODES) << "\n";
+  m_strSettings = settings.str();
+}
+
+string CTrainingCache::Fingerprint(const map<string, SFileInfo> &mFiles) const {
+  ostringstream fp;
+  fp << "alphabet " << m_pAlphabet->GetID() << "\n";
+  fp << m_strSettings;
+  for (map<string, SFileInfo>::const_iterator it = mFiles.begin(); it != mFiles.end(); it++)
+    fp << "file " << (it->second.bUser ? "u " : "s ") << it->second.iSize << " "
+       << hex << it->second.iHash << dec << " " << it->first << "\n";
+  return fp.str();
+}
+
+bool CTrainingCache::ParseFingerprint(const string &strFingerprint, map<string, SFileInfo> &mFiles) const {
+  //The alphabet and LM settings must match exactly, so compare the text...
+  const string strExpected(Fingerprint(map<string, SFileInfo>()));
+  if (strFingerprint.compare(0, strExpected.length(), strExpected)) return false;
+  //...and then read back the files.
+  istringstream in(strFingerprint.substr(strExpected.length()));
+  for (string strLine; getline(in, strLine); ) {
+    istringstream line(strLine);
+    string strFile, strUser, strDesc;
+    SFileInfo info;
+    if (!(line >> strFile >> strUser >> info.iSize >> hex >> info.iHash >> dec) || strFile != "file")
+      return false;
+    info.bUser = (strUser == "u");
+    getline(line >> ws, strDesc);
+    mFiles[strDesc] = info;
+  }
+  return true;
+}
+
+bool CTrainingCache::Restore(map<string, off_t> &mTails) {
+  m_mFiles.clear();
+  m_bUpToDate = false;
+
+  CCacheReader reader(m_pInterface);
+  m_pInterface->ScanFiles(&reader, m_strCacheFile);
+  map<string, SFileInfo> mCached;
+  const bool bHaveCache = !reader.m_strFound.empty() && ParseFingerprint(reader.m_strFingerprint, mCached);
+
+  //Always fingerprint the training files, so Store() can record them.
+  CFingerprinter fingerprinter(m_pInterface, this, mCached, m_mFiles);
+  m_pInterface->ScanFiles(&fingerprinter, m_pAlphabet->GetTrainingFile());
+
+  if (!bHaveCache || m_mFiles.empty() || mCached.size() != m_mFiles.size()) return false;
+  map<string, off_t> mAppended;
+  for (map<string, SFileInfo>::iterator it = m_mFiles.begin(); it != m_mFiles.end(); it++) {
+    map<string, SFileInfo>::iterator cached = mCached.find(it->first);
+    if (cached == mCached.end() || cached->second.bUser != it->second.bUser) return false;
+    if (cached->second.iSize == it->second.iSize && cached->second.iHash == it->second.iHash) continue;
+    //Only user files are written by Dasher, and then only appended to
+    if (!it->second.bUser || it->second.iSize <= cached->second.iSize
+        || it->second.iPrefixHash != cached->second.iHash)
+      return false;
+    mAppended[it->first] = cached->second.iSize;
+  }
+  if (!(m_eFiles == USER_FILES ? m_pLayered->ReadOverlayFromFile(reader.m_strFound)
+        : m_pLanguageModel->ReadFromFile(reader.m_strFound)))
+    return false;
+  m_bUpToDate = mAppended.empty();
+  mTails.swap(mAppended);
+  return true;
+}
+
+void CTrainingCache::Store() {
+  if (m_bUpToDate || m_mFiles.empty()) return;
+  string strData;
+  //Fails e.g. for LMs which can't be written out
+  //(For the base layer, the overlay is empty, having just been frozen into it)
+  if (!(m_eFiles == USER_FILES ? m_pLayered->WriteOverlayToString(strData, Fingerprint(m_mFiles))
+        : m_pLanguageModel->WriteToString(strData, Fingerprint(m_mFiles))))
+    return;
+  m_pInterface->WriteUserDataFile(m_strCacheFile, strData, false);
+  m_bUpToDate = true;
+}
@@ -0,0 +1,116 @@
+// TrainingCache.h
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef __TrainingCache_h__
+#define __TrainingCache_h__
+
+#include "../Common/Types/int.h"
+#include "Alphabet/AlphInfo.h"
+#include "LanguageModelling/LanguageModel.h"
+#include "LanguageModelling/LayeredPPMLanguageModel.h"
+#include "SettingsStore.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace Dasher {
+  class CDasherInterfaceBase;
+
+  /// \ingroup Model
+  /// @{
+
+  /// Keeps the language model trained from an alphabet's training files in the
+  /// user data directory (using CLanguageModel::WriteToString), so that unchanged
+  /// training text does not have to be parsed again at every startup or alphabet
+  /// switch. The cache is keyed on a fingerprint of the alphabet, the settings
+  /// affecting training (LP_LANGUAGE_MODEL_ID, LP_LM_MAX_ORDER, LP_LM_UPDATE_EXCLUSION)
+  /// and the size and content hash of each training file found by ScanFiles.
+  /// If the only change is that user training files have been appended to (see
+  /// CDasherInterfaceBase::WriteTrainFile), the cached model is still loaded and
+  /// just the appended text needs training.
+  /// A CLayeredPPMLanguageModel is instead cached in two files, one for each layer.
+  class CTrainingCache : protected CSettingsUser {
+  public:
+    /// \param pLanguageModel model which the training files train, i.e. to load
+    /// or store; must not have learnt anything yet.
+    /// (Settings are read here, so Restore and Store may then be called on
+    /// a different thread, e.g. one training in the background.)
+    CTrainingCache(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, const CAlphInfo *pAlphabet, CLanguageModel *pLanguageModel);
+
+    /// Cache just one layer of a CLayeredPPMLanguageModel: if bUser, the overlay,
+    /// trained from only the user training files (and restored after the base);
+    /// else the base, trained from only the system files - Store that once they
+    /// have been CLayeredPPMLanguageModel::Freeze()d into it.
+    CTrainingCache(CSettingsUser *pCreateFrom, CDasherInterfaceBase *pInterface, const CAlphInfo *pAlphabet, CLayeredPPMLanguageModel *pLanguageModel, bool bUser);
+
+    /// Fingerprint the training files and, if they match the cache, load it into the LM.
+    /// \param mTails filled in (if the cache is loaded) with the description (as
+    /// passed to AbstractParser::Parse) of each user training file which has been
+    /// appended to, mapped to the offset of the first byte the model hasn't seen.
+    /// Other training files are already in the model and should not be trained again.
+    /// \return true if the LM was loaded from the cache.
+    bool Restore(std::map<std::string, off_t> &mTails);
+
+    /// Store the LM as the new cache, if Restore found the cache missing or out of date.
+    /// Call after training on all the files fingerprinted by Restore, but before
+    /// learning anything else. The cache file Restore loaded may still be in use
+    /// by the LM (mapped in place), so relies on CFileUtils::WriteUserDataFile
+    /// replacing the file rather than rewriting it.
+    void Store();
+
+  private:
+    class CFingerprinter;
+    class CCacheReader;
+    struct SFileInfo {
+      bool bUser;
+      off_t iSize;
+      uint64 iHash;
+      /// Hash of only the first iPrefixLen octets (for detecting appends)
+      off_t iPrefixLen;
+      uint64 iPrefixHash;
+    };
+    enum EFiles {ALL_FILES, SYSTEM_FILES, USER_FILES};
+    void Init(const std::string &strPrefix);
+    ///Whether training files of the given kind are fingerprinted (and so cached)
+    bool Covers(bool bUser) const {return m_eFiles == ALL_FILES || bUser == (m_eFiles == USER_FILES);}
+    std::string Fingerprint(const std::map<std::string, SFileInfo> &mFiles) const;
+    bool ParseFingerprint(const std::string &strFingerprint, std::map<std::string, SFileInfo> &mFiles) const;
+
+    CDasherInterfaceBase * const m_pInterface;
+    const CAlphInfo * const m_pAlphabet;
+    CLanguageModel * const m_pLanguageModel;
+    ///The model, if caching one of its layers; else NULL
+    CLayeredPPMLanguageModel * const m_pLayered;
+    const EFiles m_eFiles;
+    ///Name of cache file in user data directory
+    std::string m_strCacheFile;
+    ///Line of the fingerprint recording the settings affecting training
+    std::string m_strSettings;
+    ///Training files found by Restore, keyed by description
+    std::map<std::string, SFileInfo> m_mFiles;
+    ///Whether Restore found the cache to exactly match the training files
+    bool m_bUpToDate;
+  };
+  /// @}
+}
+
+#endif
@@ -58,34 +58,16 @@ CTwoButtonDynamicFilter::CTwoButtonDynamicFilter(CSettingsUser *pCreator, CDashe
 bool CTwoButtonDynamicFilter::DecorateView(CDasherView *pView, CDasherInput *pInput) {
   CDasherScreen *pScreen(pView->Screen());
 
-  CDasherScreen::point p[2];
-  
-  myint iDasherX;
-  myint iDasherY;
-  
-  iDasherX = -100;
-  iDasherY = 2048 - GetLongParameter(LP_TWO_BUTTON_OFFSET);
-  
-  pView->Dasher2Screen(iDasherX, iDasherY, p[0].x, p[0].y);
-  
-  iDasherX = -1000;
-  iDasherY = 2048 - GetLongParameter(LP_TWO_BUTTON_OFFSET);
-  
-  pView->Dasher2Screen(iDasherX, iDasherY, p[1].x, p[1].y);
-  
-  pScreen->Polyline(p, 2, 3, 242);
+  //both lines at once: the first from p[0] to p[1], the second p[2] to p[3]
+  const myint iOffset(GetLongParameter(LP_TWO_BUTTON_OFFSET));
+  const myint x[4] = {-100, -1000, -100, -1000},
+    y[4] = {2048 - iOffset, 2048 - iOffset, 2048 + iOffset, 2048 + iOffset};
+  CDasherScreen::point p[4];
+
+  pView->Dasher2Screen(x, y, p, 4);
 
-  iDasherX = -100;
-  iDasherY = 2048 + GetLongParameter(LP_TWO_BUTTON_OFFSET);
-  
-  pView->Dasher2Screen(iDasherX, iDasherY, p[0].x, p[0].y);
-  
-  iDasherX = -1000;
-  iDasherY = 2048 + GetLongParameter(LP_TWO_BUTTON_OFFSET);
-  
-  pView->Dasher2Screen(iDasherX, iDasherY, p[1].x, p[1].y);
-  
   pScreen->Polyline(p, 2, 3, 242);
+  pScreen->Polyline(p+2, 2, 3, 242);
 
   bool bRV(m_bDecorationChanged);
   m_bDecorationChanged = false;
@@ -50,15 +50,11 @@ CTwoPushDynamicFilter::CTwoPushDynamicFilter(CSettingsUser *pCreator, CDasherInt
 
 void GuideLine(CDasherView *pView, const myint iDasherY, const int iColour)
 {
-  myint iDasherX = -100;
+  const myint x[2] = {-100, -1000}, y[2] = {iDasherY, iDasherY};
   CDasherScreen::point p[2];
   CDasherScreen *pScreen(pView->Screen());
-  
-  pView->Dasher2Screen(iDasherX, iDasherY, p[0].x, p[0].y);
-
-  iDasherX = -1000;
 
-  pView->Dasher2Screen(iDasherX, iDasherY, p[1].x, p[1].y);
+  pView->Dasher2Screen(x, y, p, 2);
 
   pScreen->Polyline(p, 2, 3, iColour);
 }
@@ -42,6 +42,7 @@ static UserLogParamMask s_UserLogParamMaskTable [] = {
   {LP_LM_BETA,              userLogParamOutputToSimple},
   {LP_LM_MIXTURE,           userLogParamOutputToSimple},
   {LP_LM_WORD_ALPHA,        userLogParamOutputToSimple},
+  {LP_LM_MAX_NODES,         userLogParamOutputToSimple},
   {-1, -1}  // Flag value that should always be at the end
 };
 
@@ -5,6 +5,8 @@
 
 #include "../DasherCore/DasherTypes.h"
 
+#include <algorithm>
+
 
 using namespace Dasher;
 
@@ -254,6 +256,35 @@ void CCanvas::DrawRectangle(screenint x1, screenint y1, screenint x2, screenint
   END_DRAWING;
 }
 
+void CCanvas::FillRectangles(const rect *pRects, int iNum, int iColour) {
+#if WITH_CAIRO
+#else
+  GdkGC *graphics_context;
+  GdkColormap *colormap;
+
+  graphics_context = m_pCanvas->style->fg_gc[GTK_WIDGET_STATE(m_pCanvas)];
+  colormap = gdk_colormap_get_system();
+#endif
+
+  BEGIN_DRAWING;
+  SET_COLOR(iColour);
+
+  for (int i = 0; i < iNum; i++) {
+    const int iLeft = std::min(pRects[i].x1, pRects[i].x2), iTop = std::min(pRects[i].y1, pRects[i].y2);
+    const int iWidth = std::abs(pRects[i].x2 - pRects[i].x1), iHeight = std::abs(pRects[i].y2 - pRects[i].y1);
+#if WITH_CAIRO
+    cairo_rectangle(cr, iLeft, iTop, iWidth, iHeight);
+#else
+    gdk_draw_rectangle(m_pOffscreenBuffer, graphics_context, TRUE, iLeft, iTop, iWidth + 1, iHeight + 1);
+#endif
+  }
+#if WITH_CAIRO
+  cairo_fill(cr);
+#endif
+
+  END_DRAWING;
+}
+
 void CCanvas::DrawCircle(screenint iCX, screenint iCY, screenint iR, int iFillColour, int iLineColour, int iThickness) {
 #if WITH_CAIRO
 #else
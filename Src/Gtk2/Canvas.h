@@ -126,6 +126,12 @@ public:
   ///
   void DrawRectangle(screenint x1, screenint y1, screenint x2, screenint y2, int Color, int iOutlineColour, int iThickness) override;
 
+  ///
+  /// Fill rectangles all in one colour, setting the colour once (and, with
+  /// cairo, filling them all as a single path)
+  ///
+  void FillRectangles(const rect *pRects, int iNum, int iColour) override;
+
   void DrawCircle(screenint iCX, screenint iCY, screenint iR, int iFillColour, int iLineColour, int iThickness) override;
 
   ///
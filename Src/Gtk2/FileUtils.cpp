@@ -44,11 +44,16 @@ bool FileUtils::WriteUserDataFile(const std::string &filename, const std::string
   std::string strFilename = getenv("HOME");
   strFilename += "/.dasher/";
   strFilename += filename;
-  FILE* f = fopen(strFilename.c_str(), append ? "a+" : "w+");
+  //Replace (rather than overwrite) whole files: the core may have the old one mapped.
+  const std::string strWriteTo(append ? strFilename : strFilename + ".new");
+  FILE* f = fopen(strWriteTo.c_str(), append ? "a+" : "w+");
   if (f == nullptr)
     return false;
 
   int written = fwrite(strNewText.c_str(), 1, strNewText.length(), f);
-  fclose(f);
-  return written == strNewText.length();
+  if (fclose(f) != 0 || written != strNewText.length()) {
+    if (!append) remove(strWriteTo.c_str());
+    return false;
+  }
+  return append || rename(strWriteTo.c_str(), strFilename.c_str()) == 0;
 }
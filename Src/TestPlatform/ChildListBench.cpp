@@ -0,0 +1,127 @@
+// ChildListBench.cpp
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2012 The Dasher Team
+//
+/////////////////////////////////////////////////////////////////////////////
+
+// Compares the memory use and traversal speed of the containers used for the
+// children of a CDasherNode: CChildList (as now) against std::deque (as before).
+// Builds trees of the shape Dasher makes - a chain of expanded nodes, each with
+// a full alphabet of children, most of which are never expanded - up to a
+// budget of 5000 nodes, then repeatedly walks every node's children (as
+// CDasherViewSquare and CDasherModel do each frame).
+//
+// Usage: ChildListBench [num_children [repeats]]
+
+#include "../DasherCore/ChildList.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <new>
+#include <vector>
+
+using namespace Dasher;
+using namespace std;
+
+// Count bytes allocated on the heap, so we can see what the containers cost
+static size_t iHeapBytes = 0;
+
+void *operator new(size_t iSize) {
+  size_t *p = static_cast<size_t *>(malloc(iSize + sizeof(size_t)));
+  if (!p) throw bad_alloc();
+  *p = iSize;
+  iHeapBytes += iSize;
+  return p + 1;
+}
+void operator delete(void *ptr) noexcept {
+  if (!ptr) return;
+  size_t *p = static_cast<size_t *>(ptr) - 1;
+  iHeapBytes -= *p;
+  free(p);
+}
+void *operator new[](size_t iSize) {return operator new(iSize);}
+void operator delete[](void *ptr) noexcept {operator delete(ptr);}
+
+static const unsigned int NODE_BUDGET = 5000;
+
+// Just enough of a node to hold children; iSymbol stands for everything else
+struct SDequeNode {
+  deque<SDequeNode *> children;
+  int iSymbol;
+};
+struct SListNode {
+  CChildList<SListNode> children;
+  int iSymbol;
+};
+
+// Only CChildList can be told how many children to expect
+template<typename Node> struct SReserve {
+  static void Reserve(Node *, unsigned int) {}
+};
+template<> struct SReserve<SListNode> {
+  static void Reserve(SListNode *pNode, unsigned int iNum) {pNode->children.reserve(iNum);}
+};
+
+// Make the tree: expand the root, then (any) one of its children, and so on,
+// until the budget is reached; nodes are in a vector to delete later.
+template<typename Node> void Build(vector<Node *> &vNodes, unsigned int iNumChildren) {
+  Node *pNode = new Node;
+  pNode->iSymbol = 0;
+  vNodes.push_back(pNode);
+  while (vNodes.size() + iNumChildren <= NODE_BUDGET) {
+    SReserve<Node>::Reserve(pNode, iNumChildren);
+    for (unsigned int i = 0; i < iNumChildren; i++) {
+      Node *pChild = new Node;
+      pChild->iSymbol = i;
+      pNode->children.push_back(pChild);
+      vNodes.push_back(pChild);
+    }
+    pNode = pNode->children[(pNode->iSymbol * 7 + 3) % iNumChildren];
+  }
+}
+
+// Visit every node from the root, as rendering does
+template<typename Node> long Walk(const Node *pNode) {
+  long iTotal = pNode->iSymbol;
+  for (typename decltype(pNode->children)::const_iterator it = pNode->children.begin(); it != pNode->children.end(); it++)
+    iTotal += Walk(*it);
+  return iTotal;
+}
+
+template<typename Node> void Run(const char *szName, unsigned int iNumChildren, int iRepeats) {
+  const size_t iBefore = iHeapBytes;
+  vector<Node *> vNodes;
+  vNodes.reserve(NODE_BUDGET);
+  const size_t iVector = iHeapBytes - iBefore;
+  Build(vNodes, iNumChildren);
+  const size_t iUsed = iHeapBytes - iBefore - iVector;
+
+  long iCheck = 0;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < iRepeats; i++)
+    iCheck += Walk(vNodes[0]);
+  const double dMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  cout << szName << ": " << vNodes.size() << " nodes, sizeof(node)=" << sizeof(Node)
+       << ", heap " << iUsed << " bytes (" << iUsed / vNodes.size() << " per node), "
+       << iRepeats << " traversals " << dMs << "ms (check " << iCheck << ")" << endl;
+
+  for (typename vector<Node *>::iterator it = vNodes.begin(); it != vNodes.end(); it++)
+    delete *it;
+}
+
+int main(int argc, char *argv[]) {
+  const unsigned int iNumChildren = argc > 1 ? atoi(argv[1]) : 30;
+  const int iRepeats = argc > 2 ? atoi(argv[2]) : 2000;
+  if (iNumChildren < 1 || iNumChildren >= NODE_BUDGET) {
+    cerr << "Number of children must be between 1 and " << NODE_BUDGET << endl;
+    return 1;
+  }
+  Run<SDequeNode>("std::deque", iNumChildren, iRepeats);
+  Run<SListNode>("CChildList", iNumChildren, iRepeats);
+  return 0;
+}
@@ -0,0 +1,180 @@
+// FrameBenchmark.cpp
+//
+// Copyright (c) 2012 The Dasher Team
+//
+// This file is part of Dasher.
+//
+// Dasher is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Dasher is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Dasher; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+// Runs Dasher headless (on a CRecordingScreen) along a fixed, scripted pointer
+// path, for a given number of frames of simulated time, and reports how long
+// each frame took (and its stages), along with how many nodes were made and
+// deleted, how often their probability tables were found already made, and
+// what was drawn. The path and clock are the same every run, so the same tree
+// is built: numbers from two builds may be compared directly.
+//
+// Usage: framebench [data-dir [frames [alphabet-id]]]
+//  data-dir: directory containing alphabets/, colours/, control/ and training/
+//   (i.e. Data in the source tree; default "../../Data")
+
+#include "../Common/Common.h"
+
+#include "MockInterfaceBase.h"
+#include "MockSettingsStore.h"
+#include "../DasherCore/DasherInput.h"
+#include "../DasherCore/DasherNode.h"
+#include "../DasherCore/RecordingScreen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+  const int WIDTH = 800, HEIGHT = 600;
+  /// Simulated frame interval, in ms (i.e. 60fps)
+  const double FRAME_MS = 1000.0 / 60;
+
+  /// Pointer following a Lissajous figure over the right of the canvas (mostly
+  /// forwards, but reversing briefly on each cycle) as a function of time.
+  class CScriptedInput : public CScreenCoordInput {
+  public:
+    CScriptedInput() : CScreenCoordInput(0, "Scripted Input"), m_dTime(0) {}
+    void SetTime(double dTime) {m_dTime = dTime;}
+    bool GetScreenCoords(screenint &iX, screenint &iY, CDasherView *pView) {
+      const double t(m_dTime / 1000.0);
+      iX = static_cast<screenint>(WIDTH * (0.75 + 0.2 * std::sin(t * 0.7)));
+      iY = static_cast<screenint>(HEIGHT * (0.5 + 0.35 * std::sin(t * 1.3 + 0.5)));
+      return true;
+    }
+  private:
+    double m_dTime;
+  };
+
+  class CBenchInterface : public CMockInterfaceBase {
+  public:
+    CBenchInterface(CSettingsStore *pSettingsStore, CFileUtils *pFileUtils)
+      : CMockInterfaceBase(pSettingsStore, pFileUtils), m_pInput(NULL) {}
+    CScriptedInput *GetInput() const {return m_pInput;}
+  protected:
+    void CreateModules() {
+      CMockInterfaceBase::CreateModules();
+      m_pInput = static_cast<CScriptedInput *>(RegisterModule(new CScriptedInput()));
+      SetDefaultInputDevice(m_pInput);
+    }
+  private:
+    CScriptedInput *m_pInput;
+  };
+
+  /// Value at the given fraction of the way through sorted values
+  double Percentile(const std::vector<double> &vSorted, double dFrac) {
+    if (vSorted.empty()) return 0;
+    return vSorted[std::min(vSorted.size() - 1, static_cast<size_t>(dFrac * vSorted.size()))];
+  }
+
+  /// Print mean, 50th and 99th percentiles (in microseconds) of one stage
+  void Report(const char *szName, std::vector<double> &vTimes) {
+    double dTotal = 0;
+    for (size_t i = 0; i < vTimes.size(); i++) dTotal += vTimes[i];
+    std::sort(vTimes.begin(), vTimes.end());
+    std::printf("%-8s mean %9.1f  p50 %9.1f  p99 %9.1f  max %9.1f\n", szName,
+                vTimes.empty() ? 0 : dTotal / vTimes.size(),
+                Percentile(vTimes, 0.5), Percentile(vTimes, 0.99),
+                vTimes.empty() ? 0 : vTimes.back());
+  }
+}
+
+int main(int argc, char **argv) {
+  const std::string strData(argc > 1 ? argv[1] : "../../Data");
+  const int iFrames(argc > 2 ? std::atoi(argv[2]) : 3600);
+
+  std::vector<std::string> vDirs;
+  vDirs.push_back(strData + "/alphabets");
+  vDirs.push_back(strData + "/colours");
+  vDirs.push_back(strData + "/control");
+  vDirs.push_back(strData + "/training");
+  CMockFileUtils fileUtils(vDirs);
+  CMockSettingsStore settings;
+  if (argc > 3) settings.SetStringParameter(SP_ALPHABET_ID, argv[3]);
+  settings.SetStringParameter(SP_INPUT_DEVICE, "Scripted Input");
+  //Speed must depend only on the script, not on how fast frames are rendered
+  settings.SetBoolParameter(BP_AUTO_SPEEDCONTROL, false);
+  settings.SetBoolParameter(BP_START_MOUSE, true);
+
+  CBenchInterface intf(&settings, &fileUtils);
+  CRecordingScreen screen(WIDTH, HEIGHT, false);
+  //Simulated clock, in ms; not starting from 0, which Dasher uses to mean "never"
+  double dTime = 1000;
+  intf.ChangeScreen(&screen);
+  intf.Realize(static_cast<unsigned long>(dTime));
+
+  //Let training finish, so every run uses the same model; and draw at least
+  // one frame, so any modal messages are displayed (else they stop us starting)
+  do {
+    intf.NewFrame(static_cast<unsigned long>(dTime), true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  } while (intf.isTraining());
+  std::printf("Alphabet %s, %d frames\n", settings.GetStringParameter(SP_ALPHABET_ID).c_str(), iFrames);
+
+  CDasherInterfaceBase::SFrameTimings timings;
+  intf.SetFrameTimings(&timings);
+  std::vector<double> vTotal, vTimer, vStep, vRender, vApply, vFinish;
+  screen.ResetCounts();
+  const unsigned long iMadeBefore(totalNodeObjectsMade());
+  const int iLiveBefore(currentNumNodeObjects());
+  const CProbTableStore::SStats tablesBefore(intf.GetProbTableStats());
+  intf.KeyDown(static_cast<unsigned long>(dTime), 100);
+
+  for (int i = 0; i < iFrames; i++) {
+    dTime += FRAME_MS;
+    intf.GetInput()->SetTime(dTime);
+    const std::chrono::steady_clock::time_point tStart(std::chrono::steady_clock::now());
+    intf.NewFrame(static_cast<unsigned long>(dTime), false);
+    vTotal.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tStart).count());
+    vTimer.push_back(timings.dTimer);
+    vStep.push_back(timings.dStep);
+    vRender.push_back(timings.dRender);
+    vApply.push_back(timings.dApply);
+    vFinish.push_back(timings.dFinish);
+  }
+  intf.SetFrameTimings(NULL);
+
+  std::printf("Microseconds per frame:\n");
+  Report("total", vTotal);
+  Report("timer", vTimer);
+  Report("step", vStep);
+  Report("render", vRender);
+  Report("apply", vApply);
+  Report("finish", vFinish);
+
+  const CRecordingScreen::SCounts &counts(screen.GetCounts());
+  const unsigned long iMade(totalNodeObjectsMade() - iMadeBefore);
+  std::printf("Nodes made %lu, deleted %ld\n", iMade, static_cast<long>(iMade) - (currentNumNodeObjects() - iLiveBefore));
+  CProbTableStore::SStats tables(intf.GetProbTableStats());
+  tables.iShared -= tablesBefore.iShared;
+  tables.iRehydrated -= tablesBefore.iRehydrated;
+  tables.iMissed -= tablesBefore.iMissed;
+  tables.iUnkeyed -= tablesBefore.iUnkeyed;
+  std::printf("Prob tables: %lu shared, %lu rehydrated, %lu missed, %lu unkeyed; hit rate %.1f%%\n",
+              tables.iShared, tables.iRehydrated, tables.iMissed, tables.iUnkeyed, 100 * tables.HitRate());
+  std::printf("Per frame drawn: %.1f rectangles, %.1f strings, %.1f polylines, %.1f polygons, %.1f points\n",
+              counts.iRectangles / static_cast<double>(iFrames), counts.iStrings / static_cast<double>(iFrames),
+              counts.iPolylines / static_cast<double>(iFrames), counts.iPolygons / static_cast<double>(iFrames),
+              counts.iPoints / static_cast<double>(iFrames));
+  std::printf("Text entered: %s\n", intf.GetAllContext().c_str());
+  return 0;
+}
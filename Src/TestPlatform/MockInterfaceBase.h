@@ -1,39 +1,127 @@
 #ifndef __MockInterfaceBase_h__
 #define __MockInterfaceBase_h__
 
-#include "../DasherCore/DasherInterfaceBase.h"
+#include "../DasherCore/DashIntfScreenMsgs.h"
+
+#include <cstdio>
+#include <glob.h>
+#include <sys/stat.h>
 
 using namespace Dasher;
 
+/**
+ * CFileUtils reading from a fixed list of directories (e.g. those under Data/
+ * in the source tree), all treated as system locations; and, optionally, a user
+ * data directory, which is scanned first and to which writes go. Without one,
+ * writes are discarded.
+ */
+class CMockFileUtils : public CFileUtils {
+
+  public:
+
+    CMockFileUtils(const std::vector<std::string> &vDirs, const std::string &strUserDir = "")
+      : m_vDirs(vDirs), m_strUserDir(strUserDir) {}
+
+    int GetFileSize(const std::string &strFileName) {
+      struct stat sStatInfo;
+      return stat(strFileName.c_str(), &sStatInfo) ? 0 : sStatInfo.st_size;
+    }
+
+    void ScanFiles(AbstractParser *parser, const std::string &strPattern) {
+      if (!m_strUserDir.empty()) ScanDir(parser, m_strUserDir, strPattern, true);
+      for (std::vector<std::string>::const_iterator it = m_vDirs.begin(); it != m_vDirs.end(); ++it)
+        ScanDir(parser, *it, strPattern, false);
+    }
+
+    ///As the Gtk2 version: whole files are written to a new file, then renamed over the old.
+    bool WriteUserDataFile(const std::string &filename, const std::string &strNewText, bool append) {
+      if (m_strUserDir.empty() || strNewText.empty()) return true;
+      const std::string strFilename(m_strUserDir + "/" + filename);
+      const std::string strWriteTo(append ? strFilename : strFilename + ".new");
+      FILE *f = fopen(strWriteTo.c_str(), append ? "a" : "w");
+      if (!f) return false;
+      const bool bOk = fwrite(strNewText.data(), 1, strNewText.length(), f) == strNewText.length();
+      if (fclose(f) != 0 || !bOk) return false;
+      return append || rename(strWriteTo.c_str(), strFilename.c_str()) == 0;
+    }
+
+  private:
+    static void ScanDir(AbstractParser *parser, const std::string &strDir, const std::string &strPattern, bool bUser) {
+      glob_t files;
+      if (glob((strDir + "/" + strPattern).c_str(), 0, NULL, &files) == 0) {
+        for (size_t i = 0; i < files.gl_pathc; i++)
+          parser->ParseFile(files.gl_pathv[i], bUser);
+      }
+      globfree(&files);
+    }
+
+    const std::vector<std::string> m_vDirs;
+    const std::string m_strUserDir;
+};
+
 /**
  * A useless, but concrete implementation of CDasherInterfaceBase
  * used for unit testing purposes. Allows us to instantiate 
  * CDasherInterfaceBase without delving into platform specific code.
+ * The edit buffer is just a (UTF-8) string, to which text is only ever
+ * appended or deleted at the end.
  */
-class CMockInterfaceBase : public CDasherInterfaceBase {
+class CMockInterfaceBase : public CDashIntfScreenMsgs {
   
   public:
   
-    CMockInterfaceBase() : CDasherInterfaceBase() {};
-    
-    void CreateModules() {};
-    
-    void SetupPaths() {};
-    
-    void ScanAlphabetFiles(std::vector<std::string> &vFileList) {};
-    
-    void ScanColourFiles(std::vector<std::string> &vFileList) {};
-    
-    void SetupUI() {};
-    
-    void CreateSettingsStore() {};
-    
-    int GetFileSize(const std::string &strFileName) { return 0; };
-    
-    void StartTimer() {};
-    
-    void ShutdownTimer() {};
-  
+    CMockInterfaceBase(CSettingsStore *pSettingsStore, CFileUtils *pFileUtils)
+      : CDashIntfScreenMsgs(pSettingsStore, pFileUtils) {}
+
+    using CDasherInterfaceBase::Realize;
+    using CDasherInterfaceBase::NewFrame;
+
+    void editOutput(const std::string &strText, CDasherNode *pCause) {
+      m_strBuffer += strText;
+      CDashIntfScreenMsgs::editOutput(strText, pCause);
+    }
+
+    void editDelete(const std::string &strText, CDasherNode *pCause) {
+      if (m_strBuffer.length() >= strText.length())
+        m_strBuffer.erase(m_strBuffer.length() - strText.length());
+      CDashIntfScreenMsgs::editDelete(strText, pCause);
+    }
+
+    unsigned int ctrlMove(bool bForwards, CControlManager::EditDistance dist) {
+      return GetAllContextLenght();
+    }
+
+    unsigned int ctrlDelete(bool bForwards, CControlManager::EditDistance dist) {
+      return GetAllContextLenght();
+    }
+
+    std::string GetContext(unsigned int iStart, unsigned int iLength) {
+      std::string::size_type iFrom = CharOffset(iStart);
+      return m_strBuffer.substr(iFrom, CharOffset(iStart + iLength) - iFrom);
+    }
+
+    std::string GetAllContext() {return m_strBuffer;}
+
+    int GetAllContextLenght() {return CharCount(m_strBuffer.length());}
+
+  private:
+    ///Number of UTF-8 characters in the first iBytes of the buffer
+    int CharCount(std::string::size_type iBytes) const {
+      int iChars = 0;
+      for (std::string::size_type i = 0; i < iBytes; i++)
+        if ((m_strBuffer[i] & 0xC0) != 0x80) iChars++;
+      return iChars;
+    }
+
+    ///Byte offset of the iChar'th UTF-8 character (or the end of the buffer)
+    std::string::size_type CharOffset(unsigned int iChar) const {
+      std::string::size_type i = 0;
+      for (; i < m_strBuffer.length(); i++)
+        if ((m_strBuffer[i] & 0xC0) != 0x80 && iChar-- == 0) break;
+      return i;
+    }
+
+    std::string m_strBuffer;
 };
 
 #endif
@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include "../../Src/TestPlatform/MockInterfaceBase.h"
+#include "../../Src/TestPlatform/MockSettingsStore.h"
+#include "../../Src/DasherCore/Trainer.h"
+#include "../../Src/DasherCore/Alphabet/AlphIO.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace Dasher;
+using namespace std;
+
+/*
+ * Interface with the default alphabet, making PPM models and turning text
+ * into symbols for them.
+ */
+class CKeysTestInterface : public CMockInterfaceBase {
+  public:
+    CKeysTestInterface(CSettingsStore *pSettingsStore, CFileUtils *pFileUtils)
+      : CMockInterfaceBase(pSettingsStore, pFileUtils), m_alphIO(this) {
+      ScanFiles(&m_alphIO, "alphabet*.xml");
+      m_pInfo = m_alphIO.GetInfo(m_alphIO.GetDefault());
+      const int iPara = m_pInfo->GetParagraphSymbol();
+      if (iPara) m_map.AddParagraphSymbol(iPara);
+      for (int i = 1; i < m_pInfo->iEnd; i++)
+        if (i != iPara) m_map.Add(m_pInfo->GetText(i), i);
+    }
+
+    void SetUpdateExclusion(bool bUpdateExclusion) {SetLongParameter(LP_LM_UPDATE_EXCLUSION, bUpdateExclusion);}
+
+    CPPMLanguageModel *MakeModel() {return new CPPMLanguageModel(this, m_pInfo->iEnd - 1);}
+
+    void Train(CPPMLanguageModel *pLM, const string &strText) {
+      CTrainer trainer(this, pLM, m_pInfo, &m_map);
+      istringstream in(strText);
+      trainer.Parse("", in, true);
+    }
+
+    vector<symbol> Symbols(const string &strText) {
+      vector<symbol> vSyms;
+      m_map.GetSymbols(vSyms, strText);
+      return vSyms;
+    }
+
+  private:
+    CAlphIO m_alphIO;
+    const CAlphInfo *m_pInfo;
+    CAlphabetMap m_map;
+};
+
+/*
+ * Test fixture: a model trained on the start of the system English training
+ * text, and contexts after many positions in the text following that.
+ */
+class PPMKeysTest : public ::testing::TestWithParam<bool> {
+  protected:
+    virtual void SetUp() {
+      ifstream in("../../Data/training/training_english_GB.txt", ios::binary);
+      string strText(60000, ' ');
+      in.read(&strText[0], strText.size());
+      ASSERT_EQ(strText.size(), static_cast<size_t>(in.gcount()));
+      vector<string> vDirs(1, "../../Data/alphabets");
+      m_pFileUtils = new CMockFileUtils(vDirs);
+      m_pIntf = new CKeysTestInterface(&m_settings, m_pFileUtils);
+      m_pIntf->SetUpdateExclusion(GetParam());
+      m_pLM = m_pIntf->MakeModel();
+      m_pIntf->Train(m_pLM, strText.substr(0, 50000));
+      m_vSyms = m_pIntf->Symbols(strText.substr(50000));
+      for (size_t i = 0; i + 5 < m_vSyms.size(); i += 7) {
+        CLanguageModel::Context ctx = m_pLM->CreateEmptyContext();
+        for (size_t j = i; j < i + 5; j++)
+          m_pLM->EnterSymbol(ctx, m_vSyms[j]);
+        m_vContexts.push_back(ctx);
+      }
+    }
+
+    virtual void TearDown() {
+      for (size_t i = 0; i < m_vContexts.size(); i++)
+        m_pLM->ReleaseContext(m_vContexts[i]);
+      delete m_pLM;
+      delete m_pIntf;
+      delete m_pFileUtils;
+    }
+
+    vector<unsigned int> Probs(size_t iKey) {
+      vector<unsigned int> vProbs;
+      m_pLM->GetProbsForKey(iKey, vProbs, 1 << 16, 0,
+                            m_settings.GetLongParameter(LP_LM_ALPHA), m_settings.GetLongParameter(LP_LM_BETA));
+      return vProbs;
+    }
+
+    CMockSettingsStore m_settings;
+    CMockFileUtils *m_pFileUtils;
+    CKeysTestInterface *m_pIntf;
+    CPPMLanguageModel *m_pLM;
+    vector<symbol> m_vSyms;
+    vector<CLanguageModel::Context> m_vContexts;
+};
+
+/*
+ * Learning the text symbol by symbol, the probabilities for every context
+ * whose key GetKeysChangedByLearning drops stay the same; and with update
+ * exclusion, it drops most (but not all).
+ */
+TEST_P(PPMKeysTest, UnchangedKeysKeepProbabilities) {
+  size_t iKept = 0, iAll = 0;
+  CLanguageModel::Context learn = m_pLM->CreateEmptyContext();
+  for (size_t i = 0; i < 1500; i++) {
+    //(check every tenth symbol, to keep the test fast)
+    if (i % 10) {
+      m_pLM->LearnSymbol(learn, m_vSyms[i]);
+      continue;
+    }
+    vector<size_t> vKeys;
+    vector<vector<unsigned int> > vBefore;
+    for (size_t c = 0; c < m_vContexts.size(); c++) {
+      vKeys.push_back(m_pLM->ContextKey(m_vContexts[c]));
+      vBefore.push_back(Probs(vKeys.back()));
+    }
+    vector<size_t> vChanged(vKeys);
+    m_pLM->GetKeysChangedByLearning(learn, m_vSyms[i], vChanged);
+    m_pLM->LearnSymbol(learn, m_vSyms[i]);
+    for (size_t k = 0; k < vKeys.size(); k++) {
+      if (find(vChanged.begin(), vChanged.end(), vKeys[k]) != vChanged.end()) continue;
+      ASSERT_TRUE(vBefore[k] == Probs(vKeys[k])) << "after learning symbol " << i;
+      iKept++;
+    }
+    iAll += vKeys.size();
+  }
+  m_pLM->ReleaseContext(learn);
+  //(without update exclusion, learning changes the root, so every key)
+  if (GetParam()) ASSERT_GT(iKept, iAll / 2);
+  ASSERT_LT(iKept, iAll);
+}
+
+INSTANTIATE_TEST_CASE_P(UpdateExclusion, PPMKeysTest, ::testing::Bool());
@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+#include "../../Src/TestPlatform/MockInterfaceBase.h"
+#include "../../Src/TestPlatform/MockSettingsStore.h"
+#include "../../Src/DasherCore/Trainer.h"
+#include "../../Src/DasherCore/Alphabet/AlphIO.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace Dasher;
+using namespace std;
+
+/*
+ * Interface with the default alphabet, making PPM models (without update
+ * exclusion, so CPPMTrainer may use several threads) and training them.
+ */
+class CTrainerTestInterface : public CMockInterfaceBase {
+  public:
+    CTrainerTestInterface(CSettingsStore *pSettingsStore, CFileUtils *pFileUtils)
+      : CMockInterfaceBase(pSettingsStore, pFileUtils), m_alphIO(this) {
+      SetLongParameter(LP_LM_UPDATE_EXCLUSION, 0);
+      ScanFiles(&m_alphIO, "alphabet*.xml");
+      m_pInfo = m_alphIO.GetInfo(m_alphIO.GetDefault());
+      const int iPara = m_pInfo->GetParagraphSymbol();
+      if (iPara) m_map.AddParagraphSymbol(iPara);
+      for (int i = 1; i < m_pInfo->iEnd; i++)
+        if (i != iPara) m_map.Add(m_pInfo->GetText(i), i);
+    }
+
+    void SetMaxNodes(long iMaxNodes) {SetLongParameter(LP_LM_MAX_NODES, iMaxNodes);}
+
+    CPPMLanguageModel *MakeModel() {return new CPPMLanguageModel(this, m_pInfo->iEnd - 1);}
+
+    /*
+     * Trains the model on the text, in order, on this thread.
+     */
+    void TrainSequential(CPPMLanguageModel *pLM, const string &strText) {
+      CTrainer trainer(this, pLM, m_pInfo, &m_map);
+      istringstream in(strText);
+      trainer.Parse("", in, true);
+    }
+
+    /*
+     * Trains the model on the text using CPPMTrainer with the given number of threads.
+     */
+    void TrainParallel(CPPMLanguageModel *pLM, const string &strText, unsigned int iThreads,
+                       CTrainer::ProgressIndicator *pProg = NULL) {
+      CPPMTrainer trainer(this, this, pLM, m_pInfo, &m_map, iThreads);
+      trainer.SetProgressIndicator(pProg);
+      istringstream in(strText);
+      trainer.Parse("", in, true);
+    }
+
+  private:
+    CAlphIO m_alphIO;
+    const CAlphInfo *m_pInfo;
+    CAlphabetMap m_map;
+};
+
+/*
+ * Records every position reported.
+ */
+class CRecordingProgress : public CTrainer::ProgressIndicator {
+  public:
+    void bytesRead(off_t n) {m_vReports.push_back(n);}
+    vector<off_t> m_vReports;
+};
+
+/*
+ * Test fixture: the system English training text (long enough to be split
+ * into several pieces).
+ */
+class PPMTrainerTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      ifstream in("../../Data/training/training_english_GB.txt", ios::binary);
+      ostringstream text;
+      text << in.rdbuf();
+      m_strText = text.str();
+      ASSERT_GT(m_strText.size(), 300000u);
+      vector<string> vDirs(1, "../../Data/alphabets");
+      m_pFileUtils = new CMockFileUtils(vDirs);
+      m_pIntf = new CTrainerTestInterface(&m_settings, m_pFileUtils);
+    }
+
+    virtual void TearDown() {
+      delete m_pIntf;
+      delete m_pFileUtils;
+    }
+
+    CMockSettingsStore m_settings;
+    CMockFileUtils *m_pFileUtils;
+    CTrainerTestInterface *m_pIntf;
+    string m_strText;
+};
+
+/*
+ * Learning pieces of the text on separate threads and merging them gives
+ * exactly the trie made by learning the whole text in order.
+ */
+TEST_F(PPMTrainerTest, MergedEqualsSequential) {
+  CPPMLanguageModel *pSequential = m_pIntf->MakeModel();
+  m_pIntf->TrainSequential(pSequential, m_strText);
+  CPPMLanguageModel *pParallel = m_pIntf->MakeModel();
+  m_pIntf->TrainParallel(pParallel, m_strText, 4);
+  ASSERT_TRUE(pSequential->eq(pParallel));
+
+  //Likewise when adding to a model that has learnt something already
+  m_pIntf->TrainSequential(pSequential, m_strText.substr(0, m_strText.size() / 3));
+  m_pIntf->TrainParallel(pParallel, m_strText.substr(0, m_strText.size() / 3), 3);
+  ASSERT_TRUE(pSequential->eq(pParallel));
+  delete pSequential;
+  delete pParallel;
+}
+
+/*
+ * With LP_LM_MAX_NODES, the pieces are learnt without pruning, but the
+ * merged model is then pruned to within the limit.
+ */
+TEST_F(PPMTrainerTest, MergedModelPruned) {
+  m_pIntf->SetMaxNodes(50000);
+  CPPMLanguageModel *pParallel = m_pIntf->MakeModel();
+  m_pIntf->TrainParallel(pParallel, m_strText, 4);
+  vector<SPPMSnapshotNode> vNodes;
+  pParallel->Flatten(vNodes);
+  ASSERT_LE(vNodes.size() - 1, 50000u);
+  delete pParallel;
+}
+
+/*
+ * Progress keeps going up through learning and merging, reaching the end of
+ * the text only when everything has been learnt.
+ */
+TEST_F(PPMTrainerTest, ProgressCoversLearning) {
+  CRecordingProgress progress;
+  CPPMLanguageModel *pParallel = m_pIntf->MakeModel();
+  m_pIntf->TrainParallel(pParallel, m_strText, 4, &progress);
+  const vector<off_t> &vReports(progress.m_vReports);
+  ASSERT_FALSE(vReports.empty());
+  ASSERT_EQ(static_cast<off_t>(m_strText.size()), vReports.back());
+  size_t iLearning = 0;
+  for (size_t i = 1; i < vReports.size(); i++) {
+    ASSERT_LE(vReports[i-1], vReports[i]);
+    if (vReports[i-1] > static_cast<off_t>(m_strText.size()) / 4) iLearning++;
+  }
+  //(reading is reported as the first tenth; learning and merging, the rest)
+  ASSERT_GE(iLearning, 5u);
+  delete pParallel;
+}
@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+#include "../../Src/DasherCore/ProbSpeculator.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace Dasher;
+using namespace std;
+
+/*
+ * Test fixture: speculators whose tables hold the key and the "version" of the
+ * model when computation started; keys of 13 can't be computed. The first
+ * computation of key 1 waits until Release(), so tests can see what happens to
+ * a computation in progress.
+ */
+class ProbSpeculatorTest : public ::testing::Test {
+  protected:
+    ProbSpeculatorTest() : m_pSpec(NULL), m_iVersion(0), m_iComputed(0), m_bBlocked(false), m_bReleased(false) {}
+
+    virtual void TearDown() {
+      Release();
+      delete m_pSpec;
+    }
+
+    void Make(unsigned int iThreads) {
+      m_pSpec = new CProbSpeculator(iThreads,
+          [this](size_t key, CProbSpeculator::Table &table) {return Compute(key, table);});
+    }
+
+    bool Compute(size_t key, CProbSpeculator::Table &table) {
+      table.assign(1, static_cast<unsigned int>(key));
+      table.push_back(m_iVersion);
+      {
+        unique_lock<mutex> lock(m_mutex);
+        if (key == 1 && !m_bBlocked) {
+          m_bBlocked = true;
+          m_cv.notify_all();
+          m_cv.wait(lock, [this]() {return m_bReleased;});
+        }
+      }
+      m_iComputed++;
+      return key != 13;
+    }
+
+    /*
+     * Waits until the first computation of key 1 has started (and is blocked).
+     */
+    void WaitBlocked() {
+      unique_lock<mutex> lock(m_mutex);
+      m_cv.wait(lock, [this]() {return m_bBlocked;});
+    }
+
+    void Release() {
+      lock_guard<mutex> lock(m_mutex);
+      m_bReleased = true;
+      m_cv.notify_all();
+    }
+
+    /*
+     * Takes the table for a key, waiting (up to a few seconds) for it to be computed.
+     */
+    bool WaitToTake(size_t key, CProbSpeculator::Table &table) {
+      for (int i = 0; i < 5000; i++) {
+        if (m_pSpec->Take(key, table)) return true;
+        this_thread::sleep_for(chrono::milliseconds(1));
+      }
+      return false;
+    }
+
+    static CProbSpeculator::Table Expected(unsigned int iKey, unsigned int iVersion) {
+      CProbSpeculator::Table table(1, iKey);
+      table.push_back(iVersion);
+      return table;
+    }
+
+    CProbSpeculator *m_pSpec;
+    atomic<unsigned int> m_iVersion, m_iComputed;
+  private:
+    mutex m_mutex;
+    condition_variable m_cv;
+    bool m_bBlocked, m_bReleased;
+};
+
+/*
+ * Requested tables are computed, and can each be taken once.
+ */
+TEST_F(ProbSpeculatorTest, RequestThenTake) {
+  Make(1);
+  m_pSpec->Request(2);
+  m_pSpec->Request(3);
+  CProbSpeculator::Table table;
+  ASSERT_TRUE(WaitToTake(3, table));
+  ASSERT_TRUE(table == Expected(3, 0));
+  ASSERT_TRUE(WaitToTake(2, table));
+  ASSERT_TRUE(table == Expected(2, 0));
+  ASSERT_FALSE(m_pSpec->Take(2, table));
+  ASSERT_FALSE(m_pSpec->Take(4, table));
+}
+
+/*
+ * Tables which can't be computed are never available; those requested
+ * after them (and so computed after, on one thread) still are.
+ */
+TEST_F(ProbSpeculatorTest, FailedComputation) {
+  Make(1);
+  m_pSpec->Request(13);
+  m_pSpec->Request(2);
+  CProbSpeculator::Table table;
+  ASSERT_TRUE(WaitToTake(2, table));
+  ASSERT_FALSE(m_pSpec->Take(13, table));
+}
+
+/*
+ * Asking again for a table already asked for doesn't compute it again.
+ */
+TEST_F(ProbSpeculatorTest, RequestsNotRepeated) {
+  Make(1);
+  m_pSpec->Request(1);
+  WaitBlocked();
+  for (int i = 0; i < 3; i++) m_pSpec->Request(4);
+  Release();
+  CProbSpeculator::Table table;
+  ASSERT_TRUE(WaitToTake(4, table));
+  ASSERT_TRUE(WaitToTake(1, table));
+  ASSERT_EQ(2u, m_iComputed);
+}
+
+/*
+ * Stop drops results, requests waiting, and the computation in progress;
+ * the same keys can be requested again afterwards.
+ */
+TEST_F(ProbSpeculatorTest, StopDropsEverything) {
+  Make(1);
+  m_pSpec->Request(2);
+  CProbSpeculator::Table table;
+  ASSERT_TRUE(WaitToTake(2, table));
+  m_pSpec->Request(2);
+  m_pSpec->Request(1);
+  m_pSpec->Request(3);
+  WaitBlocked();
+  //Stop waits for key 1 to finish computing
+  thread stopper([this]() {m_pSpec->Stop();});
+  Release();
+  stopper.join();
+  ASSERT_FALSE(m_pSpec->Take(1, table));
+  ASSERT_FALSE(m_pSpec->Take(2, table));
+  ASSERT_FALSE(m_pSpec->Take(3, table));
+
+  m_pSpec->Request(1);
+  m_pSpec->Request(3);
+  ASSERT_TRUE(WaitToTake(3, table));
+  ASSERT_TRUE(WaitToTake(1, table));
+}
+
+/*
+ * A computation started before Stop (i.e. before the model changed) must not
+ * replace the table for the same key, requested and computed again since.
+ */
+TEST_F(ProbSpeculatorTest, StaleResultDropped) {
+  Make(2);
+  m_pSpec->Request(1);
+  WaitBlocked();
+  m_iVersion = 1;
+  thread stopper([this]() {m_pSpec->Stop();});
+  //Until Stop has dropped the first request, asking again does nothing; after,
+  // the other thread computes it (while Stop waits for the first)
+  for (int i = 0; i < 5000 && m_iComputed == 0; i++) {
+    m_pSpec->Request(1);
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  EXPECT_EQ(1u, m_iComputed);
+  Release();
+  stopper.join();
+  CProbSpeculator::Table table;
+  ASSERT_TRUE(WaitToTake(1, table));
+  ASSERT_TRUE(table == Expected(1, 1));
+}
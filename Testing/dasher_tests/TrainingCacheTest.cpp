@@ -0,0 +1,299 @@
+#include "gtest/gtest.h"
+#include "../../Src/TestPlatform/MockInterfaceBase.h"
+#include "../../Src/TestPlatform/MockSettingsStore.h"
+#include "../../Src/DasherCore/TrainingCache.h"
+#include "../../Src/DasherCore/Trainer.h"
+#include "../../Src/DasherCore/Alphabet/AlphIO.h"
+#include "../../Src/DasherCore/LanguageModelling/LayeredPPMLanguageModel.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace Dasher;
+using namespace std;
+
+/*
+ * Interface with the default alphabet, which trains layered PPM models (whose
+ * base is mapped straight from the cache file) through a CTrainingCache, in the
+ * same way as CNodeCreationManager::Train but on the calling thread.
+ */
+class CCacheTestInterface : public CMockInterfaceBase {
+  public:
+    CCacheTestInterface(CSettingsStore *pSettingsStore, CFileUtils *pFileUtils)
+      : CMockInterfaceBase(pSettingsStore, pFileUtils), m_alphIO(this) {
+      SetLongParameter(LP_LANGUAGE_MODEL_ID, 5);
+      //Without update exclusion, learning into the overlay gives exactly the
+      // counts of learning everything into a single trie
+      SetLongParameter(LP_LM_UPDATE_EXCLUSION, 0);
+      ScanFiles(&m_alphIO, "alphabet*.xml");
+      m_pInfo = m_alphIO.GetInfo(m_alphIO.GetDefault());
+      const int iPara = m_pInfo->GetParagraphSymbol();
+      if (iPara) m_map.AddParagraphSymbol(iPara);
+      for (int i = 1; i < m_pInfo->iEnd; i++)
+        if (i != iPara) m_map.Add(m_pInfo->GetText(i), i);
+    }
+
+    const CAlphInfo *GetInfo() const {return m_pInfo;}
+
+    /*
+     * Makes a model, loads the cache into it if possible and trains on whatever
+     * it doesn't cover, then stores the cache; returns the model.
+     */
+    CLanguageModel *Train(bool &bRestored) {
+      CLanguageModel *pLM = new CLayeredPPMLanguageModel(this, m_pInfo->iEnd - 1);
+      CTrainingCache cache(this, this, m_pInfo, pLM);
+      CTrainer trainer(this, pLM, m_pInfo, &m_map);
+      map<string, off_t> mTails;
+      bRestored = cache.Restore(mTails);
+      if (!bRestored)
+        ScanFiles(&trainer, m_pInfo->GetTrainingFile());
+      TrainTails(trainer, mTails);
+      cache.Store();
+      return pLM;
+    }
+
+    /*
+     * Trains on the text appended to user files since they were cached.
+     */
+    void TrainTails(CTrainer &trainer, const map<string, off_t> &mTails) {
+      for (map<string, off_t>::const_iterator it = mTails.begin(); it != mTails.end(); it++) {
+        //descriptions are "file://" followed by the path
+        ifstream in(it->first.substr(7).c_str(), ios::binary);
+        in.seekg(it->second);
+        trainer.Parse(it->first, in, true);
+      }
+    }
+
+    /*
+     * As CNodeCreationManager::Train for a layered model: loads or trains the
+     * base from the system files, freezes it and stores its cache; then the
+     * same for the overlay and the user files. Returns the model.
+     */
+    CLayeredPPMLanguageModel *TrainLayers(bool &bBaseRestored, bool &bUserRestored) {
+      CLayeredPPMLanguageModel *pLM = new CLayeredPPMLanguageModel(this, m_pInfo->iEnd - 1);
+      CTrainingCache base(this, this, m_pInfo, pLM, false), user(this, this, m_pInfo, pLM, true);
+      CTrainer trainer(this, pLM, m_pInfo, &m_map);
+      map<string, off_t> mTails;
+      bBaseRestored = base.Restore(mTails);
+      if (!bBaseRestored) {
+        COnlyParser system(this, &trainer, false);
+        ScanFiles(&system, m_pInfo->GetTrainingFile());
+      }
+      pLM->Freeze();
+      base.Store();
+      bUserRestored = user.Restore(mTails);
+      if (!bUserRestored) {
+        COnlyParser users(this, &trainer, true);
+        ScanFiles(&users, m_pInfo->GetTrainingFile());
+      }
+      TrainTails(trainer, mTails);
+      user.Store();
+      return pLM;
+    }
+
+    /*
+     * Makes a model trained (without the cache) on each text in turn, as
+     * separate user training files.
+     */
+    CLanguageModel *Learn(const vector<string> &vTexts) {
+      CLanguageModel *pLM = new CLayeredPPMLanguageModel(this, m_pInfo->iEnd - 1);
+      CTrainer trainer(this, pLM, m_pInfo, &m_map);
+      for (vector<string>::const_iterator it = vTexts.begin(); it != vTexts.end(); it++) {
+        istringstream in(*it);
+        trainer.Parse("", in, true);
+      }
+      return pLM;
+    }
+
+    /*
+     * The probabilities the model gives after the given context.
+     */
+    vector<unsigned int> Probs(CLanguageModel *pLM, const string &strContext) {
+      vector<symbol> vSyms;
+      m_map.GetSymbols(vSyms, strContext);
+      CLanguageModel::Context ctx = pLM->CreateEmptyContext();
+      for (vector<symbol>::iterator it = vSyms.begin(); it != vSyms.end(); it++)
+        pLM->EnterSymbol(ctx, *it);
+      vector<unsigned int> vProbs;
+      pLM->GetProbs(ctx, vProbs, 1 << 16, 0);
+      pLM->ReleaseContext(ctx);
+      return vProbs;
+    }
+
+  private:
+    /*
+     * Passes just the system, or just the user, files to a trainer.
+     */
+    class COnlyParser : public AbstractParser {
+      public:
+        COnlyParser(CMessageDisplay *pMsgs, AbstractParser *pTrainer, bool bUser)
+          : AbstractParser(pMsgs), m_pTrainer(pTrainer), m_bUser(bUser) {}
+        bool Parse(const string &strDesc, istream &in, bool bUser) {
+          return bUser != m_bUser || m_pTrainer->Parse(strDesc, in, bUser);
+        }
+      private:
+        AbstractParser *m_pTrainer;
+        bool m_bUser;
+    };
+
+    CAlphIO m_alphIO;
+    const CAlphInfo *m_pInfo;
+    CAlphabetMap m_map;
+};
+
+/*
+ * Test fixture: temporary user and system data directories, the former holding
+ * a user training file made from the start of the system English training text.
+ */
+class TrainingCacheTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      char szDir[] = "/tmp/dasher_cacheXXXXXX";
+      ASSERT_TRUE(mkdtemp(szDir) != NULL);
+      m_strUserDir = szDir;
+      char szSysDir[] = "/tmp/dasher_systemXXXXXX";
+      ASSERT_TRUE(mkdtemp(szSysDir) != NULL);
+      m_strSystemDir = szSysDir;
+      ifstream in("../../Data/training/training_english_GB.txt", ios::binary);
+      m_strText.resize(40000);
+      in.read(&m_strText[0], m_strText.size());
+      m_strText.resize(in.gcount());
+      ASSERT_GT(m_strText.size(), 30000u);
+
+      vector<string> vDirs(1, "../../Data/alphabets");
+      vDirs.push_back(m_strSystemDir);
+      m_pFileUtils = new CMockFileUtils(vDirs, m_strUserDir);
+      m_pIntf = new CCacheTestInterface(&m_settings, m_pFileUtils);
+      m_strTrainingFile = m_strUserDir + "/" + m_pIntf->GetInfo()->GetTrainingFile();
+    }
+
+    virtual void TearDown() {
+      delete m_pIntf;
+      delete m_pFileUtils;
+      RemoveDir(m_strUserDir);
+      RemoveDir(m_strSystemDir);
+    }
+
+    void RemoveDir(const string &strDir) {
+      glob_t files;
+      if (glob((strDir + "/*").c_str(), 0, NULL, &files) == 0) {
+        for (size_t i = 0; i < files.gl_pathc; i++)
+          unlink(files.gl_pathv[i]);
+      }
+      globfree(&files);
+      rmdir(strDir.c_str());
+    }
+
+    void AppendUserText(const string &strText) {
+      ofstream out(m_strTrainingFile.c_str(), ios::binary | ios::app);
+      out << strText;
+    }
+
+    void WriteSystemText(const string &strText) {
+      ofstream out((m_strSystemDir + "/" + m_pIntf->GetInfo()->GetTrainingFile()).c_str(), ios::binary);
+      out << strText;
+    }
+
+    int CountCacheFiles(const string &strPrefix = "lmcache_") {
+      glob_t files;
+      const int iCount = glob((m_strUserDir + "/" + strPrefix + "*.dlf").c_str(), 0, NULL, &files) == 0 ? files.gl_pathc : 0;
+      globfree(&files);
+      return iCount;
+    }
+
+    CMockSettingsStore m_settings;
+    CMockFileUtils *m_pFileUtils;
+    CCacheTestInterface *m_pIntf;
+    string m_strUserDir, m_strSystemDir, m_strTrainingFile, m_strText;
+};
+
+/*
+ * Training stores a cache, which the next run loads instead of training.
+ */
+TEST_F(TrainingCacheTest, StoreThenRestore) {
+  AppendUserText(m_strText);
+  bool bRestored;
+  CLanguageModel *pTrained = m_pIntf->Train(bRestored);
+  ASSERT_FALSE(bRestored);
+  ASSERT_EQ(1, CountCacheFiles());
+  CLanguageModel *pLoaded = m_pIntf->Train(bRestored);
+  ASSERT_TRUE(bRestored);
+  ASSERT_TRUE(m_pIntf->Probs(pTrained, "the ") == m_pIntf->Probs(pLoaded, "the "));
+  delete pTrained;
+  delete pLoaded;
+}
+
+/*
+ * When the user file has been appended to, the cached model is loaded (mapped),
+ * the new text trained, and the cache rewritten - all while the model still
+ * uses the old cache file. That model, and the next one loaded from the
+ * rewritten cache, must both match one trained on the old and new text.
+ */
+TEST_F(TrainingCacheTest, AppendReloadStore) {
+  vector<string> vTexts;
+  vTexts.push_back(m_strText.substr(0, m_strText.size() * 3 / 4));
+  vTexts.push_back(m_strText.substr(vTexts[0].size()));
+  AppendUserText(vTexts[0]);
+  bool bRestored;
+  delete m_pIntf->Train(bRestored);
+  ASSERT_FALSE(bRestored);
+
+  AppendUserText(vTexts[1]);
+  CLanguageModel *pAppended = m_pIntf->Train(bRestored);
+  ASSERT_TRUE(bRestored);
+  ASSERT_EQ(1, CountCacheFiles());
+  CLanguageModel *pReloaded = m_pIntf->Train(bRestored);
+  ASSERT_TRUE(bRestored);
+  CLanguageModel *pExpected = m_pIntf->Learn(vTexts);
+
+  const char *aContexts[] = {"", "the ", "and th", "Dasher", "of the w"};
+  for (size_t i = 0; i < sizeof(aContexts) / sizeof(aContexts[0]); i++) {
+    const vector<unsigned int> vExpected(m_pIntf->Probs(pExpected, aContexts[i]));
+    ASSERT_TRUE(vExpected == m_pIntf->Probs(pAppended, aContexts[i])) << "after \"" << aContexts[i] << "\"";
+    ASSERT_TRUE(vExpected == m_pIntf->Probs(pReloaded, aContexts[i])) << "after \"" << aContexts[i] << "\"";
+  }
+  delete pAppended;
+  delete pReloaded;
+  delete pExpected;
+}
+
+/*
+ * A layered model caches its base, from the system text, apart from its
+ * overlay, from the user's; appending to the user text leaves the base cache
+ * in use, and the reloaded model matches one trained on all the text.
+ */
+TEST_F(TrainingCacheTest, LayersCachedApart) {
+  vector<string> vTexts;
+  vTexts.push_back(m_strText.substr(0, m_strText.size() / 2));
+  vTexts.push_back(m_strText.substr(vTexts[0].size(), m_strText.size() / 4));
+  vTexts.push_back(m_strText.substr(vTexts[0].size() + vTexts[1].size()));
+  WriteSystemText(vTexts[0]);
+  AppendUserText(vTexts[1]);
+  bool bBase, bUser;
+  delete m_pIntf->TrainLayers(bBase, bUser);
+  ASSERT_FALSE(bBase);
+  ASSERT_FALSE(bUser);
+  ASSERT_EQ(1, CountCacheFiles("lmbase_"));
+  ASSERT_EQ(1, CountCacheFiles("lmuser_"));
+
+  AppendUserText(vTexts[2]);
+  CLanguageModel *pAppended = m_pIntf->TrainLayers(bBase, bUser);
+  ASSERT_TRUE(bBase);
+  ASSERT_TRUE(bUser);
+  CLanguageModel *pReloaded = m_pIntf->TrainLayers(bBase, bUser);
+  ASSERT_TRUE(bBase);
+  ASSERT_TRUE(bUser);
+  CLanguageModel *pExpected = m_pIntf->Learn(vTexts);
+
+  const char *aContexts[] = {"", "the ", "and th", "Dasher", "of the w"};
+  for (size_t i = 0; i < sizeof(aContexts) / sizeof(aContexts[0]); i++) {
+    const vector<unsigned int> vExpected(m_pIntf->Probs(pExpected, aContexts[i]));
+    ASSERT_TRUE(vExpected == m_pIntf->Probs(pAppended, aContexts[i])) << "after \"" << aContexts[i] << "\"";
+    ASSERT_TRUE(vExpected == m_pIntf->Probs(pReloaded, aContexts[i])) << "after \"" << aContexts[i] << "\"";
+  }
+  delete pAppended;
+  delete pReloaded;
+  delete pExpected;
+}
@@ -2,3 +2,7 @@
 
 ./EventTest
 ./WordGenTest
+./TrainingCacheTest
+./PPMTrainerTest
+./PPMKeysTest
+./ProbSpeculatorTest